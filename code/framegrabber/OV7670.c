@@ -12,15 +12,38 @@
 #include "hardware/pio.h"
 #include "hardware/i2c.h"
 #include "hardware/uart.h"
+#include "hardware/irq.h"
 
 #include "pwm.pio.h"
 #include "ov7670_qvga_565.pio.h"
 
+#include "ov7670_grab.h"
+#include "ov7670_stream.h"
+#include "ov7670_pio_gen.h"
+#include "sccb.h"
+#include "boot_trace.h"
+
 #include "ov7670_linux.h"
 
-#define IMAGE_WIDTH  320
-#define IMAGE_HEIGHT 240
-#define IMAGE_SIZE   (IMAGE_WIDTH * IMAGE_HEIGHT)  // Total bytes
+// Output size - QVGA by default, changed by ov7670_set_size()
+static uint frame_width = QVGA_WIDTH;
+static uint frame_height = QVGA_HEIGHT;
+static uint frame_bpp = 2;      // YUV422 - 1 for Bayer
+
+// XCLK from init_pwm()
+#define OV7670_XCLK_MHZ 15
+
+// Nominal frame period for clkrc - 784 x 510 pixel times per frame
+// (the QVGA scaler keeps VGA timing), bpp PCLKs per pixel, and PCLK
+// is XCLK / (prescale + 1), or XCLK itself with bit 6 set
+static uint32_t ov7670_nominal_period_us(uint8_t clkrc, uint bpp)
+{
+    uint div = (clkrc & 0x40) ? 1 : (clkrc & 0x3F) + 1;
+    return 784u * 510u * bpp * div / OV7670_XCLK_MHZ;
+}
+
+// deadlines for ov7670_grab_frame() - CLKRC 0x01 from ov7670_init()
+static uint32_t frame_period_us = 784u * 510u * 2 * 2 / OV7670_XCLK_MHZ;
 
 // OV7670 camera pins (Pico 2W)
 #define PCLK_PIN   4  // Pixel clock (INPUT)
@@ -30,6 +53,16 @@
 
 #define OV7670_I2C_ADDR (0x42 >> 1)  // Use 7-bit address for Pico C SDK
 
+// Product ID, read back to see that the sensor is out of reset
+#define OV7670_PID 0x76
+#define OV7670_VER 0x73
+
+// Readiness is polled - these only bound the waits
+#define OV7670_RESET_PULSE_MS   1       // RESET pin low
+#define OV7670_ID_TIMEOUT_MS    100     // RESET pin high -> SCCB answers
+#define OV7670_SWRESET_TIMEOUT_MS 300   // COM7 reset -> registers back
+#define OV7670_SETTLE_FRAMES    2       // frames with unchanged exposure and gain
+
 // PIO used 
 PIO pio = pio0;
 uint sm = 0;
@@ -69,42 +102,38 @@ static void i2c_scan() {
     printf("Scan complete.\n");
 }
 
-// Function to write a single register to OV7670
-static void ov7670_write_reg(i2c_inst_t *i2c, uint8_t reg, uint8_t value) {
-    uint8_t data[2] = {reg, value};
-    i2c_write_blocking(i2c, OV7670_I2C_ADDR, data, 2, false);
-}
-
-// Send a set of registers 
-static void ov7670_config(i2c_inst_t *i2c, const uint8_t* config) {
+// Stage a set of registers (reg, value pairs ending in 0xFF) - see sccb.h
+static void ov7670_config(const uint8_t* config) {
     int i = 0;
     while (config[i] != 0xFF) {  // Check for end marker
-        uint8_t reg = config[i];
-        uint8_t val = config[i + 1];
-        ov7670_write_reg(i2c, reg, val);
+        sccb_set(config[i], config[i + 1]);
         i += 2;
     }
 }
 
 /*
- * Write a list of register settings; ff/ff stops the process.
+ * Stage a list of register settings; ff/ff stops the process.
+ * Nothing is written until sccb_commit().
  */
-static void ov7670_write_array(i2c_inst_t *i2c, struct regval_list *vals)
+static void ov7670_stage_array(struct regval_list *vals)
 {
 	while (vals->reg_num != 0xff || vals->value != 0xff) {
-        ov7670_write_reg(i2c, vals->reg_num, vals->value);
+        sccb_set(vals->reg_num, vals->value);
 		vals++;
 	}
 }
 
 
+// one-shot program, so a grab can put the SM back at its start
+static uint grab_offset;
+
 // Set up the PIO program
 void ov7670_pio_init() {
     
-    uint offset = pio_add_program(pio, &ov7670_qvga_565_program);
+    grab_offset = pio_add_program(pio, &ov7670_qvga_565_program);
     
     // Configure PIO state machine
-    pio_sm_config c = ov7670_qvga_565_program_get_default_config(offset);
+    pio_sm_config c = ov7670_qvga_565_program_get_default_config(grab_offset);
     
     // Map pixel data (GP6-GP13) as input
     sm_config_set_in_pins(&c, DATA_BASE);
@@ -125,7 +154,7 @@ void ov7670_pio_init() {
     }
     
     // Set up state machine
-    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_init(pio, sm, grab_offset, &c);
 
 }
 
@@ -148,7 +177,7 @@ void dma_init(uint8_t* image_buffer) {
         &c,
         (uint32_t *)image_buffer,          // Destination buffer
         &pio->rxf[sm],         // Source: PIO RX FIFO
-        IMAGE_SIZE / 2,        // Transfer 2*320*240 / 4 (since we're using 32-bit transfers)
+        frame_width * frame_height / 2,  // Transfer 2*320*240 / 4 (since we're using 32-bit transfers)
         false                  // Don't start immediately
     );
 }
@@ -245,32 +274,42 @@ void ov7670_init(uint8_t* buffer)
     gpio_set_dir(pin_rst, GPIO_OUT);
     gpio_put(pin_rst, 0);
     // wait
-    sleep_ms(10);
+    sleep_ms(OV7670_RESET_PULSE_MS);
     // set RESET to 1
     gpio_put(pin_rst, 1);
-    // wait
-    sleep_ms(10);
+    boot_trace_mark("reset pin");
+
+    // i2c init - 400 kHz, registers go through the shadow cache
+    sccb_init(i2c0, OV7670_I2C_ADDR, SCCB_BAUD);
+
+    // wait until the sensor answers with its ID
+    if (!sccb_poll(REG_PID, 0xFF, OV7670_PID, OV7670_ID_TIMEOUT_MS) ||
+        !sccb_poll(REG_VER, 0xFF, OV7670_VER, OV7670_ID_TIMEOUT_MS)) {
+        printf("OV7670: no sensor ID after %u ms\n", OV7670_ID_TIMEOUT_MS);
+    }
+    boot_trace_mark("sensor id");
 
     // ****************************************
     // END of Reset/PWR sequence
     // ****************************************
 
-    // i2c init
-    i2c_init(i2c0, 100 * 1000);
-
     // I2C scan - for testing 
     //i2c_scan();
 
-    // reset OV7670 using reg 
-    ov7670_write_reg(i2c0, 0x12, 0x80);
-    // wait 
-    sleep_ms(300);
+    // reset OV7670 using reg, wait for it, and read back the defaults
+    if (!sccb_reset(OV7670_SWRESET_TIMEOUT_MS)) {
+        printf("OV7670: register reset timed out\n");
+    }
+    boot_trace_mark("register reset");
 
     // set default 
-    //ov7670_write_array(i2c0, ov7670_default_regs);
+    //ov7670_stage_array(ov7670_default_regs);
 
     // send OV7670 config
-    ov7670_write_array(i2c0, ds_qvga_yuv_config2);
+    sccb_begin();
+    ov7670_stage_array(ds_qvga_yuv_config2);
+    sccb_commit();
+    boot_trace_mark("config");
 
 #if 0 // linux
     // set default 
@@ -310,22 +349,546 @@ void ov7670_init(uint8_t* buffer)
     dma_init(buffer);
 }
 
-// Grab a 320x420 frame 
-void ov7670_grab_frame()
+/*
+ * Stage the output window - from ov7670_set_hw() in the Linux driver.
+ *
+ * Horizontal: 11 bits, top 8 live in hstart and hstop.  Bottom 3 of
+ * hstart are in href[2:0], bottom 3 of hstop in href[5:3].  There is
+ * a mystery "edge offset" value in the top two bits of href.
+ *
+ * The driver reads HREF/VREF back and sleeps before writing them; the
+ * staged value already holds the other bits, so there is nothing to
+ * read or wait for.
+ */
+static void ov7670_set_hw(int hstart, int hstop, int vstart, int vstop)
+{
+    uint8_t v;
+
+    sccb_set(REG_HSTART, (hstart >> 3) & 0xff);
+    sccb_set(REG_HSTOP, (hstop >> 3) & 0xff);
+    v = sccb_get(REG_HREF);
+    v = (v & 0xc0) | ((hstop & 0x7) << 3) | (hstart & 0x7);
+    sccb_set(REG_HREF, v);
+
+    // Vertical: similar arrangement, but only 10 bits.
+    sccb_set(REG_VSTART, (vstart >> 2) & 0xff);
+    sccb_set(REG_VSTOP, (vstop >> 2) & 0xff);
+    v = sccb_get(REG_VREF);
+    v = (v & 0xf0) | ((vstop & 0x3) << 2) | (vstart & 0x3);
+    sccb_set(REG_VREF, v);
+}
+
+// YUYV on top of ov7670_fmt_yuv422 - same as ds_qvga_yuv_config2
+static struct regval_list vga_yuv_extra[] = {
+    { REG_COM3, 0x00 },     // no downsampling/scaling
+    { REG_COM14, 0x00 },
+    { REG_TSLB, 0x04 },     // 0D = UYVY  04 = YUYV	 - REQUIRED!
+    { REG_COM13, 0x00 },    // connect to REG_TSLB
+    { 0xB0, 0x84 },         // magic
+    { 0xff, 0xff },
+};
+
+// Set YUV422 output size. QVGA uses the downscaled config from 
+// ov7670_init(); VGA uses the full sensor window from ov7670_win_sizes. 
+// clkrc is the clock prescaler - a slow link needs a slower PCLK 
+// to keep up with line-at-a-time streaming. Only registers that 
+// differ from the current mode are written - no reset. Returns 
+// false for unsupported sizes.
+bool ov7670_set_size(uint width, uint height, uint8_t clkrc)
+{
+    if (width == QVGA_WIDTH && height == QVGA_HEIGHT) {
+        sccb_begin();
+        ov7670_stage_array(ds_qvga_yuv_config2);
+    } else if (width == VGA_WIDTH && height == VGA_HEIGHT) {
+        struct ov7670_win_size* wsize = &ov7670_win_sizes[0];
+
+        sccb_begin();
+        sccb_set(REG_COM7, ov7670_fmt_yuv422[0].value | wsize->com7_bit);
+        ov7670_stage_array(ov7670_fmt_yuv422 + 1);
+        ov7670_set_hw(wsize->hstart, wsize->hstop, wsize->vstart, wsize->vstop);
+        ov7670_stage_array(vga_yuv_extra);
+    } else {
+        return false;
+    }
+
+    // COM7 first and CLKRC last - sccb_commit() keeps that order
+    sccb_set(REG_CLKRC, clkrc);
+    sccb_commit();
+
+    frame_width = width;
+    frame_height = height;
+    frame_bpp = 2;
+    frame_period_us = ov7670_nominal_period_us(clkrc, frame_bpp);
+    return true;
+}
+
+// Raw Bayer (BGGR, 1 byte per pixel) straight from the sensor array. 
+// The scaler only works on processed output, so Bayer always runs with 
+// VGA timing - a smaller size is a centred window of the array, not a 
+// downscale. The window offsets are kept even so the first pixel is 
+// still B. clkrc as for ov7670_set_size(). Returns false for sizes 
+// over VGA or odd sizes.
+bool ov7670_set_bayer(uint width, uint height, uint8_t clkrc)
+{
+    if (width == 0 || height == 0 || width > VGA_WIDTH || height > VGA_HEIGHT ||
+        (width & 1) || (height & 1)) {
+        return false;
+    }
+    struct ov7670_win_size* wsize = &ov7670_win_sizes[0];
+
+    sccb_begin();
+    sccb_set(REG_COM7, ov7670_fmt_raw[0].value | wsize->com7_bit);
+    ov7670_stage_array(ov7670_fmt_raw + 1);
+
+    // HSTART/HSTOP count 784 per line, wrapping - see ov7670_win_sizes
+    int x = wsize->hstart + (int)(((VGA_WIDTH - width) / 2) & ~1u);
+    int y = wsize->vstart + (int)(((VGA_HEIGHT - height) / 2) & ~1u);
+    ov7670_set_hw(x % 784, (x + (int)width) % 784, y, y + (int)height);
+
+    // COM7 first and CLKRC last - sccb_commit() keeps that order
+    sccb_set(REG_CLKRC, clkrc);
+    sccb_commit();
+
+    frame_width = width;
+    frame_height = height;
+    frame_bpp = 1;
+    frame_period_us = ov7670_nominal_period_us(clkrc, frame_bpp);
+    return true;
+}
+
+// Wait for a VSYNC rising edge - false if deadline passes first
+static bool ov7670_wait_vsync(absolute_time_t deadline)
 {
+    while (gpio_get(VSYNC_PIN)) {
+        if (time_reached(deadline)) {
+            return false;
+        }
+    }
+    while (!gpio_get(VSYNC_PIN)) {
+        if (time_reached(deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Wait until frames are coming out and auto exposure has settled - 
+// exposure and gain unchanged for OV7670_SETTLE_FRAMES frames. Call 
+// after the last mode change, before capture starts. Returns false 
+// if that takes longer than timeout_ms; capture works either way, 
+// the first frames may just be too dark or bright. The VSYNCs waited 
+// for also measure the frame period the grab deadlines use.
+bool ov7670_wait_ready(uint timeout_ms)
+{
+    absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+
+    if (!ov7670_wait_vsync(deadline)) {
+        boot_trace_mark("no vsync");
+        return false;
+    }
+    boot_trace_mark("vsync");
+    uint32_t vsync_us = time_us_32();
+
+    uint8_t last[3] = { 0 };
+    uint stable = 0;
+    for (uint frame = 0; stable < OV7670_SETTLE_FRAMES; frame++) {
+        if (!ov7670_wait_vsync(deadline)) {
+            boot_trace_mark("exposure timeout");
+            return false;
+        }
+        uint32_t now_us = time_us_32();
+        frame_period_us = now_us - vsync_us;
+        vsync_us = now_us;
+
+        // AECHH, AECH and GAIN - read during the vertical blank
+        uint8_t now[3];
+        sccb_read(REG_AECHH, &now[0]);
+        sccb_read(REG_AECH, &now[1]);
+        sccb_read(REG_GAIN, &now[2]);
+        bool same = frame > 0 && now[0] == last[0] && now[1] == last[1] && now[2] == last[2];
+        stable = same ? stable + 1 : 0;
+        last[0] = now[0];
+        last[1] = now[1];
+        last[2] = now[2];
+    }
+    boot_trace_mark("exposure settled");
+    return true;
+}
+
+uint ov7670_get_width()
+{
+    return frame_width;
+}
+
+uint ov7670_get_height()
+{
+    return frame_height;
+}
+
+static ov7670_grab_stats_t grab_stats;
+static bool grab_failed;
+
+// Stop the one-shot SM and its DMA, drop what is in the FIFOs and put
+// the SM back at the pull at the start of the program - it never gets
+// there by itself, the program wraps over lines
+static void ov7670_grab_reset()
+{
+    dma_channel_abort(dma_chan);
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(grab_offset));
+}
+
+// Grab a frame of the current size and format into buffer - see 
+// ov7670_grab.h for the deadlines
+bool ov7670_grab_frame(uint8_t* buffer)
+{
+    uint32_t period = frame_period_us;
+
+    // every grab starts from the top of the program, so it waits on a 
+    // fresh VSYNC whatever the last one left behind
+    ov7670_grab_reset();
+
+    dma_channel_set_trans_count(dma_chan, frame_width * frame_height * frame_bpp / 4, false);
+    dma_channel_set_write_addr(dma_chan, buffer, false);
+
     // start DMA 
     dma_channel_start(dma_chan);
 
     // enable PIO
-    pio_sm_set_enabled(pio, 0, true);
+    pio_sm_set_enabled(pio, sm, true);
+
+    // put (bytes per line - 1) into TX FIFO which will push auto-pulled to ISR - 
+    // the FIFO was just cleared, so this can't block
+    pio_sm_put(pio, sm, frame_bpp * frame_width - 1);
+    grab_stats.grabs++;
+
+    // the SM starts on the first VSYNC falling edge after it is 
+    // enabled - watch for the same one
+    uint32_t start = time_us_32();
+    uint32_t limit = period / 100 * OV7670_GRAB_START_PCT;
+    bool vsync = gpio_get(VSYNC_PIN);
+    bool started = false;
+    bool ok = true;
+
+    while (ok && dma_channel_is_busy(dma_chan)) {
+        uint32_t now = time_us_32();
+        bool v = gpio_get(VSYNC_PIN);
+
+        if (now - start > limit) {
+            grab_stats.timeouts++;
+            ok = false;
+        } else if (vsync && !v && !started) {
+            started = true;
+            start = now;
+            limit = period / 100 * OV7670_GRAB_FRAME_PCT;
+        } else if (!vsync && v && started) {
+            grab_stats.short_frames++;
+            ok = false;
+        }
+        vsync = v;
+    }
 
-    // put (2*width - 1) into TX FIFO which will push auto-pulled to ISR
-    pio_sm_put_blocking(pio, 0, 639);
-    
-    // wait for DMA to finish 
-    dma_channel_wait_for_finish_blocking(dma_chan);
+    if (!ok) {
+        ov7670_grab_reset();
+        grab_failed = true;
+        return false;
+    }
 
     // disable PIO
-    pio_sm_set_enabled(pio, 0, false);
+    pio_sm_set_enabled(pio, sm, false);
 
-}
\ No newline at end of file
+    if (grab_failed) {
+        grab_failed = false;
+        grab_stats.recoveries++;
+    }
+    return true;
+}
+
+uint32_t ov7670_get_frame_period_us()
+{
+    return frame_period_us;
+}
+
+void ov7670_get_grab_stats(ov7670_grab_stats_t* out)
+{
+    *out = grab_stats;
+    out->frame_period_us = frame_period_us;
+}
+
+// ****************************************
+// Streaming capture
+// ****************************************
+
+// SM used for streaming - sm 0 is used by the one-shot grab
+uint stream_sm = 1;
+
+// capture program built from the descriptor
+static ov7670_capture_desc_t stream_desc;
+static ov7670_pio_gen_t stream_gen;
+static pio_program_t stream_program;
+static uint stream_offset;
+// the one-shot program was unloaded to make room
+static bool stream_took_grab;
+
+static int stream_dma_chan[2];
+static dma_channel_config stream_dma_cfg[2];
+static ov7670_stream_cb_t stream_cb;
+static volatile bool streaming = false;
+
+// band geometry
+static uint stream_band_lines;
+static uint stream_band_words;
+
+// what each channel is filling, and the next band to arm
+static uint8_t* stream_dest[2];
+static uint stream_line[2];
+static uint stream_arm_line;
+
+// dropped bands all go to this one word
+static uint32_t stream_discard;
+
+static volatile uint32_t stream_frames;
+static volatile uint32_t stream_dropped;
+static volatile uint32_t stream_bands;
+static volatile uint32_t stream_bands_discarded;
+static volatile uint32_t stream_last_us;
+static volatile uint32_t stream_period_us;
+
+// Queue the line count and line length for the next frame
+static inline void stream_push_frame_params()
+{
+    pio_sm_put(pio, stream_sm, stream_desc.height - 1);
+    pio_sm_put(pio, stream_sm, ov7670_capture_line_bytes(&stream_desc) - 1);
+}
+
+// Point channel i at the next band. Called while the other channel 
+// is running, so this channel is idle until the chain triggers it.
+static void stream_arm(int i)
+{
+    uint line = stream_arm_line;
+    stream_arm_line = (line + stream_band_lines) % stream_desc.height;
+
+    uint8_t* dest = stream_cb.band_dest(line, stream_cb.ctx);
+    stream_line[i] = line;
+    stream_dest[i] = dest;
+
+    // a dropped band is written over a single word
+    dma_channel_config c = stream_dma_cfg[i];
+    channel_config_set_write_increment(&c, dest != NULL);
+    dma_channel_set_config(stream_dma_chan[i], &c, false);
+    if (dest) {
+        dma_channel_set_write_addr(stream_dma_chan[i], dest, false);
+    } else {
+        dma_channel_set_write_addr(stream_dma_chan[i], &stream_discard, false);
+        stream_bands_discarded++;
+    }
+}
+
+// Frame rate and dropped frame accounting at the end of each frame
+static void stream_frame_end()
+{
+    uint32_t now = time_us_32();
+    if (stream_frames > 0) {
+        uint32_t delta = now - stream_last_us;
+        if (stream_period_us == 0) {
+            stream_period_us = delta;
+        } else {
+            // frames missed while waiting on VSYNC show up as a long gap
+            uint32_t missed = (delta + stream_period_us / 2) / stream_period_us;
+            if (missed > 1) {
+                stream_dropped += missed - 1;
+            } else {
+                // smooth period over ~8 frames
+                stream_period_us += ((int32_t)(delta - stream_period_us)) / 8;
+            }
+        }
+    }
+    stream_last_us = now;
+    stream_frames++;
+}
+
+// DMA IRQ - one of the two ping-pong channels has filled its band.
+// The other channel was started by the chain, so we only need to
+// hand the band off and point this one at the band after that.
+static void stream_dma_irq_handler()
+{
+    for (int i = 0; i < 2; i++) {
+        uint chan = stream_dma_chan[i];
+        if (!dma_channel_get_irq0_status(chan)) {
+            continue;
+        }
+        dma_channel_acknowledge_irq0(chan);
+
+        uint line = stream_line[i];
+        stream_bands++;
+
+        if (line + stream_band_lines == stream_desc.height) {
+            // keep the SM fed with params - TX FIFO holds 2 frames worth
+            if (pio_sm_get_tx_fifo_level(pio, stream_sm) <= 2) {
+                stream_push_frame_params();
+            }
+            stream_frame_end();
+        }
+
+        if (stream_dest[i]) {
+            stream_cb.band_done(stream_dest[i], line, stream_band_lines, stream_cb.ctx);
+        }
+
+        stream_arm(i);
+    }
+}
+
+// Configure one ping-pong channel reading the SM RX FIFO and chaining to chain_to
+static void stream_dma_configure(int i, uint chain_to)
+{
+    uint chan = stream_dma_chan[i];
+    dma_channel_config c = dma_channel_get_default_config(chan);
+
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, stream_sm, false));
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_chain_to(&c, chain_to);
+    stream_dma_cfg[i] = c;
+
+    dma_channel_configure(
+        chan,
+        &c,
+        NULL,                   // set by stream_arm()
+        &pio->rxf[stream_sm],
+        stream_band_words,
+        false
+    );
+
+    dma_channel_set_irq0_enabled(chan, true);
+}
+
+// Descriptor for the full sensor output on our pins - crop from here
+void ov7670_capture_desc_default(ov7670_capture_desc_t* desc)
+{
+    desc->vsync_pin = VSYNC_PIN;
+    desc->href_pin = HREF_PIN;
+    desc->pclk_pin = PCLK_PIN;
+    desc->data_base = DATA_BASE;
+    desc->skip_lines = 0;
+    desc->skip_pixels = 0;
+    desc->bytes_per_pixel = 2;
+    desc->luma_only = false;
+    desc->width = frame_width;
+    desc->height = frame_height;
+}
+
+// Start continuous capture of the window in desc, in bands of 
+// band_lines lines (which must divide desc->height). The capture 
+// program is generated from desc. The callbacks run from the DMA 
+// IRQ - see ov7670_stream.h. Returns false if desc can't be captured.
+bool ov7670_stream_start(const ov7670_capture_desc_t* desc, uint band_lines,
+                         const ov7670_stream_cb_t* cb)
+{
+    if (streaming) {
+        return false;
+    }
+
+    uint line_bytes = ov7670_capture_line_bytes(desc);
+    if (desc->height % band_lines || (line_bytes * band_lines) % 4) {
+        return false;
+    }
+    if (!ov7670_pio_gen(desc, &stream_gen)) {
+        return false;
+    }
+    stream_program.instructions = stream_gen.instr;
+    stream_program.length = stream_gen.length;
+    stream_program.origin = -1;
+
+    // shares pio0 with the one-shot program - long skips need more 
+    // than the slots it leaves, so it is taken out until we stop, and
+    // pio_add_program() would panic if even that isn't enough
+    stream_took_grab = !pio_can_add_program(pio, &stream_program);
+    if (stream_took_grab) {
+        pio_remove_program(pio, &ov7670_qvga_565_program, grab_offset);
+        if (!pio_can_add_program(pio, &stream_program)) {
+            pio_add_program_at_offset(pio, &ov7670_qvga_565_program, grab_offset);
+            printf("OV7670: capture program of %u instructions doesn't fit in PIO memory\n",
+                   stream_gen.length);
+            return false;
+        }
+    }
+
+    stream_desc = *desc;
+    stream_cb = *cb;
+    stream_band_lines = band_lines;
+    stream_band_words = band_lines * line_bytes / 4;
+    stream_arm_line = 0;
+    stream_frames = 0;
+    stream_dropped = 0;
+    stream_bands = 0;
+    stream_bands_discarded = 0;
+    stream_period_us = 0;
+
+    // load generated program - pins were set up in ov7670_pio_init()
+    stream_offset = pio_add_program(pio, &stream_program);
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, stream_offset + stream_gen.wrap_target, stream_offset + stream_gen.wrap);
+    sm_config_set_in_pins(&c, desc->data_base);
+    sm_config_set_in_shift(&c, true, true, 32);  // Auto-Push, shift-right, threshold 32 bits
+    pio_sm_init(pio, stream_sm, stream_offset, &c);
+
+    // two channels chained to each other
+    stream_dma_chan[0] = dma_claim_unused_channel(true);
+    stream_dma_chan[1] = dma_claim_unused_channel(true);
+    stream_dma_configure(0, stream_dma_chan[1]);
+    stream_dma_configure(1, stream_dma_chan[0]);
+    stream_arm(0);
+    stream_arm(1);
+
+    irq_set_exclusive_handler(DMA_IRQ_0, stream_dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // params for first two frames
+    stream_push_frame_params();
+    stream_push_frame_params();
+
+    streaming = true;
+    dma_channel_start(stream_dma_chan[0]);
+    pio_sm_set_enabled(pio, stream_sm, true);
+    return true;
+}
+
+// Stop continuous capture and release the DMA channels
+void ov7670_stream_stop()
+{
+    if (!streaming) {
+        return;
+    }
+
+    pio_sm_set_enabled(pio, stream_sm, false);
+    irq_set_enabled(DMA_IRQ_0, false);
+
+    for (int i = 0; i < 2; i++) {
+        dma_channel_set_irq0_enabled(stream_dma_chan[i], false);
+        dma_channel_abort(stream_dma_chan[i]);
+        dma_channel_acknowledge_irq0(stream_dma_chan[i]);
+        dma_channel_unclaim(stream_dma_chan[i]);
+    }
+
+    pio_sm_clear_fifos(pio, stream_sm);
+    pio_sm_restart(pio, stream_sm);
+    pio_remove_program(pio, &stream_program, stream_offset);
+    if (stream_took_grab) {
+        pio_add_program_at_offset(pio, &ov7670_qvga_565_program, grab_offset);
+    }
+    streaming = false;
+}
+
+// Snapshot of streaming counters
+void ov7670_stream_get_stats(ov7670_stream_stats_t* stats)
+{
+    stats->frames = stream_frames;
+    stats->dropped = stream_dropped;
+    stats->bands = stream_bands;
+    stats->bands_discarded = stream_bands_discarded;
+    stats->frame_period_us = stream_period_us;
+}
@@ -375,4 +375,16 @@ static const uint8_t arduino_config[] = {
 
 
 void ov7670_init(uint8_t* buffer);
-void ov7670_grab_frame();
+
+// Output size - 320x240 and 640x480 YUV422 are supported
+bool ov7670_set_size(uint width, uint height, uint8_t clkrc);
+// Raw BGGR Bayer - VGA, or a centred window of it
+bool ov7670_set_bayer(uint width, uint height, uint8_t clkrc);
+// Wait for VSYNC and settled exposure instead of a fixed delay
+bool ov7670_wait_ready(uint timeout_ms);
+uint ov7670_get_width();
+uint ov7670_get_height();
+
+
+#include "ov7670_grab.h"
+#include "ov7670_stream.h"
@@ -0,0 +1,44 @@
+/*
+    In-place bit reversal of every byte in a buffer - see bitrev.h.
+*/
+
+#include "bitrev.h"
+
+static inline uint8_t bitrev_byte(uint8_t b)
+{
+    return (uint8_t)bitrev_word(b);
+}
+
+void bitrev_bytes(uint8_t* buf, size_t len)
+{
+    // leading bytes up to word alignment
+    while (len && ((uintptr_t)buf & 3)) {
+        *buf = bitrev_byte(*buf);
+        buf++;
+        len--;
+    }
+
+    // 4 words per iteration
+    uint32_t* w = (uint32_t*)buf;
+    size_t words = len / 4;
+    while (words >= 4) {
+        w[0] = bitrev_word(w[0]);
+        w[1] = bitrev_word(w[1]);
+        w[2] = bitrev_word(w[2]);
+        w[3] = bitrev_word(w[3]);
+        w += 4;
+        words -= 4;
+    }
+    while (words--) {
+        *w = bitrev_word(*w);
+        w++;
+    }
+
+    // trailing bytes
+    buf = (uint8_t*)w;
+    len &= 3;
+    while (len--) {
+        *buf = bitrev_byte(*buf);
+        buf++;
+    }
+}
@@ -0,0 +1,52 @@
+/*
+
+    bitrev.h 
+
+    In-place bit reversal of every byte in a buffer.
+
+    D0-D7 of the OV7670 are connected to GP13-GP6, so every byte 
+    captured by the PIO has its bits reversed. These fix that up 
+    a 32-bit word at a time.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Reverse bits of each byte in buf[0..len)
+void bitrev_bytes(uint8_t* buf, size_t len);
+
+// rbit reverses the whole word. A host test can define 
+// BITREV_HAVE_RBIT and its own bitrev_rbit() to run the rbit path.
+#if !defined(BITREV_HAVE_RBIT) && \
+    (defined(__ARM_ARCH_8M_MAIN__) || defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__))
+#define BITREV_HAVE_RBIT 1
+static inline uint32_t bitrev_rbit(uint32_t w)
+{
+    __asm__ ("rbit %0, %1" : "=r" (w) : "r" (w));
+    return w;
+}
+#endif
+
+// Reverse bits of each byte in a word - swap nibbles, then bit pairs, 
+// then bits, within each byte
+static inline uint32_t bitrev_word_portable(uint32_t w)
+{
+    w = ((w & 0xF0F0F0F0u) >> 4) | ((w & 0x0F0F0F0Fu) << 4);
+    w = ((w & 0xCCCCCCCCu) >> 2) | ((w & 0x33333333u) << 2);
+    w = ((w & 0xAAAAAAAAu) >> 1) | ((w & 0x55555555u) << 1);
+    return w;
+}
+
+// Reverse bits of each byte in a single 32-bit word
+static inline uint32_t bitrev_word(uint32_t w)
+{
+#ifdef BITREV_HAVE_RBIT
+    // rbit also reverses byte order - rev puts the bytes back where 
+    // they were
+    return __builtin_bswap32(bitrev_rbit(w));
+#else
+    return bitrev_word_portable(w);
+#endif
+}
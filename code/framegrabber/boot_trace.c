@@ -0,0 +1,40 @@
+/*
+    Boot timeline - see boot_trace.h.
+*/
+
+#include <stdio.h>
+
+#include "boot_trace.h"
+
+static boot_phase_t phases[BOOT_TRACE_MAX];
+static uint num_phases;
+
+void boot_trace_mark(const char* name)
+{
+    if (num_phases == BOOT_TRACE_MAX) {
+        return;
+    }
+    uint32_t now = time_us_32();
+    uint32_t prev = num_phases ? phases[num_phases - 1].end_us : 0;
+    phases[num_phases++] = (boot_phase_t){ name, now, now - prev };
+}
+
+uint boot_trace_get(const boot_phase_t** p)
+{
+    *p = phases;
+    return num_phases;
+}
+
+void boot_trace_print()
+{
+    printf("boot timeline:\n");
+    for (uint i = 0; i < num_phases; i++) {
+        printf("  %-20s %8lu us  (at %lu us)\n", phases[i].name,
+               (unsigned long)phases[i].duration_us, (unsigned long)phases[i].end_us);
+    }
+}
+
+void boot_trace_clear()
+{
+    num_phases = 0;
+}
@@ -0,0 +1,34 @@
+/*
+
+    boot_trace.h
+
+    Boot timeline. Each init phase is marked as it ends, so the time
+    from power-on to the first capture can be broken down by phase.
+    Times are from boot (time_us_32()).
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+#define BOOT_TRACE_MAX 16
+
+typedef struct {
+    const char* name;
+    uint32_t end_us;        // since boot
+    uint32_t duration_us;   // since the previous mark
+} boot_phase_t;
+
+// End the current phase - name says what it was. Marks past BOOT_TRACE_MAX are dropped.
+void boot_trace_mark(const char* name);
+
+// Phases so far - returns the count
+uint boot_trace_get(const boot_phase_t** phases);
+
+// Timeline on stdout
+void boot_trace_print();
+
+// Drop every mark - the next phase starts at boot again
+void boot_trace_clear();
@@ -0,0 +1,281 @@
+/*
+    Host commands on UART RX - see cmd.h.
+*/
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+#include "cmd.h"
+#include "spsc_queue.h"
+#include "frame_proto.h"
+#include "frame_ring.h"
+#include "sccb.h"
+#include "ov7670_grab.h"
+#include "event.h"
+
+#define CMD_NUM_OPS     (CMD_OP_STATS + 1)
+
+// cmd_stats_t, frame_ring_stats_t, sccb_stats_t and ov7670_grab_stats_t as u32 words
+#define CMD_STATS_WORDS ((sizeof(cmd_stats_t) + sizeof(frame_ring_stats_t) + \
+                          sizeof(sccb_stats_t) + sizeof(ov7670_grab_stats_t)) / 4)
+
+// payload bytes per opcode - -1 is not a command
+static const int8_t payload_len[CMD_NUM_OPS] = {
+    [0]                 = -1,
+    [CMD_OP_CREDIT]     = 4,
+    [CMD_OP_PING]       = 0,
+    [CMD_OP_CAPTURE]    = 2,
+    [CMD_OP_STREAM]     = 1,
+    [CMD_OP_FORMAT]     = 6,
+    [CMD_OP_REG_READ]   = 1,
+    [CMD_OP_REG_WRITE]  = 2,
+    [CMD_OP_STATS]      = 0,
+};
+
+typedef struct {
+    uint8_t op;
+    uint8_t payload[CMD_MAX_PAYLOAD];
+    uint32_t rx_us;         // time the last byte arrived
+} cmd_msg_t;
+
+static uart_inst_t* rx_uart;
+static transport_t* transport;
+static cmd_handlers_t handlers;
+
+// RX IRQ -> cmd_poll()
+static cmd_msg_t queue_storage[CMD_QUEUE_LEN + 1];
+static spsc_queue_t queue;
+
+// RX parser state
+static uint8_t rx_msg[2 + CMD_MAX_PAYLOAD + CMD_CRC_LEN];
+static uint rx_len;
+static uint32_t rx_last_us;
+
+static uint8_t ack[CMD_ACK_HEADER_LEN + CMD_STATS_WORDS * 4 + 4];
+
+static cmd_stats_t stats;
+
+static inline uint16_t get_u16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline uint32_t get_u32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+// A complete message - credit is added now, the rest wait for cmd_poll()
+static void cmd_dispatch()
+{
+    if (rx_msg[1] == CMD_OP_CREDIT) {
+        if (handlers.credit) {
+            handlers.credit(get_u32(rx_msg + 2));
+        }
+        stats.credits++;
+        event_post(EVENT_CMD);
+        return;
+    }
+
+    cmd_msg_t msg;
+    msg.op = rx_msg[1];
+    memcpy(msg.payload, rx_msg + 2, CMD_MAX_PAYLOAD);
+    msg.rx_us = time_us_32();
+    if (!spsc_push(&queue, &msg)) {
+        stats.dropped++;
+        return;
+    }
+    event_post(EVENT_CMD);
+}
+
+// Drop the bytes before from, then skip to the next sync - the bytes
+// skipped count as errors, as they would have arriving on their own
+static void cmd_rx_resync(uint from)
+{
+    uint i = from;
+    while (i < rx_len && rx_msg[i] != CMD_SYNC) {
+        stats.rx_errors++;
+        i++;
+    }
+    rx_len -= i;
+    memmove(rx_msg, rx_msg + i, rx_len);
+}
+
+// One byte of a message
+static void cmd_rx_byte(uint8_t b)
+{
+    if (rx_len == 0 && b != CMD_SYNC) {
+        stats.rx_errors++;
+        return;
+    }
+    rx_msg[rx_len++] = b;
+
+    // after a resync the buffer can hold a bad opcode or a whole
+    // message already, so go on until it is waiting for bytes
+    while (rx_len >= 2) {
+        uint8_t op = rx_msg[1];
+        if (op >= CMD_NUM_OPS || payload_len[op] < 0) {
+            // not an opcode - a second sync may start the real message
+            stats.rx_errors++;
+            cmd_rx_resync(op == CMD_SYNC ? 1 : 2);
+            continue;
+        }
+
+        uint len = 2 + (uint)payload_len[op];
+        if (rx_len < len + CMD_CRC_LEN) {
+            return;
+        }
+        if (crc32_calc(rx_msg, len) == get_u32(rx_msg + len)) {
+            cmd_dispatch();
+            cmd_rx_resync(len + CMD_CRC_LEN);
+        } else {
+            // the sync may have been a data byte, or a lost byte pulled
+            // the start of the next message into this one, so look
+            // for a sync after it
+            stats.rx_errors++;
+            cmd_rx_resync(1);
+        }
+    }
+}
+
+// UART RX IRQ - collect messages byte by byte
+static void cmd_rx_irq()
+{
+    while (uart_is_readable(rx_uart)) {
+        uint8_t b = uart_getc(rx_uart);
+        uint32_t now = time_us_32();
+
+        // the rest of a message that lost bytes - start over
+        if (rx_len > 0 && now - rx_last_us > CMD_RX_TIMEOUT_US) {
+            stats.rx_errors++;
+            rx_len = 0;
+        }
+        rx_last_us = now;
+
+        cmd_rx_byte(b);
+    }
+}
+
+void cmd_init(uart_inst_t* uart, transport_t* t, const cmd_handlers_t* h)
+{
+    rx_uart = uart;
+    transport = t;
+    handlers = *h;
+
+    spsc_init(&queue, queue_storage, sizeof(cmd_msg_t), CMD_QUEUE_LEN);
+    rx_len = 0;
+    stats = (cmd_stats_t){0};
+
+    irq_set_exclusive_handler(UART_IRQ_NUM(uart), cmd_rx_irq);
+    irq_set_enabled(UART_IRQ_NUM(uart), true);
+    uart_set_irq_enables(uart, true, false);
+}
+
+// Counters for STATS - every field of the four structs is a uint32_t
+static uint cmd_stats_payload(uint8_t* p)
+{
+    uint32_t words[CMD_STATS_WORDS];
+    cmd_stats_t cs;
+    frame_ring_stats_t rs;
+    sccb_stats_t ss;
+    ov7670_grab_stats_t gs;
+
+    cmd_get_stats(&cs);
+    frame_ring_get_stats(&rs);
+    sccb_get_stats(&ss);
+    ov7670_get_grab_stats(&gs);
+    memcpy(words, &cs, sizeof(cs));
+    memcpy((uint8_t*)words + sizeof(cs), &rs, sizeof(rs));
+    memcpy((uint8_t*)words + sizeof(cs) + sizeof(rs), &ss, sizeof(ss));
+    memcpy((uint8_t*)words + sizeof(cs) + sizeof(rs) + sizeof(ss), &gs, sizeof(gs));
+
+    for (uint i = 0; i < CMD_STATS_WORDS; i++) {
+        put_u32(p + i * 4, words[i]);
+    }
+    return CMD_STATS_WORDS * 4;
+}
+
+// Run one command - the ack payload goes to p, its length to *len
+static cmd_status_t cmd_run(const cmd_msg_t* msg, uint8_t* p, uint* len)
+{
+    const uint8_t* arg = msg->payload;
+    *len = 0;
+
+    switch (msg->op) {
+    case CMD_OP_PING:
+        return CMD_OK;
+
+    case CMD_OP_CAPTURE:
+        return handlers.capture ? handlers.capture(get_u16(arg)) : CMD_ERR_UNSUPPORTED;
+
+    case CMD_OP_STREAM:
+        return handlers.stream ? handlers.stream(arg[0] != 0) : CMD_ERR_UNSUPPORTED;
+
+    case CMD_OP_FORMAT:
+        return handlers.format ? handlers.format(arg[0], get_u16(arg + 1), get_u16(arg + 3), arg[5])
+                               : CMD_ERR_UNSUPPORTED;
+
+    case CMD_OP_REG_READ:
+        *len = 1;
+        if (!sccb_read(arg[0], p)) {
+            p[0] = 0;
+            return CMD_ERR_BUS;
+        }
+        return CMD_OK;
+
+    case CMD_OP_REG_WRITE:
+        return sccb_write(arg[0], arg[1]) ? CMD_OK : CMD_ERR_BUS;
+
+    case CMD_OP_STATS:
+        *len = cmd_stats_payload(p);
+        return CMD_OK;
+    }
+    return CMD_ERR_UNSUPPORTED;
+}
+
+uint cmd_poll()
+{
+    cmd_msg_t msg;
+    uint n = 0;
+
+    while (spsc_pop(&queue, &msg)) {
+        uint len;
+        cmd_status_t status = cmd_run(&msg, ack + CMD_ACK_HEADER_LEN, &len);
+
+        memcpy(ack, CMD_ACK_MAGIC, 4);
+        ack[4] = msg.op;
+        ack[5] = status;
+        put_u16(ack + 6, len);
+        put_u32(ack + CMD_ACK_HEADER_LEN + len, crc32_calc(ack, CMD_ACK_HEADER_LEN + len));
+
+        stats.commands++;
+        stats.latency_us = time_us_32() - msg.rx_us;
+        if (stats.latency_us > stats.latency_max_us) {
+            stats.latency_max_us = stats.latency_us;
+        }
+        transport_send(transport, ack, CMD_ACK_HEADER_LEN + len + 4);
+        n++;
+    }
+    return n;
+}
+
+void cmd_get_stats(cmd_stats_t* out)
+{
+    *out = stats;
+}
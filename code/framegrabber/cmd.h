@@ -0,0 +1,111 @@
+/*
+
+    cmd.h
+
+    Host commands on UART RX - capture, streaming, output format,
+    sensor registers and stats - each answered with an ack on the
+    frame transport.
+
+    Host -> device messages are a sync byte, an opcode, a fixed size
+    payload and a CRC32 of all of those. Multi-byte fields are
+    little-endian. A message with a bad CRC is dropped unanswered, and
+    one whose bytes are more than CMD_RX_TIMEOUT_US apart is dropped
+    too - so a lost byte can't shift the next message into this one's
+    payload.
+
+    | opcode | name      | payload                                 | ack payload  |
+    |--------|-----------|-----------------------------------------|--------------|
+    |  0x01  | CREDIT    | u32 bytes of credit (see flow_ctrl.h)   | no ack       |
+    |  0x02  | PING      | -                                       | -            |
+    |  0x03  | CAPTURE   | u16 frames                              | -            |
+    |  0x04  | STREAM    | u8 1 = start, 0 = stop                  | -            |
+    |  0x05  | FORMAT    | u8 format, u16 width, u16 height, u8 clkrc | -         |
+    |  0x06  | REG_READ  | u8 register                             | u8 value     |
+    |  0x07  | REG_WRITE | u8 register, u8 value                   | -            |
+    |  0x08  | STATS     | -                                       | u32 counters |
+
+    The RX IRQ only parses - commands are queued and run by
+    cmd_poll() from the main loop, in the order they arrived. Every
+    command but CREDIT gets exactly one ack, sent once the command
+    has run (CAPTURE and STREAM ack once accepted, before the first
+    frame):
+
+    | off | size | field                                  |
+    |-----|------|----------------------------------------|
+    |   0 |   4  | magic "OVAK"                           |
+    |   4 |   1  | opcode                                 |
+    |   5 |   1  | status (cmd_status_t)                  |
+    |   6 |   2  | payload length                         |
+    |   8 |   n  | payload                                |
+    |  8+n|   4  | CRC32 of bytes 0..7+n                  |
+
+    Acks go on the same transport as frames and are only sent between
+    frames, so a receiver finds them the same way it finds frame
+    headers. STATS is cmd_stats_t, frame_ring_stats_t, sccb_stats_t
+    and ov7670_grab_stats_t, in that order, as u32 words.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hardware/uart.h"
+
+#include "transport.h"
+
+#define CMD_SYNC        0xA5
+
+#define CMD_OP_CREDIT    0x01
+#define CMD_OP_PING      0x02
+#define CMD_OP_CAPTURE   0x03
+#define CMD_OP_STREAM    0x04
+#define CMD_OP_FORMAT    0x05
+#define CMD_OP_REG_READ  0x06
+#define CMD_OP_REG_WRITE 0x07
+#define CMD_OP_STATS     0x08
+
+#define CMD_ACK_MAGIC   "OVAK"
+#define CMD_ACK_HEADER_LEN 8
+#define CMD_MAX_PAYLOAD 6       // FORMAT
+#define CMD_QUEUE_LEN   8       // commands waiting for cmd_poll()
+#define CMD_CRC_LEN     4
+
+// longest gap between the bytes of one message - a host writes a
+// message in one go, this is slack for USB-serial adapters
+#define CMD_RX_TIMEOUT_US 5000
+
+typedef enum {
+    CMD_OK = 0,
+    CMD_ERR_UNSUPPORTED,    // not available in this capture mode
+    CMD_ERR_ARG,            // format or size the sensor can't do
+    CMD_ERR_BUS,            // SCCB transaction failed
+} cmd_status_t;
+
+typedef struct {
+    uint32_t commands;      // commands run
+    uint32_t credits;       // CREDIT messages (not queued, no ack)
+    uint32_t rx_errors;     // bytes that weren't part of a message, bad CRCs, timeouts
+    uint32_t dropped;       // commands lost because the queue was full
+    uint32_t latency_us;    // last byte received -> ack started, last command
+    uint32_t latency_max_us;
+} cmd_stats_t;
+
+// Handlers for the mode-specific commands - NULL ones are acked
+// CMD_ERR_UNSUPPORTED. credit is called from the RX IRQ, the others
+// from cmd_poll().
+typedef struct {
+    void (*credit)(uint32_t bytes);
+    cmd_status_t (*capture)(uint16_t frames);
+    cmd_status_t (*stream)(bool on);
+    cmd_status_t (*format)(uint8_t format, uint16_t width, uint16_t height, uint8_t clkrc);
+} cmd_handlers_t;
+
+// Start taking commands on uart's RX. Acks are sent on t.
+void cmd_init(uart_inst_t* uart, transport_t* t, const cmd_handlers_t* handlers);
+
+// Run queued commands and send their acks - call from the main loop,
+// only between frames. Returns the number of commands run.
+uint cmd_poll();
+
+void cmd_get_stats(cmd_stats_t* stats);
@@ -0,0 +1,63 @@
+/*
+
+    core_handoff.h 
+
+    Passes fixed-size items from core0 to core1: a spsc_queue.h queue 
+    plus the event that wakes core1. Core0 pushes and signals with 
+    SEV. Core1 pops and sleeps in WFE while the queue is empty - a SEV 
+    between core1 finding it empty and the WFE leaves the event flag 
+    set, so the WFE returns straight away and no item is slept through.
+
+    The launch, SEV and WFE are the only SDK calls. On the host, 
+    pico_shim declares them and a test can run core1 on a thread.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#include "spsc_queue.h"
+
+typedef struct {
+    spsc_queue_t q;
+} core_handoff_t;
+
+// storage must hold capacity + 1 elements
+static inline void core_handoff_init(core_handoff_t* h, void* storage, uint16_t elem_size, uint16_t capacity)
+{
+    spsc_init(&h->q, storage, elem_size, capacity);
+}
+
+// Start core1 running entry - after core_handoff_init()
+static inline void core_handoff_launch(void (*entry)(void))
+{
+    multicore_launch_core1(entry);
+}
+
+// Core0 - false if the queue is full
+static inline bool core_handoff_push(core_handoff_t* h, const void* elem)
+{
+    if (!spsc_push(&h->q, elem)) {
+        return false;
+    }
+    __sev();
+    return true;
+}
+
+// Core1 - sleeps until there is an item
+static inline void core_handoff_pop(core_handoff_t* h, void* elem)
+{
+    while (!spsc_pop(&h->q, elem)) {
+        __wfe();
+    }
+}
+
+// Items waiting - a snapshot, either core may call it
+static inline unsigned core_handoff_level(core_handoff_t* h)
+{
+    return spsc_level(&h->q);
+}
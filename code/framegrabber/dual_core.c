@@ -0,0 +1,94 @@
+/*
+    Two-stage capture/transmit pipeline across both cores - see dual_core.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "dual_core.h"
+#include "frame_proto.h"
+#include "core_handoff.h"
+#include "bitrev.h"
+
+// core0 -> core1 - every slot can be waiting at once
+static frame_desc_t* handoff_storage[FRAME_RING_SLOTS + 1];
+static core_handoff_t handoff;
+
+static transport_t* transport;
+static uint frame_width;
+static uint frame_height;
+static uint32_t start_us;
+
+// each counter is written by one core only
+static volatile uint32_t frames_fixed;
+static volatile uint32_t frames_sent;
+static volatile uint32_t core0_busy_us;
+static volatile uint32_t core1_busy_us;
+static volatile uint32_t queue_max;
+
+static void core1_main()
+{
+    static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+    while (true) {
+        frame_desc_t* frame;
+        core_handoff_pop(&handoff, &frame);
+
+        uint32_t t0 = time_us_32();
+
+        frame_proto_encode_header(header, frame, frame_width, frame_height, 0);
+        transport_send(transport, header, sizeof(header));
+        transport_send(transport, frame->data, frame->size);
+
+        // core1 is the only one giving slots back in this mode
+        frame_ring_release(frame);
+
+        frames_sent++;
+        core1_busy_us += time_us_32() - t0;
+    }
+}
+
+void dual_core_start(transport_t* t, uint width, uint height)
+{
+    transport = t;
+    frame_width = width;
+    frame_height = height;
+    core_handoff_init(&handoff, handoff_storage, sizeof(frame_desc_t*), FRAME_RING_SLOTS);
+
+    start_us = time_us_32();
+    core_handoff_launch(core1_main);
+}
+
+void dual_core_poll()
+{
+    frame_desc_t* frame = frame_ring_get_ready();
+    if (!frame) {
+        return;
+    }
+
+    uint32_t t0 = time_us_32();
+
+    // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+    bitrev_bytes(frame->data, frame->size);
+
+    // can't fail - the queue holds every slot
+    core_handoff_push(&handoff, &frame);
+
+    uint32_t depth = core_handoff_level(&handoff);
+    if (depth > queue_max) {
+        queue_max = depth;
+    }
+
+    frames_fixed++;
+    core0_busy_us += time_us_32() - t0;
+}
+
+void dual_core_get_stats(dual_core_stats_t* stats)
+{
+    stats->frames_fixed = frames_fixed;
+    stats->frames_sent = frames_sent;
+    stats->elapsed_us = time_us_32() - start_us;
+    stats->core0_busy_us = core0_busy_us;
+    stats->core1_busy_us = core1_busy_us;
+    stats->queue_depth = core_handoff_level(&handoff);
+    stats->queue_max = queue_max;
+}
@@ -0,0 +1,36 @@
+/*
+
+    dual_core.h 
+
+    Two-stage capture/transmit pipeline across both cores.
+
+    Core0 owns capture and per-frame fix-up (bit reversal). Core1 owns 
+    encoding (header + CRC) and transport. Fixed-up frames are handed 
+    to core1 through a lock-free SPSC queue - ownership of the frame 
+    ring slot goes with it, and core1 releases the slot once it is sent.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "transport.h"
+#include "frame_ring.h"
+
+typedef struct {
+    uint32_t frames_fixed;      // core0
+    uint32_t frames_sent;       // core1
+    uint32_t elapsed_us;        // since dual_core_start()
+    uint32_t core0_busy_us;     // fix-up time
+    uint32_t core1_busy_us;     // encode + transport time
+    uint32_t queue_depth;       // frames waiting for core1 now
+    uint32_t queue_max;         // most frames ever waiting for core1
+} dual_core_stats_t;
+
+// Launch core1 sending frames of width x height on t
+void dual_core_start(transport_t* t, uint width, uint height);
+
+// Core0 - fix up captured frames and hand them to core1
+void dual_core_poll();
+
+void dual_core_get_stats(dual_core_stats_t* stats);
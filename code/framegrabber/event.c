@@ -0,0 +1,126 @@
+/*
+    Events from IRQs to the main loop - see event.h.
+*/
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "event.h"
+
+static const char* const event_names[EVENT_COUNT] = {
+    "button", "cmd", "frame", "timer",
+};
+
+static atomic_uint pending;
+
+// time of the first post since the loop last took the event
+static volatile uint32_t post_us[EVENT_COUNT];
+
+static event_stats_t stats[EVENT_COUNT];
+
+static repeating_timer_t timer;
+
+void event_post(event_t e)
+{
+    uint32_t bit = EVENT_BIT(e);
+
+    // only the first post is timed - later ones coalesce with it
+    if (!(atomic_load_explicit(&pending, memory_order_relaxed) & bit)) {
+        post_us[e] = time_us_32();
+    }
+    if (atomic_fetch_or_explicit(&pending, bit, memory_order_release) & bit) {
+        stats[e].coalesced++;
+    }
+    __sev();
+}
+
+static inline uint hist_bucket(uint32_t us)
+{
+    uint b = us ? 32 - __builtin_clz(us) : 0;
+    return b < EVENT_HIST_BUCKETS ? b : EVENT_HIST_BUCKETS - 1;
+}
+
+// Latency of every event in ev
+static void event_account(uint32_t ev)
+{
+    uint32_t now = time_us_32();
+
+    for (uint e = 0; e < EVENT_COUNT; e++) {
+        if (!(ev & EVENT_BIT(e))) {
+            continue;
+        }
+        uint32_t us = now - post_us[e];
+        stats[e].handled++;
+        stats[e].hist[hist_bucket(us)]++;
+        if (us > stats[e].latency_max_us) {
+            stats[e].latency_max_us = us;
+        }
+    }
+}
+
+uint32_t event_take()
+{
+    uint32_t ev = atomic_exchange_explicit(&pending, 0, memory_order_acquire);
+    if (ev) {
+        event_account(ev);
+    }
+    return ev;
+}
+
+uint32_t event_wait()
+{
+    uint32_t ev;
+
+    // a SEV since the last WFE makes this WFE return at once, so a post
+    // after the exchange is never slept through
+    while (!(ev = atomic_exchange_explicit(&pending, 0, memory_order_acquire))) {
+        __wfe();
+    }
+    event_account(ev);
+    return ev;
+}
+
+static bool event_timer_cb(repeating_timer_t* rt)
+{
+    (void)rt;
+    event_post(EVENT_TIMER);
+    return true;
+}
+
+bool event_timer_start(uint32_t period_ms)
+{
+    // negative - period is start to start, not end to start
+    return add_repeating_timer_ms(-(int32_t)period_ms, event_timer_cb, NULL, &timer);
+}
+
+void event_get_stats(event_t e, event_stats_t* out)
+{
+    *out = stats[e];
+}
+
+void event_print_stats()
+{
+    for (uint e = 0; e < EVENT_COUNT; e++) {
+        const event_stats_t* s = &stats[e];
+        if (!s->handled) {
+            continue;
+        }
+        printf("event %s: %lu handled, %lu coalesced, max %lu us |",
+               event_names[e], (unsigned long)s->handled, (unsigned long)s->coalesced,
+               (unsigned long)s->latency_max_us);
+        for (uint b = 0; b < EVENT_HIST_BUCKETS; b++) {
+            if (!s->hist[b]) {
+                continue;
+            }
+            if (b == EVENT_HIST_BUCKETS - 1) {
+                printf(" >=%lu us: %lu", 1ul << (b - 1), (unsigned long)s->hist[b]);
+            } else {
+                printf(" <%lu us: %lu", 1ul << b, (unsigned long)s->hist[b]);
+            }
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,61 @@
+/*
+
+    event.h
+
+    Events from interrupt handlers to the main loop, which sleeps in
+    WFE until one arrives instead of polling.
+
+    Pending events are a bit set updated with atomic OR, so any IRQ
+    (or the other core) can post without locks, and the loop takes
+    all of them with one atomic exchange. Posting an event that is
+    already pending coalesces with it - events only say "look", the
+    work itself is in the frame ring or the command queue. Every post
+    does a SEV, so an event posted between the exchange and the WFE
+    still wakes the loop.
+
+    Each event keeps a histogram of post -> handled latency in log2
+    buckets of microseconds: bucket 0 is under 1 us, bucket i is
+    2^(i-1) to 2^i - 1 us, and the last bucket holds everything longer.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    EVENT_BUTTON = 0,       // GPIO IRQ - trigger button pressed
+    EVENT_CMD,              // UART RX IRQ - command queued or credit granted
+    EVENT_FRAME,            // DMA IRQ - frame published to the frame ring (or for a snapshot, zsl.h)
+    EVENT_TIMER,            // repeating timer from event_timer_start()
+    EVENT_COUNT
+} event_t;
+
+#define EVENT_BIT(e) (1u << (e))
+
+#define EVENT_HIST_BUCKETS 16   // last bucket is 16 ms and up
+
+typedef struct {
+    uint32_t handled;       // times the loop took the event
+    uint32_t coalesced;     // posts while it was already pending
+    uint32_t latency_max_us;
+    uint32_t hist[EVENT_HIST_BUCKETS];
+} event_stats_t;
+
+// Safe to call from any IRQ
+void event_post(event_t e);
+
+// Sleep until at least one event is pending, then take all of them -
+// returns a mask of EVENT_BIT()s
+uint32_t event_wait();
+
+// Take pending events without sleeping - 0 if there were none
+uint32_t event_take();
+
+// Post EVENT_TIMER every period_ms
+bool event_timer_start(uint32_t period_ms);
+
+void event_get_stats(event_t e, event_stats_t* stats);
+
+// Latency histograms of the events handled so far, on stdout
+void event_print_stats();
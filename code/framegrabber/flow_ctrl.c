@@ -0,0 +1,171 @@
+/*
+    Credit-based flow control - see flow_ctrl.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "flow_ctrl.h"
+#include "frame_ring.h"
+#include "frame_proto.h"
+#include "bitrev.h"
+
+static transport_t* transport;
+static flow_policy_t flow_policy;
+static uint16_t frame_width;
+static uint16_t frame_height;
+
+// credit is granted - used, each written from one side only
+static volatile uint32_t credit_granted;
+static uint32_t credit_used;
+
+// frame waiting for credit
+static frame_desc_t* held;
+
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+static flow_stats_t stats;
+
+void flow_ctrl_init(transport_t* t, flow_policy_t policy, uint16_t width, uint16_t height)
+{
+    transport = t;
+    flow_policy = policy;
+    frame_width = width;
+    frame_height = height;
+
+    credit_granted = credit_used = 0;
+    held = NULL;
+    stats = (flow_stats_t){0};
+}
+
+// UART RX IRQ (cmd.c) - only this side writes credit_granted
+void flow_ctrl_add_credit(uint32_t bytes)
+{
+    credit_granted += bytes;
+    stats.grants++;
+}
+
+static inline uint32_t flow_credit()
+{
+    return credit_granted - credit_used;
+}
+
+// Decimate 2x2 in place - keeps every other line, and for YUYV makes 
+// one pair from every two: the first pair's Y0/U with the second 
+// pair's Y0/V. Bayer keeps the top-left 2x2 of 
+// every 4x4 so the result is still BGGR.
+static uint32_t downscale_2x(frame_desc_t* frame)
+{
+    uint8_t* p = frame->data;
+    uint out = 0;
+
+    if (frame->format == FRAME_FMT_BAYER) {
+        for (uint y = 0; y < frame_height; y++) {
+            if (y & 2) {
+                continue;
+            }
+            const uint8_t* line = p + y * frame_width;
+            for (uint x = 0; x < frame_width; x += 4) {
+                p[out++] = line[x];
+                p[out++] = line[x + 1];
+            }
+        }
+        return out;
+    }
+
+    for (uint y = 0; y < frame_height; y += 2) {
+        if (frame->format == FRAME_FMT_Y8) {
+            const uint8_t* line = p + y * frame_width;
+            for (uint x = 0; x < frame_width; x += 2) {
+                p[out++] = line[x];
+            }
+        } else if (frame->format == FRAME_FMT_YUV422) {
+            const uint8_t* line = p + y * frame_width * 2;
+            for (uint x = 0; x < frame_width * 2; x += 8) {
+                p[out++] = line[x];
+                p[out++] = line[x + 1];
+                p[out++] = line[x + 4];
+                p[out++] = line[x + 7];
+            }
+        } else {
+            const uint8_t* line = p + y * frame_width * 2;
+            for (uint x = 0; x < frame_width * 2; x += 4) {
+                p[out++] = line[x];
+                p[out++] = line[x + 1];
+            }
+        }
+    }
+    return out;
+}
+
+// Send the held frame if there is credit for it (or a downscaled copy)
+static void flow_ctrl_try_send()
+{
+    uint32_t full = FRAME_PROTO_HEADER_LEN + held->size;
+    uint32_t half = FRAME_PROTO_HEADER_LEN + held->size / 4;
+    uint32_t credit = flow_credit();
+
+    bool scaled = false;
+    if (credit < full) {
+        if (flow_policy != FLOW_DOWNSCALE || credit < half) {
+            return;
+        }
+        scaled = true;
+    }
+
+    stats.latency_us = time_us_32() - held->timestamp_us;
+    if (stats.latency_us > stats.latency_max_us) {
+        stats.latency_max_us = stats.latency_us;
+    }
+
+    // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+    bitrev_bytes(held->data, held->size);
+
+    // the slot keeps its full size - only the copy of the descriptor shrinks
+    frame_desc_t desc = *held;
+    uint16_t width = frame_width;
+    uint16_t height = frame_height;
+    if (scaled) {
+        desc.size = downscale_2x(held);
+        width /= 2;
+        height /= 2;
+        stats.frames_downscaled++;
+    }
+
+    credit_used += FRAME_PROTO_HEADER_LEN + desc.size;
+    frame_proto_encode_header(header, &desc, width, height, 0);
+    transport_send(transport, header, sizeof(header));
+    transport_send(transport, desc.data, desc.size);
+
+    frame_ring_release(held);
+    held = NULL;
+    stats.frames_sent++;
+}
+
+void flow_ctrl_poll()
+{
+    // always drain the ring, so what is held is never older than one frame 
+    // unless the policy keeps it
+    frame_desc_t* ready;
+    while ((ready = frame_ring_get_ready())) {
+        if (!held) {
+            held = ready;
+        } else if (flow_policy == FLOW_DROP_NEWEST) {
+            frame_ring_release(ready);
+            stats.dropped_newest++;
+        } else {
+            frame_ring_release(held);
+            held = ready;
+            stats.dropped_oldest++;
+        }
+    }
+
+    if (held) {
+        flow_ctrl_try_send();
+    }
+}
+
+void flow_ctrl_get_stats(flow_stats_t* out)
+{
+    *out = stats;
+    out->credit = flow_credit();
+}
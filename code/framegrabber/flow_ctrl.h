@@ -0,0 +1,65 @@
+/*
+
+    flow_ctrl.h 
+
+    Credit-based flow control for STREAM_MODE - the host grants 
+    bytes of credit over UART RX and frames are only sent within it.
+
+    Credit arrives as the CREDIT command (see cmd.h), which the RX 
+    IRQ hands straight to flow_ctrl_add_credit():
+
+    | byte(s) | field                                   |
+    |---------|-----------------------------------------|
+    |    0    | CMD_SYNC (0xA5)                         |
+    |    1    | CMD_OP_CREDIT (0x01)                    |
+    |   2-5   | bytes of credit to add, u32 little-end. |
+    |   6-9   | CRC32 of bytes 0-5                      |
+
+    A frame costs its header plus payload, and is only started once 
+    there is credit for all of it - so a frame is never half sent. 
+    A host keeps a window open by granting the size of every frame 
+    it has consumed.
+
+    Capture keeps running without credit. At most one frame is held 
+    waiting, and the policy decides what happens when another one 
+    arrives:
+
+    FLOW_DROP_NEWEST  keep the held frame, drop the new one
+    FLOW_DROP_OLDEST  drop the held frame, hold the new one
+    FLOW_DOWNSCALE    as drop-oldest, but if there is credit for a 
+                      half-size (2x2 decimated) frame, send that
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "transport.h"
+
+typedef enum {
+    FLOW_DROP_NEWEST = 0,
+    FLOW_DROP_OLDEST,
+    FLOW_DOWNSCALE,
+} flow_policy_t;
+
+typedef struct {
+    uint32_t credit;              // bytes the host will still take
+    uint32_t grants;
+    uint32_t frames_sent;
+    uint32_t frames_downscaled;
+    uint32_t dropped_newest;
+    uint32_t dropped_oldest;
+    uint32_t latency_us;          // capture -> send started, last frame
+    uint32_t latency_max_us;
+} flow_stats_t;
+
+// Start with no credit. Frames are width x height, sent on t.
+void flow_ctrl_init(transport_t* t, flow_policy_t policy, uint16_t width, uint16_t height);
+
+// Grant bytes more credit - safe to call from IRQ
+void flow_ctrl_add_credit(uint32_t bytes);
+
+// Take ready frames from the frame ring and send what credit allows - call from the main loop
+void flow_ctrl_poll();
+
+void flow_ctrl_get_stats(flow_stats_t* stats);
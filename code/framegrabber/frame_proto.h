@@ -0,0 +1,75 @@
+/*
+
+    frame_proto.h 
+
+    Wire format for frames sent to the host.
+
+    Every frame is sent as a fixed header followed by the payload. 
+    All fields are little-endian. The receiver finds the start of a 
+    frame by searching for FRAME_PROTO_MAGIC and checking header_crc, 
+    so it can resync in the middle of a stream if bytes are lost.
+
+    | off | size | field                                         |
+    |-----|------|-----------------------------------------------|
+    |   0 |   4  | magic "OVFR"                                  |
+    |   4 |   1  | version                                       |
+    |   5 |   1  | header length (bytes)                         |
+    |   6 |   1  | pixel format (frame_format_t)                 |
+    |   7 |   1  | flags                                         |
+    |   8 |   2  | width                                         |
+    |  10 |   2  | height                                        |
+    |  12 |   4  | sequence number                               |
+    |  16 |   4  | capture timestamp (us since boot)             |
+    |  20 |   4  | payload length (bytes)                        |
+    |  24 |   4  | CRC32 of payload                              |
+    |  28 |   4  | CRC32 of header bytes 0..27                   |
+
+    With FRAME_FLAG_CRC_TRAILER set, the payload CRC field is 0 and 
+    the CRC32 follows the payload as 4 more bytes instead. This is 
+    used when the payload is sent before it has all been captured.
+
+    With FRAME_FLAG_CHUNKED set, the payload is sent as chunks, each 
+    a 16-bit length followed by that many bytes, and ends with a zero 
+    length chunk. Bit 15 of the length (FRAME_CHUNK_STORED) marks a 
+    chunk sent as-is. Other chunks are coded as the flags say - 
+    FRAME_FLAG_QOI16 is qoi16 (qoi16.h), with the decoder reset after 
+    every stored chunk. The payload length field is the decoded size. 
+    Chunked frames always have a CRC trailer, covering every byte 
+    between the header and the trailer.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frame_ring.h"
+
+#define FRAME_PROTO_MAGIC      "OVFR"
+#define FRAME_PROTO_VERSION    1
+#define FRAME_PROTO_HEADER_LEN 32
+
+// flags
+#define FRAME_FLAG_CRC_TRAILER 0x01
+#define FRAME_FLAG_CHUNKED     0x02
+#define FRAME_FLAG_QOI16       0x04
+#define FRAME_FLAG_TILES       0x08    // changed tiles only - see tile_delta.h
+#define FRAME_FLAG_RECORD      0x10    // part of a recording burst - see record.h
+#define FRAME_FLAG_PRE_TRIGGER 0x20    // burst frame captured before the trigger
+
+// chunk length bit - chunk is not coded
+#define FRAME_CHUNK_STORED     0x8000
+
+// Standard CRC32 (reflected, poly 0xEDB88320) - same as zlib
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len);
+
+static inline uint32_t crc32_calc(const uint8_t* data, size_t len)
+{
+    return crc32_update(0, data, len);
+}
+
+// Fill header[FRAME_PROTO_HEADER_LEN] for frame. Unless flags has 
+// FRAME_FLAG_CRC_TRAILER this computes the payload CRC, so frame data 
+// must already be in its final (bit-fixed) form.
+void frame_proto_encode_header(uint8_t* header, const frame_desc_t* frame,
+                               uint16_t width, uint16_t height, uint8_t flags);
@@ -0,0 +1,315 @@
+"""
+Streaming decoder for the framed wire protocol - see frame_proto.h.
+
+Feed it bytes as they arrive; it returns complete, CRC-checked frames.
+If bytes are lost or corrupted it drops what it has and resyncs on the
+next valid header. Acks to commands (see cmd.h) found between frames
+are collected in .acks.
+"""
+
+import struct
+import zlib
+
+import qoi16
+
+MAGIC = b"OVFR"
+VERSION = 1
+HEADER_LEN = 32
+
+# <magic> version hdr_len format flags width height seq timestamp payload_len payload_crc header_crc
+HEADER_FMT = "<4sBBBBHHIIIII"
+
+# frame_format_t in frame_ring.h
+FORMATS = {0: "yuv422", 1: "rgb565", 2: "y8", 3: "jpeg", 4: "bayer"}
+
+# flags
+FLAG_CRC_TRAILER = 0x01  # payload CRC follows the payload instead of being in the header
+FLAG_CHUNKED = 0x02      # payload is length-prefixed chunks, ended by an empty one
+FLAG_QOI16 = 0x04        # chunks are qoi16 coded
+FLAG_TILES = 0x08        # changed tiles only - see tile_delta.py
+FLAG_RECORD = 0x10       # part of a recording burst - see record.h
+FLAG_PRE_TRIGGER = 0x20  # burst frame captured before the trigger
+
+CHUNK_STORED = 0x8000    # chunk length bit - chunk is not coded
+
+# Largest payload we accept - VGA RGB565 - guards against a bad length
+MAX_PAYLOAD = 640 * 480 * 2
+
+
+# host -> device commands - see cmd.h
+CMD_SYNC = 0xA5
+CMD_CREDIT = 0x01
+CMD_PING = 0x02
+CMD_CAPTURE = 0x03
+CMD_STREAM = 0x04
+CMD_FORMAT = 0x05
+CMD_REG_READ = 0x06
+CMD_REG_WRITE = 0x07
+CMD_STATS = 0x08
+
+# device -> host acks, sent between frames
+ACK_MAGIC = b"OVAK"
+ACK_HEADER_LEN = 8
+ACK_MAX_PAYLOAD = 256
+
+# cmd_status_t
+ACK_STATUS = {0: "ok", 1: "unsupported", 2: "bad argument", 3: "bus error"}
+
+# STATS ack payload - cmd_stats_t, frame_ring_stats_t, sccb_stats_t, ov7670_grab_stats_t
+STATS_FIELDS = ("commands", "credits", "rx_errors", "dropped", "latency_us", "latency_max_us",
+                "captured", "published", "consumed", "overruns",
+                "sccb_writes", "sccb_reads", "sccb_skipped", "sccb_errors",
+                "sccb_commits", "sccb_commit_writes", "sccb_commit_us",
+                "grabs", "grab_timeouts", "grab_short_frames", "grab_recoveries",
+                "frame_period_us")
+
+
+def _command(fmt, *fields):
+    """ Command message - sync, opcode and payload, then their CRC32 """
+    msg = struct.pack("<BB" + fmt, CMD_SYNC, *fields)
+    return msg + struct.pack("<I", zlib.crc32(msg))
+
+
+def encode_credit(nbytes):
+    """ Message granting nbytes more credit to the device """
+    return _command("I", CMD_CREDIT, nbytes)
+
+
+def encode_ping():
+    return _command("", CMD_PING)
+
+
+def encode_capture(frames=1):
+    """ Capture and send the next frames frames """
+    return _command("H", CMD_CAPTURE, frames)
+
+
+def encode_stream(on):
+    return _command("B", CMD_STREAM, 1 if on else 0)
+
+
+def encode_format(fmt, width, height, clkrc=0x01):
+    """ fmt is a FORMATS key or name - yuv422 or bayer """
+    if isinstance(fmt, str):
+        fmt = {name: k for k, name in FORMATS.items()}[fmt]
+    return _command("BHHB", CMD_FORMAT, fmt, width, height, clkrc)
+
+
+def encode_reg_read(reg):
+    return _command("B", CMD_REG_READ, reg)
+
+
+def encode_reg_write(reg, value):
+    return _command("BB", CMD_REG_WRITE, reg, value)
+
+
+def encode_stats():
+    return _command("", CMD_STATS)
+
+
+class Ack:
+    __slots__ = ("op", "status", "payload")
+
+    def __init__(self, op, status, payload):
+        self.op = op
+        self.status = status
+        self.payload = payload
+
+    @property
+    def ok(self):
+        return self.status == 0
+
+    @property
+    def status_name(self):
+        return ACK_STATUS.get(self.status, f"unknown({self.status})")
+
+    def stats(self):
+        """ STATS payload as a dict of counters """
+        words = struct.unpack(f"<{len(self.payload) // 4}I", self.payload)
+        return dict(zip(STATS_FIELDS, words))
+
+
+class Frame:
+    __slots__ = ("format", "flags", "width", "height", "seq", "timestamp_us", "payload")
+
+    def __init__(self, fmt, flags, width, height, seq, timestamp_us, payload):
+        self.format = fmt
+        self.flags = flags
+        self.width = width
+        self.height = height
+        self.seq = seq
+        self.timestamp_us = timestamp_us
+        self.payload = payload
+
+    @property
+    def format_name(self):
+        return FORMATS.get(self.format, f"unknown({self.format})")
+
+
+class FrameDecoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.resyncs = 0
+        self.skipped_bytes = 0
+        self.last_seq = None
+        self.lost_frames = 0
+        self.acks = []          # command acks, oldest first - taken by the caller
+
+    def feed(self, data):
+        """ Add received bytes and return a list of complete frames """
+        self.buf += data
+        frames = []
+        while True:
+            frame = self._parse_one()
+            if frame is None:
+                break
+            frames.append(frame)
+        return frames
+
+    def _skip(self, n):
+        del self.buf[:n]
+        self.skipped_bytes += n
+
+    def _chunks_end(self, pos):
+        """ Offset of the CRC trailer of a chunked payload starting at pos -
+            None if it hasn't all arrived, -1 if it can't be valid """
+        buf = self.buf
+        limit = pos + 2 * MAX_PAYLOAD
+        while True:
+            if len(buf) < pos + 2:
+                return None
+            n = struct.unpack_from("<H", buf, pos)[0] & ~CHUNK_STORED
+            pos += 2 + n
+            if pos > limit:
+                return -1
+            if n == 0:
+                return pos if len(buf) >= pos + 4 else None
+
+    def _unchunk(self, wire, flags):
+        """ Decoded payload of a chunked frame, None if a chunk won't decode """
+        out = bytearray()
+        dec = qoi16.Qoi16Decoder()
+        pos = 0
+        while True:
+            n = struct.unpack_from("<H", wire, pos)[0]
+            data = wire[pos + 2:pos + 2 + (n & ~CHUNK_STORED)]
+            pos += 2 + len(data)
+            if not data:
+                return bytes(out)
+            if n & CHUNK_STORED or not flags & FLAG_QOI16:
+                out += data
+                dec.reset()
+            else:
+                try:
+                    out += dec.decode(data)
+                except IndexError:
+                    return None
+
+    def _parse_ack(self):
+        """ Ack at the start of buf - False if it isn't all here yet """
+        buf = self.buf
+        if len(buf) < ACK_HEADER_LEN:
+            return False
+        op, status, plen = struct.unpack_from("<BBH", buf, 4)
+        if plen > ACK_MAX_PAYLOAD:
+            self.resyncs += 1
+            self._skip(1)
+            return True
+        total = ACK_HEADER_LEN + plen + 4
+        if len(buf) < total:
+            return False
+        if zlib.crc32(memoryview(buf)[:total - 4]) != struct.unpack_from("<I", buf, total - 4)[0]:
+            self.crc_errors += 1
+            self._skip(1)
+            return True
+        self.acks.append(Ack(op, status, bytes(buf[ACK_HEADER_LEN:total - 4])))
+        del buf[:total]
+        return True
+
+    def _parse_one(self):
+        buf = self.buf
+        while True:
+            # find sync marker - bytes.find runs in C so this is cheap
+            start = buf.find(MAGIC)
+
+            # acks only come between frames - one before the next header goes first
+            ack = buf.find(ACK_MAGIC, 0, start + len(ACK_MAGIC) - 1 if start >= 0 else len(buf))
+            if ack >= 0:
+                if ack > 0:
+                    self.resyncs += 1
+                    self._skip(ack)
+                if not self._parse_ack():
+                    return None
+                continue
+
+            if start < 0:
+                # keep a possible partial marker at the end
+                keep = len(MAGIC) - 1
+                if len(buf) > keep:
+                    self._skip(len(buf) - keep)
+                return None
+            if start > 0:
+                self.resyncs += 1
+                self._skip(start)
+
+            if len(buf) < HEADER_LEN:
+                return None
+
+            (magic, version, hdr_len, fmt, flags, width, height, seq, ts,
+             plen, pcrc, hcrc) = struct.unpack_from(HEADER_FMT, buf)
+
+            if (version != VERSION or hdr_len < HEADER_LEN or plen > MAX_PAYLOAD
+                    or zlib.crc32(memoryview(buf)[:28]) != hcrc):
+                # false marker in the payload or a corrupted header
+                self.resyncs += 1
+                self._skip(1)
+                continue
+
+            if flags & FLAG_CHUNKED:
+                # wire length is only known once the empty chunk arrives
+                end = self._chunks_end(hdr_len)
+                if end is None:
+                    return None
+                if end < 0:
+                    self.resyncs += 1
+                    self._skip(1)
+                    continue
+                wire = bytes(memoryview(buf)[hdr_len:end])
+                pcrc = struct.unpack_from("<I", buf, end)[0]
+                total = end + 4
+            else:
+                total = hdr_len + plen
+                if flags & FLAG_CRC_TRAILER:
+                    total += 4
+                if len(buf) < total:
+                    return None
+
+                wire = bytes(memoryview(buf)[hdr_len:hdr_len + plen])
+                if flags & FLAG_CRC_TRAILER:
+                    pcrc = struct.unpack_from("<I", buf, hdr_len + plen)[0]
+
+            crc_ok = zlib.crc32(wire) == pcrc
+            payload = wire
+            if crc_ok and flags & FLAG_CHUNKED:
+                payload = self._unchunk(wire, flags)
+                # chunks that don't decode to the advertised size count as corrupt
+                crc_ok = payload is not None and len(payload) == plen
+            if not crc_ok:
+                # drop just the header - a good frame may start inside this one
+                self.crc_errors += 1
+                self._skip(1)
+                continue
+
+            del buf[:total]
+            break
+
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq - 1) & 0xFFFFFFFF
+            if gap < 0x80000000:
+                self.lost_frames += gap
+        self.last_seq = seq
+        self.frames += 1
+
+        return Frame(fmt, flags, width, height, seq, ts, payload)
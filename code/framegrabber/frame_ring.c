@@ -0,0 +1,136 @@
+/*
+    Fixed-capacity ring of frame slots - see frame_ring.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "frame_ring.h"
+#include "spsc_queue.h"
+
+static frame_desc_t slots[FRAME_RING_SLOTS];
+
+// slot indices, + 1 for the spsc_queue_t empty entry
+static uint8_t ready_idx[FRAME_RING_SLOTS + 1];
+static uint8_t free_idx[FRAME_RING_SLOTS + 1];
+
+static spsc_queue_t ready_q;    // producer -> consumer
+static spsc_queue_t free_q;     // consumer -> producer
+
+// slots the producer aborted - its own, so free_q keeps one producer
+static uint8_t retry_idx[FRAME_RING_SLOTS];
+static uint retry_count;
+
+static uint32_t next_seq;
+static frame_ring_stats_t stats;
+
+// Set up all slots as free with the given format and size. storage 
+// holds FRAME_RING_SLOTS buffers of size bytes (at most FRAME_SLOT_SIZE).
+void frame_ring_init(uint8_t* storage, frame_format_t format, uint32_t size)
+{
+    spsc_init(&ready_q, ready_idx, 1, FRAME_RING_SLOTS);
+    spsc_init(&free_q, free_idx, 1, FRAME_RING_SLOTS);
+
+    for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+        slots[i].seq = 0;
+        slots[i].timestamp_us = 0;
+        slots[i].size = size;
+        slots[i].format = format;
+        slots[i].status = FRAME_FREE;
+        slots[i].data = storage + i * size;
+        uint8_t idx = i;
+        spsc_push(&free_q, &idx);
+    }
+
+    retry_count = 0;
+    next_seq = 0;
+    stats = (frame_ring_stats_t){0};
+}
+
+// Get a free slot to capture into - an aborted one first, NULL if 
+// all slots are in use
+frame_desc_t* frame_ring_acquire()
+{
+    uint8_t idx;
+    if (retry_count > 0) {
+        idx = retry_idx[--retry_count];
+    } else if (!spsc_pop(&free_q, &idx)) {
+        return NULL;
+    }
+    slots[idx].status = FRAME_CAPTURING;
+    return &slots[idx];
+}
+
+// Give slot the next sequence number and the current time
+void frame_ring_stamp(frame_desc_t* slot)
+{
+    slot->seq = next_seq++;
+    slot->timestamp_us = time_us_32();
+    stats.captured++;
+}
+
+// Capture into slot is complete - stamp it and pass it to the consumer
+void frame_ring_publish(frame_desc_t* slot)
+{
+    frame_ring_stamp(slot);
+    slot->status = FRAME_READY;
+
+    // can't fail - there are never more ready slots than slots
+    uint8_t idx = slot - slots;
+    spsc_push(&ready_q, &idx);
+    stats.published++;
+}
+
+// Capture into slot failed - keep it for the next acquire without 
+// using up a sequence number, nothing was captured. It stays with the 
+// producer: free_q is the consumer's to push to.
+void frame_ring_abort(frame_desc_t* slot)
+{
+    slot->status = FRAME_FREE;
+    retry_idx[retry_count++] = slot - slots;
+}
+
+// A frame was captured but there was no free slot for it, so it 
+// was dropped. The sequence number is still used up so the consumer 
+// sees the gap.
+void frame_ring_overrun()
+{
+    next_seq++;
+    stats.captured++;
+    stats.overruns++;
+}
+
+// Slot whose frame buffer starts at data - NULL if none
+frame_desc_t* frame_ring_lookup(const uint8_t* data)
+{
+    for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+        if (slots[i].data == data) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Get the oldest ready frame - NULL if none
+frame_desc_t* frame_ring_get_ready()
+{
+    uint8_t idx;
+    if (!spsc_pop(&ready_q, &idx)) {
+        return NULL;
+    }
+    slots[idx].status = FRAME_SENDING;
+    return &slots[idx];
+}
+
+// Consumer is done with slot - hand it back for capture
+void frame_ring_release(frame_desc_t* slot)
+{
+    slot->status = FRAME_FREE;
+    stats.consumed++;
+    uint8_t idx = slot - slots;
+    spsc_push(&free_q, &idx);
+}
+
+void frame_ring_get_stats(frame_ring_stats_t* out)
+{
+    *out = stats;
+}
@@ -0,0 +1,78 @@
+/*
+
+    frame_ring.h 
+
+    Fixed-capacity ring of frame slots with per-frame descriptors.
+
+    Slots are passed from the capture side (DMA IRQ) to the consumer 
+    (transmit) through a single-producer/single-consumer lock-free 
+    queue, and handed back through a second one. Capture never waits 
+    on transmit - if no slot is free, the frame is dropped and counted 
+    as an overrun.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IMAGE_WIDTH  320
+#define IMAGE_HEIGHT 240
+#define IMAGE_SIZE   (IMAGE_WIDTH * IMAGE_HEIGHT)  // Total pixels
+
+// 3 slots minimum for streaming: one being captured, one armed 
+// as the next DMA target and one being sent
+#ifndef FRAME_RING_SLOTS
+#define FRAME_RING_SLOTS 3
+#endif
+
+// QVGA RGB565/YUV422 - 2 bytes per pixel
+#define FRAME_SLOT_SIZE (IMAGE_SIZE * 2)
+
+typedef enum {
+    FRAME_FMT_YUV422 = 0,
+    FRAME_FMT_RGB565 = 1,
+    FRAME_FMT_Y8 = 2,       // luma only - YUV422 with U/V dropped at capture
+    FRAME_FMT_JPEG = 3,     // baseline JFIF, 4:2:2 - see jpeg_enc.h
+    FRAME_FMT_BAYER = 4,    // raw BGGR Bayer, 1 byte per pixel - see ov7670_set_bayer()
+} frame_format_t;
+
+typedef enum {
+    FRAME_FREE = 0,       // owned by the ring, available for capture
+    FRAME_CAPTURING,      // owned by the producer, DMA is (or will be) writing
+    FRAME_READY,          // complete, queued for the consumer
+    FRAME_SENDING,        // owned by the consumer
+} frame_status_t;
+
+typedef struct {
+    uint32_t seq;           // capture sequence number - gaps mean overruns
+    uint32_t timestamp_us;  // time the capture completed
+    uint32_t size;          // bytes of valid data
+    uint8_t format;         // frame_format_t
+    volatile uint8_t status;// frame_status_t
+    uint8_t* data;
+} frame_desc_t;
+
+typedef struct {
+    uint32_t captured;      // frames completed by the producer
+    uint32_t published;     // frames handed to the consumer
+    uint32_t consumed;      // frames released by the consumer
+    uint32_t overruns;      // frames dropped because no slot was free
+} frame_ring_stats_t;
+
+void frame_ring_init(uint8_t* storage, frame_format_t format, uint32_t size);
+
+// Producer side - safe to call from IRQ. Only the producer may 
+// abort: an aborted slot goes back to it, not through the free queue.
+frame_desc_t* frame_ring_acquire();
+void frame_ring_stamp(frame_desc_t* slot);
+void frame_ring_publish(frame_desc_t* slot);
+void frame_ring_abort(frame_desc_t* slot);
+void frame_ring_overrun();
+frame_desc_t* frame_ring_lookup(const uint8_t* data);
+
+// Consumer side
+frame_desc_t* frame_ring_get_ready();
+void frame_ring_release(frame_desc_t* slot);
+
+void frame_ring_get_stats(frame_ring_stats_t* stats);
@@ -7,32 +7,189 @@
 #include "pico/cyw43_arch.h"
 #include "hardware/uart.h"
 #include "hardware/clocks.h"
+#include "hardware/sync.h"
 
 #include "hardware/regs/io_bank0.h"
 #include "hardware/regs/sio.h"
 #include "hardware/structs/sio.h"
 
 #include "OV7670.h"
+#include "ov7670_bitbang.h"
+#include "frame_ring.h"
+#include "bitrev.h"
+#include "uart_dma.h"
+#include "frame_proto.h"
+#include "pipeline.h"
+#include "line_stream.h"
+#include "dual_core.h"
+#include "jpeg_stream.h"
+#include "tile_delta.h"
+#include "flow_ctrl.h"
+#include "cmd.h"
+#include "boot_trace.h"
+#include "event.h"
+#include "zsl.h"
+#include "record.h"
 
 // UART defines
 // By default the stdout UART is `uart0`, so we will use the second one
 #define UART_ID uart1
-#define BAUD_RATE 115200
+// uart1 TX is fed by DMA - clk_peri/16 is the upper limit
+#define BAUD_RATE 3000000
 
 // Use pins 4 and 5 for UART1
 // Pins can be changed, see the GPIO function select table in the datasheet for information on GPIO assignments
 #define UART_TX_PIN 16
 #define UART_RX_PIN 17
 
-#define IMAGE_WIDTH  320
-#define IMAGE_HEIGHT 240
-#define IMAGE_SIZE   (IMAGE_WIDTH * IMAGE_HEIGHT)  // Total bytes
+// Longest wait for the sensor to settle before capture starts
+#define READY_TIMEOUT_MS 1000
+
+// Event latency histograms on stdout at most this often - button mode
+#define EVENT_REPORT_MS 10000
+
+// Capture mode - uncomment one to capture continuously instead of on button press
+//#define STREAM_MODE       // whole frames through the frame ring
+//#define PIPELINE_MODE     // bands of lines sent while the frame is still being captured
+//#define LINE_MODE         // VGA, one line at a time through a small ring of line buffers
+//#define DUAL_CORE_MODE    // whole frames, core0 captures and fixes up, core1 sends
+//#define JPEG_MODE         // MCU rows JPEG encoded as they land, one JPEG per frame
+//#define ZSL_MODE          // whole frames, button or CAPTURE sends the newest one already captured
+//#define RECORD_MODE       // rolling history, a trigger sends the frames before and after it
+
+// Uncomment to send bands qoi16 compressed (lossless) - PIPELINE_MODE only
+//#define COMPRESS_QOI16
+
+// Uncomment to send only the 16x16 tiles that changed - STREAM_MODE only
+//#define TILE_DELTA
+
+// Uncomment to send only within credit granted by the host on UART RX - STREAM_MODE only
+//#define FLOW_CONTROL
+#define FLOW_POLICY FLOW_DROP_OLDEST    // or FLOW_DROP_NEWEST, FLOW_DOWNSCALE
+
+// RECORD_MODE - history kept and frames sent per trigger (see record.h).
+// Largest RECORD_PRE per history format with RECORD_POST 2 in 384 KB:
+// RECORD_FULL 0, RECORD_LUMA 3, RECORD_HALF 8, RECORD_LUMA_HALF 18
+#define RECORD_HISTORY RECORD_HALF
+#define RECORD_PRE     8            // K frames before the trigger
+#define RECORD_POST    2            // M frames after it
+#define RECORD_MOTION  0            // mean luma difference per pixel that triggers - 0 is off
+#define RECORD_STORAGE_BYTES (384 * 1024)
+
+// Uncomment to capture only Y from the YUYV stream - streaming modes only
+//#define LUMA_ONLY
+
+// Uncomment to capture raw BGGR Bayer (1 byte per pixel) instead of YUV422 - streaming modes only
+//#define BAYER
+#define BAYER_CLKRC 0x01
+
+#if defined(COMPRESS_QOI16) && !defined(PIPELINE_MODE)
+#error "COMPRESS_QOI16 needs PIPELINE_MODE"
+#endif
+
+#if defined(TILE_DELTA) && !defined(STREAM_MODE)
+#error "TILE_DELTA needs STREAM_MODE"
+#endif
+
+#if defined(FLOW_CONTROL) && (!defined(STREAM_MODE) || defined(TILE_DELTA))
+#error "FLOW_CONTROL needs STREAM_MODE without TILE_DELTA"
+#endif
+
+#if defined(JPEG_MODE) && defined(LUMA_ONLY)
+#error "JPEG_MODE needs YUV422 - LUMA_ONLY is not supported"
+#endif
+
+#if defined(BAYER) && (defined(LUMA_ONLY) || defined(JPEG_MODE))
+#error "BAYER can't be combined with LUMA_ONLY or JPEG_MODE"
+#endif
+
+#if defined(BAYER) && defined(RECORD_MODE)
+#error "RECORD_MODE can't reduce Bayer - use YUV422 or LUMA_ONLY"
+#endif
+
+#if defined(BAYER) && !defined(STREAM_MODE) && !defined(PIPELINE_MODE) && !defined(LINE_MODE) && !defined(DUAL_CORE_MODE) && !defined(ZSL_MODE)
+#error "BAYER needs one of the streaming modes"
+#endif
+
+#ifdef LUMA_ONLY
+#if !defined(STREAM_MODE) && !defined(PIPELINE_MODE) && !defined(LINE_MODE) && !defined(DUAL_CORE_MODE) && !defined(ZSL_MODE) && !defined(RECORD_MODE)
+#error "LUMA_ONLY needs one of the streaming modes"
+#endif
+// Y dropped out of YUYV by the PIO program - 1 byte per pixel
+#define FRAME_FORMAT FRAME_FMT_Y8
+#define FRAME_BYTES  IMAGE_SIZE
+#elif defined(BAYER)
+// raw sensor array - 1 byte per pixel, half of YUV422
+#define FRAME_FORMAT FRAME_FMT_BAYER
+#define FRAME_BYTES  IMAGE_SIZE
+#else
+// Format of frames produced by the sensor config in ov7670_init()
+#define FRAME_FORMAT FRAME_FMT_YUV422
+#define FRAME_BYTES  (IMAGE_SIZE * 2)
+#endif
+
+// LINE_MODE and JPEG_MODE keep only bands in memory - no frame ring.
+// ZSL_MODE and RECORD_MODE have their own slots, see zsl.h and record.h.
+#if !defined(LINE_MODE) && !defined(JPEG_MODE) && !defined(ZSL_MODE) && !defined(RECORD_MODE)
+#define USE_FRAME_RING
+#endif
+
+// Host commands on UART RX (see cmd.h) - only where the main loop sends 
+// whole frames, so acks always go between frames
+#if !defined(LINE_MODE) && !defined(JPEG_MODE) && !defined(PIPELINE_MODE) && !defined(DUAL_CORE_MODE)
+#define USE_CMD
+#endif
+
+#ifdef USE_FRAME_RING
+// Frame buffers are owned by the frame ring - see frame_ring.h
+static uint8_t frame_storage[FRAME_RING_SLOTS * FRAME_BYTES] __attribute__((aligned(4)));
+#endif
+
+#ifdef ZSL_MODE
+static uint8_t zsl_storage[ZSL_SLOTS * FRAME_BYTES] __attribute__((aligned(4)));
+#endif
+
+#ifdef RECORD_MODE
+static uint8_t record_storage[RECORD_STORAGE_BYTES] __attribute__((aligned(4)));
+#endif
+
+// Capture window for the streaming modes
+static void get_capture_desc(ov7670_capture_desc_t* desc) {
+    ov7670_capture_desc_default(desc);
+#ifdef LUMA_ONLY
+    desc->luma_only = true;
+#endif
+#ifdef BAYER
+    desc->bytes_per_pixel = 1;
+#endif
+}
+
+#if defined(STREAM_MODE) || defined(DUAL_CORE_MODE)
+// DMA IRQ - destination for the next frame. If no slot is free the 
+// frame is dropped (counted as an overrun), so a frame that is 
+// being sent is never overwritten.
+static uint8_t* stream_frame_dest(uint line, void* ctx) {
+    frame_desc_t* slot = frame_ring_acquire();
+    if (!slot) {
+        frame_ring_overrun();
+        return NULL;
+    }
+    return slot->data;
+}
+
+// DMA IRQ - frame is complete, pass it to the main loop
+static void stream_frame_done(uint8_t* frame, uint line, uint nlines, void* ctx) {
+    frame_ring_publish(frame_ring_lookup(frame));
+    event_post(EVENT_FRAME);
+}
 
-// QVGA image buffer - RGB565 requires 2 bytes per pixel
-uint8_t image_buffer[IMAGE_SIZE * 2];
+static const ov7670_stream_cb_t stream_cb = {
+    .band_dest = stream_frame_dest,
+    .band_done = stream_frame_done,
+};
+#endif
 
 // for button press
-volatile bool button_pressed = false;
 volatile uint32_t last_press_time = 0;
 volatile bool capturing_frame = false;  
 #define BUTTON_PIN 26
@@ -60,21 +217,21 @@ static void create_test_image(uint8_t* buffer) {
     }
 }
 
-// D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
-static uint8_t reverse_bits(uint8_t byte) {
-    byte = ((byte & 0xF0) >> 4) | ((byte & 0x0F) << 4);
-    byte = ((byte & 0xCC) >> 2) | ((byte & 0x33) << 2);
-    byte = ((byte & 0xAA) >> 1) | ((byte & 0x55) << 1);
-    return byte;
-}
+// frames are sent on UART_ID via DMA
+static transport_t* transport;
 
-// send image over UART
-static void send_image(uart_inst_t* uart, uint8_t* buffer) {
-    for (int i = 0; i < IMAGE_SIZE * 2; i++) {  // Send all pixels (each pixel = 2 bytes)
-        //uart_putc(uart, buffer[i]);
-        uint8_t val = reverse_bits(buffer[i]);
-        printf("%c", val);
-    }
+// send frame over UART - header followed by pixels
+static void send_image(transport_t* t, frame_desc_t* frame) {
+    static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+    // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+    bitrev_bytes(frame->data, frame->size);
+
+    frame_proto_encode_header(header, frame, ov7670_get_width(), ov7670_get_height(), 0);
+
+    // CPU is free until DMA is done
+    transport_send(t, header, sizeof(header));
+    transport_send(t, frame->data, frame->size);
 }
 
 // Interrupt Handler for Button Press
@@ -88,88 +245,137 @@ void button_callback(uint gpio, uint32_t events) {
     if (current_time - last_press_time < DEBOUNCE_DELAY_MS) return;
 
     last_press_time = current_time;
-    button_pressed = true;  // Mark that button was pressed
+#ifdef ZSL_MODE
+    zsl_trigger(1);  // the newest frame is pinned now, not when the loop wakes
+#elif defined(RECORD_MODE)
+    record_trigger();  // frames that completed before now are pre-trigger
+#endif
+    event_post(EVENT_BUTTON);  // wakes the main loop
 }
 
-// OV7670 camera pins (Pico 2W)
-#define PCLK_PIN   4  // Pixel clock (INPUT)
-#define VSYNC_PIN  2  // Frame sync (INPUT)
-#define HREF_PIN   3  // Row sync (INPUT)
-#define DATA_BASE  6  // GP6-GP13 (8-bit parallel data INPUT)
-
-// Data pins (D0-D7 mapped to GP6-GP13)
-#define DATA_PIN_BASE 6  // First data pin (D0 -> GP6)
-#define DATA_MASK (0xFF << DATA_PIN_BASE)  // Mask for GPIO6-GPIO13
+// format of one-shot captures - changed by the FORMAT command
+static frame_format_t capture_format = FRAME_FORMAT;
 
-void grab_frame()
+void capture_frame()
 {
-    // Initialize control pins as INPUT
-    gpio_init(PCLK_PIN);
-    gpio_set_dir(PCLK_PIN, GPIO_IN);
-    gpio_init(VSYNC_PIN);
-    gpio_set_dir(VSYNC_PIN, GPIO_IN);
-    gpio_init(HREF_PIN);
-    gpio_set_dir(HREF_PIN, GPIO_IN);
-
-    // Initialize data pins as INPUT
-    for (int pin = DATA_BASE; pin < DATA_BASE + 8; pin++) {
-        gpio_init(pin);
-        gpio_set_dir(pin, GPIO_IN);
+    frame_desc_t* slot = frame_ring_acquire();
+    if (!slot) {
+        return;
     }
 
-    uint16_t y, x;
-    uint8_t *bufPtr = image_buffer;
-
-    // Wait for VSYNC to go HIGH then LOW (Frame start)
-    while (!(gpio_get(VSYNC_PIN)));  // Wait for HIGH
-    while (gpio_get(VSYNC_PIN));     // Wait for LOW (Frame start)
-
-    y = 240;
-    while (y--) {
-        x = 640;
-        while (x--) {
-            // Wait for PCLK to go LOW
-            while (gpio_get(PCLK_PIN));
+    // turn LED on 
+    gpio_put(LED_PIN, 0); // on
 
-            // Read 8-bit parallel data in one operation
-            //uint32_t gpio_value = gpio_get_all();
-            //uint8_t byteData = (gpio_value & DATA_MASK) >> DATA_PIN_BASE;
+    // grab frame - a sensor that stalls or loses lines fails it 
+    // instead of hanging, and the next capture starts clean
+    if (!ov7670_grab_frame(slot->data)) {
+        frame_ring_abort(slot);
+        gpio_put(LED_PIN, 1); // off 
+
+        ov7670_grab_stats_t gstats;
+        ov7670_get_grab_stats(&gstats);
+        printf("grab failed: %lu timeouts, %lu short frames in %lu grabs\n",
+               (unsigned long)gstats.timeouts, (unsigned long)gstats.short_frames,
+               (unsigned long)gstats.grabs);
+        return;
+    }
+    slot->format = capture_format;
+    slot->size = ov7670_get_width() * ov7670_get_height() *
+                 (capture_format == FRAME_FMT_BAYER ? 1 : 2);
 
-            // Read 8-bit parallel data in one operation using direct register access
-            uint8_t byteData = (sio_hw->gpio_in & DATA_MASK) >> DATA_PIN_BASE;
+    //ov7670_bitbang_grab(slot->data, ov7670_get_frame_period_us());
 
+    frame_ring_publish(slot);
 
-            // Store the byte in the buffer
-            *bufPtr++ = byteData;
+    // send over uart 
+    slot = frame_ring_get_ready();
+    send_image(transport, slot);
+    frame_ring_release(slot);
 
-            // Wait for PCLK to go HIGH
-            while (!gpio_get(PCLK_PIN));
-        }
-    }
+    // LED off 
+    gpio_put(LED_PIN, 1); // off 
 }
 
-void capture_frame()
+// frames still to send (button or CAPTURE), and whether STREAM is on - main loop only
+static uint capture_pending = 0;
+#ifdef STREAM_MODE
+static bool stream_on = true;
+#else
+static bool stream_on = false;
+#endif
+
+#ifdef USE_CMD
+#ifdef ZSL_MODE
+// frames already captured - see zsl.h
+static cmd_status_t cmd_capture(uint16_t frames)
 {
-    // turn LED on 
-    gpio_put(LED_PIN, 0); // on
-
-    // grab frame
-    ov7670_grab_frame();
-
-    //grab_frame();
+    zsl_trigger(frames);
+    return CMD_OK;
+}
+#elif defined(RECORD_MODE)
+// a burst of RECORD_PRE + RECORD_POST frames, whatever frames says
+static cmd_status_t cmd_capture(uint16_t frames)
+{
+    record_trigger();
+    return CMD_OK;
+}
+#elif !defined(FLOW_CONTROL)
+static cmd_status_t cmd_capture(uint16_t frames)
+{
+    capture_pending += frames;
+    return CMD_OK;
+}
 
-    // send over uart 
-    send_image(UART_ID, image_buffer);
+static cmd_status_t cmd_stream(bool on)
+{
+    stream_on = on;
+    return CMD_OK;
+}
+#endif
 
-    // LED off 
-    gpio_put(LED_PIN, 1); // off 
+#if !defined(STREAM_MODE) && !defined(ZSL_MODE) && !defined(RECORD_MODE)
+// One-shot captures go into ring slots - the frame must fit one
+static cmd_status_t cmd_format(uint8_t format, uint16_t width, uint16_t height, uint8_t clkrc)
+{
+    bool ok;
+
+    if (format == FRAME_FMT_YUV422 && width * height * 2 <= FRAME_BYTES) {
+        ok = ov7670_set_size(width, height, clkrc);
+    } else if (format == FRAME_FMT_BAYER && width * height <= FRAME_BYTES) {
+        ok = ov7670_set_bayer(width, height, clkrc);
+    } else {
+        return CMD_ERR_ARG;
+    }
+    if (!ok) {
+        return CMD_ERR_ARG;
+    }
+    capture_format = format;
+    return CMD_OK;
 }
+#endif
+
+static const cmd_handlers_t cmd_handlers = {
+#ifdef FLOW_CONTROL
+    .credit = flow_ctrl_add_credit,
+#elif defined(ZSL_MODE) || defined(RECORD_MODE)
+    .capture = cmd_capture,
+#else
+    .capture = cmd_capture,
+    .stream = cmd_stream,
+#endif
+#if !defined(STREAM_MODE) && !defined(ZSL_MODE) && !defined(RECORD_MODE)
+    .format = cmd_format,
+#endif
+};
+#endif
 
 int main()
 {
     stdio_init_all();    
-    // Set up our UART
-    uart_init(UART_ID, BAUD_RATE);
+    // Set up our UART for DMA transmit
+    uint baud;
+    transport = uart_dma_init(UART_ID, BAUD_RATE, &baud);
+    printf("uart1 at %u baud\n", baud);
     // Set the TX and RX pins by using the function select on the GPIO
     // Set datasheet for more information on function select
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
@@ -194,23 +400,340 @@ int main()
     // Attach interrupt on falling edge (button press)
     gpio_set_irq_enabled_with_callback(BUTTON_PIN, GPIO_IRQ_EDGE_FALL, true, &button_callback);
 
+#ifdef USE_FRAME_RING
+    // all frame memory comes from the ring
+    frame_ring_init(frame_storage, FRAME_FORMAT, FRAME_BYTES);
+#endif
+
     // init OV7670
-    ov7670_init(image_buffer);
+    ov7670_init(NULL);  // frame buffer is set per grab
+
+    // sensor mode first, so readiness is checked on the mode that is captured
+#if defined(LINE_MODE) && defined(BAYER)
+    // full sensor window, slowed down so lines don't outrun the link
+    ov7670_set_bayer(640, 480, LINE_STREAM_VGA_BAYER_CLKRC);
+#elif defined(LINE_MODE)
+    ov7670_set_size(640, 480, LINE_STREAM_VGA_CLKRC);
+#elif defined(BAYER)
+    // QVGA window from the middle of the array - a frame fits a ring slot
+    ov7670_set_bayer(IMAGE_WIDTH, IMAGE_HEIGHT, BAYER_CLKRC);
+#elif defined(JPEG_MODE)
+    // QVGA, slowed down so MCU rows don't outrun the encoder
+    ov7670_set_size(IMAGE_WIDTH, IMAGE_HEIGHT, JPEG_STREAM_CLKRC);
+#endif
+    boot_trace_mark("mode");
+
+    // frames out and exposure settled - at most as long as the old fixed delay
+    if (!ov7670_wait_ready(READY_TIMEOUT_MS)) {
+        printf("sensor not settled after %u ms\n", READY_TIMEOUT_MS);
+    }
+    boot_trace_print();
+
+#ifdef LINE_MODE
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+    line_stream_init(transport, &desc);
+    ov7670_stream_start(&desc, 1, &line_stream_cb);
+
+    uint32_t last_report = 0;
+    while (true) {
+        line_stream_poll();
+
+        // memory and throughput on stdout every frame
+        line_stream_stats_t stats;
+        line_stream_get_stats(&stats);
+        if (stats.frames_sent != last_report) {
+            printf("line stream: %lu frames, %lu lines/s, %lu lines dropped, "
+                   "ring %lu bytes, high water %lu lines\n",
+                   (unsigned long)stats.frames_sent, (unsigned long)stats.lines_per_sec,
+                   (unsigned long)stats.lines_dropped, (unsigned long)stats.ring_bytes,
+                   (unsigned long)stats.ring_high_water);
+            last_report = stats.frames_sent;
+        }
+        tight_loop_contents();
+    }
+#endif
+
+#ifdef JPEG_MODE
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+    jpeg_stream_init(transport, &desc, JPEG_DEFAULT_QUALITY);
+    ov7670_stream_start(&desc, JPEG_MCU_HEIGHT, &jpeg_stream_cb);
+
+    uint32_t last_report = 0;
+    while (true) {
+        jpeg_stream_poll();
+
+        // size and encoder throughput on stdout every frame
+        jpeg_stream_stats_t stats;
+        jpeg_stream_get_stats(&stats);
+        if (stats.frames_sent != last_report) {
+            printf("jpeg: %lu frames, %lu bytes, encode %lu us (%lu MCUs/s), "
+                   "%lu skipped, %lu too big, %lu bands dropped\n",
+                   (unsigned long)stats.frames_sent, (unsigned long)stats.last_bytes,
+                   (unsigned long)stats.encode_us, (unsigned long)stats.mcus_per_sec,
+                   (unsigned long)stats.frames_skipped, (unsigned long)stats.frames_too_big,
+                   (unsigned long)stats.bands_dropped);
+            last_report = stats.frames_sent;
+        }
+        tight_loop_contents();
+    }
+#endif
+
+#ifdef STREAM_MODE
+    // one band per frame
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+#ifdef TILE_DELTA
+    tile_delta_init(desc.width, desc.height, ov7670_capture_line_bytes(&desc) / desc.width,
+                    TILE_DELTA_THRESHOLD, TILE_DELTA_KEYFRAME_INTERVAL);
+#endif
+    ov7670_stream_start(&desc, IMAGE_HEIGHT, &stream_cb);
+
+#ifdef FLOW_CONTROL
+    flow_ctrl_init(transport, FLOW_POLICY, desc.width, desc.height);
+    cmd_init(UART_ID, transport, &cmd_handlers);
+
+    uint32_t last_report = 0;
+    while (true) {
+        // a frame, or credit for the held one
+        event_wait();
+        flow_ctrl_poll();
+        cmd_poll();
+
+        // credit, drops and latency on stdout every 10 frames
+        flow_stats_t fstats;
+        flow_ctrl_get_stats(&fstats);
+        if (fstats.frames_sent >= last_report + 10) {
+            printf("flow: %lu frames (%lu downscaled), credit %lu, dropped %lu newest %lu oldest, "
+                   "latency %lu us (max %lu us)\n",
+                   (unsigned long)fstats.frames_sent, (unsigned long)fstats.frames_downscaled,
+                   (unsigned long)fstats.credit, (unsigned long)fstats.dropped_newest,
+                   (unsigned long)fstats.dropped_oldest, (unsigned long)fstats.latency_us,
+                   (unsigned long)fstats.latency_max_us);
+            last_report = fstats.frames_sent;
+        }
+    }
+#endif
+
+    cmd_init(UART_ID, transport, &cmd_handlers);
+
+    uint32_t last_overruns = 0;
+    while (true) {
+        // sleep until a frame or a command arrives
+        event_wait();
+        cmd_poll();
+
+        frame_desc_t* slot;
+        while ((slot = frame_ring_get_ready())) {
+            if (!stream_on && capture_pending == 0) {
+                // stopped by the host - capture keeps running, frames are dropped
+                frame_ring_release(slot);
+                continue;
+            }
+            if (capture_pending) {
+                capture_pending--;
+            }
+#ifdef TILE_DELTA
+            // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+            bitrev_bytes(slot->data, slot->size);
+            tile_delta_send(transport, slot);
+
+            // savings and diff cost on stdout every 30 frames
+            tile_delta_stats_t tstats;
+            tile_delta_get_stats(&tstats);
+            if (tstats.frames_sent % 30 == 0) {
+                printf("tile delta: %lu/%lu tiles, %lu bytes, %ld%% saved, diff %lu us (max %lu us)\n",
+                       (unsigned long)tstats.tiles_sent, (unsigned long)tstats.tiles_total,
+                       (unsigned long)tstats.wire_bytes, (long)tstats.saved_pct,
+                       (unsigned long)tstats.diff_us, (unsigned long)tstats.diff_max_us);
+            }
+#else
+            send_image(transport, slot);
+#endif
+            frame_ring_release(slot);
+
+            // report overruns on stdout as they happen
+            frame_ring_stats_t stats;
+            frame_ring_get_stats(&stats);
+            if (stats.overruns != last_overruns) {
+                printf("frame ring: %lu overruns\n", (unsigned long)stats.overruns);
+                last_overruns = stats.overruns;
+            }
+
+            // commands between frames, not only once the ring is empty
+            cmd_poll();
+        }
+    }
+#endif
+
+#ifdef DUAL_CORE_MODE
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+    dual_core_start(transport, desc.width, desc.height);
+    ov7670_stream_start(&desc, desc.height, &stream_cb);
+
+    uint32_t last_report = 0;
+    while (true) {
+        dual_core_poll();
+
+        // utilization and queue depth on stdout every 10 frames
+        dual_core_stats_t stats;
+        dual_core_get_stats(&stats);
+        if (stats.frames_sent >= last_report + 10) {
+            uint32_t elapsed_ms = stats.elapsed_us / 1000 + 1;
+            printf("dual core: %lu frames, core0 %lu%%, core1 %lu%%, queue %lu (max %lu)\n",
+                   (unsigned long)stats.frames_sent,
+                   (unsigned long)(stats.core0_busy_us / 10 / elapsed_ms),
+                   (unsigned long)(stats.core1_busy_us / 10 / elapsed_ms),
+                   (unsigned long)stats.queue_depth, (unsigned long)stats.queue_max);
+            last_report = stats.frames_sent;
+        }
+        __wfe();
+    }
+#endif
+
+#ifdef PIPELINE_MODE
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+#ifdef COMPRESS_QOI16
+    pipeline_init(transport, &desc, true);
+#else
+    pipeline_init(transport, &desc, false);
+#endif
+    ov7670_stream_start(&desc, PIPELINE_BAND_LINES, &pipeline_stream_cb);
+
+    uint32_t last_report = 0;
+    while (true) {
+        pipeline_poll();
+
+        // per-stage timings on stdout every 10 frames
+        pipeline_stats_t stats;
+        pipeline_get_stats(&stats);
+        if (stats.frames_sent >= last_report + 10) {
+            printf("pipeline: %lu frames, band wait %lu us, fixup %lu us, tx %lu us, "
+                   "first byte %lu us, latency %lu us (max %lu us)\n",
+                   (unsigned long)stats.frames_sent, (unsigned long)stats.band_wait_us,
+                   (unsigned long)stats.band_fixup_us, (unsigned long)stats.band_tx_us,
+                   (unsigned long)stats.first_byte_us, (unsigned long)stats.frame_latency_us,
+                   (unsigned long)stats.frame_latency_max_us);
+            printf("pipeline: %lu bytes sent for %lu bytes of pixels, %lu bands stored\n",
+                   (unsigned long)stats.wire_bytes, (unsigned long)stats.raw_bytes,
+                   (unsigned long)stats.bands_stored);
+            last_report = stats.frames_sent;
+        }
+        tight_loop_contents();
+    }
+#endif
+
+#ifdef ZSL_MODE
+    // whole frames, captured whether or not anyone asked for them
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+    zsl_init(zsl_storage, FRAME_FORMAT, FRAME_BYTES, transport, desc.width, desc.height);
+    ov7670_stream_start(&desc, desc.height, &zsl_stream_cb);
+    cmd_init(UART_ID, transport, &cmd_handlers);
+
+    uint32_t last_report = 0;
+    while (true) {
+        // a trigger, a command, or the frame a snapshot waits for
+        event_wait();
+        cmd_poll();
+        zsl_poll();
+
+        // trigger -> frame timestamp on stdout after each snapshot
+        zsl_stats_t zstats;
+        zsl_get_stats(&zstats);
+        if (zstats.snapshots != last_report) {
+            printf("zsl: %lu snapshots, frame %ld us from trigger (%ld to %ld us), "
+                   "%lu captured, %lu overruns\n",
+                   (unsigned long)zstats.snapshots, (long)zstats.lag_us,
+                   (long)zstats.lag_min_us, (long)zstats.lag_max_us,
+                   (unsigned long)zstats.captured, (unsigned long)zstats.overruns);
+            last_report = zstats.snapshots;
+        }
+    }
+#endif
+
+#ifdef RECORD_MODE
+    ov7670_capture_desc_t desc;
+    get_capture_desc(&desc);
+    printf("record: %u before + %u after, at most %u before in %u bytes\n",
+           RECORD_PRE, RECORD_POST,
+           record_max_pre(sizeof(record_storage), &desc, RECORD_HISTORY, RECORD_POST),
+           (unsigned)sizeof(record_storage));
+    if (!record_init(record_storage, sizeof(record_storage), &desc, RECORD_HISTORY,
+                     RECORD_PRE, RECORD_POST, RECORD_MOTION, transport)) {
+        printf("record: history doesn't fit\n");
+    }
+    ov7670_stream_start(&desc, RECORD_BAND_LINES, &record_stream_cb);
+    cmd_init(UART_ID, transport, &cmd_handlers);
+
+    uint32_t last_report = 0;
+    while (true) {
+        // bands, a trigger or a command
+        event_wait();
+        cmd_poll();
+        record_poll();
+
+        // on stdout after each burst
+        record_stats_t rstats;
+        record_get_stats(&rstats);
+        if (rstats.bursts != last_report) {
+            printf("record: burst of %lu frames in %lu ms, %lu triggers (%lu motion, %lu ignored), "
+                   "%lu frames recorded, %lu broken\n",
+                   (unsigned long)rstats.burst_frames, (unsigned long)(rstats.burst_us / 1000),
+                   (unsigned long)rstats.triggers, (unsigned long)rstats.motion_triggers,
+                   (unsigned long)rstats.triggers_ignored, (unsigned long)rstats.frames,
+                   (unsigned long)rstats.frames_broken);
+            last_report = rstats.bursts;
+        }
+    }
+#endif
 
-    sleep_ms(1000);
     capture_frame();
 
-    //  main loop 
+#ifdef USE_CMD
+    // the host can trigger captures too - see cmd.h
+    cmd_init(UART_ID, transport, &cmd_handlers);
+#endif
+
+    event_timer_start(EVENT_REPORT_MS);
+    uint32_t last_handled = 0;
+
+    //  main loop - sleeps until the button, a command or the timer
     while (true) {
-        if (button_pressed) {
-            button_pressed = false;  // Reset flag
+        // only sleep when there is nothing left to capture
+        uint32_t ev = (capture_pending || stream_on) ? event_take() : event_wait();
+
+#ifdef USE_CMD
+        if (ev & EVENT_BIT(EVENT_CMD)) {
+            cmd_poll();
+        }
+#endif
+        if (ev & EVENT_BIT(EVENT_BUTTON)) {
+            capture_pending++;
+        }
+        if (ev & EVENT_BIT(EVENT_TIMER)) {
+            // trigger latency histograms, when there were triggers
+            event_stats_t button, cmd;
+            event_get_stats(EVENT_BUTTON, &button);
+            event_get_stats(EVENT_CMD, &cmd);
+            if (button.handled + cmd.handled != last_handled) {
+                event_print_stats();
+                last_handled = button.handled + cmd.handled;
+            }
+        }
+
+        if (capture_pending || stream_on) {
             capturing_frame = true;  // Mark as busy
 
             capture_frame();
+            if (capture_pending) {
+                capture_pending--;
+            }
 
             capturing_frame = false;  // Mark as ready for next press
-            
         }
-        sleep_ms(100);
     }
 }
\ No newline at end of file
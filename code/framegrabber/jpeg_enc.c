@@ -0,0 +1,474 @@
+/*
+    Baseline JPEG encoder for YUYV frames - see jpeg_enc.h.
+*/
+
+#include <string.h>
+
+#include "jpeg_enc.h"
+
+// zigzag index -> natural (row-major) index
+static const uint8_t zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Annex K.1 quant tables - natural order
+static const uint8_t std_luma_q[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t std_chroma_q[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Annex K.3 Huffman tables - code counts per length 1..16, then symbols
+static const uint8_t dc_luma_bits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t dc_chroma_bits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t ac_luma_bits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t ac_luma_vals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t ac_chroma_bits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t ac_chroma_vals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+// Huffman codes by symbol - [0] luma, [1] chroma
+typedef struct {
+    uint16_t code;
+    uint8_t size;
+} huff_code_t;
+
+static huff_code_t dc_codes[2][12];
+static huff_code_t ac_codes[2][256];
+static bool huff_ready = false;
+
+// Canonical codes from the counts per length (Annex C)
+static void huff_build(huff_code_t* codes, const uint8_t* bits, const uint8_t* vals)
+{
+    uint16_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < bits[len - 1]; i++) {
+            codes[vals[k]].code = code++;
+            codes[vals[k]].size = len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+static void huff_init()
+{
+    huff_build(dc_codes[0], dc_luma_bits, dc_vals);
+    huff_build(dc_codes[1], dc_chroma_bits, dc_vals);
+    huff_build(ac_codes[0], ac_luma_bits, ac_luma_vals);
+    huff_build(ac_codes[1], ac_chroma_bits, ac_chroma_vals);
+    huff_ready = true;
+}
+
+bool jpeg_enc_init(jpeg_enc_t* enc, uint16_t width, uint16_t height, int quality)
+{
+    if (!width || !height || width % JPEG_MCU_WIDTH || height % JPEG_MCU_HEIGHT) {
+        return false;
+    }
+    if (!huff_ready) {
+        huff_init();
+    }
+
+    memset(enc, 0, sizeof(*enc));
+    enc->width = width;
+    enc->height = height;
+
+    // IJG quality scaling
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+
+    for (int i = 0; i < 64; i++) {
+        const uint8_t* std[2] = { std_luma_q, std_chroma_q };
+        for (int t = 0; t < 2; t++) {
+            int q = (std[t][zigzag[i]] * scale + 50) / 100;
+            if (q < 1) q = 1;
+            if (q > 255) q = 255;
+            enc->qtab[t][i] = q;
+            // the DCT output is scaled up by 8
+            enc->qrecip[t][i] = 65536 / (8 * q);
+        }
+    }
+    return true;
+}
+
+static inline void emit_byte(jpeg_enc_t* enc, uint8_t b)
+{
+    if (enc->out_len < enc->out_cap) {
+        enc->out[enc->out_len++] = b;
+    } else {
+        enc->overflow = true;
+    }
+}
+
+static inline void emit_u16(jpeg_enc_t* enc, uint16_t v)
+{
+    emit_byte(enc, v >> 8);
+    emit_byte(enc, v & 0xFF);
+}
+
+// Append the low n (1..16) bits of bits, stuffing a 0 after every 0xFF
+static inline void put_bits(jpeg_enc_t* enc, uint32_t bits, uint32_t n)
+{
+    enc->bit_buf = (enc->bit_buf << n) | (bits & ((1u << n) - 1));
+    enc->bit_cnt += n;
+    while (enc->bit_cnt >= 8) {
+        enc->bit_cnt -= 8;
+        uint8_t b = enc->bit_buf >> enc->bit_cnt;
+        emit_byte(enc, b);
+        if (b == 0xFF) {
+            emit_byte(enc, 0);
+        }
+    }
+}
+
+static void write_dht(jpeg_enc_t* enc, uint8_t id, const uint8_t* bits, const uint8_t* vals)
+{
+    int count = 0;
+    for (int i = 0; i < 16; i++) {
+        count += bits[i];
+    }
+
+    emit_u16(enc, 0xFFC4);
+    emit_u16(enc, 2 + 1 + 16 + count);
+    emit_byte(enc, id);
+    for (int i = 0; i < 16; i++) {
+        emit_byte(enc, bits[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        emit_byte(enc, vals[i]);
+    }
+}
+
+void jpeg_enc_begin(jpeg_enc_t* enc, uint8_t* out, uint32_t cap)
+{
+    enc->out = out;
+    enc->out_cap = cap;
+    enc->out_len = 0;
+    enc->overflow = false;
+    enc->bit_buf = 0;
+    enc->bit_cnt = 0;
+    enc->dc_pred[0] = enc->dc_pred[1] = enc->dc_pred[2] = 0;
+    enc->mcu_row = 0;
+
+    // SOI
+    emit_u16(enc, 0xFFD8);
+
+    // APP0 - JFIF 1.01, no thumbnail
+    static const uint8_t jfif[] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    emit_u16(enc, 0xFFE0);
+    emit_u16(enc, 2 + sizeof(jfif));
+    for (uint32_t i = 0; i < sizeof(jfif); i++) {
+        emit_byte(enc, jfif[i]);
+    }
+
+    // DQT - 8-bit tables 0 (luma) and 1 (chroma)
+    for (int t = 0; t < 2; t++) {
+        emit_u16(enc, 0xFFDB);
+        emit_u16(enc, 2 + 1 + 64);
+        emit_byte(enc, t);
+        for (int i = 0; i < 64; i++) {
+            emit_byte(enc, enc->qtab[t][i]);
+        }
+    }
+
+    // SOF0 - Y 2x1, Cb 1x1, Cr 1x1
+    emit_u16(enc, 0xFFC0);
+    emit_u16(enc, 2 + 6 + 3 * 3);
+    emit_byte(enc, 8);
+    emit_u16(enc, enc->height);
+    emit_u16(enc, enc->width);
+    emit_byte(enc, 3);
+    emit_byte(enc, 1); emit_byte(enc, 0x21); emit_byte(enc, 0);
+    emit_byte(enc, 2); emit_byte(enc, 0x11); emit_byte(enc, 1);
+    emit_byte(enc, 3); emit_byte(enc, 0x11); emit_byte(enc, 1);
+
+    // DHT - DC/AC tables 0 (luma) and 1 (chroma)
+    write_dht(enc, 0x00, dc_luma_bits, dc_vals);
+    write_dht(enc, 0x10, ac_luma_bits, ac_luma_vals);
+    write_dht(enc, 0x01, dc_chroma_bits, dc_vals);
+    write_dht(enc, 0x11, ac_chroma_bits, ac_chroma_vals);
+
+    // SOS - all 3 components, full spectral range
+    emit_u16(enc, 0xFFDA);
+    emit_u16(enc, 2 + 1 + 3 * 2 + 3);
+    emit_byte(enc, 3);
+    emit_byte(enc, 1); emit_byte(enc, 0x00);
+    emit_byte(enc, 2); emit_byte(enc, 0x11);
+    emit_byte(enc, 3); emit_byte(enc, 0x11);
+    emit_byte(enc, 0);
+    emit_byte(enc, 63);
+    emit_byte(enc, 0);
+}
+
+// Fixed-point forward DCT - IJG jfdctint.c (islow). Output is scaled up by 8.
+#define DCT_CONST_BITS 13
+#define DCT_PASS1_BITS 2
+#define DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+
+#define FIX_0_298631336  2446
+#define FIX_0_390180644  3196
+#define FIX_0_541196100  4433
+#define FIX_0_765366865  6270
+#define FIX_0_899976223  7373
+#define FIX_1_175875602  9633
+#define FIX_1_501321110  12299
+#define FIX_1_847759065  15137
+#define FIX_1_961570560  16069
+#define FIX_2_053119869  16819
+#define FIX_2_562915447  20995
+#define FIX_3_072711026  25172
+
+static void fdct_islow(int32_t* data)
+{
+    // pass 1 - rows, results scaled up by 2^PASS1_BITS
+    for (int r = 0; r < 8; r++) {
+        int32_t* d = data + 8 * r;
+
+        int32_t tmp0 = d[0] + d[7];
+        int32_t tmp7 = d[0] - d[7];
+        int32_t tmp1 = d[1] + d[6];
+        int32_t tmp6 = d[1] - d[6];
+        int32_t tmp2 = d[2] + d[5];
+        int32_t tmp5 = d[2] - d[5];
+        int32_t tmp3 = d[3] + d[4];
+        int32_t tmp4 = d[3] - d[4];
+
+        int32_t tmp10 = tmp0 + tmp3;
+        int32_t tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2;
+        int32_t tmp12 = tmp1 - tmp2;
+
+        d[0] = (tmp10 + tmp11) << DCT_PASS1_BITS;
+        d[4] = (tmp10 - tmp11) << DCT_PASS1_BITS;
+
+        int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+        d[2] = DESCALE(z1 + tmp13 * FIX_0_765366865, DCT_CONST_BITS - DCT_PASS1_BITS);
+        d[6] = DESCALE(z1 - tmp12 * FIX_1_847759065, DCT_CONST_BITS - DCT_PASS1_BITS);
+
+        z1 = tmp4 + tmp7;
+        int32_t z2 = tmp5 + tmp6;
+        int32_t z3 = tmp4 + tmp6;
+        int32_t z4 = tmp5 + tmp7;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+        tmp4 *= FIX_0_298631336;
+        tmp5 *= FIX_2_053119869;
+        tmp6 *= FIX_3_072711026;
+        tmp7 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+
+        d[7] = DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+        d[5] = DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+        d[3] = DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+        d[1] = DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+    }
+
+    // pass 2 - columns, removes PASS1_BITS and leaves the factor of 8
+    for (int c = 0; c < 8; c++) {
+        int32_t* d = data + c;
+
+        int32_t tmp0 = d[8 * 0] + d[8 * 7];
+        int32_t tmp7 = d[8 * 0] - d[8 * 7];
+        int32_t tmp1 = d[8 * 1] + d[8 * 6];
+        int32_t tmp6 = d[8 * 1] - d[8 * 6];
+        int32_t tmp2 = d[8 * 2] + d[8 * 5];
+        int32_t tmp5 = d[8 * 2] - d[8 * 5];
+        int32_t tmp3 = d[8 * 3] + d[8 * 4];
+        int32_t tmp4 = d[8 * 3] - d[8 * 4];
+
+        int32_t tmp10 = tmp0 + tmp3;
+        int32_t tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2;
+        int32_t tmp12 = tmp1 - tmp2;
+
+        d[8 * 0] = DESCALE(tmp10 + tmp11, DCT_PASS1_BITS);
+        d[8 * 4] = DESCALE(tmp10 - tmp11, DCT_PASS1_BITS);
+
+        int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+        d[8 * 2] = DESCALE(z1 + tmp13 * FIX_0_765366865, DCT_CONST_BITS + DCT_PASS1_BITS);
+        d[8 * 6] = DESCALE(z1 - tmp12 * FIX_1_847759065, DCT_CONST_BITS + DCT_PASS1_BITS);
+
+        z1 = tmp4 + tmp7;
+        int32_t z2 = tmp5 + tmp6;
+        int32_t z3 = tmp4 + tmp6;
+        int32_t z4 = tmp5 + tmp7;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+        tmp4 *= FIX_0_298631336;
+        tmp5 *= FIX_2_053119869;
+        tmp6 *= FIX_3_072711026;
+        tmp7 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+
+        d[8 * 7] = DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+        d[8 * 5] = DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+        d[8 * 3] = DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+        d[8 * 1] = DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+    }
+}
+
+static inline uint32_t magnitude_bits(uint32_t a)
+{
+    return a ? 32 - __builtin_clz(a) : 0;
+}
+
+// DCT, quantize and entropy code one block. comp 0 is Y, 1 Cb, 2 Cr.
+static void encode_block(jpeg_enc_t* enc, int32_t* block, int comp)
+{
+    int t = comp ? 1 : 0;
+    const uint16_t* recip = enc->qrecip[t];
+    const uint8_t* qtab = enc->qtab[t];
+
+    fdct_islow(block);
+
+    // quantize in zigzag order - round to nearest, symmetric about 0
+    int16_t zz[64];
+    for (int i = 0; i < 64; i++) {
+        int32_t v = block[zigzag[i]];
+        uint32_t half = 4 * qtab[i];
+        if (v < 0) {
+            zz[i] = -(int16_t)(((uint32_t)-v + half) * recip[i] >> 16);
+        } else {
+            zz[i] = ((uint32_t)v + half) * recip[i] >> 16;
+        }
+    }
+
+    // DC - difference from the previous block of this component
+    int32_t diff = zz[0] - enc->dc_pred[comp];
+    enc->dc_pred[comp] = zz[0];
+    uint32_t nbits = magnitude_bits(diff < 0 ? -diff : diff);
+    put_bits(enc, dc_codes[t][nbits].code, dc_codes[t][nbits].size);
+    if (nbits) {
+        put_bits(enc, diff < 0 ? diff - 1 : diff, nbits);
+    }
+
+    // AC - (run, size) symbols, ZRL for runs of 16, EOB after the last non-zero
+    const huff_code_t* ac = ac_codes[t];
+    uint32_t run = 0;
+    for (int i = 1; i < 64; i++) {
+        int32_t v = zz[i];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            put_bits(enc, ac[0xF0].code, ac[0xF0].size);
+            run -= 16;
+        }
+        nbits = magnitude_bits(v < 0 ? -v : v);
+        uint32_t sym = (run << 4) | nbits;
+        put_bits(enc, ac[sym].code, ac[sym].size);
+        put_bits(enc, v < 0 ? v - 1 : v, nbits);
+        run = 0;
+    }
+    if (run) {
+        put_bits(enc, ac[0x00].code, ac[0x00].size);
+    }
+}
+
+void jpeg_enc_mcu_row(jpeg_enc_t* enc, const uint8_t* yuyv, uint32_t stride)
+{
+    int32_t y0[64], y1[64], cb[64], cr[64];
+
+    if (enc->mcu_row >= enc->height / JPEG_MCU_HEIGHT) {
+        return;
+    }
+    enc->mcu_row++;
+
+    for (uint32_t mx = 0; mx < enc->width / JPEG_MCU_WIDTH; mx++) {
+        if (yuyv) {
+            // 16 pixels of YUYV is 32 bytes - Y0 U Y1 V per pixel pair
+            const uint8_t* base = yuyv + mx * 2 * JPEG_MCU_WIDTH;
+            for (int r = 0; r < 8; r++) {
+                const uint8_t* p = base + r * stride;
+                for (int c = 0; c < 8; c++) {
+                    y0[8 * r + c] = p[2 * c] - 128;
+                    y1[8 * r + c] = p[16 + 2 * c] - 128;
+                    cb[8 * r + c] = p[4 * c + 1] - 128;
+                    cr[8 * r + c] = p[4 * c + 3] - 128;
+                }
+            }
+        } else {
+            memset(y0, 0, sizeof(y0));
+            memset(y1, 0, sizeof(y1));
+            memset(cb, 0, sizeof(cb));
+            memset(cr, 0, sizeof(cr));
+        }
+
+        encode_block(enc, y0, 0);
+        encode_block(enc, y1, 0);
+        encode_block(enc, cb, 1);
+        encode_block(enc, cr, 2);
+    }
+}
+
+uint32_t jpeg_enc_end(jpeg_enc_t* enc)
+{
+    // rows never delivered are sent as grey so the image is complete
+    while (enc->mcu_row < enc->height / JPEG_MCU_HEIGHT) {
+        jpeg_enc_mcu_row(enc, NULL, 0);
+    }
+
+    // pad the last byte with 1s
+    if (enc->bit_cnt) {
+        put_bits(enc, 0x7F, 8 - enc->bit_cnt);
+    }
+
+    // EOI
+    emit_u16(enc, 0xFFD9);
+
+    return enc->overflow ? 0 : enc->out_len;
+}
@@ -0,0 +1,63 @@
+/*
+
+    jpeg_enc.h
+
+    Baseline JPEG encoder for YUYV (YUV422) frames.
+
+    The sensor's YUYV output maps directly onto JPEG 4:2:2 sampling
+    (Y 2x1, Cb/Cr 1x1), so no colour conversion or resampling is
+    needed - each 16x8 MCU is two Y blocks, one Cb and one Cr block
+    taken straight from 8 lines of YUYV.
+
+    The frame is encoded one MCU row (8 lines) at a time, so it can
+    consume bands as DMA delivers them. The DCT is the fixed-point
+    (13-bit constants) separable LLM DCT from the IJG "islow" code,
+    quantization uses reciprocals, and entropy coding uses the
+    standard Annex K Huffman tables.
+
+    No SDK dependencies - this builds on the host too.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JPEG_MCU_WIDTH  16
+#define JPEG_MCU_HEIGHT 8
+
+#ifndef JPEG_DEFAULT_QUALITY
+#define JPEG_DEFAULT_QUALITY 75
+#endif
+
+typedef struct {
+    uint16_t width;             // multiple of JPEG_MCU_WIDTH
+    uint16_t height;            // multiple of JPEG_MCU_HEIGHT
+    uint8_t qtab[2][64];        // luma, chroma - zigzag order, as written to DQT
+    uint16_t qrecip[2][64];     // 2^16 / (8 * q) - zigzag order
+
+    // output
+    uint8_t* out;
+    uint32_t out_cap;
+    uint32_t out_len;
+    bool overflow;              // ran out of space - the output is truncated
+
+    // entropy coder state
+    uint32_t bit_buf;
+    uint32_t bit_cnt;
+    int16_t dc_pred[3];
+    uint16_t mcu_row;
+} jpeg_enc_t;
+
+// Set size and build quant tables for quality 1..100
+bool jpeg_enc_init(jpeg_enc_t* enc, uint16_t width, uint16_t height, int quality);
+
+// Start a frame in out[cap] - writes the JPEG headers
+void jpeg_enc_begin(jpeg_enc_t* enc, uint8_t* out, uint32_t cap);
+
+// Encode the next 8 lines of YUYV, stride bytes apart. NULL encodes
+// a flat mid-grey row, for lines that were never captured.
+void jpeg_enc_mcu_row(jpeg_enc_t* enc, const uint8_t* yuyv, uint32_t stride);
+
+// Flush and write EOI - returns the JPEG length, or 0 if out was too small
+uint32_t jpeg_enc_end(jpeg_enc_t* enc);
@@ -0,0 +1,225 @@
+/*
+    JPEG streaming - see jpeg_stream.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "jpeg_stream.h"
+#include "frame_ring.h"
+#include "frame_proto.h"
+#include "spsc_queue.h"
+#include "bitrev.h"
+
+static uint8_t band_storage[JPEG_BAND_BUFS][JPEG_BAND_MAX_BYTES] __attribute__((aligned(4)));
+
+// one JPEG being encoded while the other is sent
+static uint8_t out_storage[2][JPEG_OUT_MAX];
+
+typedef struct {
+    uint8_t buf;            // index into band_storage
+    uint16_t line;
+    uint32_t frame;         // producer frame count
+    uint32_t captured_us;
+} band_event_t;
+
+static band_event_t ready_storage[JPEG_BAND_BUFS + 1];
+static uint8_t free_storage[JPEG_BAND_BUFS + 1];
+static spsc_queue_t ready_q;    // IRQ -> main loop
+static spsc_queue_t free_q;     // main loop -> IRQ
+
+static uint frame_width;
+static uint frame_height;
+static uint line_bytes;
+
+// producer side - frame each band buffer was armed for
+static volatile uint32_t capture_frame_count;
+static uint32_t band_frame[JPEG_BAND_BUFS];
+static bool capture_taken;              // frame being armed goes to the encoder
+static uint32_t frames_taken;           // by the IRQ
+static volatile uint32_t frames_encoded;// by the main loop
+
+// consumer side state for the frame being encoded
+static transport_t* transport;
+static jpeg_enc_t enc;
+static bool frame_open;
+static uint32_t frame_number;
+static uint32_t frame_captured_us;
+static uint32_t frame_encode_us;
+static int out_cur;
+
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+static jpeg_stream_stats_t stats;
+
+// DMA IRQ - next free band buffer, NULL drops the band. Buffers are 
+// armed two bands ahead, so when the first band of a frame is armed 
+// the last bands of the one before are still to land - the encoder 
+// can't have finished that one, only the ones before it.
+static uint8_t* band_dest(uint line, void* ctx)
+{
+    uint8_t idx;
+
+    if (line == 0) {
+        capture_frame_count++;
+        // a taken frame always gets its first band, so the main loop 
+        // sees it and counts it encoded
+        capture_taken = (int32_t)(frames_taken - frames_encoded) <= 1 && spsc_pop(&free_q, &idx);
+        if (!capture_taken) {
+            stats.frames_skipped++;
+            return NULL;
+        }
+        frames_taken++;
+    } else if (!capture_taken) {
+        return NULL;
+    } else if (!spsc_pop(&free_q, &idx)) {
+        stats.bands_dropped++;
+        return NULL;
+    }
+
+    band_frame[idx] = capture_frame_count;
+    return band_storage[idx];
+}
+
+// DMA IRQ - band has landed, queue it for the encoder
+static void band_done(uint8_t* dest, uint line, uint nlines, void* ctx)
+{
+    uint8_t idx = (dest - band_storage[0]) / JPEG_BAND_MAX_BYTES;
+    band_event_t ev = {
+        .buf = idx,
+        .line = line,
+        .frame = band_frame[idx],
+        .captured_us = time_us_32(),
+    };
+    spsc_push(&ready_q, &ev);
+}
+
+const ov7670_stream_cb_t jpeg_stream_cb = {
+    .band_dest = band_dest,
+    .band_done = band_done,
+    .ctx = NULL,
+};
+
+bool jpeg_stream_init(transport_t* t, const ov7670_capture_desc_t* desc, int quality)
+{
+    if (desc->luma_only || desc->bytes_per_pixel != 2 ||
+        ov7670_capture_line_bytes(desc) * JPEG_MCU_HEIGHT > JPEG_BAND_MAX_BYTES) {
+        return false;
+    }
+    if (!jpeg_enc_init(&enc, desc->width, desc->height, quality)) {
+        return false;
+    }
+
+    transport = t;
+    frame_width = desc->width;
+    frame_height = desc->height;
+    line_bytes = ov7670_capture_line_bytes(desc);
+
+    spsc_init(&ready_q, ready_storage, sizeof(band_event_t), JPEG_BAND_BUFS);
+    spsc_init(&free_q, free_storage, 1, JPEG_BAND_BUFS);
+    for (uint8_t i = 0; i < JPEG_BAND_BUFS; i++) {
+        spsc_push(&free_q, &i);
+    }
+
+    capture_frame_count = 0;
+    capture_taken = false;
+    frames_taken = 0;
+    frames_encoded = 0;
+    frame_open = false;
+    out_cur = 0;
+    stats = (jpeg_stream_stats_t){0};
+    return true;
+}
+
+static void jpeg_stream_open_frame(const band_event_t* ev)
+{
+    // the other buffer may still be going out - this one is free
+    jpeg_enc_begin(&enc, out_storage[out_cur], JPEG_OUT_MAX);
+
+    frame_open = true;
+    frame_number = ev->frame;
+    frame_captured_us = ev->captured_us;
+    frame_encode_us = 0;
+}
+
+static void jpeg_stream_close_frame()
+{
+    uint32_t len = jpeg_enc_end(&enc);
+    frame_open = false;
+
+    // the frame after the one being captured can be taken now
+    frames_encoded++;
+
+    if (!len) {
+        stats.frames_too_big++;
+        return;
+    }
+
+    frame_desc_t desc = {
+        .seq = frame_number,
+        .timestamp_us = frame_captured_us,
+        .size = len,
+        .format = FRAME_FMT_JPEG,
+        .data = out_storage[out_cur],
+    };
+    frame_proto_encode_header(header, &desc, frame_width, frame_height, 0);
+
+    // waits for the previous JPEG to finish going out
+    transport_send(transport, header, sizeof(header));
+    transport_send_async(transport, desc.data, len);
+    out_cur ^= 1;
+
+    uint32_t mcus = (frame_width / JPEG_MCU_WIDTH) * (frame_height / JPEG_MCU_HEIGHT);
+    stats.frames_sent++;
+    stats.last_bytes = len;
+    stats.encode_us = frame_encode_us;
+    if (frame_encode_us) {
+        stats.mcus_per_sec = (uint64_t)mcus * 1000000 / frame_encode_us;
+    }
+}
+
+void jpeg_stream_poll()
+{
+    // read before draining - every band of frames before the last 
+    // one started has been queued by now
+    uint32_t started = capture_frame_count;
+
+    band_event_t ev;
+    while (spsc_pop(&ready_q, &ev)) {
+        if (frame_open && ev.frame != frame_number) {
+            jpeg_stream_close_frame();
+        }
+        if (!frame_open) {
+            jpeg_stream_open_frame(&ev);
+        }
+
+        uint32_t t0 = time_us_32();
+
+        // rows we had no buffer for
+        while (enc.mcu_row < ev.line / JPEG_MCU_HEIGHT) {
+            jpeg_enc_mcu_row(&enc, NULL, 0);
+        }
+
+        // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+        uint8_t* data = band_storage[ev.buf];
+        bitrev_bytes(data, line_bytes * JPEG_MCU_HEIGHT);
+        jpeg_enc_mcu_row(&enc, data, line_bytes);
+        spsc_push(&free_q, &ev.buf);
+
+        frame_encode_us += time_us_32() - t0;
+
+        if (ev.line + JPEG_MCU_HEIGHT == frame_height) {
+            jpeg_stream_close_frame();
+        }
+    }
+
+    // the last band of the open frame was dropped - close it once 
+    // the frame after next has started
+    if (frame_open && started - frame_number >= 2) {
+        jpeg_stream_close_frame();
+    }
+}
+
+void jpeg_stream_get_stats(jpeg_stream_stats_t* out)
+{
+    *out = stats;
+}
@@ -0,0 +1,63 @@
+/*
+
+    jpeg_stream.h 
+
+    JPEG streaming - frames are captured in bands of one MCU row 
+    (8 lines) into a small ring of band buffers and JPEG encoded 
+    (jpeg_enc.h) as each band lands, so only the compressed frame 
+    is kept in memory.
+
+    A QVGA frame comes out at roughly 10-20 KB instead of 153,600 
+    bytes. The whole JPEG is sent as the payload of one frame 
+    (FRAME_FMT_JPEG) once its last row is encoded - the send runs 
+    in the background while the next frame is encoded.
+
+    At most one frame is captured ahead of the encoder - a frame that 
+    starts while the encoder is still on the one before the previous 
+    frame is skipped. Bands that arrive with no free buffer are 
+    encoded as grey.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ov7670_stream.h"
+#include "transport.h"
+#include "jpeg_enc.h"
+
+#ifndef JPEG_BAND_BUFS
+#define JPEG_BAND_BUFS 4
+#endif
+
+// longest band - QVGA YUV422, one MCU row
+#define JPEG_BAND_MAX_BYTES (320 * 2 * JPEG_MCU_HEIGHT)
+
+// largest JPEG sent - bigger frames are dropped
+#ifndef JPEG_OUT_MAX
+#define JPEG_OUT_MAX (32 * 1024)
+#endif
+
+// XCLK/8 - slows the band rate down to what the encoder keeps up with
+#define JPEG_STREAM_CLKRC 0x07
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_skipped;      // encoder a frame behind, or no buffer for the first band
+    uint32_t frames_too_big;      // over JPEG_OUT_MAX - not sent
+    uint32_t bands_dropped;       // no free band buffer - encoded as grey
+    uint32_t last_bytes;          // JPEG size of the last frame sent
+    uint32_t encode_us;           // encode time of the last frame
+    uint32_t mcus_per_sec;        // encoder throughput over the last frame
+} jpeg_stream_stats_t;
+
+// desc is the window passed to ov7670_stream_start() - YUV422, at most QVGA
+bool jpeg_stream_init(transport_t* t, const ov7670_capture_desc_t* desc, int quality);
+
+// Stream callbacks to pass to ov7670_stream_start() with JPEG_MCU_HEIGHT lines per band
+extern const ov7670_stream_cb_t jpeg_stream_cb;
+
+// Encode and send whatever bands are ready - call from the main loop
+void jpeg_stream_poll();
+
+void jpeg_stream_get_stats(jpeg_stream_stats_t* stats);
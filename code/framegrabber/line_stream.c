@@ -0,0 +1,211 @@
+/*
+    Line-at-a-time streaming - see line_stream.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "line_stream.h"
+#include "frame_ring.h"
+#include "frame_proto.h"
+#include "spsc_queue.h"
+#include "bitrev.h"
+
+static uint8_t line_storage[LINE_RING_LINES][LINE_MAX_BYTES] __attribute__((aligned(4)));
+
+typedef struct {
+    uint8_t buf;            // index into line_storage
+    uint16_t line;
+    uint32_t frame;         // producer frame count
+    uint32_t captured_us;
+} line_event_t;
+
+static line_event_t ready_storage[LINE_RING_LINES + 1];
+static uint8_t free_storage[LINE_RING_LINES + 1];
+static spsc_queue_t ready_q;    // IRQ -> main loop
+static spsc_queue_t free_q;     // main loop -> IRQ
+
+static uint line_width;
+static uint line_height;
+static uint line_bytes;
+static uint8_t line_format;
+
+// producer side - frame each line buffer was armed for
+static uint32_t capture_frame_count;
+static uint32_t line_frame[LINE_RING_LINES];
+
+// consumer side state for the frame being sent
+static transport_t* transport;
+static bool frame_open;
+static uint32_t frame_number;
+static uint next_line;
+static uint32_t frame_crc;
+static uint32_t frame_start_us;
+static int in_flight = -1;       // line buffer the transport is sending
+
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+static uint8_t trailer[4];
+static const uint8_t zero_line[LINE_MAX_BYTES];
+
+static line_stream_stats_t stats;
+
+// DMA IRQ - next free line buffer, NULL drops the line
+static uint8_t* line_dest(uint line, void* ctx)
+{
+    if (line == 0) {
+        capture_frame_count++;
+    }
+
+    uint8_t idx;
+    if (!spsc_pop(&free_q, &idx)) {
+        return NULL;
+    }
+    // armed two lines ahead, so the frame is known now, not when it lands
+    line_frame[idx] = capture_frame_count;
+    return line_storage[idx];
+}
+
+// DMA IRQ - line has landed, queue it for sending
+static void line_done(uint8_t* dest, uint line, uint nlines, void* ctx)
+{
+    uint8_t idx = (dest - line_storage[0]) / LINE_MAX_BYTES;
+    line_event_t ev = {
+        .buf = idx,
+        .line = line,
+        .frame = line_frame[idx],
+        .captured_us = time_us_32(),
+    };
+    spsc_push(&ready_q, &ev);
+
+    uint level = spsc_level(&ready_q);
+    if (level > stats.ring_high_water) {
+        stats.ring_high_water = level;
+    }
+}
+
+const ov7670_stream_cb_t line_stream_cb = {
+    .band_dest = line_dest,
+    .band_done = line_done,
+    .ctx = NULL,
+};
+
+void line_stream_init(transport_t* t, const ov7670_capture_desc_t* desc)
+{
+    transport = t;
+    line_width = desc->width;
+    line_height = desc->height;
+    line_bytes = ov7670_capture_line_bytes(desc);
+    // one byte per pixel without luma_only is raw Bayer
+    line_format = desc->luma_only ? FRAME_FMT_Y8 :
+                  desc->bytes_per_pixel == 1 ? FRAME_FMT_BAYER : FRAME_FMT_YUV422;
+
+    spsc_init(&ready_q, ready_storage, sizeof(line_event_t), LINE_RING_LINES);
+    spsc_init(&free_q, free_storage, 1, LINE_RING_LINES);
+    for (uint8_t i = 0; i < LINE_RING_LINES; i++) {
+        spsc_push(&free_q, &i);
+    }
+
+    capture_frame_count = 0;
+    frame_open = false;
+    in_flight = -1;
+    stats = (line_stream_stats_t){0};
+    stats.ring_bytes = sizeof(line_storage);
+}
+
+// Wait for the transport and give back the line buffer it was sending
+static void line_stream_wait_tx()
+{
+    while (transport_is_busy(transport));
+    if (in_flight >= 0) {
+        uint8_t idx = in_flight;
+        in_flight = -1;
+        spsc_push(&free_q, &idx);
+    }
+}
+
+static void line_stream_send_blocking(const uint8_t* data, size_t len)
+{
+    line_stream_wait_tx();
+    transport_send(transport, data, len);
+}
+
+// Send zero lines up to (not including) line
+static void line_stream_pad_to(uint line)
+{
+    while (next_line < line) {
+        frame_crc = crc32_update(frame_crc, zero_line, line_bytes);
+        line_stream_send_blocking(zero_line, line_bytes);
+        stats.lines_dropped++;
+        next_line++;
+    }
+}
+
+static void line_stream_close_frame()
+{
+    line_stream_pad_to(line_height);
+
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (frame_crc >> (8 * i)) & 0xFF;
+    }
+    line_stream_send_blocking(trailer, sizeof(trailer));
+
+    uint32_t elapsed = time_us_32() - frame_start_us;
+    if (elapsed) {
+        stats.lines_per_sec = (uint64_t)line_height * 1000000 / elapsed;
+    }
+    stats.frames_sent++;
+    frame_open = false;
+}
+
+static void line_stream_open_frame(const line_event_t* ev)
+{
+    frame_desc_t desc = {
+        .seq = ev->frame,
+        .timestamp_us = ev->captured_us,
+        .size = line_bytes * line_height,
+        .format = line_format,
+    };
+    frame_proto_encode_header(header, &desc, line_width, line_height, FRAME_FLAG_CRC_TRAILER);
+    line_stream_send_blocking(header, sizeof(header));
+
+    frame_open = true;
+    frame_number = ev->frame;
+    frame_start_us = ev->captured_us;
+    frame_crc = 0;
+    next_line = 0;
+}
+
+void line_stream_poll()
+{
+    line_event_t ev;
+    while (spsc_pop(&ready_q, &ev)) {
+        if (frame_open && ev.frame != frame_number) {
+            line_stream_close_frame();
+        }
+        if (!frame_open) {
+            line_stream_open_frame(&ev);
+        }
+
+        // lines we had no buffer for
+        line_stream_pad_to(ev.line);
+
+        // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+        uint8_t* data = line_storage[ev.buf];
+        bitrev_bytes(data, line_bytes);
+        frame_crc = crc32_update(frame_crc, data, line_bytes);
+
+        line_stream_wait_tx();
+        in_flight = ev.buf;
+        transport_send_async(transport, data, line_bytes);
+        stats.lines_sent++;
+        next_line = ev.line + 1;
+
+        if (next_line == line_height) {
+            line_stream_close_frame();
+        }
+    }
+}
+
+void line_stream_get_stats(line_stream_stats_t* out)
+{
+    *out = stats;
+}
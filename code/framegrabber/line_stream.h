@@ -0,0 +1,56 @@
+/*
+
+    line_stream.h 
+
+    Line-at-a-time streaming - captures into a small ring of line 
+    buffers and sends each line as soon as it lands, so no frame 
+    buffer is needed. This is what makes VGA (614,400 bytes of 
+    YUV422) possible on the RP2350.
+
+    The link has to keep up with the sensor line rate - run the 
+    sensor with a CLKRC prescaler that brings the line rate under 
+    the link rate (LINE_STREAM_VGA_CLKRC). Lines that arrive with 
+    no free buffer are dropped and sent as zeros so the frame 
+    still has the advertised length.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ov7670_stream.h"
+#include "transport.h"
+
+#ifndef LINE_RING_LINES
+#define LINE_RING_LINES 8
+#endif
+
+// longest line - VGA YUV422
+#define LINE_MAX_BYTES (640 * 2)
+
+// XCLK/64 - VGA lines at ~190 KB/s, under 3 Mbaud
+#define LINE_STREAM_VGA_CLKRC 0x3F
+
+// XCLK/64 too - Bayer is 1 PCLK per pixel, so half the line time for 
+// half the bytes: twice the line rate at the same ~190 KB/s
+#define LINE_STREAM_VGA_BAYER_CLKRC 0x3F
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t lines_sent;
+    uint32_t lines_dropped;       // no free line buffer - sent as zeros
+    uint32_t ring_high_water;     // most lines waiting to be sent at once
+    uint32_t ring_bytes;          // memory used for line buffers
+    uint32_t lines_per_sec;       // sustained, over the last frame
+} line_stream_stats_t;
+
+// desc is the window passed to ov7670_stream_start() - lines must fit LINE_MAX_BYTES
+void line_stream_init(transport_t* t, const ov7670_capture_desc_t* desc);
+
+// Stream callbacks to pass to ov7670_stream_start() with 1 line per band
+extern const ov7670_stream_cb_t line_stream_cb;
+
+// Send whatever lines are ready - call from the main loop
+void line_stream_poll();
+
+void line_stream_get_stats(line_stream_stats_t* stats);
@@ -0,0 +1,95 @@
+/*
+    Bit-banged grab - see ov7670_bitbang.h.
+*/
+
+#include "pico/stdlib.h"
+#include "hardware/structs/sio.h"
+
+#include "ov7670_bitbang.h"
+#include "ov7670_grab.h"
+
+// OV7670 camera pins (Pico 2W)
+#define PCLK_PIN   4  // Pixel clock (INPUT)
+#define VSYNC_PIN  2  // Frame sync (INPUT)
+#define HREF_PIN   3  // Row sync (INPUT)
+#define DATA_BASE  6  // GP6-GP13 (8-bit parallel data INPUT)
+
+// Data pins (D0-D7 mapped to GP6-GP13)
+#define DATA_PIN_BASE 6  // First data pin (D0 -> GP6)
+#define DATA_MASK (0xFF << DATA_PIN_BASE)  // Mask for GPIO6-GPIO13
+
+// HREF is every other line of 510, so first bytes are two lines
+// apart - three or more means lines went missing
+#define LINE_GAP_DIV 170
+
+bool ov7670_bitbang_grab(uint8_t* buffer, uint32_t frame_period_us)
+{
+    // Initialize control pins as INPUT
+    gpio_init(PCLK_PIN);
+    gpio_set_dir(PCLK_PIN, GPIO_IN);
+    gpio_init(VSYNC_PIN);
+    gpio_set_dir(VSYNC_PIN, GPIO_IN);
+    gpio_init(HREF_PIN);
+    gpio_set_dir(HREF_PIN, GPIO_IN);
+
+    // Initialize data pins as INPUT
+    for (int pin = DATA_BASE; pin < DATA_BASE + 8; pin++) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+    }
+
+    uint16_t y, x;
+    uint8_t *bufPtr = buffer;
+    uint32_t line_us = 0;
+
+    absolute_time_t deadline = make_timeout_time_us(frame_period_us / 100 * OV7670_GRAB_START_PCT);
+
+    // Wait for VSYNC to go HIGH then LOW (Frame start)
+    while (!(gpio_get(VSYNC_PIN))) {    // Wait for HIGH
+        if (time_reached(deadline)) return false;
+    }
+    while (gpio_get(VSYNC_PIN)) {       // Wait for LOW (Frame start)
+        if (time_reached(deadline)) return false;
+    }
+    deadline = make_timeout_time_us(frame_period_us / 100 * OV7670_GRAB_FRAME_PCT);
+
+    y = OV7670_BITBANG_LINES;
+    while (y--) {
+        // once a line - a stalled HREF still lets PCLK run
+        if (time_reached(deadline)) return false;
+
+        x = OV7670_BITBANG_LINE_BYTES;
+        while (x--) {
+            uint spins = OV7670_BITBANG_PCLK_SPINS;
+
+            // Wait for PCLK to go LOW
+            while (gpio_get(PCLK_PIN)) {
+                if (!--spins) return false;
+            }
+
+            // Read 8-bit parallel data in one operation
+            //uint32_t gpio_value = gpio_get_all();
+            //uint8_t byteData = (gpio_value & DATA_MASK) >> DATA_PIN_BASE;
+
+            // Read 8-bit parallel data in one operation using direct register access
+            uint8_t byteData = (sio_hw->gpio_in & DATA_MASK) >> DATA_PIN_BASE;
+
+
+            // Store the byte in the buffer
+            *bufPtr++ = byteData;
+
+            // a line's first byte - time it against the last line's
+            if (x == OV7670_BITBANG_LINE_BYTES - 1) {
+                uint32_t now = time_us_32();
+                if (y < OV7670_BITBANG_LINES - 1 && now - line_us > frame_period_us / LINE_GAP_DIV) return false;
+                line_us = now;
+            }
+
+            // Wait for PCLK to go HIGH
+            while (!gpio_get(PCLK_PIN)) {
+                if (!--spins) return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+/*
+
+    ov7670_bitbang.h
+
+    Bit-banged QVGA grab from the OV7670, polling PCLK, VSYNC and the
+    data pins from the CPU - the capture from before the PIO one, which
+    capture_frame() can call in place of ov7670_grab_frame(). It takes
+    OV7670_BITBANG_LINES lines of OV7670_BITBANG_LINE_BYTES bytes, one
+    byte on each PCLK falling edge. PCLK only toggles during HREF
+    (COM10_PCLK_HREF) and idles high, so HREF itself isn't read.
+
+    It has the deadlines of ov7670_grab_frame() (ov7670_grab.h), from
+    the frame period it is given:
+
+    start   VSYNC must fall within OV7670_GRAB_START_PCT % of a period
+    frame   checked once a line - the last line must start within
+            OV7670_GRAB_FRAME_PCT % of a period after that VSYNC
+    PCLK    each byte's edges give up after OV7670_BITBANG_PCLK_SPINS
+            polls, more than the blank before the first line
+    short   a line's first byte more than three line times after the
+            last line's means lines went missing - the rest would
+            come from the next frame
+
+    A failed grab leaves a partial frame in the buffer and returns
+    false. The next grab waits for a fresh VSYNC.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define OV7670_BITBANG_LINES        240
+#define OV7670_BITBANG_LINE_BYTES   640
+#define OV7670_BITBANG_PCLK_SPINS   100000
+
+// Grab a QVGA frame, 2 bytes a pixel, into buffer - false if the
+// sensor stalled or lost lines, see above
+bool ov7670_bitbang_grab(uint8_t* buffer, uint32_t frame_period_us);
@@ -0,0 +1,54 @@
+/*
+
+    ov7670_grab.h
+
+    One-shot capture from the OV7670 with a watchdog.
+
+    ov7670_grab_frame() resets the one-shot SM and DMA, waits for the
+    next VSYNC and captures one frame. None of its waits can hang on a
+    sensor that stops: each has a deadline from the frame period, the
+    nominal one for the current mode until ov7670_wait_ready() has
+    measured it.
+
+    start   VSYNC must fall within OV7670_GRAB_START_PCT % of a period
+            after the grab starts - up to a whole period until the
+            next VSYNC, plus the VSYNC pulse itself
+    frame   the last word must land within OV7670_GRAB_FRAME_PCT % of
+            a period after that VSYNC - the active lines are 480 of
+            510, so a stalled PCLK or HREF is caught here
+    short   a VSYNC rising edge while words are still due means lines
+            went missing - the SM would finish the frame with lines
+            of the next one
+
+    A failed grab leaves a partial frame in the buffer and returns
+    false. The SM is stopped, its FIFOs dropped and its PC put back at
+    the start of the program, and the DMA aborted, so the next grab
+    starts clean.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// deadlines, in percent of the frame period
+#define OV7670_GRAB_START_PCT   150
+#define OV7670_GRAB_FRAME_PCT   125
+
+typedef struct {
+    uint32_t grabs;
+    uint32_t timeouts;          // start or frame deadline passed
+    uint32_t short_frames;      // VSYNC before the last word
+    uint32_t recoveries;        // good grabs right after a failed one
+    uint32_t frame_period_us;   // the deadlines are based on
+} ov7670_grab_stats_t;
+
+// Grab a frame of the current size and format into buffer - false if
+// the sensor stalled or lost lines, see above
+bool ov7670_grab_frame(uint8_t* buffer);
+
+// Frame period of the current mode - nominal from CLKRC until
+// ov7670_wait_ready() has measured it
+uint32_t ov7670_get_frame_period_us();
+
+void ov7670_get_grab_stats(ov7670_grab_stats_t* stats);
@@ -411,7 +411,15 @@ static struct regval_list ov7670_qcif_regs[] = {
 	{ 0xff, 0xff },
 };
 
-#if 0
+#define	VGA_WIDTH	640
+#define	VGA_HEIGHT	480
+#define	QVGA_WIDTH	320
+#define	QVGA_HEIGHT	240
+#define	CIF_WIDTH	352
+#define	CIF_HEIGHT	288
+#define	QCIF_WIDTH	176
+#define	QCIF_HEIGHT	144
+
 static struct ov7670_win_size ov7670_win_sizes[] = {
 	/* VGA */
 	{
@@ -459,6 +467,7 @@ static struct ov7670_win_size ov7670_win_sizes[] = {
 	}
 };
 
+#if 0
 static struct ov7670_win_size ov7675_win_sizes[] = {
 	/*
 	 * Currently, only VGA is supported. Theoretically it could be possible
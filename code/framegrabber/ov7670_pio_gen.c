@@ -0,0 +1,99 @@
+/*
+    Builds the PIO capture program from a descriptor - see ov7670_pio_gen.h.
+*/
+
+#include "hardware/pio.h"
+#include "hardware/pio_instructions.h"
+
+#include "ov7670_pio_gen.h"
+
+static inline void emit(ov7670_pio_gen_t* prog, uint instr)
+{
+    prog->instr[prog->length++] = instr;
+}
+
+// Count count edges (high then low) of gpio. Up to 32 this is x alone, 
+// above that y counts rounds of 32 and the first round does the rest.
+// Uses y, so it must be free.
+static void emit_skip(ov7670_pio_gen_t* prog, uint gpio, uint count)
+{
+    bool nested = count > 32;
+    if (nested) {
+        emit(prog, pio_encode_set(pio_y, (count - 1) / 32));
+    }
+    emit(prog, pio_encode_set(pio_x, (count - 1) % 32));
+    uint loop = prog->length;
+    emit(prog, pio_encode_wait_gpio(true, gpio));
+    emit(prog, pio_encode_wait_gpio(false, gpio));
+    emit(prog, pio_encode_jmp_x_dec(loop));
+    if (nested) {
+        emit(prog, pio_encode_set(pio_x, 31));
+        emit(prog, pio_encode_jmp_y_dec(loop));
+    }
+}
+
+bool ov7670_pio_gen(const ov7670_capture_desc_t* desc, ov7670_pio_gen_t* prog)
+{
+    uint skip_bytes = desc->skip_pixels * desc->bytes_per_pixel;
+    if (desc->skip_lines > OV7670_PIO_GEN_MAX_SKIP || skip_bytes > OV7670_PIO_GEN_MAX_SKIP) {
+        return false;
+    }
+
+    // a long left skip parks the line count in the ISR, which is only 
+    // empty at the start of every line if lines are whole words
+    bool park_y = skip_bytes > 32;
+    if (park_y && ov7670_capture_line_bytes(desc) % 4) {
+        return false;
+    }
+
+    prog->length = 0;
+
+    // line count, then wait for the frame
+    emit(prog, pio_encode_pull(false, true));
+    emit(prog, pio_encode_wait_gpio(true, desc->vsync_pin));
+    emit(prog, pio_encode_wait_gpio(false, desc->vsync_pin));
+
+    // top border - y is still free
+    if (desc->skip_lines) {
+        emit_skip(prog, desc->href_pin, desc->skip_lines);
+    }
+
+    emit(prog, pio_encode_mov(pio_y, pio_osr));
+    emit(prog, pio_encode_pull(false, true));
+
+    uint line = prog->length;
+    emit(prog, pio_encode_wait_gpio(true, desc->href_pin));
+
+    // left border
+    if (skip_bytes) {
+        if (park_y) {
+            emit(prog, pio_encode_mov(pio_isr, pio_y));
+        }
+        emit_skip(prog, desc->pclk_pin, skip_bytes);
+        if (park_y) {
+            emit(prog, pio_encode_mov(pio_y, pio_isr));
+        }
+    }
+
+    // active bytes (or pixels if luma_only) - anything after them 
+    // until HREF drops is ignored
+    emit(prog, pio_encode_mov(pio_x, pio_osr));
+    uint pixel = prog->length;
+    emit(prog, pio_encode_wait_gpio(true, desc->pclk_pin));
+    emit(prog, pio_encode_in(pio_pins, 8));
+    emit(prog, pio_encode_wait_gpio(false, desc->pclk_pin));
+    if (desc->luma_only) {
+        // chroma byte - let it go by
+        emit(prog, pio_encode_wait_gpio(true, desc->pclk_pin));
+        emit(prog, pio_encode_wait_gpio(false, desc->pclk_pin));
+    }
+    emit(prog, pio_encode_jmp_x_dec(pixel));
+
+    emit(prog, pio_encode_wait_gpio(false, desc->href_pin));
+    emit(prog, pio_encode_jmp_y_dec(line));
+
+    // falls through to the next frame
+    prog->wrap_target = 0;
+    prog->wrap = prog->length - 1;
+    return true;
+}
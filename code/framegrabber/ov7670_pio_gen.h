@@ -0,0 +1,106 @@
+/*
+
+    ov7670_pio_gen.h 
+
+    Builds the PIO capture program at init time from a descriptor, 
+    instead of a fixed .pio file. Pins, border lines/pixels to skip 
+    and bytes per pixel are baked into the program, so crop windows 
+    and non-QVGA modes are captured exactly and blanking or border 
+    bytes never reach the RX FIFO.
+
+    Per frame the CPU pushes (height - 1) and (bytes per line - 1) 
+    into the TX FIFO, same as ov7670_stream.pio did.
+
+    With luma_only set, the pixel loop samples the first PCLK of each 
+    pixel and skips the second, so a YUYV stream is captured as Y 
+    only - half the FIFO, DMA, buffer and link traffic.
+
+    Skips of up to 32 lines or bytes are a single loop on x. Longer 
+    ones, up to OV7670_PIO_GEN_MAX_SKIP (enough to centre QVGA in 
+    VGA), also count rounds of 32 in y - for the left border the line 
+    count is parked in the ISR meanwhile, so bytes per line must be a 
+    multiple of 4.
+
+    Generated program (skip loops only if non-zero, the y rounds and 
+    parking only if the skip is over 32):
+
+        pull block              ; height - 1
+        wait 1 gpio vsync
+        wait 0 gpio vsync
+        set y, (skip_lines - 1) / 32
+        set x, (skip_lines - 1) % 32
+    skip_y:
+        wait 1 gpio href
+        wait 0 gpio href
+        jmp x-- skip_y
+        set x, 31
+        jmp y-- skip_y
+        mov y, osr
+        pull block              ; bytes per line - 1
+    line:
+        wait 1 gpio href
+        mov isr, y
+        set y, (skip_bytes - 1) / 32
+        set x, (skip_bytes - 1) % 32
+    skip_x:
+        wait 1 gpio pclk
+        wait 0 gpio pclk
+        jmp x-- skip_x
+        set x, 31
+        jmp y-- skip_x
+        mov y, isr
+        mov x, osr
+    pixel:
+        wait 1 gpio pclk
+        in pins, 8
+        wait 0 gpio pclk
+        wait 1 gpio pclk        ; luma_only - skip U/V
+        wait 0 gpio pclk        ; luma_only
+        jmp x-- pixel
+        wait 0 gpio href
+        jmp y-- line
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// longest possible program
+#define OV7670_PIO_GEN_MAX_INSTR 31
+
+// set can only load 0..31, so 32 rounds of 32
+#define OV7670_PIO_GEN_MAX_SKIP 1024
+
+typedef struct {
+    uint vsync_pin;
+    uint href_pin;
+    uint pclk_pin;
+    uint data_base;         // D0..D7 on data_base..data_base+7
+    uint skip_lines;        // lines to skip after VSYNC
+    uint skip_pixels;       // pixels to skip after HREF
+    uint bytes_per_pixel;   // PCLKs per pixel
+    bool luma_only;         // YUYV - keep only Y, the first byte of each pixel
+    uint width;             // active pixels per line
+    uint height;            // active lines
+} ov7670_capture_desc_t;
+
+typedef struct {
+    uint16_t instr[OV7670_PIO_GEN_MAX_INSTR];
+    uint length;
+    uint wrap_target;
+    uint wrap;
+} ov7670_pio_gen_t;
+
+// Bytes per captured line - what reaches the RX FIFO
+static inline uint ov7670_capture_line_bytes(const ov7670_capture_desc_t* desc)
+{
+    return desc->width * (desc->luma_only ? 1 : desc->bytes_per_pixel);
+}
+
+// Generate the capture program for desc. Jumps are relative to 0 - 
+// pio_add_program() relocates them. Returns false if desc can't be 
+// done (skips too long, or a long left skip on lines that aren't 
+// whole words).
+bool ov7670_pio_gen(const ov7670_capture_desc_t* desc, ov7670_pio_gen_t* prog);
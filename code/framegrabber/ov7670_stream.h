@@ -0,0 +1,48 @@
+/*
+
+    ov7670_stream.h 
+
+    Continuous (streaming) capture from the OV7670.
+
+    The PIO SM stays enabled and two DMA channels chained to each 
+    other fill alternating bands of lines. A DMA IRQ fires for each 
+    completed band - with band_lines equal to the frame height a band 
+    is a whole frame. The PIO program is generated from an 
+    ov7670_capture_desc_t, so the captured window can be cropped.
+    If its program doesn't fit next to the one-shot program, that is 
+    unloaded until ov7670_stream_stop() - no ov7670_grab_frame() in 
+    between.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#include "ov7670_pio_gen.h"
+
+// Callbacks - both run from the DMA IRQ
+typedef struct {
+    // Destination for the band that starts at line. Called two bands 
+    // ahead of capture. Return NULL to drop the band.
+    uint8_t* (*band_dest)(uint line, void* ctx);
+    // Band of nlines lines starting at line has landed in dest
+    void (*band_done)(uint8_t* dest, uint line, uint nlines, void* ctx);
+    void* ctx;
+} ov7670_stream_cb_t;
+
+typedef struct {
+    uint32_t frames;            // frames completed
+    uint32_t dropped;           // frames missed between completions
+    uint32_t bands;             // bands completed
+    uint32_t bands_discarded;   // bands with no destination
+    uint32_t frame_period_us;   // smoothed frame period
+} ov7670_stream_stats_t;
+
+void ov7670_capture_desc_default(ov7670_capture_desc_t* desc);
+// Returns false if already streaming, desc can't be captured in bands
+// of band_lines, or its program doesn't fit in the free PIO memory
+bool ov7670_stream_start(const ov7670_capture_desc_t* desc, uint band_lines,
+                         const ov7670_stream_cb_t* cb);
+void ov7670_stream_stop();
+void ov7670_stream_get_stats(ov7670_stream_stats_t* stats);
@@ -0,0 +1,259 @@
+/*
+    Row-pipelined streaming - see pipeline.h.
+*/
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "pipeline.h"
+#include "frame_ring.h"
+#include "frame_proto.h"
+#include "spsc_queue.h"
+#include "bitrev.h"
+#include "qoi16.h"
+
+// most bands a frame slot can hold
+#define BANDS_PER_FRAME (IMAGE_HEIGHT / PIPELINE_BAND_LINES)
+
+typedef struct {
+    frame_desc_t* frame;
+    uint16_t line;
+    uint16_t nlines;
+    uint32_t captured_us;
+} band_event_t;
+
+// every band of every slot can be in flight at once
+#define BAND_QUEUE_LEN (BANDS_PER_FRAME * FRAME_RING_SLOTS)
+static band_event_t band_storage[BAND_QUEUE_LEN + 1];
+static spsc_queue_t band_q;
+
+// compressed bands - one being coded while the other is sent
+#define CHUNK_MAX_BYTES (2 + QOI16_MAX_SIZE(IMAGE_WIDTH * PIPELINE_BAND_LINES))
+static uint8_t chunk_storage[2][CHUNK_MAX_BYTES];
+static int chunk_cur;
+static bool compress;
+static qoi16_enc_t qoi;
+
+// producer side - slot the current frame is being captured into
+static frame_desc_t* capture_frame;
+
+static uint frame_width;
+static uint frame_height;
+static uint line_bytes;
+
+static transport_t* transport;
+static volatile uint32_t tx_done_us;
+
+// consumer side state for the frame being sent
+static uint32_t frame_crc;
+static uint32_t frame_first_captured_us;
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+static uint8_t trailer[6];     // end chunk (chunked frames) + CRC
+static uint32_t frame_wire_bytes;
+static bool band_in_flight;
+static uint32_t band_tx_start_us;
+
+static pipeline_stats_t stats;
+
+// DMA IRQ - band destination, called two bands ahead of capture
+static uint8_t* pipeline_band_dest(uint line, void* ctx)
+{
+    if (line == 0) {
+        // new frame - consumer gets the slot as soon as its first band lands
+        capture_frame = frame_ring_acquire();
+        if (!capture_frame) {
+            frame_ring_overrun();
+            return NULL;
+        }
+        frame_ring_stamp(capture_frame);
+    }
+
+    if (!capture_frame) {
+        return NULL;
+    }
+    return capture_frame->data + line * line_bytes;
+}
+
+// DMA IRQ - band is in memory, queue it for sending
+static void pipeline_band_done(uint8_t* dest, uint line, uint nlines, void* ctx)
+{
+    band_event_t ev = {
+        .frame = frame_ring_lookup(dest - line * line_bytes),
+        .line = line,
+        .nlines = nlines,
+        .captured_us = time_us_32(),
+    };
+    spsc_push(&band_q, &ev);
+}
+
+const ov7670_stream_cb_t pipeline_stream_cb = {
+    .band_dest = pipeline_band_dest,
+    .band_done = pipeline_band_done,
+    .ctx = NULL,
+};
+
+// DMA IRQ - transport finished a transfer
+static void pipeline_tx_done(void* user_data)
+{
+    tx_done_us = time_us_32();
+}
+
+static inline void update_max(uint32_t* max, uint32_t v)
+{
+    if (v > *max) {
+        *max = v;
+    }
+}
+
+void pipeline_init(transport_t* t, const ov7670_capture_desc_t* desc, bool compress_bands)
+{
+    compress = compress_bands;
+    chunk_cur = 0;
+
+    frame_width = desc->width;
+    frame_height = desc->height;
+    line_bytes = ov7670_capture_line_bytes(desc);
+
+    spsc_init(&band_q, band_storage, sizeof(band_event_t), BAND_QUEUE_LEN);
+    capture_frame = NULL;
+    stats = (pipeline_stats_t){0};
+
+    transport = t;
+    transport->done_cb = pipeline_tx_done;
+    transport->user_data = NULL;
+}
+
+// Wait for the band being sent and record how long it took
+static void pipeline_wait_band_tx()
+{
+    while (transport_is_busy(transport));
+    if (band_in_flight) {
+        band_in_flight = false;
+        stats.band_tx_us = tx_done_us - band_tx_start_us;
+        update_max(&stats.band_tx_max_us, stats.band_tx_us);
+    }
+}
+
+// Code one band as a chunk - stored if it doesn't get smaller. The 
+// encoder flushes its run at every band so no op spans two chunks, 
+// but the previous pixel and the cache carry over - a chunk only 
+// decodes after the ones before it, from the last stored chunk.
+static const uint8_t* pipeline_compress_band(const uint8_t* band, size_t len)
+{
+    uint8_t* chunk = chunk_storage[chunk_cur];
+    chunk_cur ^= 1;
+
+    size_t n = qoi16_encode(&qoi, band, len / 2, chunk + 2);
+    n += qoi16_finish(&qoi, chunk + 2 + n);
+
+    uint16_t chunk_len = n;
+    if (n >= len) {
+        // the host resets its decoder after a stored chunk
+        memcpy(chunk + 2, band, len);
+        chunk_len = len | FRAME_CHUNK_STORED;
+        qoi16_enc_init(&qoi);
+        stats.bands_stored++;
+    }
+    chunk[0] = chunk_len & 0xFF;
+    chunk[1] = chunk_len >> 8;
+    return chunk;
+}
+
+// Fix up and send one band, with the header before the first and 
+// the CRC after the last
+static void pipeline_send_band(const band_event_t* ev)
+{
+    frame_desc_t* frame = ev->frame;
+    uint8_t* band = frame->data + ev->line * line_bytes;
+    size_t len = ev->nlines * line_bytes;
+
+    uint32_t t_start = time_us_32();
+    uint32_t wait = t_start - ev->captured_us;
+    stats.band_wait_us = wait;
+    update_max(&stats.band_wait_max_us, wait);
+
+    // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+    bitrev_bytes(band, len);
+    if (ev->line == 0) {
+        frame_crc = 0;
+        frame_wire_bytes = 0;
+        frame_first_captured_us = ev->captured_us;
+        qoi16_enc_init(&qoi);
+    }
+
+    const uint8_t* tx = band;
+    size_t tx_len = len;
+    if (compress) {
+        tx = pipeline_compress_band(band, len);
+        tx_len = 2 + ((tx[0] | (tx[1] << 8)) & ~FRAME_CHUNK_STORED);
+    }
+    frame_crc = crc32_update(frame_crc, tx, tx_len);
+    frame_wire_bytes += tx_len;
+
+    uint32_t t_fixed = time_us_32();
+    stats.band_fixup_us = t_fixed - t_start;
+    update_max(&stats.band_fixup_max_us, stats.band_fixup_us);
+
+    // previous band is still going out while we fixed this one
+    pipeline_wait_band_tx();
+
+    if (ev->line == 0) {
+        uint8_t flags = FRAME_FLAG_CRC_TRAILER;
+        if (compress) {
+            flags |= FRAME_FLAG_CHUNKED | FRAME_FLAG_QOI16;
+        }
+        frame_proto_encode_header(header, frame, frame_width, frame_height, flags);
+        transport_send(transport, header, sizeof(header));
+        stats.first_byte_us = time_us_32() - frame_first_captured_us;
+    }
+
+    band_tx_start_us = time_us_32();
+    band_in_flight = true;
+    transport_send_async(transport, tx, tx_len);
+    stats.bands_sent++;
+
+    if (ev->line + ev->nlines == frame_height) {
+        pipeline_wait_band_tx();
+
+        // chunked frames end with an empty chunk, covered by the CRC
+        uint8_t* crc = trailer;
+        if (compress) {
+            trailer[0] = trailer[1] = 0;
+            frame_crc = crc32_update(frame_crc, trailer, 2);
+            frame_wire_bytes += 2;
+            crc += 2;
+        }
+        for (int i = 0; i < 4; i++) {
+            crc[i] = (frame_crc >> (8 * i)) & 0xFF;
+        }
+        transport_send(transport, trailer, crc + 4 - trailer);
+
+        stats.raw_bytes = frame->size;
+        stats.wire_bytes = frame_wire_bytes;
+
+        stats.frame_latency_us = time_us_32() - ev->captured_us;
+        update_max(&stats.frame_latency_max_us, stats.frame_latency_us);
+        stats.frames_sent++;
+
+        frame_ring_release(frame);
+    }
+}
+
+void pipeline_poll()
+{
+    // only the bands queued on entry - a sensor faster than the link 
+    // queues bands while these go out, and the main loop must still run
+    unsigned n = spsc_level(&band_q);
+    band_event_t ev;
+    while (n-- && spsc_pop(&band_q, &ev)) {
+        if (ev.frame) {
+            pipeline_send_band(&ev);
+        }
+    }
+}
+
+void pipeline_get_stats(pipeline_stats_t* out)
+{
+    *out = stats;
+}
@@ -0,0 +1,59 @@
+/*
+
+    pipeline.h 
+
+    Row-pipelined streaming - bands of lines are bit-fixed and sent 
+    while later lines of the same frame are still being captured.
+
+    The frame slot is taken from the frame ring when its first band 
+    is armed and goes back to the ring once its last band is sent. 
+    Since the payload CRC is only known at the end, frames are sent 
+    with FRAME_FLAG_CRC_TRAILER and the CRC follows the payload.
+
+    With compression on, each band is qoi16 coded (qoi16.h) and sent 
+    as one chunk of a FRAME_FLAG_CHUNKED frame. A band that doesn't 
+    get smaller is sent stored instead.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ov7670_stream.h"
+#include "transport.h"
+
+// lines per band - must divide IMAGE_HEIGHT
+#ifndef PIPELINE_BAND_LINES
+#define PIPELINE_BAND_LINES 16
+#endif
+
+// Per-stage timings in us - last frame and worst seen
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t bands_sent;
+    uint32_t band_wait_us;        // band captured -> fix-up started
+    uint32_t band_wait_max_us;
+    uint32_t band_fixup_us;       // bit reversal, compression + CRC of one band
+    uint32_t band_fixup_max_us;
+    uint32_t band_tx_us;          // one band handed to the UART
+    uint32_t band_tx_max_us;
+    uint32_t first_byte_us;       // first band captured -> first band sending
+    uint32_t frame_latency_us;    // last band captured -> last byte sent
+    uint32_t frame_latency_max_us;
+    uint32_t raw_bytes;           // last frame - pixel data
+    uint32_t wire_bytes;          // last frame - payload as sent
+    uint32_t bands_stored;        // bands sent uncompressed
+} pipeline_stats_t;
+
+// desc is the window passed to ov7670_stream_start() - it must fit a frame ring slot.
+// compress codes each band with qoi16.
+void pipeline_init(transport_t* t, const ov7670_capture_desc_t* desc, bool compress);
+
+// Stream callbacks to pass to ov7670_stream_start() with PIPELINE_BAND_LINES
+extern const ov7670_stream_cb_t pipeline_stream_cb;
+
+// Send the bands that are ready - call from the main loop
+void pipeline_poll();
+
+void pipeline_get_stats(pipeline_stats_t* stats);
@@ -0,0 +1,102 @@
+/*
+    Lossless streaming codec for 16-bit pixels - see qoi16.h.
+*/
+
+#include <string.h>
+
+#include "qoi16.h"
+
+#define QOI16_OP_INDEX   0x00
+#define QOI16_OP_DIFF    0x40
+#define QOI16_OP_LUMA    0x80
+#define QOI16_OP_RUN     0xC0
+#define QOI16_OP_LITERAL 0xFE
+
+#define QOI16_MAX_RUN    62
+
+static inline uint32_t qoi16_hash(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (r * 3 + g * 5 + b * 7) & 63;
+}
+
+// sign-extend the low bits of a modulo difference
+static inline int32_t sext(uint32_t v, int bits)
+{
+    return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+void qoi16_enc_init(qoi16_enc_t* enc)
+{
+    memset(enc, 0, sizeof(*enc));
+}
+
+size_t qoi16_encode(qoi16_enc_t* enc, const uint8_t* src, size_t npixels, uint8_t* dst)
+{
+    uint8_t* out = dst;
+    uint32_t prev = enc->prev;
+    uint32_t run = enc->run;
+
+    for (size_t i = 0; i < npixels; i++) {
+        uint32_t px = src[2 * i] | (src[2 * i + 1] << 8);
+
+        if (px == prev) {
+            if (++run == QOI16_MAX_RUN) {
+                *out++ = QOI16_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            *out++ = QOI16_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        uint32_t r = px >> 11;
+        uint32_t g = (px >> 5) & 0x3F;
+        uint32_t b = px & 0x1F;
+
+        uint32_t h = qoi16_hash(r, g, b);
+        if (enc->index[h] == px) {
+            *out++ = QOI16_OP_INDEX | h;
+            prev = px;
+            continue;
+        }
+        enc->index[h] = px;
+
+        int32_t dr = sext(r - (prev >> 11), 5);
+        int32_t dg = sext(g - ((prev >> 5) & 0x3F), 6);
+        int32_t db = sext(b - (prev & 0x1F), 5);
+        prev = px;
+
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            *out++ = QOI16_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+            continue;
+        }
+
+        int32_t dr_dg = dr - dg;
+        int32_t db_dg = db - dg;
+        if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+            *out++ = QOI16_OP_LUMA | (dg + 32);
+            *out++ = ((dr_dg + 8) << 4) | (db_dg + 8);
+            continue;
+        }
+
+        *out++ = QOI16_OP_LITERAL;
+        *out++ = px & 0xFF;
+        *out++ = px >> 8;
+    }
+
+    enc->prev = prev;
+    enc->run = run;
+    return out - dst;
+}
+
+size_t qoi16_finish(qoi16_enc_t* enc, uint8_t* dst)
+{
+    if (!enc->run) {
+        return 0;
+    }
+    dst[0] = QOI16_OP_RUN | (enc->run - 1);
+    enc->run = 0;
+    return 1;
+}
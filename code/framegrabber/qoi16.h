@@ -0,0 +1,48 @@
+/*
+
+    qoi16.h 
+
+    Lossless streaming codec for 16-bit pixels (RGB565), modelled on 
+    QOI. Each pixel becomes one of:
+
+    | byte(s)            | op                                           |
+    |--------------------|----------------------------------------------|
+    | 00iiiiii           | INDEX - pixel from a 64 entry cache          |
+    | 01rrggbb           | DIFF  - dr, dg, db in -2..1 (biased by 2)    |
+    | 10gggggg drdg_dbdg | LUMA  - dg in -32..31, dr-dg/db-dg in -8..7  |
+    | 11rrrrrr           | RUN   - previous pixel 1..62 times (biased)  |
+    | 0xFE lo hi         | LITERAL - raw pixel, little-endian           |
+
+    Differences are taken per RGB565 field (5/6/5 bits), modulo the 
+    field width. The cache slot is (r * 3 + g * 5 + b * 7) % 64. The 
+    encoder starts from pixel 0 with an empty cache, and its state 
+    carries across calls, so a frame can be encoded band by band. 
+    Other 16-bit data (YUYV pairs) round-trips too, just with less 
+    gain.
+
+    The worst case is 3 bytes per pixel. No SDK dependencies - this 
+    builds on the host too. qoi16.py is the host decoder.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// worst case output for n pixels, including qoi16_finish()
+#define QOI16_MAX_SIZE(n) ((n) * 3 + 1)
+
+typedef struct {
+    uint16_t prev;
+    uint16_t index[64];
+    uint32_t run;
+} qoi16_enc_t;
+
+void qoi16_enc_init(qoi16_enc_t* enc);
+
+// Encode npixels little-endian pixels from src into dst - returns bytes 
+// written. A run can be left pending for the next call.
+size_t qoi16_encode(qoi16_enc_t* enc, const uint8_t* src, size_t npixels, uint8_t* dst);
+
+// Flush a pending run at the end of the frame - returns bytes written (0 or 1)
+size_t qoi16_finish(qoi16_enc_t* enc, uint8_t* dst);
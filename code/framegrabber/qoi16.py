@@ -0,0 +1,69 @@
+"""
+Host decoder for the qoi16 lossless 16-bit pixel codec - see qoi16.h.
+"""
+
+import struct
+
+OP_DIFF = 0x40
+OP_LUMA = 0x80
+OP_RUN = 0xC0
+OP_LITERAL = 0xFE
+
+
+class Qoi16Decoder:
+    """ Decoder state carries across chunks, like the encoder's across bands """
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.index = [0] * 64
+        self.prev = 0
+
+    def decode(self, data):
+        """ Decode a whole chunk of qoi16 ops to little-endian 16-bit pixels """
+        out = []
+        index = self.index
+        prev = self.prev
+        pos = 0
+        n = len(data)
+        while pos < n:
+            op = data[pos]
+            pos += 1
+
+            if op == OP_LITERAL:
+                px = data[pos] | (data[pos + 1] << 8)
+                pos += 2
+            elif op >= OP_RUN:
+                out.extend([prev] * ((op & 0x3F) + 1))
+                continue
+            elif op < OP_DIFF:
+                prev = index[op]
+                out.append(prev)
+                continue
+            else:
+                r, g, b = prev >> 11, (prev >> 5) & 0x3F, prev & 0x1F
+                if op < OP_LUMA:
+                    r = (r + ((op >> 4) & 3) - 2) & 0x1F
+                    g = (g + ((op >> 2) & 3) - 2) & 0x3F
+                    b = (b + (op & 3) - 2) & 0x1F
+                else:
+                    dg = (op & 0x3F) - 32
+                    x = data[pos]
+                    pos += 1
+                    r = (r + dg + (x >> 4) - 8) & 0x1F
+                    g = (g + dg) & 0x3F
+                    b = (b + dg + (x & 0x0F) - 8) & 0x1F
+                px = (r << 11) | (g << 5) | b
+
+            index[((px >> 11) * 3 + ((px >> 5) & 0x3F) * 5 + (px & 0x1F) * 7) & 63] = px
+            out.append(px)
+            prev = px
+
+        self.prev = prev
+        return struct.pack(f"<{len(out)}H", *out)
+
+
+def decode(data):
+    """ Decode a complete qoi16 stream """
+    return Qoi16Decoder().decode(data)
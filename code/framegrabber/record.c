@@ -0,0 +1,381 @@
+/*
+    Pre/post-trigger recording - see record.h.
+*/
+
+#include <string.h>
+#include <stdatomic.h>
+
+#include "pico/stdlib.h"
+
+#include "record.h"
+#include "frame_ring.h"
+#include "frame_proto.h"
+#include "spsc_queue.h"
+#include "bitrev.h"
+#include "event.h"
+
+// most history frames, whatever the storage
+#define RECORD_MAX_SLOTS 32
+
+static uint8_t band_storage[RECORD_BANDS][RECORD_BAND_MAX_BYTES] __attribute__((aligned(4)));
+
+typedef struct {
+    uint8_t buf;            // index into band_storage
+    uint16_t line;
+    uint32_t frame;         // producer frame count
+    uint32_t captured_us;
+} band_event_t;
+
+static band_event_t ready_storage[RECORD_BANDS + 1];
+static uint8_t free_storage[RECORD_BANDS + 1];
+static spsc_queue_t ready_q;    // IRQ -> main loop
+static spsc_queue_t free_q;     // main loop -> IRQ
+
+// producer side - frame each band buffer was armed for
+static uint32_t capture_frame_count;
+static uint32_t band_frame[RECORD_BANDS];
+
+// capture geometry
+static uint in_height;
+static uint in_line_bytes;
+static bool in_luma;            // Y8 from the PIO, not YUYV
+
+// history geometry
+static bool out_luma;
+static bool out_half;
+static uint out_width;
+static uint out_height;
+static uint out_line_bytes;
+
+// history ring of pre + post frames - the newest count end at head
+static frame_desc_t slots[RECORD_MAX_SLOTS];
+static uint nslots;
+static uint post_frames;
+static uint head;
+static uint count;
+
+// frame being reduced into slots[head]
+static bool assembling;
+static uint32_t cur_frame;
+static uint next_line;
+static uint32_t last_frame;     // last frame recorded - the one prev compares with
+static bool prev_valid;
+static uint32_t motion_sum;
+static uint motion_threshold;
+
+// record_trigger() -> main loop
+static atomic_bool trigger_pending;
+static volatile uint32_t trigger_us;
+
+// recording the post-trigger frames
+static bool triggered;
+static uint32_t triggered_us;
+static uint post_left;
+
+static transport_t* transport;
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+static record_stats_t stats;
+
+// DMA IRQ - next free band buffer, NULL drops the band
+static uint8_t* record_band_dest(uint line, void* ctx)
+{
+    if (line == 0) {
+        capture_frame_count++;
+    }
+
+    uint8_t idx;
+    if (!spsc_pop(&free_q, &idx)) {
+        stats.bands_dropped++;
+        return NULL;
+    }
+    // armed two bands ahead, so the frame is known now, not when it lands
+    band_frame[idx] = capture_frame_count;
+    return band_storage[idx];
+}
+
+// DMA IRQ - band has landed, queue it for the main loop
+static void record_band_done(uint8_t* dest, uint line, uint nlines, void* ctx)
+{
+    uint8_t idx = (dest - band_storage[0]) / RECORD_BAND_MAX_BYTES;
+    band_event_t ev = {
+        .buf = idx,
+        .line = line,
+        .frame = band_frame[idx],
+        .captured_us = time_us_32(),
+    };
+    spsc_push(&ready_q, &ev);
+    event_post(EVENT_FRAME);
+}
+
+const ov7670_stream_cb_t record_stream_cb = {
+    .band_dest = record_band_dest,
+    .band_done = record_band_done,
+    .ctx = NULL,
+};
+
+uint32_t record_frame_bytes(const ov7670_capture_desc_t* desc, record_history_t history)
+{
+    bool luma = desc->luma_only || history == RECORD_LUMA || history == RECORD_LUMA_HALF;
+    bool half = history == RECORD_HALF || history == RECORD_LUMA_HALF;
+    uint32_t pixels = half ? (desc->width / 2) * (desc->height / 2) : desc->width * desc->height;
+
+    return luma ? pixels : pixels * 2;
+}
+
+uint record_max_pre(uint32_t bytes, const ov7670_capture_desc_t* desc,
+                    record_history_t history, uint post)
+{
+    uint n = bytes / record_frame_bytes(desc, history);
+    if (n > RECORD_MAX_SLOTS) {
+        n = RECORD_MAX_SLOTS;
+    }
+    return n > post ? n - post : 0;
+}
+
+bool record_init(uint8_t* storage, uint32_t bytes, const ov7670_capture_desc_t* desc,
+                 record_history_t history, uint pre, uint post, uint motion, transport_t* t)
+{
+    uint line_bytes = ov7670_capture_line_bytes(desc);
+
+    // one byte per pixel without luma_only is raw Bayer
+    if (desc->bytes_per_pixel == 1 && !desc->luma_only) {
+        return false;
+    }
+    if (desc->height % RECORD_BAND_LINES || line_bytes * RECORD_BAND_LINES > RECORD_BAND_MAX_BYTES) {
+        return false;
+    }
+    if (pre + post == 0 || pre > record_max_pre(bytes, desc, history, post)) {
+        return false;
+    }
+    if (motion && pre + post < 2) {
+        return false;
+    }
+
+    in_height = desc->height;
+    in_line_bytes = line_bytes;
+    in_luma = desc->luma_only;
+
+    out_luma = in_luma || history == RECORD_LUMA || history == RECORD_LUMA_HALF;
+    out_half = history == RECORD_HALF || history == RECORD_LUMA_HALF;
+    out_width = out_half ? desc->width / 2 : desc->width;
+    out_height = out_half ? desc->height / 2 : desc->height;
+    out_line_bytes = out_luma ? out_width : out_width * 2;
+
+    uint32_t size = record_frame_bytes(desc, history);
+    nslots = pre + post;
+    for (uint i = 0; i < nslots; i++) {
+        slots[i].seq = 0;
+        slots[i].timestamp_us = 0;
+        slots[i].size = size;
+        slots[i].format = out_luma ? FRAME_FMT_Y8 : FRAME_FMT_YUV422;
+        slots[i].status = FRAME_FREE;
+        slots[i].data = storage + i * size;
+    }
+    post_frames = post;
+    head = count = 0;
+
+    assembling = false;
+    prev_valid = false;
+    motion_threshold = motion;
+    atomic_store(&trigger_pending, false);
+    triggered = false;
+    transport = t;
+
+    spsc_init(&ready_q, ready_storage, sizeof(band_event_t), RECORD_BANDS);
+    spsc_init(&free_q, free_storage, 1, RECORD_BANDS);
+    for (uint8_t i = 0; i < RECORD_BANDS; i++) {
+        spsc_push(&free_q, &i);
+    }
+    capture_frame_count = 0;
+
+    stats = (record_stats_t){0};
+    return true;
+}
+
+void record_trigger()
+{
+    trigger_us = time_us_32();
+    atomic_store(&trigger_pending, true);
+}
+
+// Reduce nlines lines from src, starting at line, into frame - bit
+// fixed - and add their luma difference from prev (if any) to motion_sum
+static void record_reduce(const uint8_t* src, uint line, uint nlines, uint8_t* frame,
+                          const uint8_t* prev)
+{
+    for (uint y = line; y < line + nlines; y++, src += in_line_bytes) {
+        if (out_half && (y & 1)) {
+            continue;
+        }
+        uint off = (out_half ? y / 2 : y) * out_line_bytes;
+        uint8_t* out = frame + off;
+
+        if (!out_luma && !out_half) {
+            memcpy(out, src, out_line_bytes);
+        } else if (!out_luma) {
+            // Y0 U Y2 V of every 4 pixels
+            for (uint x = 0, o = 0; x < in_line_bytes; x += 8) {
+                out[o++] = src[x];
+                out[o++] = src[x + 1];
+                out[o++] = src[x + 4];
+                out[o++] = src[x + 7];
+            }
+        } else {
+            uint step = (in_luma ? 1 : 2) * (out_half ? 2 : 1);
+            for (uint x = 0; x < out_width; x++) {
+                out[x] = src[x * step];
+            }
+        }
+
+        // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+        bitrev_bytes(out, out_line_bytes);
+
+        if (prev) {
+            // Y is every byte of Y8, every other byte of YUYV
+            uint step = out_luma ? 1 : 2;
+            for (uint x = 0; x < out_line_bytes; x += step) {
+                int d = out[x] - prev[off + x];
+                motion_sum += d < 0 ? -d : d;
+            }
+        }
+    }
+}
+
+// Start recording the post-trigger frames - triggered_us splits the burst
+static void record_start(uint32_t us, bool motion)
+{
+    if (triggered) {
+        stats.triggers_ignored++;
+        return;
+    }
+    triggered = true;
+    triggered_us = us;
+    post_left = post_frames;
+    stats.triggers++;
+    if (motion) {
+        stats.motion_triggers++;
+    }
+}
+
+// Send every frame in the history, oldest first, then start again empty
+static void record_send_burst()
+{
+    uint32_t start = time_us_32();
+
+    for (uint i = 0; i < count; i++) {
+        frame_desc_t* f = &slots[(head + nslots - count + i) % nslots];
+        uint8_t flags = FRAME_FLAG_RECORD;
+        if ((int32_t)(f->timestamp_us - triggered_us) <= 0) {
+            flags |= FRAME_FLAG_PRE_TRIGGER;
+        }
+        f->status = FRAME_SENDING;
+        frame_proto_encode_header(header, f, out_width, out_height, flags);
+        transport_send(transport, header, sizeof(header));
+        transport_send(transport, f->data, f->size);
+        f->status = FRAME_FREE;
+    }
+
+    stats.bursts++;
+    stats.burst_frames = count;
+    stats.burst_us = time_us_32() - start;
+
+    // capture went on while sending, without the main loop - the
+    // history has a gap, so it starts again
+    count = 0;
+    assembling = false;
+    prev_valid = false;
+    triggered = false;
+    if (atomic_exchange(&trigger_pending, false)) {
+        stats.triggers_ignored++;
+    }
+}
+
+// Last band of a frame is in - it becomes the newest in the history
+static void record_commit(uint32_t captured_us, bool compared)
+{
+    frame_desc_t* f = &slots[head];
+    f->seq = cur_frame - 1;
+    f->timestamp_us = captured_us;
+    f->status = FRAME_READY;
+
+    last_frame = cur_frame;
+    prev_valid = true;
+    head = (head + 1) % nslots;
+    if (count < nslots) {
+        count++;
+    }
+    stats.frames++;
+
+    if (triggered) {
+        // a frame that completed before the trigger is still pre-trigger
+        if ((int32_t)(captured_us - triggered_us) > 0 && post_left > 0) {
+            post_left--;
+        }
+    } else if (compared) {
+        uint32_t pixels = out_width * out_height;
+        stats.motion = motion_sum / pixels;
+        if (motion_threshold && stats.motion > motion_threshold) {
+            record_start(captured_us, true);
+        }
+    }
+
+    if (triggered && post_left == 0) {
+        record_send_burst();
+    }
+}
+
+// One band from the DMA IRQ - reduce it into the frame it belongs to
+static void record_band(const band_event_t* ev)
+{
+    if (ev->line == 0) {
+        if (assembling) {
+            stats.frames_broken++;
+        }
+        assembling = true;
+        cur_frame = ev->frame;
+        next_line = 0;
+        motion_sum = 0;
+    }
+    if (!assembling) {
+        return;
+    }
+    if (ev->frame != cur_frame || ev->line != next_line) {
+        // a band of this frame was dropped
+        stats.frames_broken++;
+        assembling = false;
+        return;
+    }
+
+    // only compare with the frame just before
+    bool compare = motion_threshold && prev_valid && last_frame + 1 == cur_frame;
+    const uint8_t* prev = compare ? slots[(head + nslots - 1) % nslots].data : NULL;
+    record_reduce(band_storage[ev->buf], ev->line, RECORD_BAND_LINES, slots[head].data, prev);
+
+    next_line += RECORD_BAND_LINES;
+    if (next_line == in_height) {
+        assembling = false;
+        record_commit(ev->captured_us, compare);
+    }
+}
+
+void record_poll()
+{
+    if (atomic_exchange(&trigger_pending, false)) {
+        record_start(trigger_us, false);
+        if (post_frames == 0) {
+            record_send_burst();
+        }
+    }
+
+    band_event_t ev;
+    while (spsc_pop(&ready_q, &ev)) {
+        record_band(&ev);
+        spsc_push(&free_q, &ev.buf);
+    }
+}
+
+void record_get_stats(record_stats_t* out)
+{
+    *out = stats;
+}
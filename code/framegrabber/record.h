@@ -0,0 +1,105 @@
+/*
+
+    record.h
+
+    Pre/post-trigger recording - the last K frames are kept in a
+    rolling history, and a trigger sends them together with the next
+    M frames as one burst.
+
+    Capture streams in bands of RECORD_BAND_LINES lines through a few
+    band buffers, and the main loop reduces each band into the history
+    slot of its frame, so no full-size frame buffer is needed besides
+    the history itself. The history can be kept reduced so more of it
+    fits in SRAM:
+
+    RECORD_FULL       as captured (YUV422, or Y8 with luma_only)
+    RECORD_HALF       2x2 decimated, same format
+    RECORD_LUMA       Y only, full resolution
+    RECORD_LUMA_HALF  Y only, 2x2 decimated
+
+    The reduction is a fixed ratio, so K is known up front - a
+    variable-rate codec (qoi16, JPEG) could overflow the history on a
+    busy scene, and the JPEG encoder doesn't keep up with full frame
+    rate anyway. record_max_pre() gives the largest K for a storage
+    size, history format and M.
+
+    A trigger can come from any IRQ (button, UART command) or from
+    the motion detector, which compares each frame's luma with the
+    one before it. Frames that completed before the trigger are the
+    pre-trigger part. Once M more frames are recorded, all K + M are
+    sent oldest first, each with its own sequence number and capture
+    timestamp, flagged FRAME_FLAG_RECORD - pre-trigger frames also
+    FRAME_FLAG_PRE_TRIGGER. Capture goes on during the burst, but the
+    main loop is sending, so those bands are dropped and the history
+    starts again empty afterwards.
+
+    A frame with a dropped band is not recorded - the history only
+    holds whole frames.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ov7670_stream.h"
+#include "transport.h"
+
+// lines per band - must divide the frame height, and be even for the
+// 2x2 reduction
+#define RECORD_BAND_LINES 8
+
+// band buffers between the DMA IRQ and the main loop - two are
+// always armed, the rest are slack for the main loop
+#define RECORD_BANDS 6
+
+// longest band - QVGA YUV422
+#define RECORD_BAND_MAX_BYTES (320 * 2 * RECORD_BAND_LINES)
+
+typedef enum {
+    RECORD_FULL = 0,
+    RECORD_HALF,
+    RECORD_LUMA,
+    RECORD_LUMA_HALF,
+} record_history_t;
+
+typedef struct {
+    uint32_t frames;            // whole frames recorded into the history
+    uint32_t frames_broken;     // frames started but missing a band - not recorded
+    uint32_t bands_dropped;     // no free band buffer
+    uint32_t triggers;
+    uint32_t triggers_ignored;  // while a burst was being recorded or sent
+    uint32_t motion_triggers;   // of triggers, from the motion detector
+    uint32_t bursts;
+    uint32_t burst_frames;      // frames in the last burst
+    uint32_t burst_us;          // time to send the last burst
+    uint32_t motion;            // mean luma difference, last frame
+} record_stats_t;
+
+// Bytes one history frame of desc takes in history format
+uint32_t record_frame_bytes(const ov7670_capture_desc_t* desc, record_history_t history);
+
+// Largest K that fits in bytes of storage with post frames after the trigger
+uint record_max_pre(uint32_t bytes, const ov7670_capture_desc_t* desc,
+                    record_history_t history, uint post);
+
+// Keep pre frames of desc (the window passed to ov7670_stream_start())
+// in storage, reduced to history, and send them with post more on a
+// trigger on t. A frame whose luma differs from the last one by more
+// than motion per pixel on average is a trigger - 0 turns the
+// detector off, and it needs pre + post of at least 2. Returns false
+// if the frames don't fit in bytes, or desc is Bayer.
+bool record_init(uint8_t* storage, uint32_t bytes, const ov7670_capture_desc_t* desc,
+                 record_history_t history, uint pre, uint post, uint motion, transport_t* t);
+
+// Start a burst - safe to call from IRQ
+void record_trigger();
+
+// Record the bands that have landed, and send the burst once it is
+// complete - call from the main loop
+void record_poll();
+
+void record_get_stats(record_stats_t* stats);
+
+// Pass to ov7670_stream_start() with RECORD_BAND_LINES lines per band
+extern const ov7670_stream_cb_t record_stream_cb;
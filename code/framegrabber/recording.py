@@ -0,0 +1,279 @@
+"""
+Append-only recording container for long captures.
+
+A recording is two files:
+
+    capture.ovr       file header, then one record per frame
+    capture.ovr.idx   one fixed-size entry per frame
+
+File header (32 bytes):
+
+    | off | size | field                       |
+    |-----|------|-----------------------------|
+    |   0 |   4  | magic "OVRC"                |
+    |   4 |   2  | version                     |
+    |   6 |   2  | header length               |
+    |   8 |   8  | start time (us since epoch) |
+    |  16 |  16  | reserved                    |
+
+Record (24 byte header, then the payload padded to 8 bytes):
+
+    | off | size | field                         |
+    |-----|------|-------------------------------|
+    |   0 |   4  | magic "OVRF"                  |
+    |   4 |   1  | pixel format (frame_format_t) |
+    |   5 |   1  | flags, as received            |
+    |   6 |   2  | width                         |
+    |   8 |   2  | height                        |
+    |  10 |   2  | reserved                      |
+    |  12 |   4  | sequence number               |
+    |  16 |   4  | capture timestamp (us)        |
+    |  20 |   4  | payload length                |
+
+The metadata is the frame header from the wire (frame_proto.h). The
+payload is always the decoded frame - chunks expanded and tile deltas
+applied - whatever the flags say.
+
+Index entry (16 bytes): record offset (u64), sequence (u32), timestamp
+(u32). Entry N is at N * 16, so frame N is found in O(1). The index is
+written alongside the records, so a recording that was cut off can be
+read back - records past the end of the index are found by scanning
+and the index is rebuilt.
+
+Usage: recording.py info <file>
+       recording.py topng <file> <out_dir> [--jobs <n>] [--gray]
+"""
+
+import mmap
+import os
+import struct
+import sys
+import time
+
+import numpy as np
+
+from frame_proto import Frame
+
+FILE_MAGIC = b"OVRC"
+FILE_VERSION = 1
+FILE_HEADER_FMT = "<4sHHQ16x"
+FILE_HEADER_LEN = struct.calcsize(FILE_HEADER_FMT)
+
+RECORD_MAGIC = b"OVRF"
+RECORD_FMT = "<4sBBHH2xIII"
+RECORD_LEN = struct.calcsize(RECORD_FMT)
+RECORD_ALIGN = 8
+
+INDEX_DTYPE = np.dtype([("offset", "<u8"), ("seq", "<u4"), ("timestamp_us", "<u4")])
+INDEX_SUFFIX = ".idx"
+
+
+def _padded(n):
+    return (n + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1)
+
+
+class RecordingWriter:
+    """ Appends frames to a new recording. Records and index entries are
+        gathered in memory and written in batches of about batch_bytes,
+        so a long capture costs a few large writes instead of two per frame. """
+
+    def __init__(self, path, batch_bytes=4 << 20):
+        self.path = path
+        self.batch_bytes = batch_bytes
+        self.file = open(path, "wb")
+        self.index = open(path + INDEX_SUFFIX, "wb")
+        self.file.write(struct.pack(FILE_HEADER_FMT, FILE_MAGIC, FILE_VERSION,
+                                    FILE_HEADER_LEN, time.time_ns() // 1000))
+        self.offset = FILE_HEADER_LEN
+        self.records = bytearray()
+        self.entries = bytearray()
+        self.frames = 0
+
+    def write(self, frame):
+        """ Append frame (a frame_proto.Frame with a decoded payload) """
+        n = len(frame.payload)
+        self.entries += struct.pack("<QII", self.offset, frame.seq, frame.timestamp_us)
+        self.records += struct.pack(RECORD_FMT, RECORD_MAGIC, frame.format, frame.flags,
+                                    frame.width, frame.height, frame.seq,
+                                    frame.timestamp_us, n)
+        self.records += frame.payload
+        self.records += bytes(_padded(n) - n)
+        self.offset += RECORD_LEN + _padded(n)
+        self.frames += 1
+
+        if len(self.records) >= self.batch_bytes:
+            self.flush()
+
+    def flush(self):
+        # records first - an index entry must never point past the data
+        self.file.write(self.records)
+        self.file.flush()
+        self.index.write(self.entries)
+        self.index.flush()
+        self.records.clear()
+        self.entries.clear()
+
+    def close(self):
+        self.flush()
+        self.file.close()
+        self.index.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class Recording:
+    """ Random access to a recording through mmap. rec[n] is frame n -
+        its payload is a memoryview into the mapping, so nothing is
+        copied until it is used. """
+
+    def __init__(self, path):
+        self.path = path
+        with open(path, "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, hdr_len, self.start_us = struct.unpack_from(FILE_HEADER_FMT, self.map)
+        if magic != FILE_MAGIC or version != FILE_VERSION:
+            raise ValueError(f"{path}: not a recording")
+        self.header_len = hdr_len
+
+        self.index = self._load_index()
+
+    def _load_index(self):
+        index = np.zeros(0, INDEX_DTYPE)
+        try:
+            with open(self.path + INDEX_SUFFIX, "rb") as f:
+                data = f.read()
+            index = np.frombuffer(data[:len(data) - len(data) % INDEX_DTYPE.itemsize], INDEX_DTYPE)
+        except FileNotFoundError:
+            pass
+
+        # drop entries past the end of the data, then scan for records
+        # the index never got - both happen when a capture is cut off
+        index = index[index["offset"] + RECORD_LEN <= len(self.map)]
+        while len(index) and self._record_end(int(index["offset"][-1])) > len(self.map):
+            index = index[:-1]
+        pos = self._record_end(int(index["offset"][-1])) if len(index) else self.header_len
+        extra = []
+        while pos + RECORD_LEN <= len(self.map):
+            magic, fmt, flags, width, height, seq, ts, n = self._record(pos)
+            if magic != RECORD_MAGIC or self._record_end(pos) > len(self.map):
+                break
+            extra.append((pos, seq, ts))
+            pos = self._record_end(pos)
+        if extra:
+            index = np.concatenate([index, np.array(extra, INDEX_DTYPE)])
+            with open(self.path + INDEX_SUFFIX, "wb") as f:
+                f.write(index.tobytes())
+        return index
+
+    def _record(self, pos):
+        return struct.unpack_from(RECORD_FMT, self.map, pos)
+
+    def _record_end(self, pos):
+        return pos + RECORD_LEN + _padded(self._record(pos)[-1])
+
+    def __len__(self):
+        return len(self.index)
+
+    def __getitem__(self, n):
+        pos = int(self.index["offset"][n])
+        magic, fmt, flags, width, height, seq, ts, size = self._record(pos)
+        if magic != RECORD_MAGIC:
+            raise ValueError(f"{self.path}: bad record at offset {pos}")
+        payload = memoryview(self.map)[pos + RECORD_LEN:pos + RECORD_LEN + size]
+        return Frame(fmt, flags, width, height, seq, ts, payload)
+
+    def __iter__(self):
+        for n in range(len(self)):
+            yield self[n]
+
+    def find_seq(self, seq):
+        """ Frame number of sequence number seq, or None """
+        hits = np.flatnonzero(self.index["seq"] == seq)
+        return int(hits[0]) if len(hits) else None
+
+    def close(self):
+        self.map.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def _topng_range(args):
+    """ Worker for topng - converts frames [first, last) of the recording """
+    path, out_dir, first, last, gray = args
+    # imported here so only the workers load OpenCV and pyserial
+    from PIL import Image
+    from recv_image import FrameConverter
+
+    converter = FrameConverter(gray)
+    rgb = None
+    done = 0
+    with Recording(path) as rec:
+        for n in range(first, last):
+            frame = rec[n]
+            if rgb is None or rgb.shape != (frame.height, frame.width, 3):
+                rgb = np.empty((frame.height, frame.width, 3), np.uint8)
+            if converter.convert(frame, rgb):
+                Image.fromarray(rgb, mode="RGB").save(os.path.join(out_dir, f"frame_{frame.seq:08d}.png"))
+                done += 1
+            del frame   # the map can't close while a payload view is alive
+    return done
+
+
+def topng(path, out_dir, jobs=None, gray=False):
+    """ Convert every frame of a recording to PNG, on all cores """
+    from multiprocessing import Pool
+
+    with Recording(path) as rec:
+        count = len(rec)
+    os.makedirs(out_dir, exist_ok=True)
+    jobs = jobs or os.cpu_count()
+
+    # many small ranges so a slow one doesn't leave the other cores idle
+    step = max(1, min(64, count // (jobs * 4)))
+    ranges = [(path, out_dir, n, min(n + step, count), gray) for n in range(0, count, step)]
+    start = time.monotonic()
+    with Pool(jobs) as pool:
+        done = sum(pool.imap_unordered(_topng_range, ranges))
+    elapsed = time.monotonic() - start
+    print(f"{done} of {count} frames converted in {elapsed:.1f} s "
+          f"({done / max(elapsed, 1e-9):.1f} frames/s, {jobs} processes)")
+
+
+def info(path):
+    with Recording(path) as rec:
+        print(f"{path}: {len(rec)} frames, started {time.ctime(rec.start_us / 1e6)}")
+        if len(rec):
+            first, last = rec[0], rec[len(rec) - 1]
+            span = (last.timestamp_us - first.timestamp_us) & 0xFFFFFFFF
+            lost = int(np.count_nonzero(np.diff(rec.index["seq"].astype(np.int64)) != 1))
+            print(f"  seq {first.seq}..{last.seq}, {first.width}x{first.height} {first.format_name}, "
+                  f"{span / 1e6:.1f} s, {lost} gaps")
+            del first, last
+
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in ("info", "topng") or (sys.argv[1] == "topng" and len(sys.argv) < 4):
+        print(f"Usage: {sys.argv[0]} info <file>")
+        print(f"       {sys.argv[0]} topng <file> <out_dir> [--jobs <n>] [--gray]")
+        sys.exit(1)
+
+    if sys.argv[1] == "info":
+        info(sys.argv[2])
+    else:
+        jobs = None
+        if "--jobs" in sys.argv:
+            jobs = int(sys.argv[sys.argv.index("--jobs") + 1])
+        topng(sys.argv[2], sys.argv[3], jobs, "--gray" in sys.argv)
+
+
+if __name__ == "__main__":
+    main()
@@ -2,28 +2,37 @@ import serial
 import numpy as np
 from PIL import Image
 import sys
+import io
 import cv2
+import queue
+import threading
+import time
+
+from frame_proto import FrameDecoder, HEADER_LEN, encode_credit, encode_capture
+from tile_delta import TileReconstructor
+from recording import RecordingWriter
+from demosaic import demosaic
 
 # Image parameters
 IMAGE_WIDTH = 320
 IMAGE_HEIGHT = 240
 IMAGE_SIZE = IMAGE_WIDTH * IMAGE_HEIGHT * 2  # 2 bytes per pixel (RGB565 or YUV422)
 
-def yuv422_to_rgb8882(frame):
+def yuv422_to_rgb8882(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
     """ Convert YUV422 byte array to an RGB888 OpenCV image """
     frame = np.frombuffer(frame, dtype=np.uint8)  # Convert byte buffer to numpy array
     
     # OpenCV expects a single row of interleaved YUYV data
-    frame = frame.reshape((IMAGE_HEIGHT, IMAGE_WIDTH * 2))  # Ensure correct YUYV format
+    frame = frame.reshape((height, width * 2))  # Ensure correct YUYV format
 
     # Convert YUV422 (YUYV) to RGB
     rgb_image = cv2.cvtColor(frame, cv2.COLOR_YUV2RGB_YUYV)
 
     return rgb_image  # Shape: (H, W, 3)
 
-def yuv422_to_rgb888(frame):
+def yuv422_to_rgb888(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
     """ Convert YUV422 byte array to an RGB888 numpy array """
-    frame = np.frombuffer(frame, dtype=np.uint8).reshape(IMAGE_HEIGHT, IMAGE_WIDTH * 2)  # YUYV pairs
+    frame = np.frombuffer(frame, dtype=np.uint8).reshape(height, width * 2)  # YUYV pairs
     frame = np.flipud(frame)
 
     # Extract Y, U, V components
@@ -31,16 +40,16 @@ def yuv422_to_rgb888(frame):
     U = frame[:, 1::4]  # U values (subsampled)
     V = frame[:, 3::4]  # V values (subsampled)
 
-    # Correctly interleave U and V to match Y resolution
-    U = np.column_stack((U, U)).reshape(IMAGE_HEIGHT, IMAGE_WIDTH)  # Expand U horizontally
-    V = np.column_stack((V, V)).reshape(IMAGE_HEIGHT, IMAGE_WIDTH)  # Expand V horizontally
+    # Each U and V is shared by a pixel pair - repeat them to match Y resolution
+    U = np.repeat(U, 2, axis=1)  # Expand U horizontally
+    V = np.repeat(V, 2, axis=1)  # Expand V horizontally
 
 
-    # Convert to RGB using standard YUV to RGB conversion
-    # Convert to RGB using standard YUV to RGB conversion
-    C = Y.astype(np.int16) - 16
-    D = U.astype(np.int16) - 128
-    E = V.astype(np.int16) - 128
+    # Convert to RGB using standard YUV to RGB conversion - int32, as
+    # 298 * C overflows int16
+    C = Y.astype(np.int32) - 16
+    D = U.astype(np.int32) - 128
+    E = V.astype(np.int32) - 128
 
     R = np.clip((298 * C + 409 * E + 128) >> 8, 0, 255)
     G = np.clip((298 * C - 100 * D - 208 * E + 128) >> 8, 0, 255)
@@ -48,16 +57,28 @@ def yuv422_to_rgb888(frame):
 
     return np.stack([R, G, B], axis=-1).astype(np.uint8)  # Shape: (H, W, 3)
 
-def yuv422_to_grayscale(frame):
+def yuv422_to_grayscale(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
     """ Extracts the Y (luminance) channel from YUV422 to create a grayscale image """
-    frame = np.frombuffer(frame, dtype=np.uint8).reshape(IMAGE_HEIGHT, IMAGE_WIDTH * 2)  # YUYV pairs 
+    frame = np.frombuffer(frame, dtype=np.uint8).reshape(height, width * 2)  # YUYV pairs 
     Y = frame[:, 0::2]  # Extract only the Y values (luminance)
     
     return np.stack([Y, Y, Y], axis=-1).astype(np.uint8)  # Convert to 3-channel grayscale image
 
-def rgb565_to_rgb888(frame):
+def y8_to_grayscale(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
+    """ Luma-only frame (U/V dropped on the device) to a 3-channel grayscale image """
+    Y = np.frombuffer(frame, dtype=np.uint8).reshape(height, width)
+
+    return np.stack([Y, Y, Y], axis=-1)
+
+def jpeg_to_rgb888(frame):
+    """ Decode a JPEG frame (encoded on the device) to an RGB888 numpy array """
+    rgb = np.array(Image.open(io.BytesIO(frame)).convert("RGB"))
+
+    return np.flipud(rgb)  # same orientation as the raw YUV422 path
+
+def rgb565_to_rgb888(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
     """ Convert RGB565 byte array to an RGB888 numpy array """
-    frame = np.frombuffer(frame, dtype=np.uint16).reshape(IMAGE_HEIGHT, IMAGE_WIDTH)
+    frame = np.frombuffer(frame, dtype=np.uint16).reshape(height, width)
     frame = np.flipud(frame) 
     
     r = ((frame >> 11) & 0x1F) << 3  # Shift left by 3
@@ -66,6 +87,10 @@ def rgb565_to_rgb888(frame):
 
     return np.stack([r, g, b], axis=-1).astype(np.uint8)  # Shape: (H, W, 3)
 
+def bayer_to_rgb888(frame, width=IMAGE_WIDTH, height=IMAGE_HEIGHT):
+    """ Demosaic a raw BGGR frame (edge-aware, see demosaic.py) to an RGB888 numpy array """
+    return np.flipud(demosaic(frame, width, height))
+
 def save_image(data, filename="output.png"):
     """ Save the RGB888 image as a PNG file using PIL """
     img = Image.fromarray(data, mode="RGB")
@@ -78,36 +103,376 @@ def save_raw_data(data, filename="output.hex"):
         f.write(data)
     print(f"Raw data saved as {filename}")
 
+class FrameConverter:
+    """ Converts frames to RGB888 into buffers the caller passes in. The
+        int32 work arrays are kept between frames and only reallocated
+        when the format or size changes, so a frame costs no allocations
+        beyond the payload itself. Output matches the functions above. """
+
+    def __init__(self, gray=False):
+        self.gray = gray
+        self.key = None
+
+    def _alloc(self, width, height):
+        half = (height, width // 2)
+        self.C = np.empty((height, width), np.int32)   # 298 * (Y - 16) + 128
+        self.D = np.empty(half, np.int32)              # U - 128
+        self.E = np.empty(half, np.int32)              # V - 128
+        self.E208 = np.empty(half, np.int32)
+        self.t = np.empty((height, width), np.int32)
+        self.t16 = np.empty((height, width), np.uint16)
+
+    def _channel(self, out, c):
+        """ out[..., c] = clip(t + C >> 8) """
+        t = self.t
+        t += self.C
+        t >>= 8
+        np.clip(t, 0, 255, out=t)
+        out[:, :, c] = t
+
+    def _yuv422(self, payload, width, height, out):
+        frame = np.frombuffer(payload, np.uint8).reshape(height, width * 2)[::-1]
+        np.subtract(frame[:, 0::2], 16, out=self.C, dtype=np.int32)
+        self.C *= 298
+        self.C += 128
+        np.subtract(frame[:, 1::4], 128, out=self.D, dtype=np.int32)
+        np.subtract(frame[:, 3::4], 128, out=self.E, dtype=np.int32)
+        np.multiply(self.E, 208, out=self.E208)
+
+        # U and V are shared by pixel pairs - broadcast over a (h, w/2, 2) view
+        t2 = self.t.reshape(height, width // 2, 2)
+        np.multiply(self.E[:, :, None], 409, out=t2)
+        self._channel(out, 0)
+        np.multiply(self.D[:, :, None], -100, out=t2)
+        t2 -= self.E208[:, :, None]
+        self._channel(out, 1)
+        np.multiply(self.D[:, :, None], 516, out=t2)
+        self._channel(out, 2)
+
+    def _rgb565(self, payload, width, height, out):
+        frame = np.frombuffer(payload, np.uint16).reshape(height, width)[::-1]
+        t16 = self.t16
+        np.right_shift(frame, 8, out=t16)
+        t16 &= 0xF8
+        out[:, :, 0] = t16
+        np.right_shift(frame, 3, out=t16)
+        t16 &= 0xFC
+        out[:, :, 1] = t16
+        np.left_shift(frame, 3, out=t16)
+        t16 &= 0xF8
+        out[:, :, 2] = t16
+
+    def convert(self, frame, out):
+        """ Convert frame into out, an (height, width, 3) uint8 array.
+            Returns False for formats it can't handle. """
+        width, height = frame.width, frame.height
+        if (frame.format, width, height) != self.key:
+            self._alloc(width, height)
+            self.key = (frame.format, width, height)
+
+        name = frame.format_name
+        if name == "y8":
+            out[:] = np.frombuffer(frame.payload, np.uint8).reshape(height, width)[:, :, None]
+        elif name == "yuv422" and self.gray:
+            out[:] = np.frombuffer(frame.payload, np.uint8).reshape(height, width * 2)[:, 0::2, None]
+        elif name == "yuv422":
+            self._yuv422(frame.payload, width, height, out)
+        elif name == "rgb565":
+            self._rgb565(frame.payload, width, height, out)
+        elif name == "bayer":
+            demosaic(frame.payload, width, height, out=out[::-1])
+        elif name == "jpeg":
+            out[:] = jpeg_to_rgb888(frame.payload)     # the JPEG decoder allocates
+        else:
+            return False
+        return True
+
+
+class WindowSink:
+    """ Live view in an OpenCV window """
+
+    needs_rgb = True
+
+    def __init__(self):
+        self.bgr = None
+
+    def write(self, frame, rgb):
+        if self.bgr is None or self.bgr.shape != rgb.shape:
+            self.bgr = np.empty_like(rgb)
+        cv2.cvtColor(rgb, cv2.COLOR_RGB2BGR, dst=self.bgr)
+        cv2.imshow("framegrabber", self.bgr)
+        cv2.waitKey(1)
+
+    def close(self):
+        cv2.destroyAllWindows()
+
+
+class PngSink:
+    """ One PNG per frame, named by sequence number """
+
+    needs_rgb = True
+
+    def __init__(self, prefix="frame"):
+        self.prefix = prefix
+
+    def write(self, frame, rgb):
+        Image.fromarray(rgb, mode="RGB").save(f"{self.prefix}_{frame.seq:08d}.png")
+
+    def close(self):
+        pass
+
+
+class RawSink:
+    """ Payloads as received, appended to one file """
+
+    needs_rgb = False
+
+    def __init__(self, filename="output.raw"):
+        self.file = open(filename, "wb")
+
+    def write(self, frame, rgb):
+        self.file.write(frame.payload)
+
+    def close(self):
+        self.file.close()
+
+
+class RecordSink:
+    """ Indexed recording (recording.py) - a new file per run """
+
+    needs_rgb = False
+
+    def __init__(self, filename=None):
+        self.writer = RecordingWriter(filename or time.strftime("capture_%Y%m%d_%H%M%S.ovr"))
+        print(f"Recording to {self.writer.path}")
+
+    def write(self, frame, rgb):
+        self.writer.write(frame)
+
+    def close(self):
+        self.writer.close()
+        print(f"{self.writer.frames} frames recorded to {self.writer.path}")
+
+
+SINKS = {"window": WindowSink, "png": PngSink, "raw": RawSink, "record": RecordSink}
+
+
+class SinkWorker:
+    """ Runs the sinks on their own thread, so disk and display never hold
+        up the serial read. Converted frames come from a small pool of
+        RGB buffers - when every buffer is still with the sinks, the frame
+        is dropped instead of waiting. Sinks that only take the payload
+        (raw, record) get every frame. """
+
+    def __init__(self, sinks, nbufs=3):
+        self.sinks = sinks
+        self.needs_rgb = any(sink.needs_rgb for sink in sinks)
+        self.pending = queue.Queue()
+        self.free = queue.Queue()
+        for _ in range(nbufs):
+            self.free.put(None)     # allocated on first use
+        self.dropped = 0
+        self.written = 0
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def get_buffer(self, width, height):
+        """ A free RGB buffer, or None if the sinks are behind """
+        try:
+            buf = self.free.get_nowait()
+        except queue.Empty:
+            self.dropped += 1
+            return None
+        if buf is None or buf.shape != (height, width, 3):
+            buf = np.empty((height, width, 3), np.uint8)
+        return buf
+
+    def put(self, frame, rgb):
+        self.pending.put((frame, rgb))
+
+    def put_back(self, rgb):
+        self.free.put(rgb)
+
+    def _run(self):
+        while True:
+            item = self.pending.get()
+            if item is None:
+                break
+            frame, rgb = item
+            for sink in self.sinks:
+                sink.write(frame, rgb)
+            self.written += 1
+            if rgb is not None:
+                self.free.put(rgb)
+
+    def close(self):
+        self.pending.put(None)
+        self.thread.join()
+        for sink in self.sinks:
+            sink.close()
+
+
+def run_continuous(ser, sinks, gray, window):
+    """ Receive until Ctrl-C, handing every frame to the sinks. Returns
+        the frames received, the seconds taken and the serial buffer
+        high-water mark in bytes. """
+    READ_SIZE = 64 * 1024
+    buf = bytearray(READ_SIZE)      # reused for every read
+    view = memoryview(buf)
+
+    decoder = FrameDecoder()
+    tiles = TileReconstructor()
+    converter = FrameConverter(gray)
+    worker = SinkWorker(sinks)
+
+    frames_total = 0
+    frames_period = 0
+    high_water = 0
+    period_start = start = time.monotonic()
+    ser.timeout = 0.5       # wake up to report even when nothing arrives
+
+    try:
+        while True:
+            # in_waiting is what the OS has buffered - if it nears the
+            # driver's buffer size, bytes are about to be lost
+            waiting = ser.in_waiting
+            high_water = max(high_water, waiting)
+            n = ser.readinto(view[:max(1, min(waiting, READ_SIZE))])
+
+            for f in decoder.feed(view[:n]):
+                if window:
+                    ser.write(encode_credit(HEADER_LEN + len(f.payload)))
+                payload = tiles.apply(f)
+                if payload is None:
+                    continue
+                f.payload = payload
+                frames_total += 1
+                frames_period += 1
+
+                if not worker.needs_rgb:
+                    worker.put(f, None)
+                    continue
+                rgb = worker.get_buffer(f.width, f.height)
+                if rgb is None:
+                    continue
+                if converter.convert(f, rgb):
+                    worker.put(f, rgb)
+                else:
+                    worker.put_back(rgb)
+            for ack in decoder.acks:
+                if not ack.ok:
+                    print(f"Command 0x{ack.op:02x} failed: {ack.status_name}")
+            decoder.acks.clear()
+
+            now = time.monotonic()
+            if now - period_start >= 1.0:
+                print(f"{frames_period / (now - period_start):5.1f} fps, "
+                      f"{worker.written} written, {worker.dropped} dropped by sinks, "
+                      f"serial buffer high water {high_water} bytes, "
+                      f"{decoder.crc_errors} CRC errors, {decoder.lost_frames} lost")
+                frames_period = 0
+                period_start = now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        # the rate frames came in at - not counting the sinks catching up
+        elapsed = time.monotonic() - start
+        worker.close()
+
+    print(f"{frames_total} frames in {elapsed:.1f} s ({frames_total / elapsed:.1f} fps), "
+          f"serial buffer high water {high_water} bytes")
+    return frames_total, elapsed, high_water
+
+
 def main():
     if len(sys.argv) < 3:
-        print(f"Usage: {sys.argv[0]} <serial_port> <format: rgb565/yuv422/gray> [--save-raw]")
+        print(f"Usage: {sys.argv[0]} <serial_port> <format: rgb565/yuv422/gray> [--save-raw] [--baud <rate>] [--window <bytes>] "
+              f"[--capture <frames>] [--continuous [--sink window|png|raw|record ...]]")
         sys.exit(1)
 
     SERIAL_PORT = sys.argv[1]  # First argument: Serial port
     FORMAT = sys.argv[2].lower()  # Second argument: Data format (rgb565, yuv422, or gray)
-    BAUD_RATE = 115200
+    BAUD_RATE = 3000000  # Must match BAUD_RATE in framegrabber.c
+    if "--baud" in sys.argv:
+        BAUD_RATE = int(sys.argv[sys.argv.index("--baud") + 1])
 
     ser = serial.Serial(SERIAL_PORT, BAUD_RATE, timeout=None)  # Blocking mode
 
+    # FLOW_CONTROL firmware only sends within credit - open a window and
+    # top it up by the size of every frame taken
+    WINDOW = 0
+    if "--window" in sys.argv:
+        WINDOW = int(sys.argv[sys.argv.index("--window") + 1])
+        ser.write(encode_credit(WINDOW))
+
+    # trigger from the host instead of the button - see cmd.h
+    if "--capture" in sys.argv:
+        ser.write(encode_capture(int(sys.argv[sys.argv.index("--capture") + 1])))
+
+    # --continuous keeps the port open and streams to the sinks (default: window)
+    if "--continuous" in sys.argv:
+        names = [sys.argv[i + 1] for i, a in enumerate(sys.argv[:-1]) if a == "--sink"]
+        sinks = [SINKS[name]() for name in names or ["window"]]
+        run_continuous(ser, sinks, FORMAT == "gray", WINDOW)
+        ser.close()
+        return
+
+    decoder = FrameDecoder()
+    tiles = TileReconstructor()
+    print("Waiting for image data...")
+
     while True:
-        print("Waiting for image data...")
-        frame = ser.read(IMAGE_SIZE)  # Block until full image is received
-        
-        if len(frame) == IMAGE_SIZE:
-            save_raw_data(frame, "output.raw")  # Save raw data first
-            
-            if FORMAT == "rgb565":
-                img_data = rgb565_to_rgb888(frame)
-            elif FORMAT == "yuv422":
-                img_data = yuv422_to_rgb888(frame)
-            elif FORMAT == "gray":
-                img_data = yuv422_to_grayscale(frame)
-            else:
-                print("Invalid format! Use 'rgb565', 'yuv422', or 'gray'.")
+        # read whatever has arrived (at least 1 byte) and let the decoder find frames
+        data = ser.read(max(1, ser.in_waiting))
+        frames = decoder.feed(data)
+        for ack in decoder.acks:
+            if not ack.ok:
+                print(f"Command 0x{ack.op:02x} failed: {ack.status_name}")
+        decoder.acks.clear()
+
+        # delta frames are patched into the last keyframe - first complete frame wins
+        frame = None
+        for f in frames:
+            if WINDOW:
+                ser.write(encode_credit(HEADER_LEN + len(f.payload)))
+            payload = tiles.apply(f)
+            if payload is not None:
+                f.payload = payload
+                frame = f
                 break
+        if frame is None:
+            continue
+
+        print(f"Frame {frame.seq}: {frame.width}x{frame.height} {frame.format_name}, "
+              f"{len(frame.payload)} bytes, t={frame.timestamp_us} us")
+        if decoder.crc_errors or decoder.resyncs:
+            print(f"  {decoder.crc_errors} CRC errors, {decoder.resyncs} resyncs")
+
+        # JPEG payloads are saved as they came, raw frames as output.raw
+        if frame.format_name == "jpeg":
+            save_raw_data(frame.payload, "output.jpg")
+        else:
+            save_raw_data(frame.payload, "output.raw")  # Save raw data first
+
+        # format comes from the frame header - 'gray' picks the Y-only view of YUV422
+        if frame.format_name == "y8":
+            img_data = y8_to_grayscale(frame.payload, frame.width, frame.height)
+        elif FORMAT == "gray":
+            img_data = yuv422_to_grayscale(frame.payload, frame.width, frame.height)
+        elif frame.format_name == "rgb565":
+            img_data = rgb565_to_rgb888(frame.payload, frame.width, frame.height)
+        elif frame.format_name == "jpeg":
+            img_data = jpeg_to_rgb888(frame.payload)
+        elif frame.format_name == "yuv422":
+            img_data = yuv422_to_rgb888(frame.payload, frame.width, frame.height)
+        elif frame.format_name == "bayer":
+            img_data = bayer_to_rgb888(frame.payload, frame.width, frame.height)
+        else:
+            print(f"Unsupported format {frame.format_name}")
+            break
 
-            save_image(img_data)  # Save as PNG
-            break  # Exit after saving one image
+        save_image(img_data)  # Save as PNG
+        break  # Exit after saving one image
 
     ser.close()
 
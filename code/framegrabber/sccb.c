@@ -0,0 +1,222 @@
+/*
+    OV7670 register access with a shadow cache - see sccb.h.
+*/
+
+#include "pico/stdlib.h"
+
+#include "sccb.h"
+
+#define SCCB_COM7       0x12
+#define SCCB_COM7_RESET 0x80
+#define SCCB_CLKRC      0x11
+
+#define SCCB_WORDS ((SCCB_NUM_REGS + 31) / 32)
+
+#define SCCB_POLL_US    100     // between reads in sccb_poll()
+
+static i2c_inst_t* sccb_i2c;
+static uint8_t sccb_addr;
+
+static uint8_t shadow[SCCB_NUM_REGS];       // last value written or read
+static uint8_t defaults[SCCB_NUM_REGS];     // read back after reset
+static uint8_t target[SCCB_NUM_REGS];       // mode being staged
+
+static uint32_t shadow_known[SCCB_WORDS];
+static uint32_t default_known[SCCB_WORDS];
+static uint32_t staged[SCCB_WORDS];
+static uint32_t volatile_regs[SCCB_WORDS];
+
+// staging order - the tables are ordered, so commit keeps it
+static uint8_t order[SCCB_NUM_REGS];
+static uint order_len;
+
+static sccb_stats_t stats;
+
+// Set by the sensor with AGC/AEC/AWB on: GAIN, BLUE, RED, AECHH, AECH,
+// ADVFL, ADVFH. COM1 also holds AEC[1:0], but it is mostly config.
+static const uint8_t sensor_owned[] = { 0x00, 0x01, 0x02, 0x07, 0x10, 0x2D, 0x2E };
+
+static inline bool bit_get(const uint32_t* bits, uint8_t reg)
+{
+    return bits[reg >> 5] & (1u << (reg & 31));
+}
+
+static inline void bit_set(uint32_t* bits, uint8_t reg, bool on)
+{
+    if (on) {
+        bits[reg >> 5] |= 1u << (reg & 31);
+    } else {
+        bits[reg >> 5] &= ~(1u << (reg & 31));
+    }
+}
+
+void sccb_init(i2c_inst_t* i2c, uint8_t addr, uint baud)
+{
+    sccb_i2c = i2c;
+    sccb_addr = addr;
+    i2c_init(i2c, baud);
+
+    for (uint i = 0; i < SCCB_WORDS; i++) {
+        shadow_known[i] = default_known[i] = staged[i] = volatile_regs[i] = 0;
+    }
+    for (uint i = 0; i < sizeof(sensor_owned); i++) {
+        bit_set(volatile_regs, sensor_owned[i], true);
+    }
+    order_len = 0;
+    stats = (sccb_stats_t){0};
+}
+
+bool sccb_write(uint8_t reg, uint8_t value)
+{
+    uint8_t data[2] = { reg, value };
+    bool ok = i2c_write_timeout_us(sccb_i2c, sccb_addr, data, 2, false, SCCB_TIMEOUT_US) == 2;
+
+    stats.writes++;
+    if (!ok) {
+        stats.errors++;
+    }
+    if (reg < SCCB_NUM_REGS) {
+        shadow[reg] = value;
+        bit_set(shadow_known, reg, ok);
+    }
+    return ok;
+}
+
+static bool bus_read(uint8_t reg, uint8_t* value)
+{
+    // SCCB has no repeated start - the register address is a write of its own
+    return i2c_write_timeout_us(sccb_i2c, sccb_addr, &reg, 1, false, SCCB_TIMEOUT_US) == 1 &&
+           i2c_read_timeout_us(sccb_i2c, sccb_addr, value, 1, false, SCCB_TIMEOUT_US) == 1;
+}
+
+bool sccb_read(uint8_t reg, uint8_t* value)
+{
+    bool ok = bus_read(reg, value);
+
+    stats.reads++;
+    if (!ok) {
+        stats.errors++;
+    } else if (reg < SCCB_NUM_REGS) {
+        shadow[reg] = *value;
+        bit_set(shadow_known, reg, true);
+    }
+    return ok;
+}
+
+bool sccb_poll(uint8_t reg, uint8_t mask, uint8_t expect, uint timeout_ms)
+{
+    absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+    uint8_t v;
+
+    do {
+        if (bus_read(reg, &v) && (v & mask) == expect) {
+            stats.reads++;
+            if (reg < SCCB_NUM_REGS) {
+                shadow[reg] = v;
+                bit_set(shadow_known, reg, true);
+            }
+            return true;
+        }
+        sleep_us(SCCB_POLL_US);
+    } while (!time_reached(deadline));
+    return false;
+}
+
+bool sccb_reset(uint timeout_ms)
+{
+    sccb_write(SCCB_COM7, SCCB_COM7_RESET);
+
+    // the reset bit clears itself once the registers are back to defaults
+    bool ready = sccb_poll(SCCB_COM7, SCCB_COM7_RESET, 0, timeout_ms);
+
+    for (uint reg = 0; reg < SCCB_NUM_REGS; reg++) {
+        uint8_t v;
+        bool ok = sccb_read(reg, &v);
+        defaults[reg] = v;
+        bit_set(default_known, reg, ok);
+        bit_set(shadow_known, reg, ok);
+    }
+    return ready;
+}
+
+void sccb_begin()
+{
+    for (uint reg = 0; reg < SCCB_NUM_REGS; reg++) {
+        target[reg] = defaults[reg];
+    }
+    for (uint i = 0; i < SCCB_WORDS; i++) {
+        staged[i] = 0;
+    }
+    order_len = 0;
+}
+
+void sccb_set(uint8_t reg, uint8_t value)
+{
+    if (reg >= SCCB_NUM_REGS) {
+        return;
+    }
+    if (!bit_get(staged, reg)) {
+        bit_set(staged, reg, true);
+        order[order_len++] = reg;
+    }
+    target[reg] = value;
+}
+
+uint8_t sccb_get(uint8_t reg)
+{
+    return reg < SCCB_NUM_REGS ? target[reg] : 0;
+}
+
+// Write reg if the sensor might not hold its target value
+static uint commit_reg(uint8_t reg)
+{
+    if (bit_get(shadow_known, reg) && !bit_get(volatile_regs, reg) &&
+        shadow[reg] == target[reg]) {
+        stats.skipped++;
+        return 0;
+    }
+    sccb_write(reg, target[reg]);
+    return 1;
+}
+
+uint sccb_commit()
+{
+    uint32_t start = time_us_32();
+    uint writes = 0;
+
+    if (bit_get(staged, SCCB_COM7) || bit_get(default_known, SCCB_COM7)) {
+        writes += commit_reg(SCCB_COM7);
+    }
+
+    // registers the previous mode changed and this one doesn't stage
+    for (uint reg = 0; reg < SCCB_NUM_REGS; reg++) {
+        if (reg == SCCB_COM7 || reg == SCCB_CLKRC) {
+            continue;
+        }
+        if (!bit_get(staged, reg) && bit_get(default_known, reg) &&
+            !bit_get(volatile_regs, reg) &&
+            (!bit_get(shadow_known, reg) || shadow[reg] != defaults[reg])) {
+            writes += commit_reg(reg);
+        }
+    }
+
+    for (uint i = 0; i < order_len; i++) {
+        if (order[i] != SCCB_COM7 && order[i] != SCCB_CLKRC) {
+            writes += commit_reg(order[i]);
+        }
+    }
+
+    if (bit_get(staged, SCCB_CLKRC) || bit_get(default_known, SCCB_CLKRC)) {
+        writes += commit_reg(SCCB_CLKRC);
+    }
+
+    stats.commits++;
+    stats.commit_writes = writes;
+    stats.commit_us = time_us_32() - start;
+    return writes;
+}
+
+void sccb_get_stats(sccb_stats_t* s)
+{
+    *s = stats;
+}
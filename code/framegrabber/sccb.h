@@ -0,0 +1,81 @@
+/*
+
+    sccb.h
+
+    OV7670 register access over SCCB (I2C), with a shadow copy of
+    registers 0x00 - 0xC9.
+
+    sccb_reset() resets the sensor, polls until the reset is done and
+    reads every register back, so the shadow starts out as the reset
+    defaults. Mode changes are then staged and committed as a diff,
+    without another reset:
+
+        sccb_begin();                   // target = reset defaults
+        sccb_set(REG_COM7, ...);        // overlay the mode's tables
+        ...
+        sccb_commit();                  // write what differs
+
+    The result is the same as a reset followed by the tables, but only
+    registers whose values change go on the bus. Commit order:
+
+    1. COM7 - it selects the format, and the Linux driver always writes
+       it before anything else
+    2. registers left over from the previous mode, back to defaults
+    3. staged registers, in the order they were staged
+    4. CLKRC - the pixel clock only changes once the rest is in place
+
+    Gain, exposure and white balance registers are changed by the
+    sensor itself, so the shadow can't be trusted for them. They are
+    written whenever they are staged and never reverted. A write that
+    fails marks its shadow entry unknown, so the next commit retries it.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hardware/i2c.h"
+
+#define SCCB_NUM_REGS   0xCA                // registers 0x00 - 0xC9
+#define SCCB_BAUD       (400 * 1000)        // fast mode - the OV7670 maximum
+#define SCCB_TIMEOUT_US 1000                // per transaction
+
+typedef struct {
+    uint32_t writes;            // register writes on the bus
+    uint32_t reads;
+    uint32_t skipped;           // staged values already in the sensor
+    uint32_t errors;            // NAKs and timeouts
+    uint32_t commits;
+    uint32_t commit_writes;     // writes in the last commit
+    uint32_t commit_us;         // time of the last commit
+} sccb_stats_t;
+
+// Set up i2c at baud for the sensor at 7-bit address addr. The shadow is unknown until sccb_reset().
+void sccb_init(i2c_inst_t* i2c, uint8_t addr, uint baud);
+
+// Reset the sensor (COM7) and read all registers into the shadow. Waits
+// for the reset bit to clear, up to timeout_ms - false if it never did.
+bool sccb_reset(uint timeout_ms);
+
+// Read reg until (value & mask) == expect, up to timeout_ms. NAKs while
+// the sensor is busy are part of waiting, not errors.
+bool sccb_poll(uint8_t reg, uint8_t mask, uint8_t expect, uint timeout_ms);
+
+// Single register access, now - both update the shadow
+bool sccb_write(uint8_t reg, uint8_t value);
+bool sccb_read(uint8_t reg, uint8_t* value);
+
+// Start staging a mode - every register is set to its reset default
+void sccb_begin();
+
+// Stage one register. Staging the same register again replaces the value.
+void sccb_set(uint8_t reg, uint8_t value);
+
+// Staged value of reg - for read-modify-write of shared registers
+uint8_t sccb_get(uint8_t reg);
+
+// Write the staged mode. Returns the number of register writes.
+uint sccb_commit();
+
+void sccb_get_stats(sccb_stats_t* stats);
@@ -0,0 +1,64 @@
+/*
+
+    spsc_queue.h 
+
+    Lock-free single-producer/single-consumer queue of fixed-size 
+    elements. The producer only writes head and the consumer only 
+    writes tail, so one side can be an IRQ handler or the other core.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct {
+    uint8_t* buf;
+    uint16_t elem_size;
+    uint16_t len;       // capacity + 1, so full and empty differ
+    atomic_uint head;   // written by producer only
+    atomic_uint tail;   // written by consumer only
+} spsc_queue_t;
+
+// storage must hold capacity + 1 elements
+static inline void spsc_init(spsc_queue_t* q, void* storage, uint16_t elem_size, uint16_t capacity)
+{
+    q->buf = storage;
+    q->elem_size = elem_size;
+    q->len = capacity + 1;
+    atomic_store(&q->head, 0);
+    atomic_store(&q->tail, 0);
+}
+
+static inline bool spsc_push(spsc_queue_t* q, const void* elem)
+{
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned next = (head + 1) % q->len;
+    if (next == atomic_load_explicit(&q->tail, memory_order_acquire)) {
+        return false;   // full
+    }
+    memcpy(q->buf + head * q->elem_size, elem, q->elem_size);
+    atomic_store_explicit(&q->head, next, memory_order_release);
+    return true;
+}
+
+static inline bool spsc_pop(spsc_queue_t* q, void* elem)
+{
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&q->head, memory_order_acquire)) {
+        return false;   // empty
+    }
+    memcpy(elem, q->buf + tail * q->elem_size, q->elem_size);
+    atomic_store_explicit(&q->tail, (tail + 1) % q->len, memory_order_release);
+    return true;
+}
+
+// Number of elements queued - a snapshot, either side may call it
+static inline unsigned spsc_level(spsc_queue_t* q)
+{
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return (head + q->len - tail) % q->len;
+}
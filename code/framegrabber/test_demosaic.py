@@ -0,0 +1,86 @@
+"""
+Tests for demosaic.py.
+
+A flat colour must come back exact with both methods. With OVCONVERT
+set (see test_recv_image.py), ovrecv::demosaic() must give bit-exact
+the same pixels as demosaic() for random frames and for mosaics of
+smooth and sharp images, with every kernel the CPU has.
+"""
+
+import os
+import subprocess
+import unittest
+
+import numpy as np
+
+from demosaic import demosaic, mosaic
+
+OVCONVERT = os.environ.get("OVCONVERT")
+
+ISAS = ("scalar", "sse2", "avx2")
+METHODS = ("bilinear", "edge")
+
+
+def host_demosaic(frame, width, height, isa, method):
+    """ ovconvert output as an (height, width, 3) array - None if isa isn't supported """
+    args = [OVCONVERT, "bayer", str(width), str(height), "rgb", "0", isa, method]
+    res = subprocess.run(args, input=frame, stdout=subprocess.PIPE)
+    if res.returncode == 3:
+        return None
+    if res.returncode:
+        raise RuntimeError(f"ovconvert failed: {res.returncode}")
+    return np.frombuffer(res.stdout, np.uint8).reshape(height, width, 3)
+
+
+def sample_images(width, height, rng):
+    """ A gradient, hard-edged stripes and a disc, as RGB """
+    y, x = np.mgrid[0:height, 0:width]
+    grad = np.stack([x * 255 // max(width - 1, 1), y * 255 // max(height - 1, 1),
+                     (x + y) * 255 // max(width + height - 2, 1)], axis=-1)
+    stripes = np.where(((x // 3 + y // 5) % 2)[..., None], rng.integers(0, 256, 3), rng.integers(0, 256, 3))
+    disc = np.where(((x - width / 2) ** 2 + (y - height / 3) ** 2 < (width / 4) ** 2)[..., None],
+                    (250, 20, 40), (10, 200, 90))
+    return [img.astype(np.uint8) for img in (grad, stripes, disc)]
+
+
+class DemosaicTest(unittest.TestCase):
+    def test_flat(self):
+        for colour in ((0, 0, 0), (255, 255, 255), (200, 30, 90), (1, 254, 128)):
+            rgb = np.empty((8, 12, 3), np.uint8)
+            rgb[:] = colour
+            for method in METHODS:
+                with self.subTest(colour=colour, method=method):
+                    np.testing.assert_array_equal(demosaic(mosaic(rgb), 12, 8, method), rgb)
+
+    def test_sites_keep_their_sample(self):
+        rng = np.random.default_rng(18)
+        frame = rng.integers(0, 256, 16 * 10, dtype=np.uint8).tobytes()
+        for method in METHODS:
+            self.assertEqual(mosaic(demosaic(frame, 16, 10, method)), frame)
+
+
+@unittest.skipUnless(OVCONVERT, "OVCONVERT not set")
+class HostLibraryTest(unittest.TestCase):
+    def check(self, frame, width, height):
+        for method in METHODS:
+            want = demosaic(frame, width, height, method)
+            for isa in ISAS:
+                with self.subTest(width=width, height=height, method=method, isa=isa):
+                    got = host_demosaic(frame, width, height, isa, method)
+                    if got is not None:
+                        np.testing.assert_array_equal(got, want)
+
+    def test_random(self):
+        rng = np.random.default_rng(18)
+        for width, height in ((2, 2), (4, 2), (6, 8), (30, 6), (64, 4), (66, 10), (320, 240), (640, 480)):
+            self.check(rng.integers(0, 256, width * height, dtype=np.uint8).tobytes(), width, height)
+
+    def test_images(self):
+        rng = np.random.default_rng(18)
+        for width, height in ((34, 18), (320, 240)):
+            for rgb in sample_images(width, height, rng):
+                self.check(mosaic(rgb), width, height)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,142 @@
+"""
+Tests for frame_proto.py - the frame decoder and the command encoders.
+
+Frames are built here from the layout in frame_proto.h. With FWCODEC
+set to the fwcodec tool from code/host/tests (ctest does this), they
+are also checked against frames encoded by the firmware's own
+frame_proto.c.
+"""
+
+import os
+import random
+import struct
+import subprocess
+import unittest
+import zlib
+
+import frame_proto
+from frame_proto import FrameDecoder, FLAG_CRC_TRAILER, HEADER_FMT, MAGIC, VERSION, HEADER_LEN
+
+FWCODEC = os.environ.get("FWCODEC")
+
+
+def encode_frame(payload, seq=0, fmt=0, flags=0, width=320, height=240, ts=0):
+    """ Frame as the firmware sends it - header, payload, CRC trailer if flagged """
+    pcrc = 0 if flags & FLAG_CRC_TRAILER else zlib.crc32(payload)
+    header = struct.pack(HEADER_FMT[:-1], MAGIC, VERSION, HEADER_LEN, fmt, flags,
+                         width, height, seq, ts, len(payload), pcrc)
+    header += struct.pack("<I", zlib.crc32(header))
+    trailer = struct.pack("<I", zlib.crc32(payload)) if flags & FLAG_CRC_TRAILER else b""
+    return header + payload + trailer
+
+
+def encode_ack(op, status, payload=b""):
+    """ Ack as cmd.c sends it """
+    msg = frame_proto.ACK_MAGIC + struct.pack("<BBH", op, status, len(payload)) + payload
+    return msg + struct.pack("<I", zlib.crc32(msg))
+
+
+def random_bytes(rng, n):
+    return bytes(rng.getrandbits(8) for _ in range(n))
+
+
+class FrameDecoderTest(unittest.TestCase):
+    def test_frames_round_trip(self):
+        rng = random.Random(1)
+        sent = [(random_bytes(rng, rng.randrange(3000)), seq, seq % 5, FLAG_CRC_TRAILER * (seq % 2))
+                for seq in range(20)]
+        stream = b"".join(encode_frame(p, seq=s, fmt=f, flags=fl, ts=s * 1000) for p, s, f, fl in sent)
+
+        dec = FrameDecoder()
+        frames = []
+        pos = 0
+        while pos < len(stream):
+            n = rng.randrange(1, 700)
+            frames += dec.feed(stream[pos:pos + n])
+            pos += n
+
+        self.assertEqual(len(frames), len(sent))
+        for frame, (payload, seq, fmt, flags) in zip(frames, sent):
+            self.assertEqual(frame.payload, payload)
+            self.assertEqual((frame.seq, frame.format, frame.flags, frame.timestamp_us),
+                             (seq, fmt, flags, seq * 1000))
+            self.assertEqual((frame.width, frame.height), (320, 240))
+        self.assertEqual(dec.crc_errors, 0)
+        self.assertEqual(dec.lost_frames, 0)
+
+    def test_resync_after_damage(self):
+        rng = random.Random(2)
+        stream = b""
+        expected = []
+        for seq in range(60):
+            payload = random_bytes(rng, rng.randrange(1, 2000))
+            wire = bytearray(encode_frame(payload, seq=seq, flags=FLAG_CRC_TRAILER * (seq % 3 == 0)))
+            damage = seq % 6
+            if damage == 1:
+                del wire[rng.randrange(len(wire))]
+            elif damage == 2:
+                wire[rng.randrange(len(wire))] ^= rng.randrange(1, 256)
+            else:
+                if damage == 3:
+                    stream += random_bytes(rng, 10) + MAGIC + random_bytes(rng, 30)
+                expected.append((seq, payload))
+            stream += wire
+
+        frames = FrameDecoder().feed(stream)
+        self.assertEqual([(f.seq, f.payload) for f in frames], expected)
+
+    def test_marker_in_payload(self):
+        payload = b"xx" + MAGIC + bytes(100) + MAGIC
+        frames = FrameDecoder().feed(encode_frame(payload) + encode_frame(payload, seq=1))
+        self.assertEqual([f.payload for f in frames], [payload, payload])
+
+    def test_lost_frames_counted(self):
+        dec = FrameDecoder()
+        dec.feed(b"".join(encode_frame(b"abc", seq=s) for s in (0, 1, 4, 5)))
+        self.assertEqual(dec.frames, 4)
+        self.assertEqual(dec.lost_frames, 2)
+
+    def test_acks_between_frames(self):
+        dec = FrameDecoder()
+        stream = (encode_frame(b"one") + encode_ack(frame_proto.CMD_PING, 0)
+                  + b"junk" + encode_ack(frame_proto.CMD_REG_READ, 0, b"\x12")
+                  + encode_frame(b"two", seq=1))
+        frames = dec.feed(stream)
+        self.assertEqual([f.payload for f in frames], [b"one", b"two"])
+        self.assertEqual([(a.op, a.ok, a.payload) for a in dec.acks],
+                         [(frame_proto.CMD_PING, True, b""), (frame_proto.CMD_REG_READ, True, b"\x12")])
+
+    @unittest.skipUnless(FWCODEC, "FWCODEC not set")
+    def test_firmware_encoder(self):
+        rng = random.Random(3)
+        for flags in (0, FLAG_CRC_TRAILER):
+            payload = random_bytes(rng, 5000)
+            args = [FWCODEC, "frame", "1", str(flags), "320", "240", "1234567", "89"]
+            wire = subprocess.run(args, input=payload, stdout=subprocess.PIPE, check=True).stdout
+            self.assertEqual(wire, encode_frame(payload, seq=1234567, fmt=1, flags=flags, ts=89))
+
+            frames = FrameDecoder().feed(wire)
+            self.assertEqual(len(frames), 1)
+            self.assertEqual(frames[0].payload, payload)
+
+
+class CommandTest(unittest.TestCase):
+    def check_command(self, msg, op, payload):
+        self.assertEqual(msg[:2], bytes([frame_proto.CMD_SYNC, op]))
+        self.assertEqual(msg[2:-4], payload)
+        self.assertEqual(struct.unpack("<I", msg[-4:])[0], zlib.crc32(msg[:-4]))
+
+    def test_encoders(self):
+        self.check_command(frame_proto.encode_credit(0x12345678), frame_proto.CMD_CREDIT, b"\x78\x56\x34\x12")
+        self.check_command(frame_proto.encode_ping(), frame_proto.CMD_PING, b"")
+        self.check_command(frame_proto.encode_capture(3), frame_proto.CMD_CAPTURE, b"\x03\x00")
+        self.check_command(frame_proto.encode_stream(True), frame_proto.CMD_STREAM, b"\x01")
+        self.check_command(frame_proto.encode_format("bayer", 640, 480, 2), frame_proto.CMD_FORMAT,
+                           struct.pack("<BHHB", 4, 640, 480, 2))
+        self.check_command(frame_proto.encode_reg_read(0x12), frame_proto.CMD_REG_READ, b"\x12")
+        self.check_command(frame_proto.encode_reg_write(0x12, 0x80), frame_proto.CMD_REG_WRITE, b"\x12\x80")
+        self.check_command(frame_proto.encode_stats(), frame_proto.CMD_STATS, b"")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,142 @@
+"""
+Tests for qoi16.py - the host decoder for qoi16.h.
+
+Each op is checked on hand-made input. With FWCODEC set (see
+test_frame_proto.py), images coded in bands by the firmware's qoi16.c
+must decode bit-exact, both through Qoi16Decoder and as a chunked
+frame through FrameDecoder.
+"""
+
+import os
+import random
+import struct
+import subprocess
+import unittest
+import zlib
+
+import qoi16
+from frame_proto import (FrameDecoder, CHUNK_STORED, FLAG_CHUNKED, FLAG_CRC_TRAILER, FLAG_QOI16,
+                         HEADER_FMT, HEADER_LEN, MAGIC, VERSION)
+
+FWCODEC = os.environ.get("FWCODEC")
+
+WIDTH = 320
+HEIGHT = 240
+
+
+def pixels(*px):
+    return struct.pack(f"<{len(px)}H", *px)
+
+
+def rgb(r, g, b):
+    return (r << 11) | (g << 5) | b
+
+
+def test_image(kind, rng):
+    """ Same kinds as code/host/tests/test_qoi16.cpp """
+    px = []
+    for y in range(HEIGHT):
+        for x in range(WIDTH):
+            if kind == 0:
+                p = (x // 100) * 0x1234 + (y // 80) * 0x0841
+            elif kind == 1:
+                p = rgb(x * 31 // WIDTH, (y * 63 // HEIGHT) ^ rng.getrandbits(1), (x + y) & 0x1F)
+            elif kind == 2:
+                p = 0x1111 * rng.randrange(6)
+            elif kind == 3:
+                p = rng.getrandbits(16)
+            else:
+                p = (((128 + y // 4) if x & 1 else (128 - x // 8)) << 8) | ((x * 2 + y) & 0xFF)
+            px.append(p & 0xFFFF)
+    return pixels(*px)
+
+
+def split_chunks(wire):
+    """ (stored, data) for each chunk of a chunked payload, without the empty one """
+    chunks = []
+    pos = 0
+    while True:
+        (n,) = struct.unpack_from("<H", wire, pos)
+        data = wire[pos + 2:pos + 2 + (n & ~CHUNK_STORED)]
+        pos += 2 + len(data)
+        if not data:
+            return chunks
+        chunks.append((bool(n & CHUNK_STORED), data))
+
+
+class OpTest(unittest.TestCase):
+    def test_literal(self):
+        self.assertEqual(qoi16.decode(bytes([qoi16.OP_LITERAL, 0x34, 0x12])), pixels(0x1234))
+
+    def test_run(self):
+        # previous pixel starts at 0
+        self.assertEqual(qoi16.decode(bytes([qoi16.OP_RUN | 4])), pixels(*[0] * 5))
+        self.assertEqual(qoi16.decode(bytes([qoi16.OP_LITERAL, 0x34, 0x12, qoi16.OP_RUN | 61])),
+                         pixels(*[0x1234] * 63))
+
+    def test_diff_wraps_per_field(self):
+        # dr -2, dg +1, db -1, from 0 - each field wraps on its own width
+        op = qoi16.OP_DIFF | (0 << 4) | (3 << 2) | 1
+        self.assertEqual(qoi16.decode(bytes([op])), pixels(rgb(30, 1, 31)))
+
+    def test_luma(self):
+        # dg +10, dr - dg = -3, db - dg = +5
+        start = rgb(10, 20, 5)
+        op = bytes([qoi16.OP_LITERAL, start & 0xFF, start >> 8, qoi16.OP_LUMA | (10 + 32), ((-3 + 8) << 4) | (5 + 8)])
+        self.assertEqual(qoi16.decode(op), pixels(start, rgb(17, 30, 20)))
+
+    def test_index(self):
+        a, b = rgb(1, 2, 3), rgb(20, 40, 10)
+        slot = (1 * 3 + 2 * 5 + 3 * 7) % 64
+        ops = bytes([qoi16.OP_LITERAL, a & 0xFF, a >> 8, qoi16.OP_LITERAL, b & 0xFF, b >> 8, slot])
+        self.assertEqual(qoi16.decode(ops), pixels(a, b, a))
+
+    def test_state_carries_across_chunks(self):
+        dec = qoi16.Qoi16Decoder()
+        self.assertEqual(dec.decode(bytes([qoi16.OP_LITERAL, 0x34, 0x12])), pixels(0x1234))
+        self.assertEqual(dec.decode(bytes([qoi16.OP_RUN | 1])), pixels(0x1234, 0x1234))
+
+
+@unittest.skipUnless(FWCODEC, "FWCODEC not set")
+class FirmwareEncoderTest(unittest.TestCase):
+    def encode(self, img, band_bytes):
+        args = [FWCODEC, "qoi16", str(band_bytes)]
+        return subprocess.run(args, input=img, stdout=subprocess.PIPE, check=True).stdout
+
+    def test_images(self):
+        rng = random.Random(12)
+        for kind in range(5):
+            img = test_image(kind, rng)
+            for band_lines in (1, 16):
+                with self.subTest(kind=kind, band_lines=band_lines):
+                    wire = self.encode(img, WIDTH * band_lines * 2)
+                    dec = qoi16.Qoi16Decoder()
+                    out = bytearray()
+                    for stored, data in split_chunks(wire):
+                        if stored:
+                            out += data
+                            dec.reset()
+                        else:
+                            out += dec.decode(data)
+                    self.assertEqual(bytes(out), img)
+
+    def test_chunked_frame(self):
+        rng = random.Random(13)
+        # noise in the middle so some bands are stored and the decoder resets
+        img = test_image(1, rng)[:60000] + test_image(3, rng)[:40000] + test_image(1, rng)[:53600]
+        wire = self.encode(img, WIDTH * 16 * 2)
+
+        flags = FLAG_CRC_TRAILER | FLAG_CHUNKED | FLAG_QOI16
+        header = struct.pack(HEADER_FMT[:-1], MAGIC, VERSION, HEADER_LEN, 1, flags,
+                             WIDTH, HEIGHT, 7, 0, len(img), 0)
+        header += struct.pack("<I", zlib.crc32(header))
+        stream = header + wire + struct.pack("<I", zlib.crc32(wire))
+
+        self.assertTrue(any(stored for stored, _ in split_chunks(wire)))
+        frames = FrameDecoder().feed(stream)
+        self.assertEqual(len(frames), 1)
+        self.assertEqual(frames[0].payload, img)
+
+
+if __name__ == "__main__":
+    unittest.main()
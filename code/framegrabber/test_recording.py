@@ -0,0 +1,136 @@
+"""
+Tests for recording.py - the recording container.
+
+Frames written with RecordingWriter must read back unchanged through
+Recording, in any batch size. A recording cut off mid-write - index
+short, index entry past the data, last record torn - must give every
+whole record and nothing else, and rebuild the index.
+"""
+
+import os
+import shutil
+import tempfile
+import unittest
+
+import numpy as np
+
+from frame_proto import Frame
+from recording import (Recording, RecordingWriter, FILE_HEADER_LEN, INDEX_DTYPE,
+                       INDEX_SUFFIX, RECORD_LEN)
+
+
+def make_frames(count, seed=17):
+    """ count frames of varied formats and sizes - odd payload lengths
+        too, so the padding is used """
+    rng = np.random.default_rng(seed)
+    frames = []
+    for n in range(count):
+        width, height = int(rng.integers(1, 64)), int(rng.integers(1, 48))
+        size = width * height * (1 if n % 3 == 2 else 2) + n % 5
+        payload = rng.integers(0, 256, size, dtype=np.uint8).tobytes()
+        frames.append(Frame(n % 5, n % 4, width, height, 3 * n + 1, 100000 * n, payload))
+    return frames
+
+
+class RecordingTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, "capture.ovr")
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def write(self, frames, batch_bytes=4 << 20):
+        with RecordingWriter(self.path, batch_bytes) as w:
+            for f in frames:
+                w.write(f)
+
+    def assert_frames(self, rec, frames):
+        self.assertEqual(len(rec), len(frames))
+        for n, want in enumerate(frames):
+            got = rec[n]
+            self.assertEqual((got.format, got.flags, got.width, got.height, got.seq, got.timestamp_us),
+                             (want.format, want.flags, want.width, want.height, want.seq, want.timestamp_us))
+            self.assertEqual(bytes(got.payload), want.payload)
+            del got     # the map can't close while a payload view is alive
+
+    def test_round_trip(self):
+        frames = make_frames(60)
+        for batch_bytes in (1, 5000, 4 << 20):
+            with self.subTest(batch_bytes=batch_bytes):
+                self.write(frames, batch_bytes)
+                with Recording(self.path) as rec:
+                    self.assert_frames(rec, frames)
+                    self.assertEqual(rec.find_seq(frames[42].seq), 42)
+                    self.assertIsNone(rec.find_seq(2))
+                    self.assertEqual(sum(1 for f in rec), len(frames))
+
+    def test_index(self):
+        frames = make_frames(30)
+        self.write(frames)
+        index = np.fromfile(self.path + INDEX_SUFFIX, INDEX_DTYPE)
+        self.assertEqual(len(index), len(frames))
+        self.assertEqual(index["offset"][0], FILE_HEADER_LEN)
+        self.assertTrue((index["offset"] % 8 == 0).all())
+        self.assertEqual(list(index["seq"]), [f.seq for f in frames])
+        self.assertEqual(os.path.getsize(self.path) - index["offset"][-1],
+                         RECORD_LEN + (len(frames[-1].payload) + 7) // 8 * 8)
+
+    def test_not_a_recording(self):
+        with open(self.path, "wb") as f:
+            f.write(bytes(FILE_HEADER_LEN + 100))
+        with self.assertRaises(ValueError):
+            Recording(self.path)
+
+    def test_index_missing(self):
+        frames = make_frames(20)
+        self.write(frames)
+        os.remove(self.path + INDEX_SUFFIX)
+        with Recording(self.path) as rec:
+            self.assert_frames(rec, frames)
+        # the rebuilt index is written back
+        self.assertEqual(len(np.fromfile(self.path + INDEX_SUFFIX, INDEX_DTYPE)), len(frames))
+
+    def test_index_short(self):
+        frames = make_frames(20)
+        self.write(frames)
+        entry = INDEX_DTYPE.itemsize
+        with open(self.path + INDEX_SUFFIX, "r+b") as f:
+            f.truncate(12 * entry + 5)      # part of an entry too
+        with Recording(self.path) as rec:
+            self.assert_frames(rec, frames)
+
+    def test_cut_off(self):
+        frames = make_frames(20)
+        self.write(frames)
+        index = np.fromfile(self.path + INDEX_SUFFIX, INDEX_DTYPE)
+        size = os.path.getsize(self.path)
+
+        # cut inside each of the last records - at its header, in its
+        # payload and just before its end
+        for n in range(len(frames) - 3, len(frames)):
+            start = int(index["offset"][n])
+            end = int(index["offset"][n + 1]) if n + 1 < len(frames) else size
+            for cut in (start + 3, start + RECORD_LEN + 1, end - 1):
+                with self.subTest(frame=n, cut=cut):
+                    self.write(frames)
+                    with open(self.path, "r+b") as f:
+                        f.truncate(cut)
+                    with Recording(self.path) as rec:
+                        self.assert_frames(rec, frames[:n])
+
+    def test_cut_off_index_short(self):
+        # data flushed further than the index, then cut in a record
+        frames = make_frames(20)
+        self.write(frames)
+        index = np.fromfile(self.path + INDEX_SUFFIX, INDEX_DTYPE)
+        with open(self.path, "r+b") as f:
+            f.truncate(int(index["offset"][15]) + RECORD_LEN + 2)
+        with open(self.path + INDEX_SUFFIX, "r+b") as f:
+            f.truncate(8 * INDEX_DTYPE.itemsize)
+        with Recording(self.path) as rec:
+            self.assert_frames(rec, frames[:15])
+
+
+if __name__ == "__main__":
+    unittest.main()
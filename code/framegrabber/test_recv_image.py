@@ -0,0 +1,220 @@
+"""
+Tests for the frame conversions in recv_image.py.
+
+With OVCONVERT set to the ovconvert tool from code/host/tests (ctest
+does this), the host library must give bit-exact the same pixels as
+the numpy functions and FrameConverter, with every kernel the CPU
+has.
+
+Continuous mode (run_continuous) is run against a simulated serial
+port that delivers frames at the link's byte rate in real time, into
+a driver buffer of fixed size. Every frame must reach the sinks, the
+converted ones exactly as yuv422_to_rgb888 gives them, and the
+buffer must never fill - also with a sink too slow for the frame
+rate, which may only cost its own frames. It prints the frames per
+second against what the link carries and the buffer high-water mark.
+"""
+
+import os
+import subprocess
+import sys
+import threading
+import time
+import types
+import unittest
+
+import numpy as np
+
+# recv_image.py imports these at the top but converting doesn't use them
+for name in ("serial", "cv2", "PIL", "PIL.Image"):
+    if name not in sys.modules:
+        try:
+            __import__(name)
+        except ImportError:
+            sys.modules[name] = types.ModuleType(name)
+sys.modules["PIL"].Image = sys.modules["PIL.Image"]
+
+import recv_image                   # noqa: E402
+from frame_proto import Frame       # noqa: E402
+from test_frame_proto import encode_frame   # noqa: E402
+
+OVCONVERT = os.environ.get("OVCONVERT")
+
+ISAS = ("scalar", "sse2", "avx2")
+
+
+def host_convert(fmt, payload, width, height, flip, isa, layout="rgb"):
+    """ ovconvert output as an (height, width, 3 or 4) array - None if isa isn't supported """
+    args = [OVCONVERT, fmt, str(width), str(height), layout, str(int(flip)), isa]
+    res = subprocess.run(args, input=payload, stdout=subprocess.PIPE)
+    if res.returncode == 3:
+        return None
+    if res.returncode:
+        raise RuntimeError(f"ovconvert failed: {res.returncode}")
+    return np.frombuffer(res.stdout, np.uint8).reshape(height, width, 4 if layout == "rgba" else 3)
+
+
+@unittest.skipUnless(OVCONVERT, "OVCONVERT not set")
+class HostLibraryTest(unittest.TestCase):
+    def check(self, fmt, payload, width, height, want, flip=True, with_rgba=True):
+        for isa in ISAS:
+            with self.subTest(fmt=fmt, width=width, isa=isa):
+                got = host_convert(fmt, payload, width, height, flip, isa)
+                if got is None:
+                    continue
+                np.testing.assert_array_equal(got, want)
+                if not with_rgba:
+                    continue
+
+                rgba = host_convert(fmt, payload, width, height, flip, isa, "rgba")
+                np.testing.assert_array_equal(rgba[:, :, :3], want)
+                self.assertTrue((rgba[:, :, 3] == 255).all())
+
+    def test_yuv422_every_value(self):
+        # each row one U/V pair, with Y 0..255 along it
+        uv = np.arange(65536)
+        y = np.arange(256)
+        frame = np.empty((65536, 512), np.uint8)
+        frame[:, 0::2] = y
+        frame[:, 1::4] = (uv >> 8)[:, None]
+        frame[:, 3::4] = (uv & 0xFF)[:, None]
+        payload = frame.tobytes()
+        self.check("yuv422", payload, 256, 65536, recv_image.yuv422_to_rgb888(payload, 256, 65536),
+                   with_rgba=False)
+
+    def test_rgb565_every_value(self):
+        payload = np.arange(65536, dtype="<u2").tobytes()
+        self.check("rgb565", payload, 256, 256, recv_image.rgb565_to_rgb888(payload, 256, 256))
+
+    def test_frame_sizes(self):
+        rng = np.random.default_rng(15)
+        for width, height in ((2, 1), (6, 3), (30, 7), (66, 5), (320, 240), (640, 480)):
+            payload = rng.integers(0, 256, width * height * 2, dtype=np.uint8).tobytes()
+            self.check("yuv422", payload, width, height, recv_image.yuv422_to_rgb888(payload, width, height))
+            self.check("rgb565", payload, width, height, recv_image.rgb565_to_rgb888(payload, width, height))
+            y8 = payload[:width * height]
+            self.check("y8", y8, width, height, recv_image.y8_to_grayscale(y8, width, height), flip=False)
+
+            # FrameConverter must give the same as the functions
+            conv = recv_image.FrameConverter()
+            out = np.empty((height, width, 3), np.uint8)
+            for fmt, name in ((0, "yuv422"), (1, "rgb565")):
+                self.assertTrue(conv.convert(Frame(fmt, 0, width, height, 0, 0, payload), out))
+                self.check(name, payload, width, height, out)
+
+
+class SimSerial:
+    """ A serial port receiving wire at baud / 10 bytes per second from
+        when it is opened. As in Linux, in_waiting is what N_TTY holds,
+        at most read_buffer bytes - past that, bytes wait in the tty
+        flip buffers, and past flip_buffer more the driver drops them.
+        Reading past the end is Ctrl-C, which ends run_continuous. """
+
+    def __init__(self, wire, baud, read_buffer, flip_buffer):
+        self.wire = wire
+        self.rate = baud / 10
+        self.read_buffer = read_buffer
+        self.buffer_size = read_buffer + flip_buffer
+        self.pos = 0
+        self.lost = 0
+        self.peak = 0           # most bytes waiting, in N_TTY and the flip buffers
+        self.timeout = None
+        self.written = b""
+        self.start = time.monotonic()
+
+    def _arrived(self):
+        n = min(len(self.wire), int((time.monotonic() - self.start) * self.rate))
+        # bytes past full buffers are gone, as the driver would drop them
+        if n - self.pos > self.buffer_size:
+            self.lost += n - self.pos - self.buffer_size
+            self.pos = n - self.buffer_size
+        self.peak = max(self.peak, n - self.pos)
+        return n
+
+    @property
+    def in_waiting(self):
+        return min(self._arrived() - self.pos, self.read_buffer)
+
+    def readinto(self, view):
+        if self.pos == len(self.wire):
+            raise KeyboardInterrupt
+        n = self._arrived()
+        if n == self.pos:
+            time.sleep((self.pos + 1) / self.rate - (time.monotonic() - self.start))
+            n = self._arrived()
+        n = min(n - self.pos, len(view))
+        view[:n] = self.wire[self.pos:self.pos + n]
+        self.pos += n
+        return n
+
+    def write(self, data):
+        self.written += data
+
+
+class CheckSink:
+    """ Keeps what it is given, taking delay seconds a frame """
+
+    needs_rgb = True
+
+    def __init__(self, delay=0):
+        self.delay = delay
+        self.frames = []
+        self.closed = threading.Event()
+
+    def write(self, frame, rgb):
+        self.frames.append((frame.seq, frame.payload, rgb.copy()))
+        time.sleep(self.delay)
+
+    def close(self):
+        self.closed.set()
+
+
+class ContinuousTest(unittest.TestCase):
+    BAUD = 3000000
+    READ_BUFFER = 4096      # N_TTY's
+    FLIP_BUFFER = 65536     # the tty layer's limit for a port
+    WIDTH, HEIGHT = 160, 120
+    FRAMES = 20
+
+    def setUp(self):
+        rng = np.random.default_rng(16)
+        self.payloads = [rng.integers(0, 256, self.WIDTH * self.HEIGHT * 2, dtype=np.uint8).tobytes()
+                         for _ in range(self.FRAMES)]
+        self.wire = b"".join(encode_frame(p, seq=seq, width=self.WIDTH, height=self.HEIGHT)
+                             for seq, p in enumerate(self.payloads))
+        self.link_fps = self.BAUD / 10 * self.FRAMES / len(self.wire)
+
+    def run_sinks(self, sinks):
+        ser = SimSerial(self.wire, self.BAUD, self.READ_BUFFER, self.FLIP_BUFFER)
+        frames, elapsed, high_water = recv_image.run_continuous(ser, sinks, False, 0)
+        fps = frames / elapsed
+        print(f"{len(sinks)} sink(s): {fps:.2f} fps of the link's {self.link_fps:.2f}, "
+              f"serial buffer high water {high_water} of {self.READ_BUFFER} bytes "
+              f"({ser.peak} waiting at most), "
+              f"{[len(s.frames) for s in sinks]} frames at the sinks")
+
+        self.assertEqual(ser.lost, 0)
+        self.assertEqual(frames, self.FRAMES)
+        self.assertGreater(fps, 0.9 * self.link_fps)
+        for sink in sinks:
+            self.assertTrue(sink.closed.is_set())
+            for seq, payload, rgb in sink.frames:
+                self.assertEqual(payload, self.payloads[seq])
+                np.testing.assert_array_equal(
+                    rgb, recv_image.yuv422_to_rgb888(payload, self.WIDTH, self.HEIGHT))
+
+    def test_every_frame(self):
+        sink = CheckSink()
+        self.run_sinks([sink])
+        self.assertEqual([seq for seq, _, _ in sink.frames], list(range(self.FRAMES)))
+
+    def test_slow_sink(self):
+        # three frame times a frame - it gets some, the read loop keeps up
+        sink = CheckSink(3 / self.link_fps)
+        self.run_sinks([sink])
+        self.assertGreater(len(sink.frames), 0)
+        self.assertLess(len(sink.frames), self.FRAMES)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,206 @@
+/*
+    Inter-frame delta coding of 16x16 tiles - see tile_delta.h.
+*/
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "tile_delta.h"
+#include "frame_proto.h"
+
+#define BLOCK_SIZE 4
+#define BLOCKS_PER_TILE ((TILE_SIZE / BLOCK_SIZE) * (TILE_SIZE / BLOCK_SIZE))
+
+// signature of every tile as last sent
+static uint16_t tile_sig[TILE_MAX][BLOCKS_PER_TILE];
+
+static uint8_t dirty[(TILE_MAX + 7) / 8];
+
+// dirty tiles of one tile row - one being filled while the other is sent
+static uint8_t staging[2][(IMAGE_WIDTH / TILE_SIZE) * TILE_SIZE * TILE_SIZE * 2];
+
+static uint16_t frame_width;
+static uint16_t frame_height;
+static uint bpp;
+static uint tiles_x;
+static uint tiles_y;
+static uint32_t block_threshold;
+static uint keyframe_every;
+static uint frames_since_key;
+static uint8_t prev_seq[4];     // of the frame sent last, as a delta refers to it
+
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+static uint8_t trailer[4];
+
+static uint64_t total_wire;
+static uint64_t total_raw;
+static tile_delta_stats_t stats;
+
+bool tile_delta_init(uint16_t width, uint16_t height, uint bytes_per_pixel,
+                     uint threshold, uint keyframe_interval)
+{
+    if (width % TILE_SIZE || height % TILE_SIZE || width > IMAGE_WIDTH ||
+        height > IMAGE_HEIGHT || bytes_per_pixel < 1 || bytes_per_pixel > 2) {
+        return false;
+    }
+
+    frame_width = width;
+    frame_height = height;
+    bpp = bytes_per_pixel;
+    tiles_x = width / TILE_SIZE;
+    tiles_y = height / TILE_SIZE;
+    block_threshold = threshold * BLOCK_SIZE * BLOCK_SIZE * bpp;
+    keyframe_every = keyframe_interval;
+
+    // first frame is a keyframe
+    frames_since_key = keyframe_interval;
+    total_wire = total_raw = 0;
+    stats = (tile_delta_stats_t){0};
+    stats.tiles_total = tiles_x * tiles_y;
+    return true;
+}
+
+// Block sums of the tile at tx, ty
+static void tile_signature(const uint8_t* frame, uint tx, uint ty, uint16_t* sig)
+{
+    uint stride = frame_width * bpp;
+    uint block_bytes = BLOCK_SIZE * bpp;
+    const uint8_t* tile = frame + ty * TILE_SIZE * stride + tx * TILE_SIZE * bpp;
+
+    for (uint by = 0; by < TILE_SIZE / BLOCK_SIZE; by++) {
+        for (uint bx = 0; bx < TILE_SIZE / BLOCK_SIZE; bx++) {
+            const uint8_t* p = tile + by * BLOCK_SIZE * stride + bx * block_bytes;
+            uint32_t sum = 0;
+            for (uint r = 0; r < BLOCK_SIZE; r++) {
+                for (uint c = 0; c < block_bytes; c++) {
+                    sum += p[c];
+                }
+                p += stride;
+            }
+            *sig++ = sum;
+        }
+    }
+}
+
+// Mark tiles that moved past the threshold, refreshing their signatures 
+// as they will be sent. Returns the number of dirty tiles.
+static uint tile_delta_diff(const uint8_t* frame, bool key)
+{
+    uint count = 0;
+    memset(dirty, 0, sizeof(dirty));
+
+    for (uint ty = 0; ty < tiles_y; ty++) {
+        for (uint tx = 0; tx < tiles_x; tx++) {
+            uint i = ty * tiles_x + tx;
+            uint16_t sig[BLOCKS_PER_TILE];
+            tile_signature(frame, tx, ty, sig);
+
+            bool changed = key;
+            for (int b = 0; b < BLOCKS_PER_TILE && !changed; b++) {
+                int32_t d = (int32_t)sig[b] - tile_sig[i][b];
+                changed = (uint32_t)(d < 0 ? -d : d) > block_threshold;
+            }
+            if (changed) {
+                memcpy(tile_sig[i], sig, sizeof(sig));
+                dirty[i / 8] |= 1 << (i % 8);
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static void tile_delta_send_key(transport_t* t, const frame_desc_t* frame)
+{
+    frame_proto_encode_header(header, frame, frame_width, frame_height, 0);
+    transport_send(t, header, sizeof(header));
+    transport_send(t, frame->data, frame->size);
+
+    stats.keyframes++;
+    stats.wire_bytes = frame->size;
+}
+
+static void tile_delta_send_tiles(transport_t* t, const frame_desc_t* frame, uint count)
+{
+    uint stride = frame_width * bpp;
+    uint tile_line = TILE_SIZE * bpp;
+    uint bitmap_len = (tiles_x * tiles_y + 7) / 8;
+
+    frame_desc_t desc = *frame;
+    desc.size = sizeof(prev_seq) + bitmap_len + count * TILE_SIZE * tile_line;
+    frame_proto_encode_header(header, &desc, frame_width, frame_height,
+                              FRAME_FLAG_CRC_TRAILER | FRAME_FLAG_TILES);
+    transport_send(t, header, sizeof(header));
+    transport_send(t, prev_seq, sizeof(prev_seq));
+    transport_send(t, dirty, bitmap_len);
+    uint32_t crc = crc32_update(0, prev_seq, sizeof(prev_seq));
+    crc = crc32_update(crc, dirty, bitmap_len);
+
+    // gather the dirty tiles of each tile row, sending the previous row meanwhile
+    int cur = 0;
+    for (uint ty = 0; ty < tiles_y; ty++) {
+        uint8_t* out = staging[cur];
+        for (uint tx = 0; tx < tiles_x; tx++) {
+            uint i = ty * tiles_x + tx;
+            if (!(dirty[i / 8] & (1 << (i % 8)))) {
+                continue;
+            }
+            const uint8_t* p = frame->data + ty * TILE_SIZE * stride + tx * tile_line;
+            for (uint r = 0; r < TILE_SIZE; r++) {
+                memcpy(out, p, tile_line);
+                out += tile_line;
+                p += stride;
+            }
+        }
+
+        size_t len = out - staging[cur];
+        if (len) {
+            crc = crc32_update(crc, staging[cur], len);
+            while (transport_is_busy(t));
+            transport_send_async(t, staging[cur], len);
+            cur ^= 1;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (crc >> (8 * i)) & 0xFF;
+    }
+    transport_send(t, trailer, sizeof(trailer));
+
+    stats.wire_bytes = desc.size + sizeof(trailer);
+}
+
+void tile_delta_send(transport_t* t, const frame_desc_t* frame)
+{
+    bool key = ++frames_since_key >= keyframe_every;
+
+    uint32_t t0 = time_us_32();
+    uint count = tile_delta_diff(frame->data, key);
+    stats.diff_us = time_us_32() - t0;
+    if (stats.diff_us > stats.diff_max_us) {
+        stats.diff_max_us = stats.diff_us;
+    }
+
+    if (count == tiles_x * tiles_y) {
+        tile_delta_send_key(t, frame);
+        frames_since_key = 0;
+    } else {
+        tile_delta_send_tiles(t, frame, count);
+    }
+    for (int i = 0; i < 4; i++) {
+        prev_seq[i] = (frame->seq >> (8 * i)) & 0xFF;
+    }
+
+    stats.frames_sent++;
+    stats.tiles_sent = count;
+    stats.raw_bytes = frame->size;
+    total_wire += stats.wire_bytes;
+    total_raw += frame->size;
+    stats.saved_pct = (int32_t)(((int64_t)total_raw - (int64_t)total_wire) * 100 / (int64_t)total_raw);
+}
+
+void tile_delta_get_stats(tile_delta_stats_t* out)
+{
+    *out = stats;
+}
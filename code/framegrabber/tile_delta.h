@@ -0,0 +1,70 @@
+/*
+
+    tile_delta.h 
+
+    Inter-frame delta coding - only the 16x16 tiles that changed 
+    since they were last sent go out.
+
+    Each tile keeps a signature of 16 sums, one per 4x4 pixel block, 
+    taken when the tile was last sent. A tile is dirty when any block 
+    sum has moved by more than threshold per byte. Comparing against 
+    the last sent version rather than the last frame means slow drift 
+    is caught too. This costs 32 bytes per tile instead of a 
+    reference frame.
+
+    Delta frames have FRAME_FLAG_TILES set. The payload is the 
+    sequence number of the frame sent before it (u32), a bitmap of 
+    dirty tiles (1 bit per tile, row-major, LSB first), then the dirty 
+    tiles in the same order, each TILE_SIZE lines of TILE_SIZE pixels. 
+    Every keyframe_interval frames, and whenever every tile is dirty, 
+    a normal full frame (keyframe) is sent instead. The host rebuilds 
+    frames from the last keyframe (tile_delta.py).
+
+    Sequence numbers count captured frames, so there are gaps between 
+    frames sent whenever capture runs ahead of the link. A delta only 
+    applies on top of the frame named in its payload - that is what 
+    the host checks to find a lost frame, not the gap.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_ring.h"
+#include "transport.h"
+
+#define TILE_SIZE 16
+
+// most tiles - QVGA
+#define TILE_MAX ((IMAGE_WIDTH / TILE_SIZE) * (IMAGE_HEIGHT / TILE_SIZE))
+
+// mean change per byte of a 4x4 block that makes a tile dirty
+#ifndef TILE_DELTA_THRESHOLD
+#define TILE_DELTA_THRESHOLD 4
+#endif
+
+#ifndef TILE_DELTA_KEYFRAME_INTERVAL
+#define TILE_DELTA_KEYFRAME_INTERVAL 30
+#endif
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t keyframes;
+    uint32_t tiles_sent;          // last frame
+    uint32_t tiles_total;         // tiles per frame
+    uint32_t wire_bytes;          // last frame - payload as sent
+    uint32_t raw_bytes;           // last frame - full frame size
+    int32_t saved_pct;            // payload bytes saved over all frames sent - negative if more went out
+    uint32_t diff_us;             // last frame - tile signatures and compare
+    uint32_t diff_max_us;
+} tile_delta_stats_t;
+
+// width and height must be multiples of TILE_SIZE and at most QVGA
+bool tile_delta_init(uint16_t width, uint16_t height, uint bytes_per_pixel,
+                     uint threshold, uint keyframe_interval);
+
+// Send frame (already bit-fixed) as a keyframe or a delta - returns once it is all sent
+void tile_delta_send(transport_t* t, const frame_desc_t* frame);
+
+void tile_delta_get_stats(tile_delta_stats_t* stats);
@@ -0,0 +1,72 @@
+"""
+Host side of the inter-frame tile delta coding - see tile_delta.h.
+
+Keeps the last full frame and patches the changed tiles of each delta
+frame into it. A delta names the frame sent before it - sequence
+numbers count captured frames, so gaps between frames sent are normal.
+"""
+
+import struct
+
+import numpy as np
+
+from frame_proto import FLAG_TILES
+
+TILE_SIZE = 16
+
+
+class TileReconstructor:
+    def __init__(self):
+        self.ref = None         # last full frame, (height, width * bpp) bytes
+        self.key = None         # (format, width, height) of ref
+        self.waiting = True     # need a keyframe before deltas can be applied
+        self.last_seq = None
+        self.deltas = 0
+        self.skipped = 0
+
+    def apply(self, frame):
+        """ Full payload for frame, or None until a keyframe has arrived """
+        key = (frame.format, frame.width, frame.height)
+
+        last_seq = self.last_seq
+        self.last_seq = frame.seq
+
+        if not frame.flags & FLAG_TILES:
+            bpp = len(frame.payload) // (frame.width * frame.height)
+            if not bpp or len(frame.payload) != bpp * frame.width * frame.height:
+                return frame.payload    # compressed - can't be a reference
+            self.ref = np.frombuffer(frame.payload, np.uint8).reshape(
+                frame.height, frame.width * bpp).copy()
+            self.key = key
+            self.waiting = False
+            return frame.payload
+
+        # a lost frame may have carried tiles - wait for the next keyframe
+        (prev_seq,) = struct.unpack_from("<I", frame.payload)
+        if prev_seq != last_seq:
+            self.waiting = True
+
+        if self.waiting or key != self.key:
+            self.skipped += 1
+            return None
+
+        tiles_x = frame.width // TILE_SIZE
+        tiles_y = frame.height // TILE_SIZE
+        tile_line = self.ref.shape[1] // tiles_x
+        bitmap_len = (tiles_x * tiles_y + 7) // 8
+
+        payload = np.frombuffer(frame.payload, np.uint8)[4:]
+        dirty = np.unpackbits(payload[:bitmap_len], bitorder="little")[:tiles_x * tiles_y]
+        tiles = payload[bitmap_len:].reshape(-1, TILE_SIZE, tile_line)
+        if len(tiles) != dirty.sum():
+            self.skipped += 1
+            self.waiting = True
+            return None
+
+        for tile, i in zip(tiles, np.flatnonzero(dirty)):
+            ty, tx = divmod(int(i), tiles_x)
+            self.ref[ty * TILE_SIZE:(ty + 1) * TILE_SIZE,
+                     tx * tile_line:(tx + 1) * tile_line] = tile
+
+        self.deltas += 1
+        return self.ref.tobytes()
@@ -0,0 +1,50 @@
+/*
+
+    transport.h 
+
+    Byte transport used to send frames to the host.
+
+    A transport starts a transfer and returns straight away. done_cb 
+    (if set) is called when the last byte has been handed to the 
+    hardware - on the device that is from an IRQ.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*transport_done_cb_t)(void* user_data);
+
+typedef struct transport transport_t;
+
+struct transport {
+    // start sending len bytes - data must stay valid until done
+    bool (*send_async)(transport_t* t, const uint8_t* data, size_t len);
+    bool (*is_busy)(transport_t* t);
+
+    transport_done_cb_t done_cb;
+    void* user_data;
+
+    uint32_t bytes_sent;
+    uint32_t transfers;
+};
+
+static inline bool transport_send_async(transport_t* t, const uint8_t* data, size_t len)
+{
+    return t->send_async(t, data, len);
+}
+
+static inline bool transport_is_busy(transport_t* t)
+{
+    return t->is_busy(t);
+}
+
+// Send and wait for completion
+static inline void transport_send(transport_t* t, const uint8_t* data, size_t len)
+{
+    while (transport_is_busy(t));
+    transport_send_async(t, data, len);
+    while (transport_is_busy(t));
+}
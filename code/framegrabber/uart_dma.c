@@ -0,0 +1,95 @@
+/*
+    UART transport fed by DMA - see uart_dma.h.
+*/
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+
+#include "uart_dma.h"
+
+typedef struct {
+    transport_t base;
+    uart_inst_t* uart;
+    int dma_chan;
+    volatile bool busy;
+} uart_dma_t;
+
+// only one UART is used for frames
+static uart_dma_t uart_dma;
+
+// DMA IRQ 1 - the transfer has been written to the TX FIFO
+static void uart_dma_irq_handler()
+{
+    if (!dma_channel_get_irq1_status(uart_dma.dma_chan)) {
+        return;
+    }
+    dma_channel_acknowledge_irq1(uart_dma.dma_chan);
+
+    uart_dma.busy = false;
+    if (uart_dma.base.done_cb) {
+        uart_dma.base.done_cb(uart_dma.base.user_data);
+    }
+}
+
+static bool uart_dma_send_async(transport_t* t, const uint8_t* data, size_t len)
+{
+    uart_dma_t* u = (uart_dma_t*)t;
+    if (u->busy) {
+        return false;
+    }
+
+    u->busy = true;
+    t->bytes_sent += len;
+    t->transfers++;
+
+    // read address + trigger
+    dma_channel_set_trans_count(u->dma_chan, len, false);
+    dma_channel_set_read_addr(u->dma_chan, data, true);
+    return true;
+}
+
+static bool uart_dma_is_busy(transport_t* t)
+{
+    return ((uart_dma_t*)t)->busy;
+}
+
+transport_t* uart_dma_init(uart_inst_t* uart, uint baud, uint* actual_baud)
+{
+    uart_dma_t* u = &uart_dma;
+
+    uint baud_set = uart_init(uart, baud);
+    if (actual_baud) {
+        *actual_baud = baud_set;
+    }
+    uart_set_fifo_enabled(uart, true);
+
+    u->uart = uart;
+    u->busy = false;
+    u->base.send_async = uart_dma_send_async;
+    u->base.is_busy = uart_dma_is_busy;
+
+    // byte transfers from memory to the UART data register, paced by TX DREQ
+    u->dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(u->dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+
+    dma_channel_configure(
+        u->dma_chan,
+        &c,
+        &uart_get_hw(uart)->dr,     // Destination: UART data register
+        NULL,                       // Source: set per transfer
+        0,
+        false
+    );
+
+    dma_channel_set_irq1_enabled(u->dma_chan, true);
+    irq_add_shared_handler(DMA_IRQ_1, uart_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    return &u->base;
+}
@@ -0,0 +1,17 @@
+/*
+
+    uart_dma.h 
+
+    UART transport - the TX FIFO is fed by a DMA channel so the CPU 
+    only starts the transfer and gets a callback when it is done.
+*/
+
+#pragma once
+
+#include "hardware/uart.h"
+
+#include "transport.h"
+
+// Init uart at baud and return its transport. Returns the actual 
+// baud rate in actual_baud if not NULL.
+transport_t* uart_dma_init(uart_inst_t* uart, uint baud, uint* actual_baud);
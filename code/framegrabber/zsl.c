@@ -0,0 +1,198 @@
+/*
+    Zero-shutter-lag snapshots - see zsl.h.
+*/
+
+#include <stdatomic.h>
+
+#include "pico/stdlib.h"
+
+#include "zsl.h"
+#include "frame_proto.h"
+#include "bitrev.h"
+#include "event.h"
+
+#define ZSL_NONE (-1)
+
+static frame_desc_t slots[ZSL_SLOTS];
+
+static atomic_uint free_mask;   // bit per slot DMA may fill
+static atomic_int newest;       // slot index or ZSL_NONE
+static atomic_int pinned;
+
+// snapshots asked for by zsl_trigger() - sent by zsl_poll()
+static atomic_uint requested;
+static atomic_uint sent;
+
+// the last trigger, and the last one whose lag was accounted
+static atomic_uint triggers;
+static volatile uint32_t trigger_us;
+static uint triggers_seen;
+
+static uint32_t next_seq;
+
+static transport_t* transport;
+static uint16_t frame_width;
+static uint16_t frame_height;
+
+static uint8_t header[FRAME_PROTO_HEADER_LEN];
+
+static zsl_stats_t stats;
+
+void zsl_init(uint8_t* storage, frame_format_t format, uint32_t size,
+              transport_t* t, uint16_t width, uint16_t height)
+{
+    for (int i = 0; i < ZSL_SLOTS; i++) {
+        slots[i].seq = 0;
+        slots[i].timestamp_us = 0;
+        slots[i].size = size;
+        slots[i].format = format;
+        slots[i].status = FRAME_FREE;
+        slots[i].data = storage + i * size;
+    }
+    atomic_store(&free_mask, (1u << ZSL_SLOTS) - 1);
+    atomic_store(&newest, ZSL_NONE);
+    atomic_store(&pinned, ZSL_NONE);
+    atomic_store(&requested, 0);
+    atomic_store(&sent, 0);
+    atomic_store(&triggers, 0);
+    triggers_seen = 0;
+    next_seq = 0;
+
+    transport = t;
+    frame_width = width;
+    frame_height = height;
+
+    stats = (zsl_stats_t){0};
+    stats.lag_min_us = INT32_MAX;
+    stats.lag_max_us = INT32_MIN;
+}
+
+// Give slot i back to capture - from the DMA IRQ or the main loop
+static inline void zsl_free(int i)
+{
+    slots[i].status = FRAME_FREE;
+    atomic_fetch_or(&free_mask, 1u << i);
+}
+
+// DMA IRQ - a free slot for the frame two ahead, NULL to drop it.
+// Frames are armed in capture order, so the sequence number is given
+// here and a dropped frame still uses one up.
+static uint8_t* zsl_band_dest(uint line, void* ctx)
+{
+    uint m = atomic_load(&free_mask);
+
+    // the main loop only adds bits - retry if it did in between
+    while (m && !atomic_compare_exchange_weak(&free_mask, &m, m & (m - 1)));
+    if (!m) {
+        next_seq++;
+        stats.overruns++;
+        return NULL;
+    }
+
+    frame_desc_t* slot = &slots[__builtin_ctz(m)];
+    slot->seq = next_seq++;
+    slot->status = FRAME_CAPTURING;
+    return slot->data;
+}
+
+// DMA IRQ - frame is complete, it replaces newest
+static void zsl_band_done(uint8_t* dest, uint line, uint nlines, void* ctx)
+{
+    int i = 0;
+    while (slots[i].data != dest) {
+        i++;
+    }
+    slots[i].timestamp_us = time_us_32();
+    slots[i].status = FRAME_READY;
+    stats.captured++;
+
+    int old = atomic_exchange(&newest, i);
+    if (old != ZSL_NONE) {
+        zsl_free(old);
+        stats.recycled++;
+    }
+
+    // only wake the main loop when a snapshot is waiting for a frame
+    if (atomic_load(&requested) != atomic_load(&sent)) {
+        event_post(EVENT_FRAME);
+    }
+}
+
+const ov7670_stream_cb_t zsl_stream_cb = {
+    .band_dest = zsl_band_dest,
+    .band_done = zsl_band_done,
+    .ctx = NULL,
+};
+
+void zsl_trigger(uint frames)
+{
+    if (frames == 0) {
+        return;
+    }
+    trigger_us = time_us_32();
+
+    // pin now rather than when the main loop wakes, so a frame that
+    // completes in between can't take its place
+    if (atomic_load(&pinned) == ZSL_NONE) {
+        int i = atomic_exchange(&newest, ZSL_NONE);
+        if (i != ZSL_NONE) {
+            slots[i].status = FRAME_SENDING;
+            atomic_store(&pinned, i);
+        }
+    }
+
+    atomic_fetch_add(&triggers, 1);
+    atomic_fetch_add(&requested, frames);
+}
+
+// Send the frame in slot - t is the trigger count when it was taken,
+// lag is accounted for the first frame after a trigger
+static void zsl_send(frame_desc_t* slot, uint t)
+{
+    if (t != triggers_seen) {
+        triggers_seen = t;
+        stats.lag_us = (int32_t)(slot->timestamp_us - trigger_us);
+        if (stats.lag_us < stats.lag_min_us) {
+            stats.lag_min_us = stats.lag_us;
+        }
+        if (stats.lag_us > stats.lag_max_us) {
+            stats.lag_max_us = stats.lag_us;
+        }
+    }
+
+    // D0-D7 is connected to GP13-GP6 - so need to reverse bits for each byte
+    bitrev_bytes(slot->data, slot->size);
+
+    frame_proto_encode_header(header, slot, frame_width, frame_height, 0);
+    transport_send(transport, header, sizeof(header));
+    transport_send(transport, slot->data, slot->size);
+    stats.snapshots++;
+}
+
+uint zsl_poll()
+{
+    uint n = 0;
+
+    while (atomic_load(&sent) != atomic_load(&requested)) {
+        uint t = atomic_load(&triggers);
+        int i = atomic_exchange(&pinned, ZSL_NONE);
+        if (i == ZSL_NONE) {
+            i = atomic_exchange(&newest, ZSL_NONE);
+        }
+        if (i == ZSL_NONE) {
+            break;
+        }
+        slots[i].status = FRAME_SENDING;
+        zsl_send(&slots[i], t);
+        zsl_free(i);
+        atomic_fetch_add(&sent, 1);
+        n++;
+    }
+    return n;
+}
+
+void zsl_get_stats(zsl_stats_t* out)
+{
+    *out = stats;
+    out->triggers = atomic_load(&triggers);
+}
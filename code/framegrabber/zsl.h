@@ -0,0 +1,75 @@
+/*
+
+    zsl.h
+
+    Zero-shutter-lag snapshots - capture streams continuously into a
+    small set of slots, and a trigger takes the newest frame that is
+    already complete instead of starting a capture.
+
+    The one-shot path (capture_frame()) only starts after the trigger:
+    it waits for the next VSYNC, then for a whole frame, so the frame
+    sent ends 1 to 2 frame periods after the trigger. Here the frame
+    ended at most one period before it.
+
+    Slots move between three owners without locks:
+
+    free    DMA may fill it - taken by the DMA IRQ when a band is
+            armed, given back by the IRQ or the main loop
+    newest  the latest complete frame - each new frame replaces it,
+            and the one it replaces goes straight back to free
+    pinned  held for a snapshot - the trigger (or the main loop) takes
+            newest, so capture can never overwrite it
+
+    With ZSL_SLOTS 3 and nothing pinned, two slots are armed and one
+    is newest, so no frame is dropped. While a snapshot is being sent
+    only two are left for capture and every other frame is dropped -
+    the main loop never waits on capture, and capture never waits on
+    the link.
+
+    Each frame's timestamp is the time it completed. The lag of a
+    snapshot is its timestamp minus the trigger time: negative when
+    the frame was already complete at the trigger, positive when the
+    trigger had to wait for one (only right after start).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_ring.h"
+#include "ov7670_stream.h"
+#include "transport.h"
+
+// one being sent, one being captured, one armed as the next DMA target
+#define ZSL_SLOTS 3
+
+typedef struct {
+    uint32_t triggers;
+    uint32_t snapshots;     // frames sent
+    uint32_t captured;      // frames completed by DMA
+    uint32_t recycled;      // complete frames replaced by a newer one
+    uint32_t overruns;      // frames dropped - all slots in use
+    int32_t lag_us;         // frame timestamp - trigger, last trigger
+    int32_t lag_min_us;
+    int32_t lag_max_us;
+} zsl_stats_t;
+
+// storage holds ZSL_SLOTS buffers of size bytes. Snapshots are
+// width x height frames in format, sent on t.
+void zsl_init(uint8_t* storage, frame_format_t format, uint32_t size,
+              transport_t* t, uint16_t width, uint16_t height);
+
+// Ask for frames snapshots - the first is the newest complete frame,
+// the rest the frames completed after it. Safe to call from IRQ.
+void zsl_trigger(uint frames);
+
+// Send the snapshots asked for - call from the main loop. Returns
+// the number sent, less than asked for if no frame is complete yet
+// (EVENT_FRAME is posted when one is).
+uint zsl_poll();
+
+void zsl_get_stats(zsl_stats_t* stats);
+
+// Pass to ov7670_stream_start() with whole-frame bands
+extern const ov7670_stream_cb_t zsl_stream_cb;
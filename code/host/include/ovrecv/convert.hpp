@@ -0,0 +1,71 @@
+/*
+
+    convert.hpp
+
+    Frame to RGB888/RGBA8888 conversion into caller-owned buffers.
+
+    The formulas are the ones in recv_image.py, bit for bit:
+
+        RGB565  r = r5 << 3, g = g6 << 2, b = b5 << 3
+        YUV422  C = Y - 16, D = U - 128, E = V - 128
+                R = clip((298 C + 409 E + 128) >> 8)
+                G = clip((298 C - 100 D - 208 E + 128) >> 8)
+                B = clip((298 C + 516 D + 128) >> 8)
+        Y8      R = G = B = Y
+        BAYER   demosaiced, edge-aware - see demosaic()
+
+    With flip set, rows are written bottom-up as they are converted,
+    so there is no separate flip pass. Kernels are scalar, SSE2 and
+    AVX2, picked at run time for the CPU.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ovrecv/frame.hpp"
+
+namespace ovrecv {
+
+enum class Layout {
+    RGB888,     // 3 bytes per pixel
+    RGBA8888,   // 4 bytes per pixel, alpha 255
+};
+
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+constexpr size_t bytes_per_pixel(Layout layout)
+{
+    return layout == Layout::RGB888 ? 3 : 4;
+}
+
+// Convert a width x height frame into dst (width * height * bytes_per_pixel(layout)).
+// Returns false for formats that aren't raw pixels (JPEG), odd YUV422 widths
+// and odd Bayer sizes.
+bool convert(Format format, const uint8_t* src, int width, int height,
+             uint8_t* dst, Layout layout, bool flip);
+
+enum class Demosaic {
+    Bilinear,   // mean of the nearest samples of each colour
+    EdgeAware,  // G along the smaller gradient, R/B as differences from G
+};
+
+// Demosaic a BGGR frame (width and height even) into dst, like convert().
+// Same results as demosaic.py.
+bool demosaic(const uint8_t* src, int width, int height, uint8_t* dst,
+              Layout layout, bool flip, Demosaic method = Demosaic::EdgeAware);
+
+// Kernels in use - the best the CPU supports unless forced
+Isa convert_isa();
+const char* isa_name(Isa isa);
+
+// Use isa (if the CPU supports it) - for benchmarks and cross-checks.
+// Returns the ISA actually selected.
+Isa convert_force_isa(Isa isa);
+
+}
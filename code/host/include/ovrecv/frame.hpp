@@ -0,0 +1,48 @@
+/*
+
+    frame.hpp
+
+    A frame as received from the framegrabber - see
+    code/framegrabber/frame_proto.h for the wire format.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ovrecv {
+
+// frame_format_t in frame_ring.h
+enum class Format : uint8_t {
+    YUV422 = 0,
+    RGB565 = 1,
+    Y8 = 2,
+    JPEG = 3,
+    BAYER = 4,      // raw BGGR, 1 byte per pixel
+};
+
+// header flags
+constexpr uint8_t FLAG_CRC_TRAILER = 0x01;
+constexpr uint8_t FLAG_CHUNKED = 0x02;
+constexpr uint8_t FLAG_QOI16 = 0x04;
+constexpr uint8_t FLAG_TILES = 0x08;
+constexpr uint8_t FLAG_RECORD = 0x10;        // part of a pre/post-trigger burst
+constexpr uint8_t FLAG_PRE_TRIGGER = 0x20;   // burst frame captured before the trigger
+
+struct Frame {
+    Format format = Format::YUV422;
+    uint8_t flags = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint32_t seq = 0;
+    uint32_t timestamp_us = 0;
+
+    // decoded payload - chunked/qoi16 frames are already expanded.
+    // FLAG_TILES frames are left as sent (see tile_delta.h).
+    std::vector<uint8_t> payload;
+};
+
+const char* format_name(Format format);
+
+}
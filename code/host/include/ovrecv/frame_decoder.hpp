@@ -0,0 +1,67 @@
+/*
+
+    frame_decoder.hpp
+
+    Streaming decoder for the framed wire protocol - the C++ version
+    of frame_proto.py.
+
+    Feed it bytes as they arrive and it returns complete, CRC-checked
+    frames. If bytes are lost or corrupted it drops what it has and
+    resyncs on the next valid header.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ovrecv/frame.hpp"
+
+namespace ovrecv {
+
+constexpr size_t HEADER_LEN = 32;
+
+// Largest payload accepted - VGA RGB565 - guards against a bad length
+constexpr uint32_t MAX_PAYLOAD = 640 * 480 * 2;
+
+struct DecoderStats {
+    uint64_t frames = 0;
+    uint64_t crc_errors = 0;
+    uint64_t resyncs = 0;
+    uint64_t skipped_bytes = 0;
+    uint64_t lost_frames = 0;       // gaps in the sequence number
+};
+
+class FrameDecoder {
+public:
+    // Add received bytes - complete frames are appended to out
+    void feed(const uint8_t* data, size_t len, std::vector<Frame>& out);
+
+    const DecoderStats& stats() const { return stats_; }
+
+private:
+    bool parse_one(Frame& frame);
+    void skip(size_t n);
+    long chunks_end(size_t pos) const;
+    bool unchunk(const uint8_t* wire, size_t len, uint8_t flags, std::vector<uint8_t>& out) const;
+
+    std::vector<uint8_t> buf_;
+    size_t start_ = 0;              // first unparsed byte in buf_
+    bool have_seq_ = false;
+    uint32_t last_seq_ = 0;
+    DecoderStats stats_;
+};
+
+// Standard CRC32 (reflected, poly 0xEDB88320) - same as zlib
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len);
+
+// Decode a qoi16 chunk (qoi16.h), appending pixels to out. prev/index
+// carry across chunks. Returns false on a truncated op.
+bool qoi16_decode(const uint8_t* data, size_t len, uint16_t& prev, uint16_t* index,
+                  std::vector<uint8_t>& out);
+
+// Host -> device credit grant, with its CRC - see cmd.h
+std::vector<uint8_t> encode_credit(uint32_t nbytes);
+
+}
@@ -0,0 +1,66 @@
+/*
+
+    receiver.hpp
+
+    Reads the serial stream on its own thread and queues decoded
+    frames. If the application falls behind, the oldest queued frame
+    is dropped so latency stays bounded.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ovrecv/frame_decoder.hpp"
+#include "ovrecv/serial_port.hpp"
+
+namespace ovrecv {
+
+struct ReceiverStats {
+    DecoderStats decoder;
+    uint64_t bytes_read = 0;
+    uint64_t frames_dropped = 0;    // queue was full
+    size_t queue_high_water = 0;
+};
+
+class Receiver {
+public:
+    explicit Receiver(size_t queue_depth = 4);
+    ~Receiver();
+
+    // Open the port and start the reader thread
+    void start(const std::string& port, int baud);
+    void stop();
+
+    // Oldest queued frame - false on timeout or once stopped
+    bool wait_frame(Frame& out, std::chrono::milliseconds timeout);
+
+    // Send bytes to the device (e.g. encode_credit()) - safe from any thread
+    void send(const std::vector<uint8_t>& data);
+
+    ReceiverStats stats() const;
+
+private:
+    void run();
+
+    SerialPort port_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Frame> queue_;
+    size_t queue_depth_;
+    ReceiverStats stats_;
+
+    std::mutex write_mutex_;
+};
+
+}
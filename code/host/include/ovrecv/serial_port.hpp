@@ -0,0 +1,38 @@
+/*
+
+    serial_port.hpp
+
+    Raw POSIX serial port - 8N1, no flow control, arbitrary baud rates
+    (the framegrabber runs at 3 Mbaud).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ovrecv {
+
+class SerialPort {
+public:
+    SerialPort() = default;
+    ~SerialPort();
+
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    // Throws std::system_error if the port can't be opened or configured
+    void open(const std::string& path, int baud);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    // Wait up to timeout_ms for data - returns bytes read, 0 on timeout
+    size_t read(uint8_t* data, size_t len, int timeout_ms);
+    void write(const uint8_t* data, size_t len);
+
+private:
+    int fd_ = -1;
+};
+
+}
@@ -0,0 +1,199 @@
+/*
+    Frame to RGB conversion - see convert.hpp.
+*/
+
+#include "ovrecv/convert.hpp"
+#include "convert_kernels.hpp"
+#include "demosaic_impl.hpp"
+
+#include <atomic>
+
+namespace ovrecv {
+
+namespace {
+
+inline uint8_t clip(int v)
+{
+    return uint8_t(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+// One pixel pair - src is Y0 U Y1 V
+template <int BPP>
+inline void yuyv_pair(const uint8_t* src, uint8_t* dst)
+{
+    int d = src[1] - 128, e = src[3] - 128;
+    int r = 409 * e + 128;
+    int g = -100 * d - 208 * e + 128;
+    int b = 516 * d + 128;
+
+    for (int i = 0; i < 2; i++) {
+        int c = 298 * (src[i * 2] - 16);
+        dst[0] = clip((c + r) >> 8);
+        dst[1] = clip((c + g) >> 8);
+        dst[2] = clip((c + b) >> 8);
+        if (BPP == 4)
+            dst[3] = 255;
+        dst += BPP;
+    }
+}
+
+template <int BPP>
+inline void rgb565_px(const uint8_t* src, uint8_t* dst)
+{
+    uint16_t v = uint16_t(src[0] | (src[1] << 8));
+    dst[0] = uint8_t((v >> 8) & 0xF8);
+    dst[1] = uint8_t((v >> 3) & 0xFC);
+    dst[2] = uint8_t((v << 3) & 0xF8);
+    if (BPP == 4)
+        dst[3] = 255;
+}
+
+Isa detect_isa()
+{
+#if defined(OVRECV_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Isa::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return Isa::SSE2;
+#endif
+    return Isa::Scalar;
+}
+
+const Kernels* kernels_for(Isa isa)
+{
+#ifdef OVRECV_X86
+    if (isa == Isa::AVX2)
+        return &avx2_kernels;
+    if (isa == Isa::SSE2)
+        return &sse2_kernels;
+#endif
+    (void)isa;
+    return &scalar_kernels;
+}
+
+const Isa best_isa = detect_isa();
+std::atomic<Isa> active_isa{best_isa};
+
+}
+
+void rgb565_rgb888_scalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++)
+        rgb565_px<3>(src + x * 2, dst + x * 3);
+}
+
+void rgb565_rgba_scalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++)
+        rgb565_px<4>(src + x * 2, dst + x * 4);
+}
+
+void yuyv_rgb888_scalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x += 2)
+        yuyv_pair<3>(src + x * 2, dst + x * 3);
+}
+
+void yuyv_rgba_scalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x += 2)
+        yuyv_pair<4>(src + x * 2, dst + x * 4);
+}
+
+static void bayer_scalar(const uint8_t* src, int width, int height, uint8_t* dst,
+                         Layout layout, bool flip, bool edge)
+{
+    auto rgb = [](const BayerRow& row, uint8_t* out, int qw) { bayer_pairs_scalar(row, 0, qw, out, 3); };
+    auto rgba = [](const BayerRow& row, uint8_t* out, int qw) { bayer_pairs_scalar(row, 0, qw, out, 4); };
+    demosaic_dispatch(src, width, height, dst, layout, flip, edge, rgb, rgba);
+}
+
+const Kernels scalar_kernels = {
+    { rgb565_rgb888_scalar, rgb565_rgba_scalar },
+    { yuyv_rgb888_scalar, yuyv_rgba_scalar },
+    bayer_scalar,
+};
+
+Isa convert_isa()
+{
+    return active_isa.load(std::memory_order_relaxed);
+}
+
+Isa convert_force_isa(Isa isa)
+{
+    // can't go above what the CPU has
+    if (int(isa) > int(best_isa))
+        isa = best_isa;
+    active_isa.store(isa, std::memory_order_relaxed);
+    return isa;
+}
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::SSE2: return "sse2";
+    case Isa::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool convert(Format format, const uint8_t* src, int width, int height,
+             uint8_t* dst, Layout layout, bool flip)
+{
+    const Kernels* k = kernels_for(convert_isa());
+    size_t bpp = bytes_per_pixel(layout);
+    size_t dst_stride = size_t(width) * bpp;
+    size_t src_stride;
+    RowFn row = nullptr;
+
+    switch (format) {
+    case Format::RGB565:
+        src_stride = size_t(width) * 2;
+        row = k->rgb565[int(layout)];
+        break;
+    case Format::YUV422:
+        if (width & 1)
+            return false;
+        src_stride = size_t(width) * 2;
+        row = k->yuyv[int(layout)];
+        break;
+    case Format::Y8:
+        src_stride = size_t(width);
+        break;
+    case Format::BAYER:
+        return demosaic(src, width, height, dst, layout, flip);
+    default:
+        return false;
+    }
+
+    for (int y = 0; y < height; y++) {
+        // flip by writing rows bottom-up - no extra pass over the image
+        uint8_t* out = dst + size_t(flip ? height - 1 - y : y) * dst_stride;
+        const uint8_t* in = src + size_t(y) * src_stride;
+
+        if (row) {
+            row(in, out, width);
+        } else {
+            for (int x = 0; x < width; x++, out += bpp) {
+                out[0] = out[1] = out[2] = in[x];
+                if (bpp == 4)
+                    out[3] = 255;
+            }
+        }
+    }
+    return true;
+}
+
+bool demosaic(const uint8_t* src, int width, int height, uint8_t* dst,
+              Layout layout, bool flip, Demosaic method)
+{
+    if ((width & 1) || (height & 1) || width <= 0 || height <= 0)
+        return false;
+    kernels_for(convert_isa())->bayer(src, width, height, dst, layout, flip,
+                                      method == Demosaic::EdgeAware);
+    return true;
+}
+
+}
@@ -0,0 +1,233 @@
+/*
+    AVX2 conversion kernels - see convert_kernels.hpp.
+
+    32 pixels per iteration. The arithmetic is the SSE2 kernel's,
+    twice as wide. Packs and unpacks work within 128-bit lanes, so
+    the results are put back in pixel order with permutes before they
+    are stored.
+*/
+
+#include "convert_kernels.hpp"
+#include "demosaic_impl.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+
+namespace ovrecv {
+
+namespace {
+
+// R, G, B (32 pixels each, in order) to RGBA - as four registers of 8 pixels
+inline void interleave_rgba(__m256i r, __m256i g, __m256i b, __m256i q[4])
+{
+    __m256i a = _mm256_set1_epi8(char(0xFF));
+    __m256i rg_lo = _mm256_unpacklo_epi8(r, g);     // pixels 0-7 | 16-23
+    __m256i rg_hi = _mm256_unpackhi_epi8(r, g);     // pixels 8-15 | 24-31
+    __m256i ba_lo = _mm256_unpacklo_epi8(b, a);
+    __m256i ba_hi = _mm256_unpackhi_epi8(b, a);
+
+    __m256i q0 = _mm256_unpacklo_epi16(rg_lo, ba_lo);   // 0-3 | 16-19
+    __m256i q1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);   // 4-7 | 20-23
+    __m256i q2 = _mm256_unpacklo_epi16(rg_hi, ba_hi);   // 8-11 | 24-27
+    __m256i q3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);   // 12-15 | 28-31
+
+    q[0] = _mm256_permute2x128_si256(q0, q1, 0x20);
+    q[1] = _mm256_permute2x128_si256(q2, q3, 0x20);
+    q[2] = _mm256_permute2x128_si256(q0, q1, 0x31);
+    q[3] = _mm256_permute2x128_si256(q2, q3, 0x31);
+}
+
+inline void store_rgba(__m256i r, __m256i g, __m256i b, uint8_t* dst)
+{
+    __m256i q[4];
+    interleave_rgba(r, g, b, q);
+    for (int i = 0; i < 4; i++)
+        _mm256_storeu_si256((__m256i*)(dst + i * 32), q[i]);
+}
+
+// Drops alpha - each 16-byte lane packs to 12 bytes. The 16-byte stores
+// overlap, each writing 4 bytes past its pixels that the next store
+// overwrites. At the end of a row the last one is copied exactly.
+inline void store_rgb(__m256i r, __m256i g, __m256i b, uint8_t* dst, bool row_end)
+{
+    const __m256i pack = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m256i q[4];
+    interleave_rgba(r, g, b, q);
+    for (int i = 0; i < 4; i++) {
+        __m256i p = _mm256_shuffle_epi8(q[i], pack);
+        _mm_storeu_si128((__m128i*)(dst + i * 24), _mm256_castsi256_si128(p));
+        __m128i hi = _mm256_extracti128_si256(p, 1);
+        if (i == 3 && row_end) {
+            alignas(16) uint8_t tmp[16];
+            _mm_store_si128((__m128i*)tmp, hi);
+            memcpy(dst + i * 24 + 12, tmp, 12);
+        } else {
+            _mm_storeu_si128((__m128i*)(dst + i * 24 + 12), hi);
+        }
+    }
+}
+
+// packus works per lane - put the 64-bit quarters back in order
+inline __m256i pack_u8(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+inline void rgb565_unpack(__m256i v, __m256i& r, __m256i& g, __m256i& b)
+{
+    r = _mm256_and_si256(_mm256_srli_epi16(v, 8), _mm256_set1_epi16(0xF8));
+    g = _mm256_and_si256(_mm256_srli_epi16(v, 3), _mm256_set1_epi16(0xFC));
+    b = _mm256_and_si256(_mm256_slli_epi16(v, 3), _mm256_set1_epi16(0xF8));
+}
+
+inline void rgb565_32(const uint8_t* src, __m256i& r, __m256i& g, __m256i& b)
+{
+    __m256i r0, g0, b0, r1, g1, b1;
+    rgb565_unpack(_mm256_loadu_si256((const __m256i*)src), r0, g0, b0);
+    rgb565_unpack(_mm256_loadu_si256((const __m256i*)(src + 32)), r1, g1, b1);
+    r = pack_u8(r0, r1);
+    g = pack_u8(g0, g1);
+    b = pack_u8(b0, b1);
+}
+
+inline __m256i madd_pair(__m256i x, __m256i y, __m256i k, __m256i round)
+{
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(x, y), k);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(x, y), k);
+    lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 8);
+    hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 8);
+    return _mm256_packs_epi32(lo, hi);      // unpack then pack keeps pixel order
+}
+
+// 16 pixels of YUYV (32 bytes) to 16-bit R, G, B
+inline void yuyv_16(const uint8_t* src, __m256i& r, __m256i& g, __m256i& b)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)src);
+    __m256i c = _mm256_sub_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0xFF)), _mm256_set1_epi16(16));
+    __m256i uv = _mm256_sub_epi16(_mm256_srli_epi16(v, 8), _mm256_set1_epi16(128));
+
+    __m256i d = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    __m256i e = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    const __m256i k_ce = _mm256_set1_epi32(pair16(298, 409));
+    const __m256i k_cd_g = _mm256_set1_epi32(pair16(298, -100));
+    const __m256i k_e1 = _mm256_set1_epi32(pair16(-208, 128));
+    const __m256i k_cd_b = _mm256_set1_epi32(pair16(298, 516));
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i one = _mm256_set1_epi16(1);
+
+    r = madd_pair(c, e, k_ce, round);
+    b = madd_pair(c, d, k_cd_b, round);
+
+    __m256i glo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(c, d), k_cd_g),
+                                   _mm256_madd_epi16(_mm256_unpacklo_epi16(e, one), k_e1));
+    __m256i ghi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(c, d), k_cd_g),
+                                   _mm256_madd_epi16(_mm256_unpackhi_epi16(e, one), k_e1));
+    g = _mm256_packs_epi32(_mm256_srai_epi32(glo, 8), _mm256_srai_epi32(ghi, 8));
+}
+
+inline void yuyv_32(const uint8_t* src, __m256i& r, __m256i& g, __m256i& b)
+{
+    __m256i r0, g0, b0, r1, g1, b1;
+    yuyv_16(src, r0, g0, b0);
+    yuyv_16(src + 32, r1, g1, b1);
+    r = pack_u8(r0, r1);
+    g = pack_u8(g0, g1);
+    b = pack_u8(b0, b1);
+}
+
+void rgb565_rgb888_avx2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b;
+        rgb565_32(src + x * 2, r, g, b);
+        store_rgb(r, g, b, dst + x * 3, x + 32 + 2 > width);
+    }
+    rgb565_rgb888_scalar(src + x * 2, dst + x * 3, width - x);
+}
+
+void rgb565_rgba_avx2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b;
+        rgb565_32(src + x * 2, r, g, b);
+        store_rgba(r, g, b, dst + x * 4);
+    }
+    rgb565_rgba_scalar(src + x * 2, dst + x * 4, width - x);
+}
+
+void yuyv_rgb888_avx2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b;
+        yuyv_32(src + x * 2, r, g, b);
+        store_rgb(r, g, b, dst + x * 3, x + 32 + 2 > width);
+    }
+    yuyv_rgb888_scalar(src + x * 2, dst + x * 3, width - x);
+}
+
+void yuyv_rgba_avx2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b;
+        yuyv_32(src + x * 2, r, g, b);
+        store_rgba(r, g, b, dst + x * 4);
+    }
+    yuyv_rgba_scalar(src + x * 2, dst + x * 4, width - x);
+}
+
+// Even and odd columns j..j+31 of each channel, interleaved into pixels
+// 2j..2j+31 (lo) and 2j+32..2j+63 (hi). The unpacks work within lanes,
+// so the quadwords go in as 0 2 1 3.
+inline void bayer_pairs(const BayerRow& row, int j, __m256i lo[3], __m256i hi[3])
+{
+    for (int c = 0; c < 3; c++) {
+        __m256i e = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i*)(row.even[c] + j)), 0xD8);
+        __m256i o = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i*)(row.odd[c] + j)), 0xD8);
+        lo[c] = _mm256_unpacklo_epi8(e, o);
+        hi[c] = _mm256_unpackhi_epi8(e, o);
+    }
+}
+
+void bayer_avx2(const uint8_t* src, int width, int height, uint8_t* dst,
+                Layout layout, bool flip, bool edge)
+{
+    // 32 pairs from each half row are 64 pixels per channel
+    auto rgb = [](const BayerRow& row, uint8_t* out, int qw) {
+        int j = 0;
+        for (; j + 32 <= qw; j += 32) {
+            __m256i lo[3], hi[3];
+            bayer_pairs(row, j, lo, hi);
+            store_rgb(lo[0], lo[1], lo[2], out + j * 6, false);
+            store_rgb(hi[0], hi[1], hi[2], out + j * 6 + 96, 2 * j + 64 + 2 > 2 * qw);
+        }
+        bayer_pairs_scalar(row, j, qw, out + j * 6, 3);
+    };
+    auto rgba = [](const BayerRow& row, uint8_t* out, int qw) {
+        int j = 0;
+        for (; j + 32 <= qw; j += 32) {
+            __m256i lo[3], hi[3];
+            bayer_pairs(row, j, lo, hi);
+            store_rgba(lo[0], lo[1], lo[2], out + j * 8);
+            store_rgba(hi[0], hi[1], hi[2], out + j * 8 + 128);
+        }
+        bayer_pairs_scalar(row, j, qw, out + j * 8, 4);
+    };
+    demosaic_dispatch(src, width, height, dst, layout, flip, edge, rgb, rgba);
+}
+
+}
+
+const Kernels avx2_kernels = {
+    { rgb565_rgb888_avx2, rgb565_rgba_avx2 },
+    { yuyv_rgb888_avx2, yuyv_rgba_avx2 },
+    bayer_avx2,
+};
+
+}
@@ -0,0 +1,48 @@
+/*
+
+    convert_kernels.hpp
+
+    Kernels behind convert() - one set per instruction set. Row kernels
+    convert one row of width pixels; YUV422 widths are even.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "ovrecv/convert.hpp"
+
+namespace ovrecv {
+
+using RowFn = void (*)(const uint8_t* src, uint8_t* dst, int width);
+
+// Whole BGGR frame - see demosaic_impl.hpp
+using BayerFn = void (*)(const uint8_t* src, int width, int height, uint8_t* dst,
+                         Layout layout, bool flip, bool edge);
+
+struct Kernels {
+    RowFn rgb565[2];    // indexed by Layout
+    RowFn yuyv[2];
+    BayerFn bayer;
+};
+
+// Scalar rows - also used for the tails the SIMD loops leave
+void rgb565_rgb888_scalar(const uint8_t* src, uint8_t* dst, int width);
+void rgb565_rgba_scalar(const uint8_t* src, uint8_t* dst, int width);
+void yuyv_rgb888_scalar(const uint8_t* src, uint8_t* dst, int width);
+void yuyv_rgba_scalar(const uint8_t* src, uint8_t* dst, int width);
+
+// Two int16 madd coefficients in one 32-bit lane - lo pairs with the
+// first unpacked operand
+constexpr int pair16(int lo, int hi)
+{
+    return int(uint32_t(uint16_t(lo)) | (uint32_t(uint16_t(hi)) << 16));
+}
+
+extern const Kernels scalar_kernels;
+#ifdef OVRECV_X86
+extern const Kernels sse2_kernels;
+extern const Kernels avx2_kernels;
+#endif
+
+}
@@ -0,0 +1,234 @@
+/*
+    SSE2 conversion kernels - see convert_kernels.hpp.
+
+    16 pixels per iteration, computing 16-bit R, G, B with madd and
+    saturating to bytes with packus.
+*/
+
+#include "convert_kernels.hpp"
+#include "demosaic_impl.hpp"
+
+#include <cstring>
+#include <emmintrin.h>
+
+namespace ovrecv {
+
+namespace {
+
+// R, G, B (16 pixels each) to RGBA - as four registers of 4 pixels
+inline void interleave_rgba(__m128i r, __m128i g, __m128i b, __m128i q[4])
+{
+    __m128i a = _mm_set1_epi8(char(0xFF));
+    __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+    __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+    __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+    __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+    q[0] = _mm_unpacklo_epi16(rg_lo, ba_lo);
+    q[1] = _mm_unpackhi_epi16(rg_lo, ba_lo);
+    q[2] = _mm_unpacklo_epi16(rg_hi, ba_hi);
+    q[3] = _mm_unpackhi_epi16(rg_hi, ba_hi);
+}
+
+inline void store_rgba(__m128i r, __m128i g, __m128i b, uint8_t* dst)
+{
+    __m128i q[4];
+    interleave_rgba(r, g, b, q);
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*)(dst + i * 16), q[i]);
+}
+
+// Drops alpha from 4 RGBA pixels - 12 bytes of RGB, then 4 zero bytes.
+// Without a byte shuffle this is shifts and masks: pixel pairs close
+// up within each 64-bit half, then the halves close up.
+inline __m128i pack_rgb(__m128i q)
+{
+    const __m128i lo_px = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    const __m128i hi_px = _mm_set_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0);
+    __m128i six = _mm_or_si128(_mm_and_si128(q, lo_px), _mm_srli_epi64(_mm_and_si128(q, hi_px), 8));
+    __m128i lo = _mm_move_epi64(six);
+    return _mm_or_si128(lo, _mm_slli_si128(_mm_srli_si128(six, 8), 6));
+}
+
+// Each 16-byte store writes 4 bytes past its pixels that the next one
+// overwrites. At the end of a row the last one is written exactly.
+inline void store_rgb(__m128i r, __m128i g, __m128i b, uint8_t* dst, bool row_end)
+{
+    __m128i q[4];
+    interleave_rgba(r, g, b, q);
+    for (int i = 0; i < 3; i++)
+        _mm_storeu_si128((__m128i*)(dst + i * 12), pack_rgb(q[i]));
+
+    __m128i last = pack_rgb(q[3]);
+    if (row_end) {
+        uint32_t tail = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(last, 8)));
+        _mm_storel_epi64((__m128i*)(dst + 36), last);
+        memcpy(dst + 44, &tail, 4);
+    } else {
+        _mm_storeu_si128((__m128i*)(dst + 36), last);
+    }
+}
+
+// 8 RGB565 pixels to 16-bit r, g, b already scaled to 8 bits
+inline void rgb565_unpack(__m128i v, __m128i& r, __m128i& g, __m128i& b)
+{
+    r = _mm_and_si128(_mm_srli_epi16(v, 8), _mm_set1_epi16(0xF8));
+    g = _mm_and_si128(_mm_srli_epi16(v, 3), _mm_set1_epi16(0xFC));
+    b = _mm_and_si128(_mm_slli_epi16(v, 3), _mm_set1_epi16(0xF8));
+}
+
+inline void rgb565_16(const uint8_t* src, __m128i& r, __m128i& g, __m128i& b)
+{
+    __m128i r0, g0, b0, r1, g1, b1;
+    rgb565_unpack(_mm_loadu_si128((const __m128i*)src), r0, g0, b0);
+    rgb565_unpack(_mm_loadu_si128((const __m128i*)(src + 16)), r1, g1, b1);
+    r = _mm_packus_epi16(r0, r1);
+    g = _mm_packus_epi16(g0, g1);
+    b = _mm_packus_epi16(b0, b1);
+}
+
+// (x * k0 + y * k1 + round) >> 8 for 8 pixels, saturated to int16
+inline __m128i madd_pair(__m128i x, __m128i y, __m128i k, __m128i round)
+{
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, y), k);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, y), k);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 8);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 8);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// 8 pixels of YUYV (16 bytes) to 16-bit R, G, B
+inline void yuyv_8(const uint8_t* src, __m128i& r, __m128i& g, __m128i& b)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+    __m128i c = _mm_sub_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), _mm_set1_epi16(16));
+    __m128i uv = _mm_sub_epi16(_mm_srli_epi16(v, 8), _mm_set1_epi16(128));
+
+    // U0 V0 U1 V1 ... to one U and one V per pixel
+    __m128i d = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i e = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    // 16-bit coefficient pairs for madd
+    const __m128i k_ce = _mm_set1_epi32(pair16(298, 409));
+    const __m128i k_cd_g = _mm_set1_epi32(pair16(298, -100));
+    const __m128i k_e1 = _mm_set1_epi32(pair16(-208, 128));
+    const __m128i k_cd_b = _mm_set1_epi32(pair16(298, 516));
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i one = _mm_set1_epi16(1);
+
+    r = madd_pair(c, e, k_ce, round);
+    b = madd_pair(c, d, k_cd_b, round);
+
+    // G has three terms - the rounding rides along as E * -208 + 1 * 128
+    __m128i glo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(c, d), k_cd_g),
+                                _mm_madd_epi16(_mm_unpacklo_epi16(e, one), k_e1));
+    __m128i ghi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(c, d), k_cd_g),
+                                _mm_madd_epi16(_mm_unpackhi_epi16(e, one), k_e1));
+    g = _mm_packs_epi32(_mm_srai_epi32(glo, 8), _mm_srai_epi32(ghi, 8));
+}
+
+// 16 pixels to clamped 8-bit R, G, B
+inline void yuyv_16(const uint8_t* src, __m128i& r, __m128i& g, __m128i& b)
+{
+    __m128i r0, g0, b0, r1, g1, b1;
+    yuyv_8(src, r0, g0, b0);
+    yuyv_8(src + 16, r1, g1, b1);
+    r = _mm_packus_epi16(r0, r1);
+    g = _mm_packus_epi16(g0, g1);
+    b = _mm_packus_epi16(b0, b1);
+}
+
+void rgb565_rgb888_sse2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        rgb565_16(src + x * 2, r, g, b);
+        // the tail needs 2 pixels to cover the overlapping store
+        store_rgb(r, g, b, dst + x * 3, x + 16 + 2 > width);
+    }
+    rgb565_rgb888_scalar(src + x * 2, dst + x * 3, width - x);
+}
+
+void rgb565_rgba_sse2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        rgb565_16(src + x * 2, r, g, b);
+        store_rgba(r, g, b, dst + x * 4);
+    }
+    rgb565_rgba_scalar(src + x * 2, dst + x * 4, width - x);
+}
+
+void yuyv_rgb888_sse2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        yuyv_16(src + x * 2, r, g, b);
+        // the tail needs 2 pixels to cover the overlapping store
+        store_rgb(r, g, b, dst + x * 3, x + 16 + 2 > width);
+    }
+    yuyv_rgb888_scalar(src + x * 2, dst + x * 3, width - x);
+}
+
+void yuyv_rgba_sse2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        yuyv_16(src + x * 2, r, g, b);
+        store_rgba(r, g, b, dst + x * 4);
+    }
+    yuyv_rgba_scalar(src + x * 2, dst + x * 4, width - x);
+}
+
+// Even and odd columns j..j+15 of each channel, interleaved into pixels
+// 2j..2j+15 (lo) and 2j+16..2j+31 (hi)
+inline void bayer_pairs(const BayerRow& row, int j, __m128i lo[3], __m128i hi[3])
+{
+    for (int c = 0; c < 3; c++) {
+        __m128i e = _mm_loadu_si128((const __m128i*)(row.even[c] + j));
+        __m128i o = _mm_loadu_si128((const __m128i*)(row.odd[c] + j));
+        lo[c] = _mm_unpacklo_epi8(e, o);
+        hi[c] = _mm_unpackhi_epi8(e, o);
+    }
+}
+
+void bayer_sse2(const uint8_t* src, int width, int height, uint8_t* dst,
+                Layout layout, bool flip, bool edge)
+{
+    // 16 pairs from each half row are 32 pixels per channel
+    auto rgb = [](const BayerRow& row, uint8_t* out, int qw) {
+        int j = 0;
+        for (; j + 16 <= qw; j += 16) {
+            __m128i lo[3], hi[3];
+            bayer_pairs(row, j, lo, hi);
+            store_rgb(lo[0], lo[1], lo[2], out + j * 6, false);
+            store_rgb(hi[0], hi[1], hi[2], out + j * 6 + 48, 2 * j + 32 + 2 > 2 * qw);
+        }
+        bayer_pairs_scalar(row, j, qw, out + j * 6, 3);
+    };
+    auto rgba = [](const BayerRow& row, uint8_t* out, int qw) {
+        int j = 0;
+        for (; j + 16 <= qw; j += 16) {
+            __m128i lo[3], hi[3];
+            bayer_pairs(row, j, lo, hi);
+            store_rgba(lo[0], lo[1], lo[2], out + j * 8);
+            store_rgba(hi[0], hi[1], hi[2], out + j * 8 + 64);
+        }
+        bayer_pairs_scalar(row, j, qw, out + j * 8, 4);
+    };
+    demosaic_dispatch(src, width, height, dst, layout, flip, edge, rgb, rgba);
+}
+
+}
+
+const Kernels sse2_kernels = {
+    { rgb565_rgb888_sse2, rgb565_rgba_sse2 },
+    { yuyv_rgb888_sse2, yuyv_rgba_sse2 },
+    bayer_sse2,
+};
+
+}
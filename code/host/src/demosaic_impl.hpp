@@ -0,0 +1,267 @@
+/*
+
+    demosaic_impl.hpp
+
+    BGGR demosaic, included by each kernel file so it is compiled once
+    per instruction set. Everything is in an anonymous namespace - the
+    copies must not be merged by the linker.
+
+    The frame is split into its four quarter planes (B, Gb, Gr, R), so
+    every neighbour of a site is at a unit offset in some plane and the
+    loops are plain unit-stride int16 arithmetic, which the compiler
+    vectorizes for the target. Planes have a one-sample border copied
+    from the edge - the same as repeating the nearest pixel of the same
+    colour. The formulas are the ones in demosaic.py, bit for bit.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ovrecv/convert.hpp"
+
+namespace ovrecv {
+namespace {
+
+enum {
+    P_B, P_GB, P_GR, P_R,       // samples from the frame
+    P_G_B, P_G_R,               // G interpolated at B and R sites
+    P_DB, P_DR,                 // B and R as differences from G (or as is, bilinear)
+    BAYER_PLANES
+};
+
+struct BayerScratch {
+    int qw = 0;
+    int qh = 0;
+    int stride = 0;
+    std::vector<int16_t> planes;
+    std::vector<uint8_t> rows;      // half rows of one output row - see BayerRow
+
+    void resize(int width, int height)
+    {
+        qw = width / 2;
+        qh = height / 2;
+        stride = qw + 2;
+        planes.resize(size_t(BAYER_PLANES) * size_t(stride) * size_t(qh + 2));
+        rows.resize(size_t(qw) * 6);
+    }
+
+    // sample (0, 0) of plane i - the border is at -1 and qw/qh
+    int16_t* plane(int i)
+    {
+        return planes.data() + size_t(i) * size_t(stride) * size_t(qh + 2) + stride + 1;
+    }
+};
+
+// One output row as six unit-stride half rows: R, G and B of the even
+// and of the odd columns. Emit functors interleave them into pixels.
+struct BayerRow {
+    const uint8_t* even[3];
+    const uint8_t* odd[3];
+};
+
+// Pairs j..qw-1 of row as pixels of bpp bytes (3 or 4) - row tails
+inline void bayer_pairs_scalar(const BayerRow& row, int j, int qw, uint8_t* out, int bpp)
+{
+    for (; j < qw; j++, out += 2 * bpp) {
+        for (int c = 0; c < 3; c++) {
+            out[c] = row.even[c][j];
+            out[bpp + c] = row.odd[c][j];
+        }
+        if (bpp == 4)
+            out[3] = out[7] = 255;
+    }
+}
+
+inline int16_t clip8(int v)
+{
+    return int16_t(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+void pad_plane(int16_t* p, int qw, int qh, int stride)
+{
+    for (int i = 0; i < qh; i++) {
+        p[i * stride - 1] = p[i * stride];
+        p[i * stride + qw] = p[i * stride + qw - 1];
+    }
+    memcpy(p - stride - 1, p - 1, sizeof(int16_t) * size_t(stride));
+    memcpy(p + qh * stride - 1, p + (qh - 1) * stride - 1, sizeof(int16_t) * size_t(stride));
+}
+
+// G at the sites of row c from the G samples left, right, above and
+// below. EDGE picks the direction with the smaller gradient and adds a
+// Laplacian correction from c (Hamilton-Adams), else it is the mean.
+template <bool EDGE>
+void green_row(const int16_t* c, int stride, const int16_t* gl, const int16_t* gr,
+               const int16_t* gu, const int16_t* gd, int16_t* out, int qw)
+{
+    for (int j = 0; j < qw; j++) {
+        int l = gl[j], r = gr[j], u = gu[j], d = gd[j];
+        if (!EDGE) {
+            out[j] = int16_t((l + r + u + d + 2) >> 2);
+            continue;
+        }
+        int cc = 2 * c[j];
+        int lh = cc - c[j - 1] - c[j + 1];
+        int lv = cc - c[j - stride] - c[j + stride];
+        int dh = abs(l - r) + abs(lh);
+        int dv = abs(u - d) + abs(lv);
+        int eh = (2 * (l + r) + lh + 2) >> 2;
+        int ev = (2 * (u + d) + lv + 2) >> 2;
+        int g = dh < dv ? eh : dv < dh ? ev : (eh + ev + 1) >> 1;
+        out[j] = clip8(g);
+    }
+}
+
+// Even and odd samples of a frame row. A pair is loaded as one word -
+// two byte loads at stride 2 don't vectorize.
+void split_row(const uint8_t* __restrict src, int16_t* __restrict even,
+               int16_t* __restrict odd, int qw)
+{
+    for (int j = 0; j < qw; j++) {
+        uint16_t w;
+        memcpy(&w, src + 2 * j, 2);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        w = uint16_t(w >> 8 | w << 8);
+#endif
+        even[j] = int16_t(w & 0xFF);
+        odd[j] = int16_t(w >> 8);
+    }
+}
+
+// Output rows as half rows (see BayerRow). The plane pointers are to row
+// i; __restrict is what lets these vectorize - there are too many arrays
+// for runtime alias checks.
+//
+// B G B G - B sites then Gb sites (B left/right, R up/down)
+template <bool EDGE>
+void bg_row(const int16_t* __restrict pb, const int16_t* __restrict pgb,
+            const int16_t* __restrict gatb, const int16_t* __restrict db,
+            const int16_t* __restrict dr, int st, uint8_t* __restrict r0, uint8_t* __restrict r1,
+            uint8_t* __restrict g0, uint8_t* __restrict g1, uint8_t* __restrict b0,
+            uint8_t* __restrict b1, int qw)
+{
+    for (int j = 0; j < qw; j++) {
+        int g = gatb[j];
+        int k = EDGE ? g : 0;
+        r0[j] = uint8_t(clip8(k + ((dr[j - st - 1] + dr[j - st] + dr[j - 1] + dr[j] + 2) >> 2)));
+        g0[j] = uint8_t(g);
+        b0[j] = uint8_t(pb[j]);
+
+        g = pgb[j];
+        k = EDGE ? g : 0;
+        r1[j] = uint8_t(clip8(k + ((dr[j - st] + dr[j]) >> 1)));
+        g1[j] = uint8_t(g);
+        b1[j] = uint8_t(clip8(k + ((db[j] + db[j + 1]) >> 1)));
+    }
+}
+
+// G R G R - Gr sites (R left/right, B up/down) then R sites
+template <bool EDGE>
+void gr_row(const int16_t* __restrict pr, const int16_t* __restrict pgr,
+            const int16_t* __restrict gatr, const int16_t* __restrict db,
+            const int16_t* __restrict dr, int st, uint8_t* __restrict r0, uint8_t* __restrict r1,
+            uint8_t* __restrict g0, uint8_t* __restrict g1, uint8_t* __restrict b0,
+            uint8_t* __restrict b1, int qw)
+{
+    for (int j = 0; j < qw; j++) {
+        int g = pgr[j];
+        int k = EDGE ? g : 0;
+        r0[j] = uint8_t(clip8(k + ((dr[j - 1] + dr[j]) >> 1)));
+        g0[j] = uint8_t(g);
+        b0[j] = uint8_t(clip8(k + ((db[j] + db[j + st]) >> 1)));
+
+        g = gatr[j];
+        k = EDGE ? g : 0;
+        r1[j] = uint8_t(pr[j]);
+        g1[j] = uint8_t(g);
+        b1[j] = uint8_t(clip8(k + ((db[j] + db[j + 1] + db[j + st] + db[j + st + 1] + 2) >> 2)));
+    }
+}
+
+template <bool EDGE, class Emit>
+void demosaic_bggr(BayerScratch& s, const uint8_t* src, int width, int height,
+                   uint8_t* dst, size_t dst_stride, bool flip, Emit emit)
+{
+    s.resize(width, height);
+    const int qw = s.qw, qh = s.qh, st = s.stride;
+    int16_t* pb = s.plane(P_B);
+    int16_t* pgb = s.plane(P_GB);
+    int16_t* pgr = s.plane(P_GR);
+    int16_t* pr = s.plane(P_R);
+    int16_t* gatb = s.plane(P_G_B);
+    int16_t* gatr = s.plane(P_G_R);
+    int16_t* db = s.plane(P_DB);
+    int16_t* dr = s.plane(P_DR);
+
+    for (int i = 0; i < qh; i++) {
+        const uint8_t* s0 = src + size_t(2 * i) * size_t(width);
+        split_row(s0, pb + i * st, pgb + i * st, qw);
+        split_row(s0 + width, pgr + i * st, pr + i * st, qw);
+    }
+    for (int p = P_B; p <= P_R; p++)
+        pad_plane(s.plane(p), qw, qh, st);
+
+    // G at B sites: left/right are Gb (j-1, j), up/down are Gr (i-1, i).
+    // G at R sites: left/right are Gr (j, j+1), up/down are Gb (i, i+1).
+    for (int i = 0; i < qh; i++) {
+        int o = i * st;
+        green_row<EDGE>(pb + o, st, pgb + o - 1, pgb + o, pgr + o - st, pgr + o, gatb + o, qw);
+        green_row<EDGE>(pr + o, st, pgr + o, pgr + o + 1, pgb + o, pgb + o + st, gatr + o, qw);
+    }
+
+    // R and B as differences from G, so they follow the G edges
+    for (int i = 0; i < qh; i++) {
+        int o = i * st;
+        for (int j = 0; j < qw; j++) {
+            db[o + j] = int16_t(pb[o + j] - (EDGE ? gatb[o + j] : 0));
+            dr[o + j] = int16_t(pr[o + j] - (EDGE ? gatr[o + j] : 0));
+        }
+    }
+    pad_plane(db, qw, qh, st);
+    pad_plane(dr, qw, qh, st);
+
+    uint8_t* h = s.rows.data();
+    uint8_t *r0 = h, *r1 = h + qw, *g0 = h + 2 * qw, *g1 = h + 3 * qw, *b0 = h + 4 * qw, *b1 = h + 5 * qw;
+    const BayerRow row = { { r0, g0, b0 }, { r1, g1, b1 } };
+
+    for (int i = 0; i < qh; i++) {
+        int o = i * st;
+
+        bg_row<EDGE>(pb + o, pgb + o, gatb + o, db + o, dr + o, st, r0, r1, g0, g1, b0, b1, qw);
+        int y = 2 * i;
+        emit(row, dst + size_t(flip ? height - 1 - y : y) * dst_stride, qw);
+
+        gr_row<EDGE>(pr + o, pgr + o, gatr + o, db + o, dr + o, st, r0, r1, g0, g1, b0, b1, qw);
+        y++;
+        emit(row, dst + size_t(flip ? height - 1 - y : y) * dst_stride, qw);
+    }
+}
+
+// Per-call entry - EmitRgb/EmitRgba write one BayerRow of qw pixel pairs
+template <class EmitRgb, class EmitRgba>
+void demosaic_dispatch(const uint8_t* src, int width, int height, uint8_t* dst,
+                       Layout layout, bool flip, bool edge, EmitRgb rgb, EmitRgba rgba)
+{
+    // scratch is reused between frames - no allocation once warmed up
+    static thread_local BayerScratch scratch;
+    size_t stride = size_t(width) * bytes_per_pixel(layout);
+
+    if (layout == Layout::RGB888) {
+        if (edge)
+            demosaic_bggr<true>(scratch, src, width, height, dst, stride, flip, rgb);
+        else
+            demosaic_bggr<false>(scratch, src, width, height, dst, stride, flip, rgb);
+    } else {
+        if (edge)
+            demosaic_bggr<true>(scratch, src, width, height, dst, stride, flip, rgba);
+        else
+            demosaic_bggr<false>(scratch, src, width, height, dst, stride, flip, rgba);
+    }
+}
+
+}
+}
@@ -0,0 +1,304 @@
+/*
+    Frame stream decoder - see frame_decoder.hpp.
+*/
+
+#include "ovrecv/frame_decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ovrecv {
+
+namespace {
+
+const uint8_t MAGIC[4] = { 'O', 'V', 'F', 'R' };
+constexpr uint8_t VERSION = 1;
+constexpr uint16_t CHUNK_STORED = 0x8000;
+
+// qoi16 ops - see qoi16.h
+constexpr uint8_t OP_DIFF = 0x40;
+constexpr uint8_t OP_LUMA = 0x80;
+constexpr uint8_t OP_RUN = 0xC0;
+constexpr uint8_t OP_LITERAL = 0xFE;
+
+// host -> device messages - see cmd.h
+constexpr uint8_t CMD_SYNC = 0xA5;
+constexpr uint8_t CMD_CREDIT = 0x01;
+
+uint16_t get16(const uint8_t* p) { return uint16_t(p[0] | (p[1] << 8)); }
+uint32_t get32(const uint8_t* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24); }
+
+struct Crc32Table {
+    uint32_t t[256];
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+            t[i] = c;
+        }
+    }
+};
+
+const Crc32Table crc_table;
+
+void put_pixel(std::vector<uint8_t>& out, uint16_t px)
+{
+    out.push_back(uint8_t(px));
+    out.push_back(uint8_t(px >> 8));
+}
+
+}
+
+const char* format_name(Format format)
+{
+    switch (format) {
+    case Format::YUV422: return "yuv422";
+    case Format::RGB565: return "rgb565";
+    case Format::Y8: return "y8";
+    case Format::JPEG: return "jpeg";
+    case Format::BAYER: return "bayer";
+    }
+    return "unknown";
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+        crc = crc_table.t[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+bool qoi16_decode(const uint8_t* data, size_t len, uint16_t& prev, uint16_t* index,
+                  std::vector<uint8_t>& out)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t op = data[pos++];
+        uint16_t px;
+
+        if (op == OP_LITERAL) {
+            if (pos + 2 > len)
+                return false;
+            px = get16(data + pos);
+            pos += 2;
+        } else if (op >= OP_RUN) {
+            for (int i = (op & 0x3F) + 1; i > 0; i--)
+                put_pixel(out, prev);
+            continue;
+        } else if (op < OP_DIFF) {
+            prev = index[op];
+            put_pixel(out, prev);
+            continue;
+        } else {
+            int r = prev >> 11, g = (prev >> 5) & 0x3F, b = prev & 0x1F;
+            if (op < OP_LUMA) {
+                r = (r + ((op >> 4) & 3) - 2) & 0x1F;
+                g = (g + ((op >> 2) & 3) - 2) & 0x3F;
+                b = (b + (op & 3) - 2) & 0x1F;
+            } else {
+                if (pos >= len)
+                    return false;
+                int dg = (op & 0x3F) - 32;
+                uint8_t x = data[pos++];
+                r = (r + dg + (x >> 4) - 8) & 0x1F;
+                g = (g + dg) & 0x3F;
+                b = (b + dg + (x & 0x0F) - 8) & 0x1F;
+            }
+            px = uint16_t((r << 11) | (g << 5) | b);
+        }
+
+        index[((px >> 11) * 3 + ((px >> 5) & 0x3F) * 5 + (px & 0x1F) * 7) & 63] = px;
+        put_pixel(out, px);
+        prev = px;
+    }
+    return true;
+}
+
+std::vector<uint8_t> encode_credit(uint32_t nbytes)
+{
+    std::vector<uint8_t> msg = { CMD_SYNC, CMD_CREDIT, uint8_t(nbytes), uint8_t(nbytes >> 8),
+                                 uint8_t(nbytes >> 16), uint8_t(nbytes >> 24) };
+    uint32_t crc = crc32_update(0, msg.data(), msg.size());
+    for (int i = 0; i < 4; i++)
+        msg.push_back(uint8_t(crc >> (8 * i)));
+    return msg;
+}
+
+void FrameDecoder::feed(const uint8_t* data, size_t len, std::vector<Frame>& out)
+{
+    // compact rather than erase per frame - parsing only moves start_
+    if (start_ > 0 && start_ >= buf_.size() / 2) {
+        buf_.erase(buf_.begin(), buf_.begin() + long(start_));
+        start_ = 0;
+    }
+    buf_.insert(buf_.end(), data, data + len);
+
+    Frame frame;
+    while (parse_one(frame))
+        out.push_back(std::move(frame));
+}
+
+void FrameDecoder::skip(size_t n)
+{
+    start_ += n;
+    stats_.skipped_bytes += n;
+}
+
+// Offset of the CRC trailer of a chunked payload starting at pos -
+// 0 if it hasn't all arrived, -1 if it can't be valid
+long FrameDecoder::chunks_end(size_t pos) const
+{
+    size_t limit = pos + 2 * size_t(MAX_PAYLOAD);
+    for (;;) {
+        if (buf_.size() < start_ + pos + 2)
+            return 0;
+        size_t n = get16(&buf_[start_ + pos]) & ~CHUNK_STORED;
+        pos += 2 + n;
+        if (pos > limit)
+            return -1;
+        if (n == 0)
+            return buf_.size() >= start_ + pos + 4 ? long(pos) : 0;
+    }
+}
+
+// Decoded payload of a chunked frame - false if a chunk won't decode
+bool FrameDecoder::unchunk(const uint8_t* wire, size_t len, uint8_t flags,
+                           std::vector<uint8_t>& out) const
+{
+    uint16_t index[64] = {};
+    uint16_t prev = 0;
+    size_t pos = 0;
+
+    for (;;) {
+        uint16_t n = get16(wire + pos);
+        size_t size = n & ~CHUNK_STORED;
+        const uint8_t* data = wire + pos + 2;
+        pos += 2 + size;
+        if (size == 0 || pos > len)
+            return size == 0;
+        if ((n & CHUNK_STORED) || !(flags & FLAG_QOI16)) {
+            out.insert(out.end(), data, data + size);
+            std::fill(index, index + 64, 0);
+            prev = 0;
+        } else if (!qoi16_decode(data, size, prev, index, out)) {
+            return false;
+        }
+    }
+}
+
+bool FrameDecoder::parse_one(Frame& frame)
+{
+    uint8_t fmt, flags;
+    uint16_t width, height;
+    uint32_t seq, ts;
+    std::vector<uint8_t> payload;
+
+    for (;;) {
+        // find sync marker
+        const uint8_t* base = buf_.data() + start_;
+        size_t avail = buf_.size() - start_;
+        const uint8_t* hit = std::search(base, base + avail, MAGIC, MAGIC + 4);
+        if (hit == base + avail) {
+            // keep a possible partial marker at the end
+            if (avail > 3)
+                skip(avail - 3);
+            return false;
+        }
+        if (hit != base) {
+            stats_.resyncs++;
+            skip(size_t(hit - base));
+            base = hit;
+            avail = buf_.size() - start_;
+        }
+
+        if (avail < HEADER_LEN)
+            return false;
+
+        uint8_t version = base[4], hdr_len = base[5];
+        fmt = base[6];
+        flags = base[7];
+        width = get16(base + 8);
+        height = get16(base + 10);
+        seq = get32(base + 12);
+        ts = get32(base + 16);
+        uint32_t plen = get32(base + 20);
+        uint32_t pcrc = get32(base + 24);
+        uint32_t hcrc = get32(base + 28);
+
+        if (version != VERSION || hdr_len < HEADER_LEN || plen > MAX_PAYLOAD
+                || crc32_update(0, base, 28) != hcrc) {
+            // false marker in the payload or a corrupted header
+            stats_.resyncs++;
+            skip(1);
+            continue;
+        }
+
+        size_t wire_len, total;
+        if (flags & FLAG_CHUNKED) {
+            // wire length is only known once the empty chunk arrives
+            long end = chunks_end(hdr_len);
+            if (end == 0)
+                return false;
+            if (end < 0) {
+                stats_.resyncs++;
+                skip(1);
+                continue;
+            }
+            wire_len = size_t(end) - hdr_len;
+            pcrc = get32(base + end);
+            total = size_t(end) + 4;
+        } else {
+            wire_len = plen;
+            total = hdr_len + plen;
+            if (flags & FLAG_CRC_TRAILER)
+                total += 4;
+            if (avail < total)
+                return false;
+            if (flags & FLAG_CRC_TRAILER)
+                pcrc = get32(base + hdr_len + plen);
+        }
+
+        const uint8_t* wire = base + hdr_len;
+        bool crc_ok = crc32_update(0, wire, wire_len) == pcrc;
+        payload.clear();
+        if (crc_ok && (flags & FLAG_CHUNKED)) {
+            payload.reserve(plen);
+            // chunks that don't decode to the advertised size count as corrupt
+            crc_ok = unchunk(wire, wire_len, flags, payload) && payload.size() == plen;
+        } else if (crc_ok) {
+            payload.assign(wire, wire + wire_len);
+        }
+        if (!crc_ok) {
+            // drop just the header - a good frame may start inside this one
+            stats_.crc_errors++;
+            skip(1);
+            continue;
+        }
+
+        start_ += total;
+        break;
+    }
+
+    if (have_seq_) {
+        uint32_t gap = seq - last_seq_ - 1;
+        if (gap < 0x80000000u)
+            stats_.lost_frames += gap;
+    }
+    have_seq_ = true;
+    last_seq_ = seq;
+    stats_.frames++;
+
+    frame.format = Format(fmt);
+    frame.flags = flags;
+    frame.width = width;
+    frame.height = height;
+    frame.seq = seq;
+    frame.timestamp_us = ts;
+    frame.payload = std::move(payload);
+    return true;
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+    Threaded frame receiver - see receiver.hpp.
+*/
+
+#include "ovrecv/receiver.hpp"
+
+namespace ovrecv {
+
+Receiver::Receiver(size_t queue_depth)
+    : queue_depth_(queue_depth ? queue_depth : 1)
+{
+}
+
+Receiver::~Receiver()
+{
+    stop();
+}
+
+void Receiver::start(const std::string& port, int baud)
+{
+    stop();
+    port_.open(port, baud);
+    running_ = true;
+    thread_ = std::thread(&Receiver::run, this);
+}
+
+void Receiver::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+    port_.close();
+    cv_.notify_all();
+}
+
+void Receiver::run()
+{
+    FrameDecoder decoder;
+    std::vector<uint8_t> buf(64 * 1024);
+    std::vector<Frame> frames;
+
+    while (running_) {
+        size_t n;
+        try {
+            // short timeout so stop() is noticed
+            n = port_.read(buf.data(), buf.size(), 100);
+        } catch (const std::system_error&) {
+            running_ = false;
+            break;
+        }
+        if (n == 0)
+            continue;
+
+        frames.clear();
+        decoder.feed(buf.data(), n, frames);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_read += n;
+        stats_.decoder = decoder.stats();
+        for (Frame& f : frames) {
+            // full - the application is behind, drop the oldest
+            if (queue_.size() >= queue_depth_) {
+                queue_.pop_front();
+                stats_.frames_dropped++;
+            }
+            queue_.push_back(std::move(f));
+        }
+        if (queue_.size() > stats_.queue_high_water)
+            stats_.queue_high_water = queue_.size();
+        if (!frames.empty())
+            cv_.notify_one();
+    }
+    cv_.notify_all();
+}
+
+bool Receiver::wait_frame(Frame& out, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [this] { return !queue_.empty() || !running_; }))
+        return false;
+    if (queue_.empty())
+        return false;
+    out = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+}
+
+void Receiver::send(const std::vector<uint8_t>& data)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    port_.write(data.data(), data.size());
+}
+
+ReceiverStats Receiver::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}
@@ -0,0 +1,116 @@
+/*
+    POSIX serial port - see serial_port.hpp.
+*/
+
+#include "ovrecv/serial_port.hpp"
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// termios.h and asm/termbits.h can't both be included
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#else
+#include <termios.h>
+#endif
+
+namespace ovrecv {
+
+namespace {
+
+[[noreturn]] void fail(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+SerialPort::~SerialPort()
+{
+    close();
+}
+
+void SerialPort::open(const std::string& path, int baud)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0)
+        fail("open " + path);
+
+#ifdef __linux__
+    // termios2 takes any rate, not just the Bxxx constants
+    struct termios2 tio;
+    if (ioctl(fd_, TCGETS2, &tio) < 0)
+        fail("TCGETS2 " + path);
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+    tio.c_ispeed = tio.c_ospeed = speed_t(baud);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (ioctl(fd_, TCSETS2, &tio) < 0)
+        fail("TCSETS2 " + path);
+#else
+    struct termios tio;
+    if (tcgetattr(fd_, &tio) < 0)
+        fail("tcgetattr " + path);
+    cfmakeraw(&tio);
+    tio.c_cflag |= CREAD | CLOCAL;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (cfsetspeed(&tio, speed_t(baud)) < 0 || tcsetattr(fd_, TCSANOW, &tio) < 0)
+        fail("baud rate " + path);
+#endif
+}
+
+void SerialPort::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+size_t SerialPort::read(uint8_t* data, size_t len, int timeout_ms)
+{
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR)
+            return 0;
+        fail("poll");
+    }
+    if (n == 0)
+        return 0;
+
+    ssize_t got = ::read(fd_, data, len);
+    if (got < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+        fail("read");
+    }
+    return size_t(got);
+}
+
+void SerialPort::write(const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                fail("write");
+            struct pollfd pfd = { fd_, POLLOUT, 0 };
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        data += n;
+        len -= size_t(n);
+    }
+}
+
+}
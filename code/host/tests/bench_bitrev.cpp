@@ -0,0 +1,85 @@
+/*
+    bench_bitrev - bitrev_bytes() (bitrev.c) against the per-byte
+    reverse_bits() loop that send_image() used before.
+
+    Usage: bench_bitrev [seconds per case]
+
+    Each case fixes up a QVGA RGB565 frame (153,600 bytes) in place
+    over and over. Cycles are TSC ticks on x86, nanoseconds elsewhere.
+    The host takes the portable path of bitrev_word() - on the
+    RP2350 it is rbit + rev, 2 instructions a word.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "bitrev.h"
+}
+
+namespace {
+
+constexpr size_t FRAME_BYTES = 320 * 240 * 2;
+
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// as it was in framegrabber.c
+uint8_t reverse_bits(uint8_t byte)
+{
+    byte = ((byte & 0xF0) >> 4) | ((byte & 0x0F) << 4);
+    byte = ((byte & 0xCC) >> 2) | ((byte & 0x33) << 2);
+    byte = ((byte & 0xAA) >> 1) | ((byte & 0x55) << 1);
+    return byte;
+}
+
+__attribute__((noinline)) void per_byte(uint8_t* buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        buf[i] = reverse_bits(buf[i]);
+}
+
+// bytes per cycle of fn over seconds
+template <typename Fn>
+double run(Fn fn, uint8_t* buf, double seconds)
+{
+    uint64_t frames = 0, c = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    while (std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() < seconds) {
+        uint64_t c0 = cycles();
+        fn(buf, FRAME_BYTES);
+        c += cycles() - c0;
+        frames++;
+    }
+    return double(frames * FRAME_BYTES) / double(c);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+
+    std::vector<uint8_t> frame(FRAME_BYTES);
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = uint8_t(i * 131 + (i >> 9));
+
+    double old_rate = run(per_byte, frame.data(), seconds);
+    double new_rate = run(bitrev_bytes, frame.data(), seconds);
+    printf("reverse_bits() per byte  %6.2f bytes/cycle\n", old_rate);
+    printf("bitrev_bytes()           %6.2f bytes/cycle  (%.1fx)\n", new_rate, new_rate / old_rate);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+    bench_convert - frame conversion time per kernel.
+
+    Usage: bench_convert [seconds per case]
+
+    QVGA YUV422 and RGB565 frames to flipped RGB888, in us per frame,
+    and VGA Bayer frames demosaiced to flipped RGB888, in Mpixel/s -
+    the units of the tables in ../README.md. bench_convert.py times
+    the numpy code in recv_image.py the same way.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "ovrecv/convert.hpp"
+
+using namespace ovrecv;
+
+namespace {
+
+// seconds per call of fn, over at least the given time
+double time_per_call(const std::function<void()>& fn, double seconds)
+{
+    using clock = std::chrono::steady_clock;
+    fn();
+    long calls = 0;
+    auto t0 = clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        fn();
+        calls++;
+        elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+    }
+    return elapsed / calls;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+
+    std::mt19937 rng(15);
+    std::vector<uint8_t> qvga(320 * 240 * 2), vga(640 * 480);
+    for (auto& b : qvga)
+        b = uint8_t(rng());
+    for (auto& b : vga)
+        b = uint8_t(rng());
+    std::vector<uint8_t> dst(640 * 480 * 3);
+
+    printf("%-8s %14s %14s %18s %18s\n", "", "YUV422 us", "RGB565 us", "Bilinear Mpx/s", "EdgeAware Mpx/s");
+    Isa best = convert_force_isa(Isa::AVX2);
+    for (Isa isa : { Isa::Scalar, Isa::SSE2, Isa::AVX2 }) {
+        if (convert_force_isa(isa) != isa)
+            continue;
+
+        double yuv = time_per_call([&] {
+            convert(Format::YUV422, qvga.data(), 320, 240, dst.data(), Layout::RGB888, true);
+        }, seconds);
+        double rgb = time_per_call([&] {
+            convert(Format::RGB565, qvga.data(), 320, 240, dst.data(), Layout::RGB888, true);
+        }, seconds);
+        double bil = time_per_call([&] {
+            demosaic(vga.data(), 640, 480, dst.data(), Layout::RGB888, true, Demosaic::Bilinear);
+        }, seconds);
+        double edge = time_per_call([&] {
+            demosaic(vga.data(), 640, 480, dst.data(), Layout::RGB888, true, Demosaic::EdgeAware);
+        }, seconds);
+
+        printf("%-8s %14.0f %14.0f %18.0f %18.0f\n", isa_name(isa), yuv * 1e6, rgb * 1e6,
+               640 * 480 / bil / 1e6, 640 * 480 / edge / 1e6);
+    }
+    convert_force_isa(best);
+    return 0;
+}
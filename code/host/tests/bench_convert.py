@@ -0,0 +1,75 @@
+"""
+bench_convert.py - the numpy column for bench_convert.
+
+Usage: python3 bench_convert.py [seconds per case]
+
+Times recv_image.py converting a QVGA YUV422 and RGB565 frame to
+flipped RGB888 (the functions, and FrameConverter into a reused
+buffer), and demosaic.py on a VGA Bayer frame, in the units
+bench_convert prints.
+"""
+
+import os
+import sys
+import time
+import types
+
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "framegrabber"))
+
+# recv_image.py imports these at the top but converting doesn't use them
+for name in ("serial", "cv2", "PIL", "PIL.Image"):
+    if name not in sys.modules:
+        try:
+            __import__(name)
+        except ImportError:
+            sys.modules[name] = types.ModuleType(name)
+sys.modules["PIL"].Image = sys.modules["PIL.Image"]
+
+import recv_image                       # noqa: E402
+from demosaic import demosaic           # noqa: E402
+from frame_proto import Frame           # noqa: E402
+
+
+def time_per_call(fn, seconds):
+    fn()
+    calls = 0
+    t0 = time.perf_counter()
+    elapsed = 0
+    while elapsed < seconds:
+        fn()
+        calls += 1
+        elapsed = time.perf_counter() - t0
+    return elapsed / calls
+
+
+def main():
+    seconds = float(sys.argv[1]) if len(sys.argv) > 1 else 0.5
+    rng = np.random.default_rng(15)
+    qvga = rng.integers(0, 256, 320 * 240 * 2, dtype=np.uint8).tobytes()
+    vga = rng.integers(0, 256, 640 * 480, dtype=np.uint8).tobytes()
+
+    out = np.empty((240, 320, 3), np.uint8)
+    conv = recv_image.FrameConverter()
+    yuv_frame = Frame(0, 0, 320, 240, 0, 0, qvga)
+    rgb_frame = Frame(1, 0, 320, 240, 0, 0, qvga)
+
+    rows = [
+        ("numpy", time_per_call(lambda: recv_image.yuv422_to_rgb888(qvga), seconds),
+         time_per_call(lambda: recv_image.rgb565_to_rgb888(qvga), seconds)),
+        ("numpy *", time_per_call(lambda: conv.convert(yuv_frame, out), seconds),
+         time_per_call(lambda: conv.convert(rgb_frame, out), seconds)),
+    ]
+    bil = time_per_call(lambda: demosaic(vga, 640, 480, "bilinear")[::-1], seconds)
+    edge = time_per_call(lambda: demosaic(vga, 640, 480, "edge")[::-1], seconds)
+
+    print(f"{'':8} {'YUV422 us':>14} {'RGB565 us':>14} {'Bilinear Mpx/s':>18} {'EdgeAware Mpx/s':>18}")
+    print(f"{rows[0][0]:8} {rows[0][1] * 1e6:14.0f} {rows[0][2] * 1e6:14.0f} "
+          f"{640 * 480 / bil / 1e6:18.0f} {640 * 480 / edge / 1e6:18.0f}")
+    print(f"{rows[1][0]:8} {rows[1][1] * 1e6:14.0f} {rows[1][2] * 1e6:14.0f}")
+    print("* FrameConverter, into a reused buffer")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+/*
+    bench_decoder - parse throughput of ovrecv::FrameDecoder.
+
+    Usage: bench_decoder [seconds per case]
+
+    Streams of QVGA RGB565 frames, encoded as the firmware sends them
+    (frame_proto.c, and qoi16.c in bands like pipeline.c), are fed to
+    the decoder in 4 KiB reads. Throughput is given in wire MB/s and
+    as a multiple of the 3 Mbaud link (300 KB/s with 8N1 framing).
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ovrecv/frame_decoder.hpp"
+
+extern "C" {
+#include "frame_proto.h"
+#include "qoi16.h"
+}
+
+using namespace ovrecv;
+
+namespace {
+
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 240;
+constexpr int BAND_LINES = 16;
+constexpr int FRAMES = 32;
+constexpr double LINK_BYTES_PER_S = 3000000 / 10.0;
+
+void put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(uint8_t(v >> (8 * i)));
+}
+
+// A camera-like RGB565 frame - smooth gradients, a moving edge and some noise
+std::vector<uint8_t> test_image(uint32_t n)
+{
+    std::vector<uint8_t> img(WIDTH * HEIGHT * 2);
+    uint32_t noise = 12345 + n;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            noise = noise * 1103515245 + 12345;
+            int r = x * 31 / WIDTH;
+            int g = (y * 48 / HEIGHT + (x > int(n * 7 % WIDTH) ? 15 : 0) + int((noise >> 16) & 1)) & 0x3F;
+            int b = 31 - (x + y) * 31 / (WIDTH + HEIGHT);
+            uint16_t px = uint16_t((r << 11) | (g << 5) | b);
+            img[(y * WIDTH + x) * 2] = uint8_t(px);
+            img[(y * WIDTH + x) * 2 + 1] = uint8_t(px >> 8);
+        }
+    }
+    return img;
+}
+
+void append_frame(std::vector<uint8_t>& stream, const std::vector<uint8_t>& img, uint32_t seq, bool qoi)
+{
+    frame_desc_t desc = {};
+    desc.seq = seq;
+    desc.timestamp_us = seq * 100000;
+    desc.format = FRAME_FMT_RGB565;
+    desc.size = uint32_t(img.size());
+    desc.data = const_cast<uint8_t*>(img.data());
+
+    uint8_t header[FRAME_PROTO_HEADER_LEN];
+    if (!qoi) {
+        frame_proto_encode_header(header, &desc, WIDTH, HEIGHT, 0);
+        stream.insert(stream.end(), header, header + sizeof(header));
+        stream.insert(stream.end(), img.begin(), img.end());
+        return;
+    }
+
+    // one chunk per band, stored if it doesn't shrink - as pipeline.c does
+    frame_proto_encode_header(header, &desc, WIDTH, HEIGHT,
+                              FRAME_FLAG_CRC_TRAILER | FRAME_FLAG_CHUNKED | FRAME_FLAG_QOI16);
+    stream.insert(stream.end(), header, header + sizeof(header));
+    size_t start = stream.size();
+
+    qoi16_enc_t enc;
+    qoi16_enc_init(&enc);
+    size_t band_bytes = WIDTH * BAND_LINES * 2;
+    std::vector<uint8_t> chunk(QOI16_MAX_SIZE(band_bytes / 2));
+    for (size_t pos = 0; pos < img.size(); pos += band_bytes) {
+        size_t n = qoi16_encode(&enc, &img[pos], band_bytes / 2, chunk.data());
+        n += qoi16_finish(&enc, chunk.data() + n);
+        uint16_t len = uint16_t(n);
+        const uint8_t* data = chunk.data();
+        if (n >= band_bytes) {
+            len = uint16_t(band_bytes | FRAME_CHUNK_STORED);
+            data = &img[pos];
+            n = band_bytes;
+            qoi16_enc_init(&enc);
+        }
+        stream.push_back(uint8_t(len));
+        stream.push_back(uint8_t(len >> 8));
+        stream.insert(stream.end(), data, data + n);
+    }
+    stream.push_back(0);
+    stream.push_back(0);
+    put32(stream, crc32_calc(&stream[start], stream.size() - start));
+}
+
+void run(const char* name, bool qoi, double seconds)
+{
+    std::vector<uint8_t> stream;
+    for (uint32_t i = 0; i < FRAMES; i++)
+        append_frame(stream, test_image(i), i, qoi);
+
+    using clock = std::chrono::steady_clock;
+    std::vector<Frame> frames;
+    uint64_t bytes = 0, decoded = 0;
+    auto t0 = clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        FrameDecoder decoder;
+        for (size_t pos = 0; pos < stream.size(); pos += 4096) {
+            decoder.feed(stream.data() + pos, std::min<size_t>(4096, stream.size() - pos), frames);
+            decoded += frames.size();
+            frames.clear();
+        }
+        bytes += stream.size();
+        elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    if (decoded != bytes / stream.size() * FRAMES) {
+        printf("%-8s decoded %llu frames, expected %llu\n", name, (unsigned long long)decoded,
+               (unsigned long long)(bytes / stream.size() * FRAMES));
+        exit(1);
+    }
+
+    double mb_s = bytes / elapsed / 1e6;
+    printf("%-8s %6.1f KB/frame  %8.1f MB/s  %8.0f frames/s  %6.0fx 3 Mbaud\n", name,
+           stream.size() / 1e3 / FRAMES, mb_s, decoded / elapsed, bytes / elapsed / LINK_BYTES_PER_S);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    printf("QVGA RGB565, %d frames per stream, fed in 4 KiB reads\n", FRAMES);
+    run("raw", false, seconds);
+    run("qoi16", true, seconds);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+    bench_jpeg_enc - MCUs per second of the JPEG encoder (jpeg_enc.c).
+
+    Usage: bench_jpeg_enc [seconds per case]
+
+    QVGA YUYV frames (300 MCUs of 16x8) are encoded a row of MCUs at a
+    time as jpeg_stream.c does, at a few qualities and on three kinds
+    of content: flat grey, a camera-like scene and noise. The time per
+    MCU is mostly the DCT on flat content and mostly the Huffman coder
+    on noise. Cycles are TSC ticks on x86, nanoseconds elsewhere.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "jpeg_enc.h"
+}
+
+namespace {
+
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 240;
+constexpr int MCUS = (WIDTH / JPEG_MCU_WIDTH) * (HEIGHT / JPEG_MCU_HEIGHT);
+
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// 0 flat grey, 1 smooth gradients with a few edges and a little noise, 2 noise
+std::vector<uint8_t> test_frame(int kind)
+{
+    std::vector<uint8_t> f(WIDTH * HEIGHT * 2, 128);
+    uint32_t noise = 7;
+    for (int y = 0; y < HEIGHT && kind; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            noise = noise * 1103515245 + 12345;
+            uint8_t* p = &f[(y * WIDTH + x) * 2];
+            if (kind == 2) {
+                p[0] = uint8_t(noise >> 16);
+                p[1] = uint8_t(noise >> 24);
+                continue;
+            }
+            int v = 40 + x * 120 / WIDTH + y * 60 / HEIGHT + int((noise >> 16) % 5) - 2;
+            if ((x - 200) * (x - 200) + (y - 100) * (y - 100) < 2500)
+                v += 50;
+            p[0] = uint8_t(v);
+            p[1] = uint8_t(x % 2 ? 110 + y / 8 : 150 - x / 8);
+        }
+    }
+    return f;
+}
+
+struct Result {
+    double mcus_per_s;
+    double cycles_per_mcu;
+    uint32_t bytes;
+};
+
+Result run(const std::vector<uint8_t>& frame, int quality, double seconds)
+{
+    static uint8_t out[256 * 1024];
+    jpeg_enc_t enc;
+    jpeg_enc_init(&enc, WIDTH, HEIGHT, quality);
+
+    uint64_t frames = 0, c = 0;
+    uint32_t len = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double s;
+    while ((s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count()) < seconds) {
+        uint64_t c0 = cycles();
+        jpeg_enc_begin(&enc, out, sizeof(out));
+        for (int r = 0; r < HEIGHT / JPEG_MCU_HEIGHT; r++)
+            jpeg_enc_mcu_row(&enc, frame.data() + r * JPEG_MCU_HEIGHT * WIDTH * 2, WIDTH * 2);
+        len = jpeg_enc_end(&enc);
+        c += cycles() - c0;
+        frames++;
+    }
+    return { frames * MCUS / s, double(c) / double(frames * MCUS), len };
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    const char* names[] = { "flat", "scene", "noise" };
+
+    printf("%-6s %7s %8s %10s %11s %9s\n", "", "quality", "bytes", "MCU/s", "cycles/MCU", "QVGA fps");
+    for (int kind = 0; kind < 3; kind++) {
+        std::vector<uint8_t> frame = test_frame(kind);
+        for (int quality : { 50, 75, 90 }) {
+            Result r = run(frame, quality, seconds);
+            printf("%-6s %7d %8u %10.0f %11.0f %9.1f\n", names[kind], quality, r.bytes, r.mcus_per_s,
+                   r.cycles_per_mcu, r.mcus_per_s / MCUS);
+        }
+    }
+    return 0;
+}
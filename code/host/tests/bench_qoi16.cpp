@@ -0,0 +1,157 @@
+/*
+    bench_qoi16 - compression ratio and encode cycles per pixel of the
+    qoi16 encoder (qoi16.c).
+
+    Usage: bench_qoi16 [output.raw] [seconds per case]
+
+    QVGA RGB565 frames are coded in bands of PIPELINE_BAND_LINES lines
+    as pipeline.c does it: the run is flushed at the end of each band,
+    and a band that doesn't get smaller goes out stored, which resets
+    the encoder. The frames are output.raw (a capture saved by
+    recv_image.py --save-raw), create_test_image()'s bars from
+    framegrabber.c, a gradient scene and noise. The ratio counts the
+    2-byte chunk lengths and the end chunk. Cycles are TSC ticks on x86,
+    nanoseconds elsewhere, for qoi16_encode() and qoi16_finish() only.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "pipeline.h"
+#include "qoi16.h"
+}
+
+namespace {
+
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 240;
+constexpr size_t FRAME_BYTES = WIDTH * HEIGHT * 2;
+constexpr size_t BAND_PIXELS = WIDTH * PIPELINE_BAND_LINES;
+
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// as it is in framegrabber.c
+std::vector<uint8_t> create_test_image()
+{
+    std::vector<uint8_t> buffer(FRAME_BYTES);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            uint16_t color = y < 80 ? 0xF800 : y < 160 ? 0x07E0 : 0x001F;
+            int index = (y * WIDTH + x) * 2;
+            buffer[index] = color & 0xFF;
+            buffer[index + 1] = (color >> 8) & 0xFF;
+        }
+    }
+    return buffer;
+}
+
+// 0 smooth gradients with an edge and a little noise, 1 noise
+std::vector<uint8_t> test_frame(int kind)
+{
+    std::vector<uint8_t> f(FRAME_BYTES);
+    uint32_t noise = 7;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            noise = noise * 1103515245 + 12345;
+            uint16_t p = uint16_t(noise >> 16);
+            if (kind == 0) {
+                int r = x * 31 / WIDTH, g = y * 63 / HEIGHT, b = 20 + int((noise >> 16) % 3);
+                if ((x - 200) * (x - 200) + (y - 100) * (y - 100) < 2500)
+                    g = 63 - g;
+                p = uint16_t(r << 11 | g << 5 | b);
+            }
+            f[(y * WIDTH + x) * 2] = p & 0xFF;
+            f[(y * WIDTH + x) * 2 + 1] = p >> 8;
+        }
+    }
+    return f;
+}
+
+std::vector<uint8_t> read_raw(const char* path)
+{
+    std::vector<uint8_t> f(FRAME_BYTES);
+    FILE* fp = fopen(path, "rb");
+    if (!fp || fread(f.data(), 1, f.size(), fp) != f.size()) {
+        fprintf(stderr, "can't read a %zu byte frame from %s\n", f.size(), path);
+        exit(1);
+    }
+    fclose(fp);
+    return f;
+}
+
+struct Result {
+    size_t wire_bytes;      // chunk lengths, chunks and the end chunk
+    int bands_stored;
+    double cycles_per_px;
+    double mpx_per_s;
+};
+
+Result run(const std::vector<uint8_t>& frame, double seconds)
+{
+    static uint8_t chunk[QOI16_MAX_SIZE(BAND_PIXELS)];
+    qoi16_enc_t enc;
+    Result r = {};
+
+    uint64_t frames = 0, c = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double s;
+    while ((s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count()) < seconds) {
+        size_t wire = 2;
+        int stored = 0;
+        qoi16_enc_init(&enc);
+        for (size_t pos = 0; pos < FRAME_BYTES; pos += BAND_PIXELS * 2) {
+            uint64_t c0 = cycles();
+            size_t n = qoi16_encode(&enc, frame.data() + pos, BAND_PIXELS, chunk);
+            n += qoi16_finish(&enc, chunk + n);
+            c += cycles() - c0;
+            if (n >= BAND_PIXELS * 2) {
+                n = BAND_PIXELS * 2;
+                qoi16_enc_init(&enc);
+                stored++;
+            }
+            wire += 2 + n;
+        }
+        r.wire_bytes = wire;
+        r.bands_stored = stored;
+        frames++;
+    }
+    r.cycles_per_px = double(c) / double(frames * WIDTH * HEIGHT);
+    r.mpx_per_s = frames * WIDTH * HEIGHT / s / 1e6;
+    return r;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const char* raw_path = argc > 1 ? argv[1] : OUTPUT_RAW;
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+
+    const char* names[] = { "output.raw", "create_test_image", "scene", "noise" };
+    std::vector<uint8_t> frames[] = { read_raw(raw_path), create_test_image(), test_frame(0), test_frame(1) };
+
+    printf("QVGA RGB565, %d-line bands\n", PIPELINE_BAND_LINES);
+    printf("%-18s %8s %8s %7s %7s %10s %7s\n", "", "raw", "wire", "ratio", "stored", "cycles/px", "Mpx/s");
+    for (int i = 0; i < 4; i++) {
+        Result r = run(frames[i], seconds);
+        printf("%-18s %8zu %8zu %6.1f:1 %4d/%-2d %10.1f %7.1f\n", names[i], FRAME_BYTES, r.wire_bytes,
+               double(FRAME_BYTES) / r.wire_bytes, r.bands_stored, HEIGHT / PIPELINE_BAND_LINES, r.cycles_per_px,
+               r.mpx_per_s);
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+/*
+
+    check.hpp
+
+    CHECK() for the tests - a failure is printed and counted, and the 
+    test keeps going. main() returns check_result().
+*/
+
+#pragma once
+
+#include <cstdio>
+
+inline int check_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+inline int check_result()
+{
+    if (check_failures)
+        fprintf(stderr, "%d checks failed\n", check_failures);
+    return check_failures ? 1 : 0;
+}
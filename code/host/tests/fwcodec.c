@@ -0,0 +1,198 @@
+/*
+    fwcodec - firmware encoders on the host, for the Python tests to
+    check their decoders against (test_*.py in ../../framegrabber).
+
+    Usage: fwcodec frame <format> <flags> <width> <height> <seq> <timestamp_us>
+           fwcodec qoi16 <band_bytes>
+           fwcodec tiles <width> <height> <bpp> <threshold> <keyframe_interval>
+
+    Each reads stdin and writes stdout.
+
+    frame   the payload as the firmware sends it - header (frame_proto.c),
+            payload and, with FRAME_FLAG_CRC_TRAILER, the CRC trailer
+    qoi16   16-bit pixels as the chunks of a FRAME_FLAG_QOI16 frame, one
+            per band as pipeline.c codes them, ending with the empty
+            chunk
+    tiles   whole frames, back to back, as tile_delta.c sends them -
+            keyframes and deltas. Frame n gets sequence number 2n, as
+            if every other capture was dropped.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "frame_proto.h"
+#include "qoi16.h"
+#include "tile_delta.h"
+
+static uint8_t* read_all(FILE* f, size_t* len)
+{
+    size_t cap = 1 << 16;
+    uint8_t* buf = malloc(cap);
+    *len = 0;
+    size_t n;
+    while ((n = fread(buf + *len, 1, cap - *len, f)) > 0) {
+        *len += n;
+        if (*len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+    return buf;
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+static int cmd_frame(int argc, char** argv)
+{
+    if (argc != 6) {
+        return 2;
+    }
+
+    size_t len;
+    uint8_t* payload = read_all(stdin, &len);
+
+    frame_desc_t desc = {0};
+    desc.format = strtoul(argv[0], NULL, 0);
+    uint8_t flags = strtoul(argv[1], NULL, 0);
+    uint16_t width = strtoul(argv[2], NULL, 0);
+    uint16_t height = strtoul(argv[3], NULL, 0);
+    desc.seq = strtoul(argv[4], NULL, 0);
+    desc.timestamp_us = strtoul(argv[5], NULL, 0);
+    desc.size = len;
+    desc.data = payload;
+
+    uint8_t header[FRAME_PROTO_HEADER_LEN];
+    frame_proto_encode_header(header, &desc, width, height, flags);
+    fwrite(header, 1, sizeof(header), stdout);
+    fwrite(payload, 1, len, stdout);
+    if (flags & FRAME_FLAG_CRC_TRAILER) {
+        uint8_t trailer[4];
+        put_u32(trailer, crc32_calc(payload, len));
+        fwrite(trailer, 1, sizeof(trailer), stdout);
+    }
+
+    free(payload);
+    return 0;
+}
+
+static void put_chunk(uint16_t len, const uint8_t* data, size_t n)
+{
+    uint8_t prefix[2] = { len & 0xFF, len >> 8 };
+    fwrite(prefix, 1, sizeof(prefix), stdout);
+    if (n) {
+        fwrite(data, 1, n, stdout);
+    }
+}
+
+// Code each band as a chunk, stored if it doesn't get smaller - as
+// pipeline.c does
+static int cmd_qoi16(int argc, char** argv)
+{
+    if (argc != 1) {
+        return 2;
+    }
+    size_t band_bytes = strtoul(argv[0], NULL, 0);
+    if (!band_bytes || band_bytes % 2 || band_bytes >= FRAME_CHUNK_STORED) {
+        return 2;
+    }
+
+    size_t len;
+    uint8_t* pixels = read_all(stdin, &len);
+    uint8_t* chunk = malloc(QOI16_MAX_SIZE(band_bytes / 2));
+
+    qoi16_enc_t qoi;
+    qoi16_enc_init(&qoi);
+    for (size_t pos = 0; pos + 1 < len; pos += band_bytes) {
+        size_t band = len - pos < band_bytes ? (len - pos) & ~1u : band_bytes;
+        size_t n = qoi16_encode(&qoi, pixels + pos, band / 2, chunk);
+        n += qoi16_finish(&qoi, chunk + n);
+        if (n >= band) {
+            put_chunk(band | FRAME_CHUNK_STORED, pixels + pos, band);
+            qoi16_enc_init(&qoi);
+        } else {
+            put_chunk(n, chunk, n);
+        }
+    }
+    put_chunk(0, NULL, 0);
+
+    free(chunk);
+    free(pixels);
+    return 0;
+}
+
+uint32_t time_us_32(void)
+{
+    return 0;
+}
+
+static bool stdout_send(transport_t* t, const uint8_t* data, size_t len)
+{
+    fwrite(data, 1, len, stdout);
+    t->bytes_sent += len;
+    t->transfers++;
+    return true;
+}
+
+static bool stdout_is_busy(transport_t* t)
+{
+    (void)t;
+    return false;
+}
+
+static int cmd_tiles(int argc, char** argv)
+{
+    if (argc != 5) {
+        return 2;
+    }
+    uint16_t width = strtoul(argv[0], NULL, 0);
+    uint16_t height = strtoul(argv[1], NULL, 0);
+    uint bpp = strtoul(argv[2], NULL, 0);
+    if (!tile_delta_init(width, height, bpp, strtoul(argv[3], NULL, 0), strtoul(argv[4], NULL, 0))) {
+        return 2;
+    }
+
+    size_t len;
+    uint8_t* frames = read_all(stdin, &len);
+    uint32_t frame_bytes = width * height * bpp;
+
+    transport_t t = { .send_async = stdout_send, .is_busy = stdout_is_busy };
+    for (uint32_t n = 0; (n + 1) * frame_bytes <= len; n++) {
+        frame_desc_t desc = {0};
+        desc.seq = 2 * n;
+        desc.format = bpp == 1 ? FRAME_FMT_Y8 : FRAME_FMT_YUV422;
+        desc.size = frame_bytes;
+        desc.data = frames + n * frame_bytes;
+        tile_delta_send(&t, &desc);
+    }
+
+    free(frames);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int rc = 2;
+    if (argc >= 2 && !strcmp(argv[1], "frame")) {
+        rc = cmd_frame(argc - 2, argv + 2);
+    } else if (argc >= 2 && !strcmp(argv[1], "qoi16")) {
+        rc = cmd_qoi16(argc - 2, argv + 2);
+    } else if (argc >= 2 && !strcmp(argv[1], "tiles")) {
+        rc = cmd_tiles(argc - 2, argv + 2);
+    }
+    if (rc == 2) {
+        fprintf(stderr, "Usage: %s frame <format> <flags> <width> <height> <seq> <timestamp_us>\n"
+                        "       %s qoi16 <band_bytes>\n"
+                        "       %s tiles <width> <height> <bpp> <threshold> <keyframe_interval>\n",
+                argv[0], argv[0], argv[0]);
+    }
+    return rc;
+}
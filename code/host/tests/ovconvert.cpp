@@ -0,0 +1,77 @@
+/*
+    ovconvert - convert one frame with the host library, for the Python
+    tests to compare against recv_image.py and demosaic.py.
+
+    Usage: ovconvert <format> <width> <height> <rgb|rgba> <flip> [isa] [bilinear|edge]
+
+    format is yuv422, rgb565, y8 or bayer, flip 0 or 1 and isa scalar,
+    sse2 or avx2 (the best the CPU has if left out). Bayer frames use
+    the given demosaic method, edge if left out. Reads the frame from
+    stdin and writes the pixels to stdout. Exits with 3 if the isa
+    isn't supported here.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ovrecv/convert.hpp"
+
+using namespace ovrecv;
+
+int main(int argc, char** argv)
+{
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s <format> <width> <height> <rgb|rgba> <flip> [isa] [bilinear|edge]\n", argv[0]);
+        return 2;
+    }
+
+    Format format;
+    if (!strcmp(argv[1], "yuv422"))
+        format = Format::YUV422;
+    else if (!strcmp(argv[1], "rgb565"))
+        format = Format::RGB565;
+    else if (!strcmp(argv[1], "y8"))
+        format = Format::Y8;
+    else if (!strcmp(argv[1], "bayer"))
+        format = Format::BAYER;
+    else
+        return 2;
+
+    int width = atoi(argv[2]);
+    int height = atoi(argv[3]);
+    Layout layout = strcmp(argv[4], "rgba") ? Layout::RGB888 : Layout::RGBA8888;
+    bool flip = atoi(argv[5]) != 0;
+
+    if (argc > 6) {
+        const Isa isas[] = { Isa::Scalar, Isa::SSE2, Isa::AVX2 };
+        bool found = false;
+        for (Isa isa : isas) {
+            if (!strcmp(argv[6], isa_name(isa))) {
+                if (convert_force_isa(isa) != isa)
+                    return 3;
+                found = true;
+            }
+        }
+        if (!found)
+            return 2;
+    }
+    Demosaic method = (argc > 7 && !strcmp(argv[7], "bilinear")) ? Demosaic::Bilinear : Demosaic::EdgeAware;
+
+    size_t src_size = size_t(width) * height * (format == Format::YUV422 || format == Format::RGB565 ? 2 : 1);
+    std::vector<uint8_t> src(src_size);
+    if (fread(src.data(), 1, src_size, stdin) != src_size) {
+        fprintf(stderr, "%s: short frame\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> dst(size_t(width) * height * bytes_per_pixel(layout));
+    bool ok = format == Format::BAYER
+        ? demosaic(src.data(), width, height, dst.data(), layout, flip, method)
+        : convert(format, src.data(), width, height, dst.data(), layout, flip);
+    if (!ok)
+        return 1;
+    fwrite(dst.data(), 1, dst.size(), stdout);
+    return 0;
+}
@@ -0,0 +1,37 @@
+/*
+
+    hardware/gpio.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h.
+*/
+
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+typedef enum {
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+} gpio_function_t;
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, gpio_function_t fn);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,29 @@
+/*
+
+    hardware/i2c.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h.
+*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i2c_inst i2c_inst_t;
+
+#define i2c0 ((i2c_inst_t*)0)
+#define i2c1 ((i2c_inst_t*)1)
+
+uint i2c_init(i2c_inst_t* i2c, uint baudrate);
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                         uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, uint timeout_us);
+int i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop);
+
+#ifdef __cplusplus
+}
+#endif
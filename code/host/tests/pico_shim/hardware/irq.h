@@ -0,0 +1,23 @@
+/*
+
+    hardware/irq.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h.
+*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
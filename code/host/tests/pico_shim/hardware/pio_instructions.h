@@ -0,0 +1,93 @@
+/*
+
+    hardware/pio_instructions.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h. The 
+    encodings are the real ones, so generated programs can be run 
+    by a simulator.
+*/
+
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum pio_instr_bits {
+    pio_instr_bits_jmp = 0x0000,
+    pio_instr_bits_wait = 0x2000,
+    pio_instr_bits_in = 0x4000,
+    pio_instr_bits_out = 0x6000,
+    pio_instr_bits_push = 0x8000,
+    pio_instr_bits_pull = 0x8080,
+    pio_instr_bits_mov = 0xa000,
+    pio_instr_bits_irq = 0xc000,
+    pio_instr_bits_set = 0xe000,
+};
+
+// the 3-bit source/destination field - the SDK also packs validity 
+// flags in, which the encoders here don't check
+enum pio_src_dest {
+    pio_pins = 0,
+    pio_x = 1,
+    pio_y = 2,
+    pio_null = 3,
+    pio_pindirs = 4,
+    pio_exec_mov = 4,
+    pio_status = 5,
+    pio_pc = 5,
+    pio_isr = 6,
+    pio_osr = 7,
+    pio_exec_out = 7,
+};
+
+static inline uint _pio_encode_instr_and_args(enum pio_instr_bits bits, uint arg1, uint arg2)
+{
+    return (uint)bits | ((arg1 & 7u) << 5) | (arg2 & 0x1fu);
+}
+
+static inline uint pio_encode_jmp(uint addr)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_jmp, 0, addr);
+}
+
+static inline uint pio_encode_jmp_x_dec(uint addr)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_jmp, 2, addr);
+}
+
+static inline uint pio_encode_jmp_y_dec(uint addr)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_jmp, 4, addr);
+}
+
+static inline uint pio_encode_wait_gpio(bool polarity, uint gpio)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_wait, polarity ? 4 : 0, gpio);
+}
+
+static inline uint pio_encode_in(enum pio_src_dest src, uint count)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_in, src, count);
+}
+
+static inline uint pio_encode_pull(bool if_empty, bool block)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_pull, (if_empty ? 2 : 0) | (block ? 1 : 0), 0);
+}
+
+static inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_mov, dest, src);
+}
+
+static inline uint pio_encode_set(enum pio_src_dest dest, uint value)
+{
+    return _pio_encode_instr_and_args(pio_instr_bits_set, dest, value);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+/*
+
+    hardware/structs/sio.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h. sio_hw
+    is a pointer the test defines, not the register block.
+*/
+
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t gpio_in;
+} sio_hw_t;
+
+extern sio_hw_t* sio_hw;
+
+#ifdef __cplusplus
+}
+#endif
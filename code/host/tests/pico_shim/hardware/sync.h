@@ -0,0 +1,23 @@
+/*
+
+    hardware/sync.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h. The SDK 
+    has __sev() and __wfe() as inline asm; here they are functions the 
+    test defines.
+*/
+
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void __sev(void);
+void __wfe(void);
+
+#ifdef __cplusplus
+}
+#endif
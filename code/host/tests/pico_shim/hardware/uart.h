@@ -0,0 +1,31 @@
+/*
+
+    hardware/uart.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h.
+*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uart_inst uart_inst_t;
+
+#define uart0 ((uart_inst_t*)0)
+#define uart1 ((uart_inst_t*)1)
+
+#define UART0_IRQ 33
+#define UART_IRQ_NUM(uart) (UART0_IRQ + uart_get_index(uart))
+
+uint uart_get_index(uart_inst_t* uart);
+bool uart_is_readable(uart_inst_t* uart);
+char uart_getc(uart_inst_t* uart);
+void uart_set_irq_enables(uart_inst_t* uart, bool rx_has_data, bool tx_needs_data);
+
+#ifdef __cplusplus
+}
+#endif
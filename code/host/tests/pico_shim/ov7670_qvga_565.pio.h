@@ -0,0 +1,25 @@
+/*
+
+    ov7670_qvga_565.pio.h
+
+    Host stand-in for the header pioasm generates from ../../framegrabber/ov7670_qvga_565.pio.
+    The tests model the state machine, so the program is empty.
+*/
+
+#pragma once
+
+#include "hardware/pio.h"
+
+static const uint16_t ov7670_qvga_565_program_instructions[] = { 0 };
+
+static const pio_program_t ov7670_qvga_565_program = {
+    .instructions = ov7670_qvga_565_program_instructions,
+    .length = 1,
+    .origin = -1,
+};
+
+static inline pio_sm_config ov7670_qvga_565_program_get_default_config(uint offset)
+{
+    (void)offset;
+    return pio_get_default_sm_config();
+}
@@ -0,0 +1,18 @@
+/*
+
+    pico/stdlib.h
+
+    Host stand-in for the Pico SDK header, so firmware modules build 
+    into the tests. Only the calls those modules make are declared - 
+    each test defines them.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
@@ -0,0 +1,17 @@
+/*
+
+    pico/types.h
+
+    Host stand-in for the Pico SDK header - see pico/stdlib.h.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+// microseconds since boot
+typedef uint64_t absolute_time_t;
@@ -0,0 +1,25 @@
+/*
+
+    pwm.pio.h
+
+    Host stand-in for the header pioasm generates from ../../framegrabber/pwm.pio.
+    The tests model the state machine, so the program is empty.
+*/
+
+#pragma once
+
+#include "hardware/pio.h"
+
+static const uint16_t pwm_generator_program_instructions[] = { 0 };
+
+static const pio_program_t pwm_generator_program = {
+    .instructions = pwm_generator_program_instructions,
+    .length = 1,
+    .origin = -1,
+};
+
+static inline pio_sm_config pwm_generator_program_get_default_config(uint offset)
+{
+    (void)offset;
+    return pio_get_default_sm_config();
+}
@@ -0,0 +1,162 @@
+/*
+    transport_t on a pseudo-terminal - see pty_transport.h.
+*/
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "pty_transport.h"
+
+struct pty_transport {
+    transport_t base;       // first, so a transport_t* is a pty_transport_t*
+    int fd;
+    char path[64];
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // the transfer in flight - set by send_async, cleared by the writer
+    const uint8_t* data;
+    size_t len;
+    bool busy;
+    bool stop;
+};
+
+static void* pty_writer(void* arg)
+{
+    pty_transport_t* p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->busy && !p->stop) {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+        if (!p->busy) {
+            break;
+        }
+        const uint8_t* data = p->data;
+        size_t len = p->len;
+        pthread_mutex_unlock(&p->lock);
+
+        while (len > 0) {
+            ssize_t n = write(p->fd, data, len);
+            if (n <= 0) {
+                break;
+            }
+            data += n;
+            len -= (size_t)n;
+        }
+
+        // unlocked, so the callback can start the next transfer
+        pthread_mutex_lock(&p->lock);
+        p->busy = false;
+        pthread_mutex_unlock(&p->lock);
+        if (p->base.done_cb) {
+            p->base.done_cb(p->base.user_data);
+        }
+        pthread_mutex_lock(&p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static bool pty_send_async(transport_t* t, const uint8_t* data, size_t len)
+{
+    pty_transport_t* p = (pty_transport_t*)t;
+
+    pthread_mutex_lock(&p->lock);
+    bool ok = !p->busy;
+    if (ok) {
+        p->data = data;
+        p->len = len;
+        p->busy = true;
+        t->bytes_sent += len;
+        t->transfers++;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+static bool pty_is_busy(transport_t* t)
+{
+    pty_transport_t* p = (pty_transport_t*)t;
+
+    pthread_mutex_lock(&p->lock);
+    bool busy = p->busy;
+    pthread_mutex_unlock(&p->lock);
+
+    // transport_send() spins on this - on one core the writer needs the CPU
+    if (busy) {
+        sched_yield();
+    }
+    return busy;
+}
+
+pty_transport_t* pty_transport_open(void)
+{
+    pty_transport_t* p = calloc(1, sizeof(*p));
+    if (!p) {
+        return NULL;
+    }
+
+    p->fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (p->fd < 0 || grantpt(p->fd) || unlockpt(p->fd) || ptsname_r(p->fd, p->path, sizeof(p->path))) {
+        if (p->fd >= 0) {
+            close(p->fd);
+        }
+        free(p);
+        return NULL;
+    }
+
+    // raw - no echo or newline translation, whatever the host end sets
+    struct termios tio;
+    if (tcgetattr(p->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(p->fd, TCSANOW, &tio);
+    }
+
+    p->base.send_async = pty_send_async;
+    p->base.is_busy = pty_is_busy;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    pthread_create(&p->thread, NULL, pty_writer, p);
+    return p;
+}
+
+void pty_transport_close(pty_transport_t* p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stop = true;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    close(p->fd);
+    free(p);
+}
+
+transport_t* pty_transport_get(pty_transport_t* p)
+{
+    return &p->base;
+}
+
+const char* pty_transport_path(pty_transport_t* p)
+{
+    return p->path;
+}
+
+int pty_transport_fd(pty_transport_t* p)
+{
+    return p->fd;
+}
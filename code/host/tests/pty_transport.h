@@ -0,0 +1,40 @@
+/*
+
+    pty_transport.h
+
+    transport_t (transport.h) on the master end of a POSIX pseudo-
+    terminal, so the firmware's send paths can run on the host. The 
+    host end opens pty_transport_path() with ovrecv::SerialPort, as 
+    it would a USB-serial adapter.
+
+    A writer thread stands in for the UART's DMA channel: send_async 
+    hands it the buffer and returns, and done_cb is called from that 
+    thread once the last byte is in the pty - as uart_dma.c calls it 
+    from the DMA IRQ. The pty's buffer fills if the host end doesn't 
+    read, so a slow reader holds the sender up like a slow link.
+*/
+
+#pragma once
+
+#include "transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pty_transport pty_transport_t;
+
+// NULL if no pty could be opened
+pty_transport_t* pty_transport_open(void);
+// Waits for the transfer in flight
+void pty_transport_close(pty_transport_t* p);
+
+transport_t* pty_transport_get(pty_transport_t* p);
+// The slave end, for the host to open
+const char* pty_transport_path(pty_transport_t* p);
+// The master end - what the host writes can be read from it
+int pty_transport_fd(pty_transport_t* p);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,722 @@
+/*
+    Simulated sensor, capture path and UART - see sim_sensor.hpp.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+
+}
+
+namespace sim {
+
+uint64_t now_us = 1000000;
+
+namespace {
+
+// events in time order, and in the order they were added for the same time
+std::multimap<uint64_t, std::function<void()>> events;
+
+Sensor sensor;
+ov7670_capture_desc_t window;
+uint64_t sensor_t0;
+SensorStats stats;
+uint8_t rev[256];
+
+// capture SM
+bool sm_enabled;
+bool sm_armed;              // has the parameters for the next frame
+bool sm_capturing;
+std::deque<uint32_t> tx_fifo;
+std::deque<uint8_t> rx;
+
+// the two DMA channels - index is the channel number
+struct Channel {
+    uint32_t ctrl = 0;      // bit 0 write increment, bits 8-11 chain to
+    uint8_t* write = nullptr;
+    uint32_t count = 0;     // reload value
+    uint32_t left = 0;
+    bool busy = false, irq = false, irq_enabled = false;
+};
+Channel chans[2];
+int claimed;
+irq_handler_t dma_irq;
+bool dma_irq_enabled;
+bool irq_scheduled;
+
+void run_dma_irq()
+{
+    irq_scheduled = false;
+    if (dma_irq && dma_irq_enabled && (chans[0].irq || chans[1].irq))
+        dma_irq();
+}
+
+// Move whole words from the RX FIFO to the running channel
+void dma_pump()
+{
+    while (rx.size() >= 4) {
+        Channel* c = chans[0].busy ? &chans[0] : chans[1].busy ? &chans[1] : nullptr;
+        uint8_t word[4];
+        for (int i = 0; i < 4; i++) {
+            word[i] = rx.front();
+            rx.pop_front();
+        }
+        if (!c) {
+            stats.rx_overflows++;
+            continue;
+        }
+        memcpy(c->write, word, 4);
+        if (c->ctrl & 1)
+            c->write += 4;
+        if (--c->left)
+            continue;
+
+        c->busy = false;
+        c->irq = c->irq_enabled;
+        Channel& next = chans[(c->ctrl >> 8) & 15];
+        next.busy = true;
+        next.left = next.count;
+        if (c->irq && !irq_scheduled) {
+            irq_scheduled = true;
+            at(now_us + sensor.irq_latency_us, run_dma_irq);
+        }
+    }
+}
+
+// The SM pulls the next frame's parameters as soon as it is free
+void sm_pull()
+{
+    if (!sm_enabled || sm_armed || sm_capturing || tx_fifo.size() < 2)
+        return;
+    uint32_t lines = tx_fifo[0], bytes = tx_fifo[1];
+    tx_fifo.pop_front();
+    tx_fifo.pop_front();
+    if (lines != window.height - 1 || bytes != ov7670_capture_line_bytes(&window) - 1)
+        stats.bad_params++;
+    sm_armed = true;
+}
+
+uint32_t line_us()
+{
+    return (sensor.period_us - sensor.vblank_us - sensor.front_porch_us) / sensor.lines;
+}
+
+void frame_start(uint32_t f);
+
+void line_end(uint32_t f, uint l)
+{
+    if (sm_capturing && l >= window.skip_lines && l < window.skip_lines + window.height) {
+        uint bpp = window.bytes_per_pixel;
+        for (uint p = window.skip_pixels; p < window.skip_pixels + window.width; p++) {
+            if (window.luma_only) {
+                rx.push_back(rev[sensor.byte(f, l, p * bpp)]);
+            } else {
+                for (uint i = 0; i < bpp; i++)
+                    rx.push_back(rev[sensor.byte(f, l, p * bpp + i)]);
+            }
+        }
+        dma_pump();
+        if (l == window.skip_lines + window.height - 1) {
+            sm_capturing = false;
+            stats.captured++;
+            sm_pull();
+        }
+    }
+
+    if (l + 1 < sensor.lines)
+        at(frame_start_us(f) + sensor.vblank_us + uint64_t(l + 2) * line_us(), [f, l] { line_end(f, l + 1); });
+    else
+        at(frame_start_us(f + 1), [f] { frame_start(f + 1); });
+}
+
+void frame_start(uint32_t f)
+{
+    if (sensor.skip && sensor.skip(f)) {
+        at(frame_start_us(f + 1), [f] { frame_start(f + 1); });
+        return;
+    }
+    stats.frames++;
+    if (sm_armed) {
+        sm_armed = false;
+        sm_capturing = true;
+    } else {
+        stats.missed++;
+    }
+    at(frame_start_us(f) + sensor.vblank_us + line_us(), [f] { line_end(f, 0); });
+}
+
+// the UART - transport_t first, so the transport is the Uart
+struct Uart {
+    transport_t t;
+    uint32_t baud;
+    bool busy;
+    uint64_t busy_us;
+    std::vector<uint8_t> wire;
+    std::deque<uint8_t> rx;
+    uint64_t rx_free_us;        // when the last byte queued on RX has arrived
+};
+Uart uart;
+irq_handler_t uart_irq;
+bool uart_irq_enabled;
+bool uart_rx_irq_enabled;
+
+uint64_t byte_us()
+{
+    return (10 * 1000000ull + uart.baud - 1) / uart.baud;
+}
+
+void uart_rx_byte(uint8_t b)
+{
+    uart.rx.push_back(b);
+    if (uart_irq && uart_irq_enabled && uart_rx_irq_enabled)
+        uart_irq();
+}
+
+// SCCB - the sensor at 0x21 (0x42 >> 1)
+constexpr uint8_t SCCB_ADDR = 0x21;
+constexpr uint8_t SCCB_COM7 = 0x12;
+
+// Reset values from the OV7670 datasheet - 0 for the rest
+const std::pair<uint8_t, uint8_t> sccb_defaults[] = {
+    { 0x01, 0x80 }, { 0x02, 0x80 }, { 0x0A, 0x76 }, { 0x0B, 0x73 }, { 0x0E, 0x01 }, { 0x0F, 0x43 },
+    { 0x10, 0x40 }, { 0x11, 0x80 }, { 0x13, 0x8F }, { 0x14, 0x4A }, { 0x17, 0x11 }, { 0x18, 0x61 },
+    { 0x19, 0x03 }, { 0x1A, 0x7B }, { 0x1C, 0x7F }, { 0x1D, 0xA2 }, { 0x1E, 0x01 }, { 0x24, 0x75 },
+    { 0x25, 0x63 }, { 0x26, 0xD4 }, { 0x32, 0x80 }, { 0x3A, 0x0D }, { 0x3C, 0x40 }, { 0x3D, 0x88 },
+    { 0x40, 0xC0 }, { 0x41, 0x08 }, { 0x4F, 0x40 }, { 0x50, 0x34 }, { 0x51, 0x0C }, { 0x52, 0x17 },
+    { 0x53, 0x29 }, { 0x54, 0x40 }, { 0x56, 0x40 }, { 0x58, 0x1E }, { 0x6B, 0x0A }, { 0x70, 0x3A },
+    { 0x71, 0x35 }, { 0x72, 0x11 }, { 0xA2, 0x02 },
+};
+
+constexpr uint VSYNC_PIN = 2, RESET_PIN = 15;
+
+bool sensor_on;
+
+struct Sccb {
+    uint8_t regs[256];
+    uint8_t pointer = 0;            // register address of the next read
+    uint32_t baud = 100000;
+    uint32_t pin_reset_us = SCCB_RESET_US;
+    uint32_t com7_reset_us = SCCB_RESET_US;
+    bool held = false;              // RESET pin low
+    uint64_t busy_until = 0;        // NAKs until then
+    uint64_t busy_us = 0;
+    std::vector<SccbOp> log;
+};
+Sccb sccb;
+
+void sccb_defaults_load()
+{
+    memset(sccb.regs, 0, sizeof(sccb.regs));
+    for (auto& d : sccb_defaults)
+        sccb.regs[d.first] = d.second;
+}
+
+// A transaction of len data bytes after the address byte - false for a NAK
+bool sccb_transfer(size_t len)
+{
+    uint64_t us = ((2 + 9 * (1 + uint64_t(len))) * 1000000 + sccb.baud - 1) / sccb.baud;
+    sccb.busy_us += us;
+    run_until(now_us + us);
+    return !sccb.held && now_us >= sccb.busy_until;
+}
+
+void timer_fire(repeating_timer_t* rt, uint64_t t)
+{
+    if (rt->callback(rt))
+        at(t + rt->delay_us, [rt, t] { timer_fire(rt, t + rt->delay_us); });
+}
+
+bool uart_send_async(transport_t*, const uint8_t* data, size_t len)
+{
+    if (uart.busy)
+        return false;
+    uart.busy = true;
+    uint64_t us = (uint64_t(len) * 10 * 1000000 + uart.baud - 1) / uart.baud;
+    uart.busy_us += us;
+    at(now_us + us, [data, len] {
+        uart.wire.insert(uart.wire.end(), data, data + len);
+        uart.t.bytes_sent += uint32_t(len);
+        uart.t.transfers++;
+        uart.busy = false;
+        if (uart.t.done_cb)
+            uart.t.done_cb(uart.t.user_data);
+    });
+    return true;
+}
+
+bool uart_is_busy(transport_t*)
+{
+    if (uart.busy)
+        step();
+    return uart.busy;
+}
+
+}
+
+void reset()
+{
+    events.clear();
+    sm_enabled = sm_armed = sm_capturing = false;
+    tx_fifo.clear();
+    rx.clear();
+    for (auto& c : chans)
+        c = Channel();
+    claimed = 0;
+    irq_scheduled = false;
+    stats = SensorStats();
+    sensor_on = false;
+    uart.rx.clear();
+    uart.rx_free_us = 0;
+    uint32_t baud = sccb.baud;
+    sccb = Sccb();
+    sccb.baud = baud;
+    sccb_defaults_load();
+}
+
+void at(uint64_t t, std::function<void()> fn)
+{
+    events.emplace(t, std::move(fn));
+}
+
+bool step()
+{
+    if (events.empty())
+        return false;
+    auto it = events.begin();
+    if (it->first > now_us)
+        now_us = it->first;
+    auto fn = std::move(it->second);
+    events.erase(it);
+    fn();
+    return true;
+}
+
+void run_until(uint64_t t)
+{
+    while (!events.empty() && events.begin()->first <= t)
+        step();
+    if (t > now_us)
+        now_us = t;
+}
+
+void sensor_start(const Sensor& s, const ov7670_capture_desc_t& desc, uint64_t start_us)
+{
+    for (int b = 0; b < 256; b++) {
+        uint8_t r = 0;
+        for (int i = 0; i < 8; i++)
+            r |= ((b >> i) & 1) << (7 - i);
+        rev[b] = r;
+    }
+    sensor = s;
+    window = desc;
+    sensor_t0 = start_us;
+    sensor_on = true;
+    at(start_us, [] { frame_start(0); });
+}
+
+uint64_t frame_start_us(uint32_t f)
+{
+    return sensor_t0 + uint64_t(f) * sensor.period_us;
+}
+
+uint64_t frame_end_us(uint32_t f, const ov7670_capture_desc_t& desc)
+{
+    return frame_start_us(f) + sensor.vblank_us + uint64_t(desc.skip_lines + desc.height) * line_us();
+}
+
+uint32_t frame_at(uint64_t t)
+{
+    return t < sensor_t0 ? 0 : uint32_t((t - sensor_t0) / sensor.period_us);
+}
+
+const SensorStats& sensor_stats()
+{
+    return stats;
+}
+
+std::vector<uint8_t> expected_frame(uint32_t f, const ov7670_capture_desc_t& desc)
+{
+    std::vector<uint8_t> out;
+    uint bpp = desc.bytes_per_pixel;
+    for (uint l = desc.skip_lines; l < desc.skip_lines + desc.height; l++) {
+        for (uint p = desc.skip_pixels; p < desc.skip_pixels + desc.width; p++) {
+            if (desc.luma_only) {
+                out.push_back(sensor.byte(f, l, p * bpp));
+            } else {
+                for (uint i = 0; i < bpp; i++)
+                    out.push_back(sensor.byte(f, l, p * bpp + i));
+            }
+        }
+    }
+    return out;
+}
+
+transport_t* uart_open(uint32_t baud)
+{
+    uart = Uart();
+    uart.t.send_async = uart_send_async;
+    uart.t.is_busy = uart_is_busy;
+    uart.baud = baud;
+    return &uart.t;
+}
+
+std::vector<uint8_t>& uart_wire()
+{
+    return uart.wire;
+}
+
+void uart_rx(const std::vector<uint8_t>& bytes)
+{
+    uint64_t t = std::max(now_us, uart.rx_free_us);
+    for (uint8_t b : bytes) {
+        t += byte_us();
+        at(t, [b] { uart_rx_byte(b); });
+    }
+    uart.rx_free_us = t;
+}
+
+uint64_t uart_busy_us()
+{
+    return uart.busy_us;
+}
+
+const std::vector<SccbOp>& sccb_log()
+{
+    return sccb.log;
+}
+
+void sccb_clear_log()
+{
+    sccb.log.clear();
+}
+
+uint8_t sccb_reg(uint8_t reg)
+{
+    return sccb.regs[reg];
+}
+
+void sccb_set_reg(uint8_t reg, uint8_t value)
+{
+    sccb.regs[reg] = value;
+}
+
+uint64_t sccb_busy_us()
+{
+    return sccb.busy_us;
+}
+
+void sccb_timing(uint32_t pin_reset_us, uint32_t com7_reset_us)
+{
+    sccb.pin_reset_us = pin_reset_us;
+    sccb.com7_reset_us = com7_reset_us;
+}
+
+}
+
+using sim::chans;
+using sim::sccb;
+using sim::now_us;
+
+extern "C" {
+
+// Time
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(now_us);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return now_us + ms * 1000ull;
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return now_us >= t;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sim::run_until(now_us + ms * 1000ull);
+}
+
+void sleep_us(uint64_t us)
+{
+    sim::run_until(now_us + us);
+}
+
+// Fires from the event loop, start to start whatever the sign
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void* user_data,
+                            repeating_timer_t* out)
+{
+    out->delay_us = int64_t(delay_ms < 0 ? -delay_ms : delay_ms) * 1000;
+    out->callback = callback;
+    out->user_data = user_data;
+    uint64_t t = now_us + out->delay_us;
+    sim::at(t, [out, t] { sim::timer_fire(out, t); });
+    return true;
+}
+
+// WFE returns at the next event - the simulation runs on one thread,
+// so anything posted before it is already pending
+void __wfe(void)
+{
+    sim::step();
+}
+
+void __sev(void)
+{
+}
+
+// The stream path
+
+int dma_claim_unused_channel(bool)
+{
+    return sim::claimed++;
+}
+
+void dma_channel_unclaim(uint)
+{
+    sim::claimed--;
+}
+
+dma_channel_config dma_channel_get_default_config(uint)
+{
+    return dma_channel_config();
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool incr)
+{
+    c->ctrl = (c->ctrl & ~1u) | incr;
+}
+
+void channel_config_set_chain_to(dma_channel_config* c, uint chain_to)
+{
+    c->ctrl = (c->ctrl & ~0xf00u) | chain_to << 8;
+}
+
+void dma_channel_configure(uint ch, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void*, uint count, bool trigger)
+{
+    chans[ch].ctrl = config->ctrl;
+    chans[ch].write = (uint8_t*)write_addr;
+    chans[ch].count = chans[ch].left = count;
+    chans[ch].busy = trigger;
+}
+
+void dma_channel_set_config(uint ch, const dma_channel_config* config, bool)
+{
+    chans[ch].ctrl = config->ctrl;
+}
+
+void dma_channel_set_write_addr(uint ch, volatile void* write_addr, bool)
+{
+    chans[ch].write = (uint8_t*)write_addr;
+}
+
+void dma_channel_set_trans_count(uint ch, uint32_t count, bool)
+{
+    chans[ch].count = count;
+}
+
+void dma_channel_start(uint ch)
+{
+    chans[ch].busy = true;
+    chans[ch].left = chans[ch].count;
+}
+
+void dma_channel_abort(uint ch)
+{
+    chans[ch].busy = false;
+}
+
+bool dma_channel_is_busy(uint ch)
+{
+    return chans[ch].busy;
+}
+
+void dma_channel_set_irq0_enabled(uint ch, bool enabled)
+{
+    chans[ch].irq_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint ch)
+{
+    return chans[ch].irq;
+}
+
+void dma_channel_acknowledge_irq0(uint ch)
+{
+    chans[ch].irq = false;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    if (num == DMA_IRQ_0)
+        sim::dma_irq = handler;
+    else
+        sim::uart_irq = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+    if (num == DMA_IRQ_0)
+        sim::dma_irq_enabled = enabled;
+    else
+        sim::uart_irq_enabled = enabled;
+}
+
+uint uart_get_index(uart_inst_t* uart)
+{
+    return uint(uintptr_t(uart));
+}
+
+bool uart_is_readable(uart_inst_t*)
+{
+    return !sim::uart.rx.empty();
+}
+
+char uart_getc(uart_inst_t*)
+{
+    char c = char(sim::uart.rx.front());
+    sim::uart.rx.pop_front();
+    return c;
+}
+
+void uart_set_irq_enables(uart_inst_t*, bool rx_has_data, bool)
+{
+    sim::uart_rx_irq_enabled = rx_has_data;
+}
+
+void pio_sm_put(PIO, uint, uint32_t data)
+{
+    sim::tx_fifo.push_back(data);
+    sim::sm_pull();
+}
+
+uint pio_sm_get_tx_fifo_level(PIO, uint)
+{
+    return uint(sim::tx_fifo.size());
+}
+
+void pio_sm_clear_fifos(PIO, uint)
+{
+    sim::tx_fifo.clear();
+    sim::rx.clear();
+}
+
+void pio_sm_set_enabled(PIO, uint sm, bool enabled)
+{
+    if (sm == 0)
+        return;     // the one-shot SM
+    sim::sm_enabled = enabled;
+    if (!enabled) {
+        sim::sm_armed = false;
+        sim::sm_capturing = false;
+    }
+    sim::sm_pull();
+}
+
+// SCCB - a register write is the address and the value, a read an
+// address write and then the read
+
+uint i2c_init(i2c_inst_t*, uint baudrate)
+{
+    sccb.baud = baudrate;
+    return baudrate;
+}
+
+int i2c_write_timeout_us(i2c_inst_t*, uint8_t addr, const uint8_t* src, size_t len, bool, uint)
+{
+    bool ack = sim::sccb_transfer(len) && addr == sim::SCCB_ADDR && len > 0;
+    if (ack)
+        sccb.pointer = src[0];
+    if (len == 2) {
+        sccb.log.push_back({ now_us, true, src[0], src[1], ack });
+        if (ack && src[0] == sim::SCCB_COM7 && (src[1] & 0x80)) {
+            sim::sccb_defaults_load();
+            sccb.busy_until = now_us + sccb.com7_reset_us;
+        } else if (ack) {
+            sccb.regs[src[0]] = src[1];
+        }
+    }
+    return ack ? int(len) : -1;
+}
+
+int i2c_read_timeout_us(i2c_inst_t*, uint8_t addr, uint8_t* dst, size_t len, bool, uint)
+{
+    bool ack = sim::sccb_transfer(len) && addr == sim::SCCB_ADDR;
+    for (size_t i = 0; ack && i < len; i++)
+        dst[i] = sccb.regs[uint8_t(sccb.pointer + i)];
+    sccb.log.push_back({ now_us, false, sccb.pointer, ack && len ? dst[0] : uint8_t(0), ack });
+    return ack ? int(len) : -1;
+}
+
+// Pins
+
+bool gpio_get(uint gpio)
+{
+    sim::run_until(now_us + 1);
+    if (gpio != sim::VSYNC_PIN || !sim::sensor_on || now_us < sim::sensor_t0)
+        return false;
+    uint32_t f = sim::frame_at(now_us);
+    if (sim::sensor.skip && sim::sensor.skip(f))
+        return false;
+    return now_us - sim::frame_start_us(f) < sim::sensor.vsync_us;
+}
+
+// RESET is active low - the registers go back to their defaults
+void gpio_put(uint gpio, bool value)
+{
+    if (gpio != sim::RESET_PIN || value != sccb.held)
+        return;
+    sccb.held = !value;
+    sim::sccb_defaults_load();
+    if (value)
+        sccb.busy_until = now_us + sccb.pin_reset_us;
+}
+
+// Not on the stream path
+
+void channel_config_set_read_increment(dma_channel_config*, bool) {}
+void channel_config_set_dreq(dma_channel_config*, uint) {}
+void channel_config_set_transfer_data_size(dma_channel_config*, enum dma_channel_transfer_size) {}
+void pio_sm_exec(PIO, uint, uint) {}
+void pio_sm_restart(PIO, uint) {}
+void gpio_init(uint) {}
+void gpio_set_dir(uint, bool) {}
+void gpio_set_function(uint, gpio_function_t) {}
+void gpio_set_pulls(uint, bool, bool) {}
+int i2c_read_blocking(i2c_inst_t*, uint8_t, uint8_t*, size_t, bool) { return -1; }
+pio_sm_config pio_get_default_sm_config(void) { return pio_sm_config(); }
+void sm_config_set_in_pins(pio_sm_config*, uint) {}
+void sm_config_set_in_shift(pio_sm_config*, bool, bool, uint) {}
+void sm_config_set_wrap(pio_sm_config*, uint, uint) {}
+bool pio_can_add_program(PIO, const pio_program_t*) { return true; }
+uint pio_add_program(PIO, const pio_program_t*) { return 0; }
+void pio_add_program_at_offset(PIO, const pio_program_t*, uint) {}
+void pio_remove_program(PIO, const pio_program_t*, uint) {}
+void pio_gpio_init(PIO, uint) {}
+uint pio_get_dreq(PIO, uint, bool) { return 0; }
+int pio_sm_init(PIO, uint, uint, const pio_sm_config*) { return 0; }
+uint pwm_gpio_to_slice_num(uint) { return 0; }
+void pwm_set_clkdiv(uint, float) {}
+void pwm_set_wrap(uint, uint16_t) {}
+void pwm_set_chan_level(uint, uint, uint16_t) {}
+void pwm_set_enabled(uint, bool) {}
+
+}
@@ -0,0 +1,154 @@
+/*
+
+    sim_sensor.hpp
+
+    A simulated OV7670 behind the streaming capture (OV7670.c,
+    ov7670_stream.h) and a simulated UART, on virtual time - for tests
+    that run a streaming mode end to end.
+
+    The sensor sends a frame every period: VSYNC, then its HREF lines
+    spread evenly over the rest of the period but a front porch. The
+    capture SM is modelled a line at a time: at VSYNC it takes the
+    line count and line length from the TX FIFO, or misses the frame
+    if they aren't there, then each line of the window puts its bytes
+    in the RX FIFO as the generated program would (test_pio_gen checks
+    the program itself). D0-D7 are on GP13-GP6, so the bytes arrive
+    bit-reversed, as on the board. The two chained DMA channels move
+    whole words out of the RX FIFO into memory, and the DMA IRQ runs
+    irq_latency_us after a channel finishes.
+
+    The UART sends 10 bits per byte at its baud rate, keeps what it
+    sent, and calls done_cb (from the event loop, as its IRQ) when the
+    last byte has gone. A send keeps reading the caller's buffer until
+    then, so a buffer reused too early shows up on the wire. While a
+    transfer is on, transport_is_busy() moves time on to the next
+    event, so the firmware's own busy-waits run the simulation. Bytes
+    from the host arrive on RX at the same rate, and the RX IRQ runs
+    for each one.
+
+    The sensor's registers sit on an SCCB bus at the rate i2c_init()
+    was given, 9 bits a byte plus start and stop. It keeps a log of
+    every register write and read. Writing COM7 with the reset bit
+    puts every register back to its default, and the sensor NAKs
+    while it does - sccb.c runs on top. So it does from the RESET pin
+    (GP15) going high until it has come out of reset.
+
+    VSYNC (GP2) is high for the first vsync_us of every frame the
+    sensor sends. Reading a pin takes 1 us, so polling loops move on.
+
+    Firmware code takes no virtual time - the timings come out of the
+    sensor, the bus and the link. This file defines the SDK calls
+    OV7670.c makes while streaming, the UART RX calls cmd.c makes, the
+    I2C calls sccb.c makes, the time calls, repeating timers and
+    __wfe()/__sev(); a test that uses it links sccb.c and defines no
+    SDK calls of its own for those.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include "ov7670_pio_gen.h"
+#include "transport.h"
+}
+
+namespace sim {
+
+extern uint64_t now_us;
+
+// Drop every pending event and put the SM and DMA back to their
+// reset state - between runs, after ov7670_stream_stop(). A run
+// starts a fresh UART with uart_open().
+void reset();
+
+// Run fn at virtual time t, from the event loop as an IRQ would
+void at(uint64_t t, std::function<void()> fn);
+
+// Run the next event due, moving the time to it - false if there are none
+bool step();
+
+// Run every event due up to t, then set the time to t
+void run_until(uint64_t t);
+
+// HREF lines of line_bytes bytes each - byte(f, l, i) is byte i of
+// line l of frame f as the sensor drives it on D0-D7
+struct Sensor {
+    uint32_t period_us = 66667;
+    uint lines = 240;
+    uint line_bytes = 640;
+    uint32_t vblank_us = 3000;          // VSYNC start to the first HREF
+    uint32_t vsync_us = 200;            // VSYNC pulse
+    uint32_t front_porch_us = 1000;     // last HREF to the next VSYNC
+    uint32_t irq_latency_us = 5;
+    std::function<uint8_t(uint32_t f, uint l, uint i)> byte;
+    std::function<bool(uint32_t f)> skip;   // frames the sensor doesn't send - may be empty
+};
+
+struct SensorStats {
+    uint32_t frames;            // frames sent by the sensor
+    uint32_t captured;          // frames the SM captured
+    uint32_t missed;            // frames the SM had no parameters for
+    uint32_t bad_params;        // parameters that don't match the window
+    uint32_t rx_overflows;      // words with no DMA channel running
+};
+
+// Start sending frames from start_us, frame 0 first. desc is the
+// window passed to ov7670_stream_start().
+void sensor_start(const Sensor& s, const ov7670_capture_desc_t& desc, uint64_t start_us);
+
+uint64_t frame_start_us(uint32_t f);
+
+// When the last line of frame f's window was captured
+uint64_t frame_end_us(uint32_t f, const ov7670_capture_desc_t& desc);
+
+// The frame the sensor is sending (or about to) at time t
+uint32_t frame_at(uint64_t t);
+
+const SensorStats& sensor_stats();
+
+// The bytes of frame f the window desc should give, after bit reversal
+std::vector<uint8_t> expected_frame(uint32_t f, const ov7670_capture_desc_t& desc);
+
+// A UART sending at baud, 8N1
+transport_t* uart_open(uint32_t baud);
+
+// Everything sent so far
+std::vector<uint8_t>& uart_wire();
+
+// Bytes from the host on RX, after anything still arriving
+void uart_rx(const std::vector<uint8_t>& bytes);
+
+// Virtual time the UART spent sending
+uint64_t uart_busy_us();
+
+constexpr uint32_t SCCB_RESET_US = 1000;   // RESET pin or COM7 reset -> the sensor answers again
+
+// How long the sensor NAKs after the RESET pin goes high, and after a
+// COM7 reset - SCCB_RESET_US each until the next reset()
+void sccb_timing(uint32_t pin_reset_us, uint32_t com7_reset_us);
+
+// One register access on the bus - ack false for a NAK
+struct SccbOp {
+    uint64_t t_us;
+    bool write;
+    uint8_t reg;
+    uint8_t value;
+    bool ack;
+};
+
+// Everything since reset(), or since the last sccb_clear_log()
+const std::vector<SccbOp>& sccb_log();
+void sccb_clear_log();
+
+// The registers as the sensor holds them. sccb_set_reg() is the sensor
+// changing one itself, as AGC does.
+uint8_t sccb_reg(uint8_t reg);
+void sccb_set_reg(uint8_t reg, uint8_t value);
+
+// Virtual time the bus was busy
+uint64_t sccb_busy_us();
+
+}
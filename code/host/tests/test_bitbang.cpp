@@ -0,0 +1,244 @@
+/*
+    ov7670_bitbang_grab() (ov7670_bitbang.c) against a simulated sensor.
+
+    Time is virtual: every gpio_get() is a 100 ns poll, and reading
+    sio_hw->gpio_in gives the pins at the last one. The sensor runs
+    QVGA YUV422 at CLKRC 0x01 as in test_grab - 510 lines of 784 PCLK
+    times per 106624 us, VSYNC on lines 0-2 and HREF on the even lines
+    20-498. PCLK toggles for the first 640 of an HREF line, low for the
+    first half of each byte, and idles high.
+
+    Faults: some frames lose a run of lines, PCLK stalls for 1-400 ms
+    (VSYNC keeps going) and the sensor stops entirely for 50-1500 ms.
+
+    A grab that returns true must have exactly one frame's bytes. A
+    grab may only fail when a fault fell in it, and failures on all
+    three kinds of fault must be seen and recovered from. None may
+    take longer than the start and frame deadlines (1.5 + 1.25
+    periods), a line, and the polls of one PCLK wait.
+*/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "pico/stdlib.h"
+#include "hardware/structs/sio.h"
+
+#include "ov7670_bitbang.h"
+#include "ov7670_grab.h"
+}
+
+namespace {
+
+constexpr uint64_t PERIOD_US = 106624;
+constexpr uint64_t PERIOD_NS = PERIOD_US * 1000;
+constexpr uint32_t LINES = 510;
+constexpr uint32_t LINE_CLOCKS = 784;
+constexpr uint64_t POLL_NS = 100;
+constexpr int DROP_PCT = 10;        // frames that lose lines
+constexpr int GRABS = 150;
+
+constexpr uint32_t VSYNC_PIN = 2, PCLK_PIN = 4, DATA_PIN_BASE = 6;
+
+uint64_t now_ns = 1000000000;
+sio_hw_t sio;
+
+// [from, to) - sorted and apart
+struct Window {
+    uint64_t from, to;
+};
+std::vector<Window> stalls;         // PCLK stopped, VSYNC running
+std::vector<Window> stops;          // sensor stopped
+
+bool in_window(const std::vector<Window>& w, uint64_t t)
+{
+    auto it = std::upper_bound(w.begin(), w.end(), t, [](uint64_t t, const Window& w) { return t < w.from; });
+    return it != w.begin() && t < (it - 1)->to;
+}
+
+bool overlaps(const std::vector<Window>& w, uint64_t from, uint64_t to)
+{
+    for (const Window& x : w)
+        if (x.from < to && from < x.to)
+            return true;
+    return false;
+}
+
+uint32_t hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t frame_of(uint64_t t)
+{
+    return uint32_t(t / PERIOD_NS);
+}
+
+bool drops_lines(uint32_t f)
+{
+    return hash(f) % 100 < uint32_t(DROP_PCT);
+}
+
+// Line l of frame f has HREF - some frames lose a run of lines
+bool href_line(uint32_t f, uint32_t l)
+{
+    if (l < 20 || l > 498 || (l & 1))
+        return false;
+    if (drops_lines(f)) {
+        uint32_t k = (l - 20) / 2, at = hash(f * 7 + 1) % OV7670_BITBANG_LINES, n = 1 + hash(f * 7 + 2) % 16;
+        if (k >= at && k < at + n)
+            return false;
+    }
+    return true;
+}
+
+// byte i of active line k of frame f - the frame number in the first four
+uint8_t frame_byte(uint32_t f, uint32_t k, uint32_t i)
+{
+    if (k == 0 && i < 4)
+        return uint8_t(f >> (8 * i));
+    return uint8_t(i * 3 + k * 5 + f * 7);
+}
+
+struct Pins {
+    bool vsync, pclk;
+    uint8_t data;
+};
+
+Pins pins_at(uint64_t t)
+{
+    Pins p = { false, true, 0 };
+    if (in_window(stops, t))
+        return p;
+    // in 1/PERIOD_NS PCLK times since the frame started
+    uint64_t u = (t % PERIOD_NS) * LINES * LINE_CLOCKS;
+    uint32_t clock = uint32_t(u / PERIOD_NS), line = clock / LINE_CLOCKS, col = clock % LINE_CLOCKS;
+    uint32_t f = frame_of(t);
+    p.vsync = line < 3;
+    if (in_window(stalls, t) || col >= OV7670_BITBANG_LINE_BYTES || !href_line(f, line))
+        return p;
+    p.pclk = u % PERIOD_NS >= PERIOD_NS / 2;
+    p.data = frame_byte(f, (line - 20) / 2, col);
+    return p;
+}
+
+// buffer is all of one frame
+bool one_frame(const uint8_t* buffer)
+{
+    uint32_t f = buffer[0] | buffer[1] << 8 | buffer[2] << 16 | uint32_t(buffer[3]) << 24;
+    for (uint32_t k = 0; k < OV7670_BITBANG_LINES; k++)
+        for (uint32_t i = 0; i < OV7670_BITBANG_LINE_BYTES; i++)
+            if (*buffer++ != frame_byte(f, k, i))
+                return false;
+    return true;
+}
+
+}
+
+extern "C" {
+
+sio_hw_t* sio_hw = &sio;
+
+bool gpio_get(uint gpio)
+{
+    now_ns += POLL_NS;
+    Pins p = pins_at(now_ns);
+    sio.gpio_in = uint32_t(p.data) << DATA_PIN_BASE | uint32_t(p.pclk) << PCLK_PIN | uint32_t(p.vsync) << VSYNC_PIN;
+    return (sio.gpio_in >> gpio) & 1;
+}
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(now_ns / 1000);
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return now_ns / 1000 + us;
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return now_ns / 1000 >= t;
+}
+
+void gpio_init(uint) {}
+void gpio_set_dir(uint, bool) {}
+
+}
+
+int main()
+{
+    std::mt19937 rng(25);
+    static uint8_t buffer[OV7670_BITBANG_LINES * OV7670_BITBANG_LINE_BYTES];
+
+    // faults over the run
+    uint64_t end = now_ns + uint64_t(GRABS) * 700000000;
+    for (uint64_t t = now_ns + 1000000000; t < end; t += 1000000000 + rng() % 4000000000u)
+        stalls.push_back({ t, t + 1000000 + rng() % 400000000 });
+    for (uint64_t t = now_ns + 3000000000u; t < end; t += 3000000000u + rng() % 12000000000u)
+        stops.push_back({ t, t + 50000000 + rng() % 1450000000 });
+
+    uint32_t ok = 0, bad = 0, failed = 0, unexplained = 0, recoveries = 0;
+    uint32_t failed_stop = 0, failed_stall = 0, failed_lines = 0;
+    uint64_t ok_max = 0, failed_max = 0;
+    bool last_failed = false;
+    for (int i = 0; i < GRABS; i++) {
+        uint64_t t0 = now_ns;
+        bool got = ov7670_bitbang_grab(buffer, uint32_t(PERIOD_US));
+        uint64_t took = now_ns - t0;
+        if (got) {
+            ok++;
+            ok_max = std::max(ok_max, took);
+            bad += !one_frame(buffer);
+            recoveries += last_failed;
+        } else {
+            failed++;
+            failed_max = std::max(failed_max, took);
+            bool lines = false;
+            for (uint32_t f = frame_of(t0); f <= frame_of(now_ns); f++)
+                lines |= drops_lines(f);
+            if (overlaps(stops, t0, now_ns))
+                failed_stop++;
+            else if (overlaps(stalls, t0, now_ns))
+                failed_stall++;
+            else if (lines)
+                failed_lines++;
+            else
+                unexplained++;
+        }
+        last_failed = !got;
+
+        // sending, waiting for the button
+        now_ns += (rng() % 600000) * 1000;
+    }
+
+    // both deadlines, a line, and one PCLK wait
+    uint64_t limit = PERIOD_NS * (OV7670_GRAB_START_PCT + OV7670_GRAB_FRAME_PCT) / 100 + PERIOD_NS / LINES +
+                     OV7670_BITBANG_PCLK_SPINS * POLL_NS;
+
+    printf("%d grabs: %u ok (%u torn or mixed), %u failed - %u sensor stop, %u PCLK stall, %u lost lines, "
+           "%u unexplained; %u recoveries\n",
+           GRABS, ok, bad, failed, failed_stop, failed_stall, failed_lines, unexplained, recoveries);
+    printf("longest grab: ok %.1f ms, failed %.1f ms (limit %.1f ms)\n", ok_max / 1e6, failed_max / 1e6,
+           limit / 1e6);
+    printf("%zu PCLK stalls, %zu sensor stops, %d%% of frames lose lines\n", stalls.size(), stops.size(), DROP_PCT);
+
+    CHECK(bad == 0);
+    CHECK(unexplained == 0);
+    CHECK(ok > uint32_t(GRABS) / 2);
+    CHECK(failed_stop > 0 && failed_stall > 0 && failed_lines > 0 && recoveries > 0);
+    CHECK(ok_max <= limit);
+    CHECK(failed_max <= limit);
+
+    return check_result();
+}
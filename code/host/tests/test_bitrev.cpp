@@ -0,0 +1,106 @@
+/*
+    Bit reversal (bitrev.h, bitrev.c) against the per-byte
+    reverse_bits() that send_image() used before.
+
+    This test is built with BITREV_HAVE_RBIT and an rbit that does
+    what the Cortex-M33 instruction does, so bitrev_word() takes the
+    rbit + byte swap path. It must give the same word as the portable
+    fallback and as reverse_bits() on each byte, for every byte value
+    in every lane and for 16M random words. bitrev_bytes() (built
+    portable, as on any host) must match reverse_bits() for every
+    length up to 67 at every alignment, and leave the bytes around
+    the range alone.
+*/
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+
+// rbit, one bit at a time
+uint32_t bitrev_rbit(uint32_t w)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++)
+        r |= ((w >> i) & 1) << (31 - i);
+    return r;
+}
+
+}
+
+#define BITREV_HAVE_RBIT 1
+extern "C" {
+#include "bitrev.h"
+}
+
+namespace {
+
+// as it was in framegrabber.c
+uint8_t reverse_bits(uint8_t byte)
+{
+    byte = ((byte & 0xF0) >> 4) | ((byte & 0x0F) << 4);
+    byte = ((byte & 0xCC) >> 2) | ((byte & 0x33) << 2);
+    byte = ((byte & 0xAA) >> 1) | ((byte & 0x55) << 1);
+    return byte;
+}
+
+uint32_t reverse_bytes(uint32_t w)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < 4; i++)
+        r |= uint32_t(reverse_bits(uint8_t(w >> (8 * i)))) << (8 * i);
+    return r;
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(3);
+    uint32_t bad_rbit = 0, bad_portable = 0;
+
+    auto check_word = [&](uint32_t w) {
+        uint32_t want = reverse_bytes(w);
+        bad_rbit += bitrev_word(w) != want;
+        bad_portable += bitrev_word_portable(w) != want;
+    };
+
+    // every byte value in every lane, the other lanes random
+    for (int lane = 0; lane < 4; lane++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            for (int n = 0; n < 16; n++) {
+                uint32_t w = rng() & ~(0xFFu << (8 * lane));
+                check_word(w | b << (8 * lane));
+            }
+        }
+    }
+    for (uint32_t w : { 0u, 0xFFFFFFFFu, 0x80000001u, 0x01020408u, 0x10204080u })
+        check_word(w);
+    for (int n = 0; n < (1 << 24); n++)
+        check_word(rng());
+    printf("words: %u wrong on the rbit path, %u on the portable path\n", bad_rbit, bad_portable);
+    CHECK(bad_rbit == 0);
+    CHECK(bad_portable == 0);
+
+    // every length at every alignment, with guard bytes either side
+    uint32_t bad_ranges = 0;
+    std::vector<uint8_t> buf(96), want(96);
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t len = 0; len < 68; len++) {
+            for (auto& b : buf)
+                b = uint8_t(rng());
+            want = buf;
+            for (size_t i = 0; i < len; i++)
+                want[8 + offset + i] = reverse_bits(want[8 + offset + i]);
+            bitrev_bytes(buf.data() + 8 + offset, len);
+            bad_ranges += buf != want;
+        }
+    }
+    printf("ranges: %u wrong\n", bad_ranges);
+    CHECK(bad_ranges == 0);
+
+    return check_result();
+}
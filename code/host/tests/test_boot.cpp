@@ -0,0 +1,168 @@
+/*
+    Boot without fixed delays: ov7670_init() and ov7670_wait_ready(),
+    as main() runs them, against a simulated sensor with configurable
+    settle times (sim_sensor.hpp), on virtual time from power-on.
+
+    The sensor NAKs on SCCB for a while after the RESET pin goes high
+    and after the COM7 reset, its first VSYNC comes some time after
+    power-on, and auto exposure moves GAIN and AECH every frame for a
+    number of frames before it holds. For each setting:
+    - no phase may end before the sensor is ready for it - the ID
+      read before it answers, the reset before it is done, settled
+      before exposure has held for OV7670_SETTLE_FRAMES frames
+    - and each must end soon after - within a poll and the bus time
+      it needs
+    - a sensor with no VSYNC, or exposure that never holds, must give
+      up at READY_TIMEOUT_MS and say which it was
+
+    It prints the boot timeline (boot_trace.c) for each, against the
+    1.33 s the fixed delays took.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "check.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "OV7670.h"
+#include "boot_trace.h"
+#include "sccb.h"
+}
+
+namespace {
+
+// as framegrabber.c
+constexpr uint READY_TIMEOUT_MS = 1000;
+
+// OV7670.c
+constexpr uint SETTLE_FRAMES = 2;
+constexpr uint8_t REG_GAIN_ = 0x00, REG_AECH_ = 0x10;
+
+// the old boot - 10 + 10 ms around the RESET pin, 300 ms after the
+// COM7 reset, 1000 ms before the first capture, the table at 100 kHz
+constexpr uint32_t OLD_BOOT_US = 1320000 + 2000;
+
+uint8_t frame_buffer[320 * 240 * 2];
+
+struct Setting {
+    const char* name;
+    uint32_t pin_reset_us;      // RESET pin high -> SCCB answers
+    uint32_t com7_reset_us;     // COM7 reset -> SCCB answers
+    uint32_t first_vsync_us;    // from power-on, 0 for none
+    uint32_t period_us;
+    uint32_t aec_frames;        // frames exposure moves for
+    const char* last_phase;
+};
+
+uint32_t aec_frames;
+
+// auto exposure - a new GAIN and AECH at the start of each frame, until it holds
+void aec(uint32_t f)
+{
+    if (f >= aec_frames)
+        return;
+    sim::sccb_set_reg(REG_GAIN_, uint8_t(0x10 + f));
+    sim::sccb_set_reg(REG_AECH_, uint8_t(0x40 - f));
+    sim::at(sim::frame_start_us(f + 1), [f] { aec(f + 1); });
+}
+
+uint32_t phase_end(const char* name)
+{
+    const boot_phase_t* phases;
+    uint n = boot_trace_get(&phases);
+    for (uint i = 0; i < n; i++) {
+        if (strcmp(phases[i].name, name) == 0)
+            return phases[i].end_us;
+    }
+    return UINT32_MAX;
+}
+
+// bus time of one transfer of len bytes after the address
+uint32_t xfer_us(uint len)
+{
+    return ((2 + 9 * (1 + len)) * 1000000 + SCCB_BAUD - 1) / SCCB_BAUD;
+}
+
+bool boot(const Setting& s)
+{
+    sim::reset();
+    sim::now_us = 0;
+    boot_trace_clear();
+    sim::sccb_timing(s.pin_reset_us, s.com7_reset_us);
+
+    ov7670_capture_desc_t desc;
+    ov7670_capture_desc_default(&desc);
+    if (s.first_vsync_us) {
+        sim::Sensor sensor;
+        sensor.period_us = s.period_us;
+        sim::sensor_start(sensor, desc, s.first_vsync_us);
+        aec_frames = s.aec_frames;
+        sim::at(s.first_vsync_us, [] { aec(0); });
+    }
+
+    // main()
+    ov7670_init(frame_buffer);
+    boot_trace_mark("mode");
+    bool ready = ov7670_wait_ready(READY_TIMEOUT_MS);
+    ov7670_stream_stop();
+    return ready;
+}
+
+}
+
+int main()
+{
+    const Setting settings[] = {
+        { "30 fps, settled", 1000, 1000, 5000, 33333, 0, "exposure settled" },
+        { "15 fps, AEC 8 frames", 1000, 1000, 20000, 66667, 8, "exposure settled" },
+        { "slow reset, AEC 3 frames", 20000, 10000, 5000, 33333, 3, "exposure settled" },
+        { "no VSYNC", 1000, 1000, 0, 33333, 0, "no vsync" },
+        { "AEC never holds", 1000, 1000, 5000, 33333, UINT32_MAX, "exposure timeout" },
+    };
+
+    for (const Setting& s : settings) {
+        bool ready = boot(s);
+        uint32_t done_us = uint32_t(sim::now_us);
+        printf("%s: %s at %u us, against %u us with the fixed delays\n", s.name, ready ? "ready" : "gave up",
+               done_us, OLD_BOOT_US);
+        boot_trace_print();
+
+        const boot_phase_t* phases;
+        uint n = boot_trace_get(&phases);
+        CHECK(n > 0 && strcmp(phases[n - 1].name, s.last_phase) == 0);
+        CHECK(ready == (strcmp(s.last_phase, "exposure settled") == 0));
+
+        // the ID once the sensor answers - a poll, a NAK'd read and a read later at most
+        uint32_t pin_us = phase_end("reset pin");
+        uint32_t id_us = phase_end("sensor id");
+        uint32_t poll_us = 100 + 4 * xfer_us(1);
+        CHECK(id_us >= pin_us + s.pin_reset_us);
+        CHECK(id_us <= pin_us + s.pin_reset_us + 2 * poll_us);
+
+        // the reset once it is done, then every register read back
+        uint32_t reset_us = phase_end("register reset");
+        uint32_t readback_us = SCCB_NUM_REGS * 2 * xfer_us(1);
+        CHECK(reset_us >= id_us + s.com7_reset_us + readback_us);
+        CHECK(reset_us <= id_us + xfer_us(2) + s.com7_reset_us + poll_us + readback_us);
+
+        uint32_t mode_us = phase_end("mode");
+        if (ready) {
+            // settled no sooner than SETTLE_FRAMES frames after the last change,
+            // and within the frames it takes to see that
+            uint32_t first = sim::frame_at(mode_us) + 1;
+            uint32_t last_change = s.aec_frames ? s.aec_frames - 1 : 0;
+            uint64_t earliest = sim::frame_start_us(last_change + SETTLE_FRAMES);
+            uint64_t latest = sim::frame_start_us(std::max(first + 1, last_change) + SETTLE_FRAMES) + 1000;
+            CHECK(done_us >= earliest && done_us <= latest);
+            CHECK(phase_end("vsync") <= sim::frame_start_us(first) + 1000);
+            CHECK(done_us < OLD_BOOT_US / 2);
+        } else {
+            uint32_t timeout_us = READY_TIMEOUT_MS * 1000;
+            CHECK(done_us >= mode_us + timeout_us && done_us <= mode_us + timeout_us + 1000);
+        }
+    }
+
+    return check_result();
+}
@@ -0,0 +1,412 @@
+/*
+    Host commands (cmd.c) over a pseudo-terminal.
+
+    The device end is the pty master: one thread stands in for the
+    UART RX IRQ and runs cmd.c's handler whenever bytes arrive, another
+    for the main loop, which runs cmd_poll() on EVENT_CMD and sends
+    the acks back through the pty transport. The host end is ovrecv::SerialPort on the pty
+    slave, as it would open a USB-serial adapter.
+
+    Every command must get exactly one ack, with the right opcode,
+    status, payload and CRC - CREDIT none. A message with a bad CRC,
+    one that lost a byte and one split by a gap longer than
+    CMD_RX_TIMEOUT_US must all be dropped, and the message after each
+    must still get through. The time from writing a command to the
+    first byte of its ack is given as p50/p99.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "ovrecv/serial_port.hpp"
+
+extern "C" {
+#include "hardware/irq.h"
+
+#include "cmd.h"
+#include "event.h"
+#include "frame_proto.h"
+#include "frame_ring.h"
+#include "ov7670_grab.h"
+#include "sccb.h"
+
+#include "pty_transport.h"
+}
+
+namespace {
+
+const auto t_start = std::chrono::steady_clock::now();
+
+// the device - pty master, "IRQ" handler and a register file for sccb_*
+int master_fd = -1;
+irq_handler_t rx_handler;
+uint8_t regs[256];
+std::atomic<uint32_t> credit_total{0};
+
+std::mutex event_mutex;
+std::condition_variable event_cv;
+bool event_pending;
+
+// rx thread only
+uint8_t rx_buf[256];
+size_t rx_pos, rx_len;
+
+void on_credit(uint32_t bytes)
+{
+    credit_total += bytes;
+}
+
+cmd_status_t on_capture(uint16_t frames)
+{
+    return frames ? CMD_OK : CMD_ERR_ARG;
+}
+
+cmd_status_t on_format(uint8_t, uint16_t width, uint16_t height, uint8_t)
+{
+    return width <= 640 && height <= 480 ? CMD_OK : CMD_ERR_ARG;
+}
+
+std::vector<uint8_t> message(uint8_t op, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> msg = { CMD_SYNC, op };
+    for (uint8_t b : payload)
+        msg.push_back(b);
+    uint32_t crc = crc32_calc(msg.data(), msg.size());
+    for (int i = 0; i < 4; i++)
+        msg.push_back(uint8_t(crc >> (8 * i)));
+    return msg;
+}
+
+struct Ack {
+    uint8_t op;
+    uint8_t status;
+    std::vector<uint8_t> payload;
+};
+
+// The host end - reads acks off the pty slave
+class Host {
+public:
+    explicit Host(const char* path) { port_.open(path, 3000000); }
+
+    void send(const std::vector<uint8_t>& msg) { send(msg.data(), msg.size()); }
+
+    void send(const uint8_t* data, size_t len)
+    {
+        sent_ = std::chrono::steady_clock::now();
+        first_byte_ = {};
+        port_.write(data, len);
+    }
+
+    // Next ack - false if none came within timeout_ms or it was damaged
+    bool next_ack(Ack& ack, int timeout_ms = 2000)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;) {
+            auto magic = std::search(buf_.begin(), buf_.end(), CMD_ACK_MAGIC, CMD_ACK_MAGIC + 4);
+            buf_.erase(buf_.begin(), magic);
+            if (buf_.size() >= CMD_ACK_HEADER_LEN) {
+                size_t len = buf_[6] | (buf_[7] << 8);
+                size_t total = CMD_ACK_HEADER_LEN + len + CMD_CRC_LEN;
+                if (buf_.size() >= total) {
+                    uint32_t crc = 0;
+                    for (int i = 0; i < 4; i++)
+                        crc |= uint32_t(buf_[total - 4 + i]) << (8 * i);
+                    bool ok = crc == ovrecv::crc32_update(0, buf_.data(), total - 4);
+                    ack.op = buf_[4];
+                    ack.status = buf_[5];
+                    ack.payload.assign(buf_.begin() + CMD_ACK_HEADER_LEN, buf_.begin() + total - 4);
+                    buf_.erase(buf_.begin(), buf_.begin() + total);
+                    return ok;
+                }
+            }
+
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0)
+                return false;
+            uint8_t chunk[256];
+            size_t n = port_.read(chunk, sizeof(chunk), int(left));
+            if (n && first_byte_ == std::chrono::steady_clock::time_point())
+                first_byte_ = std::chrono::steady_clock::now();
+            buf_.insert(buf_.end(), chunk, chunk + n);
+        }
+    }
+
+    // Command written -> first byte of the reply, in us
+    double latency_us() const
+    {
+        return std::chrono::duration<double, std::micro>(first_byte_ - sent_).count();
+    }
+
+    bool idle(int timeout_ms)
+    {
+        uint8_t chunk[256];
+        size_t n = port_.read(chunk, sizeof(chunk), timeout_ms);
+        buf_.insert(buf_.end(), chunk, chunk + n);
+        return buf_.empty();
+    }
+
+private:
+    ovrecv::SerialPort port_;
+    std::vector<uint8_t> buf_;
+    std::chrono::steady_clock::time_point sent_, first_byte_;
+};
+
+// Send a command and take its ack, which must be for it and intact
+bool command(Host& host, uint8_t op, const std::vector<uint8_t>& payload, Ack& ack)
+{
+    host.send(message(op, payload));
+    return host.next_ack(ack) && ack.op == op;
+}
+
+// REG_READ, as the message that must get through after a damaged one
+int read_reg(Host& host, uint8_t reg)
+{
+    Ack ack;
+    if (!command(host, CMD_OP_REG_READ, { reg }, ack) || ack.status != CMD_OK || ack.payload.size() != 1)
+        return -1;
+    return ack.payload[0];
+}
+
+uint32_t word(const std::vector<uint8_t>& p, size_t i)
+{
+    return p[4 * i] | (p[4 * i + 1] << 8) | (p[4 * i + 2] << 16) | (uint32_t(p[4 * i + 3]) << 24);
+}
+
+}
+
+extern "C" {
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t_start).count());
+}
+
+uint uart_get_index(uart_inst_t*)
+{
+    return 0;
+}
+
+bool uart_is_readable(uart_inst_t*)
+{
+    return rx_pos < rx_len;
+}
+
+char uart_getc(uart_inst_t*)
+{
+    return char(rx_buf[rx_pos++]);
+}
+
+void uart_set_irq_enables(uart_inst_t*, bool, bool)
+{
+}
+
+void irq_set_exclusive_handler(uint, irq_handler_t handler)
+{
+    rx_handler = handler;
+}
+
+void irq_set_enabled(uint, bool)
+{
+}
+
+void event_post(event_t)
+{
+    std::lock_guard<std::mutex> lock(event_mutex);
+    event_pending = true;
+    event_cv.notify_one();
+}
+
+bool sccb_read(uint8_t reg, uint8_t* value)
+{
+    *value = regs[reg];
+    return reg != 0xFF;     // a register that never answers
+}
+
+bool sccb_write(uint8_t reg, uint8_t value)
+{
+    regs[reg] = value;
+    return reg != 0xFF;
+}
+
+void sccb_get_stats(sccb_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void frame_ring_get_stats(frame_ring_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void ov7670_get_grab_stats(ov7670_grab_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+}
+
+int main()
+{
+    pty_transport_t* pty = pty_transport_open();
+    if (!pty) {
+        perror("pty_transport_open");
+        return 1;
+    }
+    master_fd = pty_transport_fd(pty);
+    Host host(pty_transport_path(pty));
+
+    cmd_handlers_t handlers = {};
+    handlers.credit = on_credit;
+    handlers.capture = on_capture;
+    handlers.format = on_format;
+    cmd_init(uart0, pty_transport_get(pty), &handlers);
+
+    std::atomic<bool> stop{false};
+
+    // UART RX IRQ - the FIFO is whatever one read() gets
+    std::thread rx([&] {
+        while (!stop) {
+            struct pollfd pfd = { master_fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 10) <= 0)
+                continue;
+            ssize_t n = read(master_fd, rx_buf, sizeof(rx_buf));
+            if (n <= 0)
+                continue;
+            rx_pos = 0;
+            rx_len = size_t(n);
+            rx_handler();
+        }
+    });
+
+    // main loop
+    std::thread device([&] {
+        while (!stop) {
+            {
+                std::unique_lock<std::mutex> lock(event_mutex);
+                event_cv.wait_for(lock, std::chrono::milliseconds(10), [] { return event_pending; });
+                event_pending = false;
+            }
+            cmd_poll();
+        }
+    });
+
+    Ack ack;
+    uint32_t commands = 0, credits = 0;
+
+    // every command once
+    CHECK(command(host, CMD_OP_PING, {}, ack) && ack.status == CMD_OK && ack.payload.empty());
+    CHECK(command(host, CMD_OP_CAPTURE, { 3, 0 }, ack) && ack.status == CMD_OK);
+    CHECK(command(host, CMD_OP_CAPTURE, { 0, 0 }, ack) && ack.status == CMD_ERR_ARG);
+    CHECK(command(host, CMD_OP_STREAM, { 1 }, ack) && ack.status == CMD_ERR_UNSUPPORTED);
+    CHECK(command(host, CMD_OP_FORMAT, { 1, 0x40, 0x01, 0xF0, 0x00, 1 }, ack) && ack.status == CMD_OK);
+    CHECK(command(host, CMD_OP_FORMAT, { 1, 0x00, 0x04, 0xF0, 0x00, 1 }, ack) && ack.status == CMD_ERR_ARG);
+    CHECK(command(host, CMD_OP_REG_WRITE, { 0x12, 0x80 }, ack) && ack.status == CMD_OK);
+    CHECK(read_reg(host, 0x12) == 0x80);
+    CHECK(command(host, CMD_OP_REG_WRITE, { 0xFF, 0x01 }, ack) && ack.status == CMD_ERR_BUS);
+    CHECK(command(host, CMD_OP_REG_READ, { 0xFF }, ack) && ack.status == CMD_ERR_BUS && ack.payload.size() == 1);
+    commands += 10;
+
+    // CREDIT is never acked - the next ack must be the PING after it
+    host.send(message(CMD_OP_CREDIT, { 0x00, 0x10, 0x00, 0x00 }));
+    credits++;
+    CHECK(command(host, CMD_OP_PING, {}, ack));
+    CHECK(credit_total == 0x1000);
+    commands++;
+
+    // damaged messages, each followed by a read of the register it would write
+    std::mt19937 rng(21);
+    uint32_t damaged = 0;
+    for (int i = 0; i < 50; i++) {
+        uint8_t reg = uint8_t(0x20 + i);
+        regs[reg] = 0x11;
+        std::vector<uint8_t> msg = message(CMD_OP_REG_WRITE, { reg, 0x99 });
+        switch (i % 4) {
+        case 0:     // bad CRC
+            msg[4 + rng() % 4] ^= uint8_t(1 + rng() % 255);
+            host.send(msg);
+            break;
+        case 1:     // byte lost
+            msg.erase(msg.begin() + 1 + rng() % (msg.size() - 1));
+            host.send(msg);
+            break;
+        case 2:     // gap in the middle - too long, the message is stale
+            host.send(msg.data(), 3);
+            std::this_thread::sleep_for(std::chrono::microseconds(CMD_RX_TIMEOUT_US * 3));
+            host.send(msg.data() + 3, msg.size() - 3);
+            break;
+        case 3: {   // junk, with syncs in it
+            std::vector<uint8_t> junk(1 + rng() % 20);
+            for (auto& b : junk)
+                b = rng() % 3 ? uint8_t(rng()) : CMD_SYNC;
+            host.send(junk);
+            regs[reg] = 0x99;   // nothing to drop - the read must still work
+            break;
+        }
+        }
+        CHECK(read_reg(host, reg) == regs[reg]);
+        CHECK(regs[reg] == (i % 4 == 3 ? 0x99 : 0x11));
+        damaged++;
+        commands++;
+    }
+
+    // latency, with commands back to back
+    std::vector<double> latency;
+    for (int i = 0; i < 1000; i++) {
+        uint8_t reg = uint8_t(rng());
+        if (reg == 0xFF)
+            reg = 0;
+        bool ok = i % 2 ? read_reg(host, reg) == regs[reg]
+                        : command(host, CMD_OP_PING, {}, ack) && ack.status == CMD_OK;
+        CHECK(ok);
+        latency.push_back(host.latency_us());
+        commands++;
+    }
+
+    // STATS sees all of the above
+    CHECK(command(host, CMD_OP_STATS, {}, ack) && ack.status == CMD_OK);
+    cmd_stats_t stats = {};
+    if (ack.payload.size() >= sizeof(cmd_stats_t)) {
+        stats.commands = word(ack.payload, 0);
+        stats.credits = word(ack.payload, 1);
+        stats.rx_errors = word(ack.payload, 2);
+        stats.dropped = word(ack.payload, 3);
+        stats.latency_us = word(ack.payload, 4);
+        stats.latency_max_us = word(ack.payload, 5);
+    }
+    CHECK(ack.payload.size() % 4 == 0 && ack.payload.size() > sizeof(cmd_stats_t));
+    CHECK(stats.commands == commands);
+    CHECK(stats.credits == credits);
+    CHECK(stats.rx_errors >= damaged * 3 / 4);
+    CHECK(stats.dropped == 0);
+
+    // and nothing else came back
+    CHECK(host.idle(50));
+
+    stop = true;
+    rx.join();
+    device.join();
+    pty_transport_close(pty);
+
+    std::sort(latency.begin(), latency.end());
+    printf("%u commands, %u damaged messages dropped, %u rx errors\n", commands, damaged, stats.rx_errors);
+    printf("command -> ack first byte: p50 %.0f us, p99 %.0f us, max %.0f us (device: max %u us)\n",
+           latency[latency.size() / 2], latency[latency.size() * 99 / 100], latency.back(),
+           stats.latency_max_us);
+
+    return check_result();
+}
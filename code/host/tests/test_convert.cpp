@@ -0,0 +1,167 @@
+/*
+    Every conversion kernel (scalar, SSE2, AVX2 - whichever the CPU
+    has) against the recv_image.py formulas, written out plainly here:
+
+        RGB565  r = r5 << 3, g = g6 << 2, b = b5 << 3
+        YUV422  C = Y - 16, D = U - 128, E = V - 128
+                R = clip((298 C + 409 E + 128) >> 8)
+                G = clip((298 C - 100 D - 208 E + 128) >> 8)
+                B = clip((298 C + 516 D + 128) >> 8)
+        Y8      R = G = B = Y
+
+    Every Y/U/V combination and every RGB565 value is converted, then
+    random frames of many sizes in both layouts, flipped and not. The
+    SIMD demosaic kernels must match the scalar one (test_demosaic.py
+    checks that one against demosaic.py).
+*/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/convert.hpp"
+
+using namespace ovrecv;
+
+namespace {
+
+uint8_t clip(int v)
+{
+    return uint8_t(std::min(std::max(v, 0), 255));
+}
+
+void ref_pixel(Format format, const uint8_t* src, int x, uint8_t* out)
+{
+    switch (format) {
+    case Format::RGB565: {
+        int v = src[2 * x] | (src[2 * x + 1] << 8);
+        out[0] = uint8_t(((v >> 11) & 0x1F) << 3);
+        out[1] = uint8_t(((v >> 5) & 0x3F) << 2);
+        out[2] = uint8_t((v & 0x1F) << 3);
+        break;
+    }
+    case Format::YUV422: {
+        const uint8_t* pair = src + (x & ~1) * 2;
+        int c = src[2 * x] - 16, d = pair[1] - 128, e = pair[3] - 128;
+        out[0] = clip((298 * c + 409 * e + 128) >> 8);
+        out[1] = clip((298 * c - 100 * d - 208 * e + 128) >> 8);
+        out[2] = clip((298 * c + 516 * d + 128) >> 8);
+        break;
+    }
+    default:
+        out[0] = out[1] = out[2] = src[x];
+        break;
+    }
+}
+
+std::vector<uint8_t> reference(Format format, const uint8_t* src, int width, int height,
+                               Layout layout, bool flip)
+{
+    size_t bpp = bytes_per_pixel(layout);
+    size_t src_stride = size_t(width) * (format == Format::Y8 ? 1 : 2);
+    std::vector<uint8_t> dst(size_t(width) * height * bpp);
+    for (int y = 0; y < height; y++) {
+        uint8_t* out = &dst[size_t(flip ? height - 1 - y : y) * width * bpp];
+        for (int x = 0; x < width; x++, out += bpp) {
+            ref_pixel(format, src + y * src_stride, x, out);
+            if (bpp == 4)
+                out[3] = 255;
+        }
+    }
+    return dst;
+}
+
+bool matches(Format format, const std::vector<uint8_t>& src, int width, int height,
+             Layout layout, bool flip)
+{
+    std::vector<uint8_t> dst(size_t(width) * height * bytes_per_pixel(layout), 0xCD);
+    if (!convert(format, src.data(), width, height, dst.data(), layout, flip))
+        return false;
+    return dst == reference(format, src.data(), width, height, layout, flip);
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(15);
+
+    // each row is one U/V pair, with Y 0..255 along it
+    std::vector<uint8_t> all_yuv(size_t(256) * 2 * 65536);
+    for (size_t uv = 0; uv < 65536; uv++) {
+        uint8_t* row = &all_yuv[uv * 512];
+        for (int p = 0; p < 128; p++) {
+            row[p * 4] = uint8_t(2 * p);
+            row[p * 4 + 1] = uint8_t(uv >> 8);
+            row[p * 4 + 2] = uint8_t(2 * p + 1);
+            row[p * 4 + 3] = uint8_t(uv);
+        }
+    }
+    std::vector<uint8_t> all_rgb565(65536 * 2);
+    for (size_t v = 0; v < 65536; v++) {
+        all_rgb565[2 * v] = uint8_t(v);
+        all_rgb565[2 * v + 1] = uint8_t(v >> 8);
+    }
+
+    const Format formats[] = { Format::YUV422, Format::RGB565, Format::Y8 };
+    const Layout layouts[] = { Layout::RGB888, Layout::RGBA8888 };
+
+    Isa best = convert_force_isa(Isa::AVX2);
+    for (Isa isa : { Isa::Scalar, Isa::SSE2, Isa::AVX2 }) {
+        if (convert_force_isa(isa) != isa) {
+            printf("%s: not supported here, skipped\n", isa_name(isa));
+            continue;
+        }
+
+        CHECK(matches(Format::YUV422, all_yuv, 256, 65536, Layout::RGB888, false));
+        CHECK(matches(Format::RGB565, all_rgb565, 256, 256, Layout::RGB888, false));
+
+        // sizes around the vector widths, odd ones for RGB565 and Y8
+        int cases = 0;
+        for (int width : { 1, 2, 3, 6, 8, 14, 16, 17, 30, 32, 33, 62, 64, 66, 100, 320, 322, 640 }) {
+            for (Format format : formats) {
+                for (Layout layout : layouts) {
+                    for (bool flip : { false, true }) {
+                        int height = 1 + int(rng() % 9);
+                        std::vector<uint8_t> src(size_t(width) * height * 2);
+                        for (auto& b : src)
+                            b = uint8_t(rng());
+                        if (format == Format::YUV422 && (width & 1)) {
+                            std::vector<uint8_t> dst(size_t(width) * height * 4);
+                            CHECK(!convert(format, src.data(), width, height, dst.data(), layout, flip));
+                            continue;
+                        }
+                        CHECK(matches(format, src, width, height, layout, flip));
+                        cases++;
+                    }
+                }
+            }
+        }
+
+        // demosaic - SIMD kernels against the scalar one
+        for (int i = 0; i < 24; i++) {
+            int width = 2 + 2 * int(rng() % 200), height = 2 + 2 * int(rng() % 40);
+            Layout layout = layouts[i % 2];
+            bool flip = (i / 2) % 2;
+            Demosaic method = (i / 4) % 2 ? Demosaic::EdgeAware : Demosaic::Bilinear;
+            std::vector<uint8_t> src(size_t(width) * height);
+            for (auto& b : src)
+                b = uint8_t(rng());
+
+            size_t size = size_t(width) * height * bytes_per_pixel(layout);
+            std::vector<uint8_t> want(size), got(size);
+            convert_force_isa(Isa::Scalar);
+            CHECK(demosaic(src.data(), width, height, want.data(), layout, flip, method));
+            convert_force_isa(isa);
+            CHECK(demosaic(src.data(), width, height, got.data(), layout, flip, method));
+            CHECK(got == want);
+            cases++;
+        }
+
+        printf("%s: all YUV and RGB565 values, %d random frames\n", isa_name(isa), cases);
+    }
+    convert_force_isa(best);
+
+    return check_result();
+}
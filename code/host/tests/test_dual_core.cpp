@@ -0,0 +1,300 @@
+/*
+    The two-core pipeline (dual_core.c) with each core on a thread.
+
+    multicore_launch_core1() starts core1 on its own thread. __sev()
+    and __wfe() are the event flag of the M33: SEV sets it, WFE sleeps
+    until it is set and clears it, so a SEV before the WFE is not lost.
+    A producer thread stands in for the capture IRQ and completes a
+    frame every period into the real frame ring, counting an overrun
+    when no slot is free. Core0 is the main thread calling
+    dual_core_poll().
+
+    The transport takes a while per frame, and every 10th frame three
+    periods, so frames queue for core1 and the ring fills. At the end
+    of each send it checks the header and that the bytes are the
+    frame's pattern bit-reversed once - a slot written to by the
+    producer, or fixed up twice, while core1 holds it fails that. The
+    producer must never be given the slot on the wire, and the
+    counters must agree with the ring's: every frame fixed up is sent,
+    the queue is empty at the end and was never deeper than the ring.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "pico/stdlib.h"
+
+#include "dual_core.h"
+#include "frame_proto.h"
+}
+
+namespace {
+
+constexpr uint WIDTH = 64, HEIGHT = 32;
+constexpr uint32_t FRAME_BYTES = WIDTH * HEIGHT * 2;
+constexpr uint32_t FRAMES = 3000;
+constexpr uint32_t PERIOD_US = 200;
+constexpr uint32_t SEND_US = 120;
+constexpr uint32_t SLOW_SEND_US = 3 * PERIOD_US;
+
+const auto t_start = std::chrono::steady_clock::now();
+
+// Never destroyed - core1 is still asleep in __wfe() at exit
+std::mutex& event_mutex = *new std::mutex;
+std::condition_variable& event_cv = *new std::condition_variable;
+bool event_flag;
+std::atomic<uint32_t> wfe_sleeps{0};
+
+std::atomic<int> launches{0};
+std::thread::id core1_id;
+
+uint8_t rev[256];
+
+uint8_t fill_byte(uint32_t seq, uint32_t i)
+{
+    return uint8_t(seq * 31 + i * 7 + (i >> 8));
+}
+
+uint32_t get_u32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+}
+
+// A link with a fixed time per transfer. The data is checked when the
+// transfer ends, so it has to stay put all the while it is on the wire.
+struct Wire {
+    transport_t t;
+    const uint8_t* data = nullptr;
+    size_t len = 0;
+    uint32_t done_us = 0;
+    std::atomic<const uint8_t*> on_wire{nullptr};
+
+    uint8_t header[FRAME_PROTO_HEADER_LEN];
+    bool have_header = false;
+    uint32_t frames = 0;
+    uint32_t bad_frames = 0;
+    uint32_t bad_headers = 0;
+    uint32_t not_core1 = 0;
+    int64_t last_seq = -1;
+    uint32_t out_of_order = 0;
+};
+
+Wire wire;
+
+bool wire_send_async(transport_t*, const uint8_t* data, size_t len)
+{
+    if (wire.data)
+        return false;
+    if (std::this_thread::get_id() != core1_id)
+        wire.not_core1++;
+    bool frame = len == FRAME_BYTES;
+    uint32_t us = 5;
+    if (frame)
+        us = wire.frames % 10 == 9 ? SLOW_SEND_US : SEND_US;
+    wire.data = data;
+    wire.len = len;
+    wire.done_us = time_us_32() + us;
+    if (frame)
+        wire.on_wire = data;
+    return true;
+}
+
+// The transfer that just ended
+void wire_check()
+{
+    if (wire.len == FRAME_PROTO_HEADER_LEN) {
+        memcpy(wire.header, wire.data, FRAME_PROTO_HEADER_LEN);
+        wire.have_header = true;
+        return;
+    }
+
+    const uint8_t* h = wire.header;
+    uint32_t seq = get_u32(h + 12);
+    if (!wire.have_header || memcmp(h, FRAME_PROTO_MAGIC, 4) != 0 || (h[8] | h[9] << 8) != WIDTH ||
+        (h[10] | h[11] << 8) != HEIGHT || get_u32(h + 20) != wire.len ||
+        get_u32(h + 24) != crc32_calc(wire.data, wire.len)) {
+        wire.bad_headers++;
+    }
+    bool intact = wire.len == FRAME_BYTES;
+    for (uint32_t i = 0; intact && i < wire.len; i++)
+        intact = wire.data[i] == rev[fill_byte(seq, i)];
+    if (!intact)
+        wire.bad_frames++;
+    if (int64_t(seq) <= wire.last_seq)
+        wire.out_of_order++;
+    wire.last_seq = seq;
+    wire.have_header = false;
+    wire.frames++;
+}
+
+bool wire_is_busy(transport_t*)
+{
+    if (!wire.data)
+        return false;
+    if (int32_t(time_us_32() - wire.done_us) < 0) {
+        std::this_thread::yield();
+        return true;
+    }
+    wire_check();
+    wire.on_wire = nullptr;
+    wire.data = nullptr;
+    return false;
+}
+
+}
+
+extern "C" {
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t_start).count());
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+    launches++;
+    std::thread core1(entry);
+    core1_id = core1.get_id();
+    core1.detach();
+}
+
+void __sev(void)
+{
+    std::lock_guard<std::mutex> lock(event_mutex);
+    event_flag = true;
+    event_cv.notify_all();
+}
+
+void __wfe(void)
+{
+    std::unique_lock<std::mutex> lock(event_mutex);
+    if (!event_flag)
+        wfe_sleeps++;
+    event_cv.wait(lock, [] { return event_flag; });
+    event_flag = false;
+}
+
+}
+
+int main()
+{
+    for (int b = 0; b < 256; b++) {
+        uint8_t r = 0;
+        for (int i = 0; i < 8; i++)
+            r |= ((b >> i) & 1) << (7 - i);
+        rev[b] = uint8_t(r);
+    }
+
+    std::vector<uint8_t> storage(FRAME_RING_SLOTS * FRAME_BYTES);
+    frame_ring_init(storage.data(), FRAME_FMT_RGB565, FRAME_BYTES);
+
+    wire.t.send_async = wire_send_async;
+    wire.t.is_busy = wire_is_busy;
+    dual_core_start(&wire.t, WIDTH, HEIGHT);
+
+    std::atomic<bool> done{false};
+    uint32_t overruns = 0;
+    uint32_t given_on_wire = 0;
+    uint32_t bad_acquire = 0;
+
+    std::thread producer([&] {
+        uint32_t next = time_us_32();
+        for (uint32_t seq = 0; seq < FRAMES; seq++) {
+            next += PERIOD_US;
+            while (int32_t(time_us_32() - next) < 0)
+                std::this_thread::yield();
+
+            frame_desc_t* slot = frame_ring_acquire();
+            if (!slot) {
+                frame_ring_overrun();
+                overruns++;
+                continue;
+            }
+            if (slot->data == wire.on_wire)
+                given_on_wire++;
+            if (slot->status != FRAME_CAPTURING)
+                bad_acquire++;
+            for (uint32_t i = 0; i < slot->size; i++)
+                slot->data[i] = fill_byte(seq, i);
+            frame_ring_publish(slot);
+        }
+        done = true;
+    });
+
+    // core0 - with the queue depth sampled as it goes
+    uint32_t depth_max = 0;
+    uint32_t too_deep = 0;
+    for (uint32_t n = 0; !done; n++) {
+        dual_core_poll();
+        if (n % 16 == 0) {
+            dual_core_stats_t s;
+            dual_core_get_stats(&s);
+            depth_max = std::max(depth_max, s.queue_depth);
+            if (s.queue_depth > FRAME_RING_SLOTS || s.queue_max > FRAME_RING_SLOTS)
+                too_deep++;
+        }
+        std::this_thread::yield();
+    }
+    producer.join();
+
+    // the frames still in the ring and the queue
+    frame_ring_stats_t ring;
+    dual_core_stats_t stats;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do {
+        dual_core_poll();
+        std::this_thread::yield();
+        frame_ring_get_stats(&ring);
+        dual_core_get_stats(&stats);
+    } while ((stats.frames_sent != ring.published || ring.consumed != ring.published) &&
+             std::chrono::steady_clock::now() < deadline);
+
+    printf("%u frames: %u sent, %u overruns; queue max %u, core1 slept %u times\n", FRAMES, stats.frames_sent,
+           overruns, stats.queue_max, wfe_sleeps.load());
+    printf("core0 %.1f%% busy, core1 %.1f%% busy\n", 100.0 * stats.core0_busy_us / stats.elapsed_us,
+           100.0 * stats.core1_busy_us / stats.elapsed_us);
+
+    CHECK(launches == 1);
+    CHECK(wire.not_core1 == 0);
+
+    // ownership
+    CHECK(given_on_wire == 0);
+    CHECK(bad_acquire == 0);
+    CHECK(wire.bad_headers == 0);
+    CHECK(wire.bad_frames == 0);
+    CHECK(wire.out_of_order == 0);
+
+    // counters
+    CHECK(stats.frames_fixed == ring.published);
+    CHECK(stats.frames_sent == stats.frames_fixed);
+    CHECK(wire.frames == stats.frames_sent);
+    CHECK(ring.consumed == stats.frames_sent);
+    CHECK(stats.frames_sent + overruns == FRAMES);
+    CHECK(ring.overruns == overruns);
+    CHECK(stats.queue_depth == 0);
+    CHECK(too_deep == 0);
+    CHECK(stats.queue_max <= FRAME_RING_SLOTS);
+    CHECK(stats.queue_max >= depth_max);
+
+    // the slow sends backed frames up, and core1 went to sleep when idle
+    CHECK(stats.queue_max >= 2);
+    CHECK(overruns > 0);
+    CHECK(wfe_sleeps > 0);
+
+    // every slot is back in the ring
+    for (int i = 0; i < FRAME_RING_SLOTS; i++)
+        CHECK(frame_ring_acquire() != nullptr);
+    CHECK(frame_ring_acquire() == nullptr);
+
+    return check_result();
+}
@@ -0,0 +1,221 @@
+/*
+    Trigger to VSYNC armed, with the event loop (event.c) and with the
+    sleep_ms(100) poll it replaced, with events injected from threads.
+
+    __sev() and __wfe() are the event flag of the M33, as in
+    test_dual_core. A thread presses the button at random 50-250 ms
+    intervals - in the poll loop it sets the flag the old GPIO IRQ
+    set, in the event loop it calls event_post() as the IRQ does now.
+    The main thread runs the loop, and a press counts as armed where
+    the loop would call capture_frame(). The event loop is run again
+    with a second thread posting EVENT_CMD every 50 us.
+
+    The event loop must arm every press, within a few ms of host
+    thread wakeup, and must wake for nothing else. event.c's
+    histogram must count every press. It prints latency percentiles
+    and wakeups per second for each loop, and event.c's histograms.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "event.h"
+}
+
+namespace {
+
+constexpr uint32_t PRESSES = 40;
+constexpr uint32_t POLL_MS = 100;
+constexpr uint32_t CMD_US = 50;
+
+const auto t_start = std::chrono::steady_clock::now();
+
+// Never destroyed - a thread may still be in __sev() at exit
+std::mutex& event_mutex = *new std::mutex;
+std::condition_variable& event_cv = *new std::condition_variable;
+bool event_flag;
+
+std::atomic<bool> done;
+std::atomic<bool> button_pressed;       // the old GPIO IRQ's flag
+std::atomic<uint32_t> pressed_us;       // the last press
+
+// The button - PRESSES presses at random intervals
+void press_thread(bool post)
+{
+    std::mt19937 rng(22);
+    std::uniform_int_distribution<int> gap_ms(50, 250);
+    for (uint32_t i = 0; i < PRESSES; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(gap_ms(rng)));
+        pressed_us = time_us_32();
+        if (post)
+            event_post(EVENT_BUTTON);
+        else
+            button_pressed = true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS + 10));
+    done = true;
+    if (post)
+        event_post(EVENT_TIMER);    // wake the loop to see it
+}
+
+// The UART RX IRQ, busy
+void cmd_thread()
+{
+    while (!done) {
+        event_post(EVENT_CMD);
+        std::this_thread::sleep_for(std::chrono::microseconds(CMD_US));
+    }
+}
+
+struct Result {
+    std::vector<uint32_t> latency_us;
+    uint32_t wakeups;           // times the loop woke up
+    double seconds;
+    event_stats_t button;       // event.c's, for this run
+};
+
+// The old main loop
+Result run_poll()
+{
+    Result r = {};
+    done = false;
+    std::thread presser(press_thread, false);
+    uint32_t t0 = time_us_32();
+    while (!done) {
+        if (button_pressed.exchange(false))
+            r.latency_us.push_back(time_us_32() - pressed_us);
+        r.wakeups++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+    }
+    r.seconds = (time_us_32() - t0) / 1e6;
+    presser.join();
+    return r;
+}
+
+// framegrabber.c's main loop
+Result run_events(bool commands)
+{
+    Result r = {};
+    event_stats_t before;
+    event_get_stats(EVENT_BUTTON, &before);
+    done = false;
+    std::thread presser(press_thread, true);
+    std::thread cmds;
+    if (commands)
+        cmds = std::thread(cmd_thread);
+    uint32_t t0 = time_us_32();
+    while (!done) {
+        uint32_t ev = event_wait();
+        if (ev & EVENT_BIT(EVENT_BUTTON))
+            r.latency_us.push_back(time_us_32() - pressed_us);
+        if (!done)
+            r.wakeups++;
+    }
+    r.seconds = (time_us_32() - t0) / 1e6;
+    presser.join();
+    if (commands)
+        cmds.join();
+    event_take();
+
+    event_get_stats(EVENT_BUTTON, &r.button);
+    r.button.handled -= before.handled;
+    r.button.coalesced -= before.coalesced;
+    for (uint b = 0; b < EVENT_HIST_BUCKETS; b++)
+        r.button.hist[b] -= before.hist[b];
+    return r;
+}
+
+uint32_t percentile(std::vector<uint32_t> v, uint p)
+{
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[std::min<size_t>(v.size() - 1, v.size() * p / 100)];
+}
+
+double mean(const std::vector<uint32_t>& v)
+{
+    double sum = 0;
+    for (uint32_t x : v)
+        sum += x;
+    return v.empty() ? 0 : sum / v.size();
+}
+
+}
+
+extern "C" {
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t_start)
+                        .count());
+}
+
+void __sev(void)
+{
+    std::lock_guard<std::mutex> lock(event_mutex);
+    event_flag = true;
+    event_cv.notify_all();
+}
+
+void __wfe(void)
+{
+    std::unique_lock<std::mutex> lock(event_mutex);
+    event_cv.wait(lock, [] { return event_flag; });
+    event_flag = false;
+}
+
+// no report timer here
+bool add_repeating_timer_ms(int32_t, repeating_timer_callback_t, void*, repeating_timer_t*)
+{
+    return false;
+}
+
+}
+
+int main()
+{
+    Result poll = run_poll();
+    Result events = run_events(false);
+    Result busy = run_events(true);
+
+    printf("%u presses, 50-250 ms apart - trigger to VSYNC armed:\n", PRESSES);
+    const Result* results[] = { &poll, &events, &busy };
+    const char* names[] = { "sleep_ms(100) poll", "event loop", "event loop, EVENT_CMD every 50 us" };
+    for (int i = 0; i < 3; i++) {
+        const Result& r = *results[i];
+        printf("  %-34s %2zu armed, mean %6.0f us, p50 %6u us, p99 %6u us, max %6u us, %.1f wakeups/s\n",
+               names[i], r.latency_us.size(), mean(r.latency_us), percentile(r.latency_us, 50),
+               percentile(r.latency_us, 99), percentile(r.latency_us, 100), r.wakeups / r.seconds);
+    }
+    event_print_stats();
+
+    // every press armed, within a host thread wakeup, and no waking for nothing
+    for (const Result* r : { &events, &busy }) {
+        CHECK(r->latency_us.size() == PRESSES);
+        CHECK(r->button.handled == PRESSES && r->button.coalesced == 0);
+        uint32_t counted = 0;
+        for (uint b = 0; b < EVENT_HIST_BUCKETS; b++)
+            counted += r->button.hist[b];
+        CHECK(counted == PRESSES);
+        CHECK(percentile(r->latency_us, 50) < 2000);
+        CHECK(percentile(r->latency_us, 100) < 20000);
+    }
+    CHECK(events.wakeups == PRESSES);
+
+    // the poll waits half a period on average, and wakes ten times a second
+    CHECK(mean(poll.latency_us) > 20000 && percentile(poll.latency_us, 100) <= POLL_MS * 1000 + 20000);
+    CHECK(poll.wakeups / poll.seconds > 8);
+
+    return check_result();
+}
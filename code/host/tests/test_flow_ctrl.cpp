@@ -0,0 +1,262 @@
+/*
+    Credit-based flow control (flow_ctrl.c) against a slow consumer:
+    STREAM_MODE with FLOW_CONTROL - the streaming capture in OV7670.c,
+    cmd.c on UART RX, event.c and flow_ctrl.c - on a simulated sensor
+    and a 3 Mbaud UART, on virtual time (sim_sensor.hpp).
+
+    The host reads the wire with ovrecv::FrameDecoder but only gets
+    through HOST_BYTES_PER_S of it. Every 10 ms it grants CREDIT for
+    the bytes it got through, over RX, after an opening window of two
+    frames. The sensor outruns that ten times over.
+
+    For each policy:
+    - the device may never have sent more than the host granted
+    - no frame is half sent - the wire is whole frames and nothing
+      else, each exactly what the sensor sent (downscaled frames
+      checked against a 2x2 decimation done here), in order
+    - the drop counters are the policy's and add up with the frames
+      sent to the frames captured
+    - latency stays bounded: capture to send started within
+      FRAME_RING_SLOTS frame periods for drop-oldest and downscale -
+      the ring has no slot for newer frames while one is going out -
+      and within the time to earn a frame's credit for drop-newest,
+      which holds the old frame
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "bitrev.h"
+#include "cmd.h"
+#include "event.h"
+#include "flow_ctrl.h"
+#include "frame_proto.h"
+#include "frame_ring.h"
+#include "ov7670_stream.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 320, HEIGHT = 240;
+constexpr uint32_t FRAME_BYTES = WIDTH * HEIGHT * 2;
+constexpr uint32_t FULL_WIRE = FRAME_PROTO_HEADER_LEN + FRAME_BYTES;
+
+// 784 x 510 pixel times a frame at 2 PCLKs a pixel, XCLK 15 MHz / 2
+constexpr uint32_t PERIOD_US = 784 * 510 * 2 * 2 / 15;
+constexpr uint32_t FRAMES = 90;
+
+constexpr uint32_t HOST_BYTES_PER_S = 150000;
+constexpr uint32_t HOST_TICK_US = 10000;
+constexpr uint32_t HOST_WINDOW = 2 * FULL_WIRE;
+
+uint8_t frame_storage[FRAME_RING_SLOTS * FRAME_BYTES];
+
+// byte i of line l of frame f - the frame number in the first two
+// bytes, which the downscale keeps
+uint8_t scene_byte(uint32_t f, uint l, uint i)
+{
+    if (l == 0 && i < 2)
+        return uint8_t(f >> (8 * i));
+    return uint8_t(i * 3 + l * 5 + f * 7);
+}
+
+// STREAM_MODE's stream callbacks - a frame is one band
+uint8_t* stream_frame_dest(uint line, void* ctx)
+{
+    frame_desc_t* slot = frame_ring_acquire();
+    if (!slot) {
+        frame_ring_overrun();
+        return NULL;
+    }
+    return slot->data;
+}
+
+void stream_frame_done(uint8_t* frame, uint line, uint nlines, void* ctx)
+{
+    frame_ring_publish(frame_ring_lookup(frame));
+    event_post(EVENT_FRAME);
+}
+
+const ov7670_stream_cb_t stream_cb = { stream_frame_dest, stream_frame_done, NULL };
+
+const cmd_handlers_t cmd_handlers = { flow_ctrl_add_credit, NULL, NULL, NULL };
+
+// YUYV 2x2 decimated as flow_ctrl.c describes it
+std::vector<uint8_t> downscale(const std::vector<uint8_t>& in)
+{
+    std::vector<uint8_t> out;
+    for (uint y = 0; y < HEIGHT; y += 2) {
+        const uint8_t* line = &in[y * WIDTH * 2];
+        for (uint x = 0; x < WIDTH * 2; x += 8) {
+            out.push_back(line[x]);
+            out.push_back(line[x + 1]);
+            out.push_back(line[x + 4]);
+            out.push_back(line[x + 7]);
+        }
+    }
+    return out;
+}
+
+// The slow consumer
+struct Host {
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> frames;
+    std::vector<uint64_t> arrived_us;
+    size_t fed = 0;
+    uint64_t consumed = 0;
+    uint64_t granted = 0;
+    uint64_t over_credit = 0;       // polls that found more on the wire than granted
+
+    void grant(uint32_t bytes)
+    {
+        granted += bytes;
+        sim::uart_rx(ovrecv::encode_credit(bytes));
+    }
+
+    void tick()
+    {
+        const std::vector<uint8_t>& wire = sim::uart_wire();
+        if (wire.size() > granted)
+            over_credit++;
+        if (wire.size() > fed) {
+            dec.feed(wire.data() + fed, wire.size() - fed, frames);
+            fed = wire.size();
+            arrived_us.resize(frames.size(), sim::now_us);
+        }
+        uint64_t take = std::min<uint64_t>(wire.size() - consumed, HOST_BYTES_PER_S / (1000000 / HOST_TICK_US));
+        if (take) {
+            consumed += take;
+            grant(uint32_t(take));
+        }
+        sim::at(sim::now_us + HOST_TICK_US, [this] { tick(); });
+    }
+};
+
+struct Result {
+    uint32_t sent, intact, downscaled, out_of_order;
+    uint64_t wire_bytes, frame_bytes;
+    uint64_t host_latency_max_us;   // capture -> last byte at the host
+    flow_stats_t flow;
+    frame_ring_stats_t ring;
+    uint64_t over_credit, granted;
+};
+
+Result run(flow_policy_t policy)
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    ov7670_capture_desc_t desc;
+    ov7670_capture_desc_default(&desc);
+    frame_ring_init(frame_storage, FRAME_FMT_YUV422, FRAME_BYTES);
+
+    sim::Sensor sensor;
+    sensor.period_us = PERIOD_US;
+    sensor.byte = scene_byte;
+    sensor.skip = [](uint32_t f) { return f >= FRAMES; };
+    sim::sensor_start(sensor, desc, sim::now_us + 20000);
+    CHECK(ov7670_stream_start(&desc, HEIGHT, &stream_cb));
+
+    flow_ctrl_init(uart, policy, WIDTH, HEIGHT);
+    cmd_init(uart1, uart, &cmd_handlers);
+
+    Host host;
+    host.grant(HOST_WINDOW);
+    sim::at(sim::now_us + HOST_TICK_US, [&host] { host.tick(); });
+
+    // STREAM_MODE's FLOW_CONTROL loop, until the last frames have gone -
+    // with a timer, so the loop still wakes once the sensor has stopped
+    CHECK(event_timer_start(100));
+    uint64_t end = sim::frame_start_us(FRAMES) + 4 * FULL_WIRE * 1000000ull / HOST_BYTES_PER_S;
+    while (sim::now_us < end) {
+        event_wait();
+        flow_ctrl_poll();
+        cmd_poll();
+    }
+
+    Result res = {};
+    flow_ctrl_get_stats(&res.flow);
+    frame_ring_get_stats(&res.ring);
+    ov7670_stream_stop();
+    host.tick();
+    res.over_credit = host.over_credit;
+    res.granted = host.granted;
+    res.wire_bytes = sim::uart_wire().size();
+
+    CHECK(host.dec.stats().crc_errors == 0 && host.dec.stats().skipped_bytes == 0);
+    int64_t last = -1;
+    for (size_t k = 0; k < host.frames.size(); k++) {
+        const auto& fr = host.frames[k];
+        uint32_t f = fr.payload.size() >= 2 ? fr.payload[0] | fr.payload[1] << 8 : 0;
+        std::vector<uint8_t> want = sim::expected_frame(f, desc);
+        bool half = fr.width == WIDTH / 2;
+        if (half) {
+            want = downscale(want);
+            res.downscaled++;
+        }
+        res.sent++;
+        res.frame_bytes += FRAME_PROTO_HEADER_LEN + fr.payload.size();
+        if (fr.payload == want && fr.height == (half ? HEIGHT / 2 : HEIGHT))
+            res.intact++;
+        if (int64_t(f) <= last)
+            res.out_of_order++;
+        last = f;
+        res.host_latency_max_us = std::max(res.host_latency_max_us, host.arrived_us[k] - fr.timestamp_us);
+    }
+    return res;
+}
+
+}
+
+int main()
+{
+    const flow_policy_t policies[] = { FLOW_DROP_NEWEST, FLOW_DROP_OLDEST, FLOW_DOWNSCALE };
+    const char* names[] = { "drop newest", "drop oldest", "downscale" };
+
+    uint32_t tx_us = uint32_t(uint64_t(FULL_WIRE) * 10 * 1000000 / BAUD);
+    uint32_t earn_us = uint32_t(uint64_t(FULL_WIRE) * 1000000 / HOST_BYTES_PER_S);
+    printf("sensor %.1f fps, link %u KB/s, host %u KB/s; a frame is %u us on the wire, "
+           "its credit %u us at the host\n",
+           1e6 / PERIOD_US, BAUD / 10 / 1000, HOST_BYTES_PER_S / 1000, tx_us, earn_us);
+
+    for (int p = 0; p < 3; p++) {
+        Result r = run(policies[p]);
+        printf("%-11s %2u frames sent (%2u downscaled), %2u intact, dropped %2u newest %2u oldest; "
+               "%llu bytes sent for %llu granted\n",
+               names[p], r.sent, r.downscaled, r.intact, r.flow.dropped_newest, r.flow.dropped_oldest,
+               (unsigned long long)r.wire_bytes, (unsigned long long)r.granted);
+        printf("%-11s capture to send %u us (max %u us), to the host max %llu us\n", "", r.flow.latency_us,
+               r.flow.latency_max_us, (unsigned long long)r.host_latency_max_us);
+
+        // within credit, and whole frames only
+        CHECK(r.over_credit == 0 && r.wire_bytes <= r.granted);
+        CHECK(r.wire_bytes == r.frame_bytes);
+        CHECK(r.sent > 0 && r.intact == r.sent && r.out_of_order == 0);
+        CHECK(r.sent == r.flow.frames_sent && r.downscaled == r.flow.frames_downscaled);
+
+        // every frame captured is sent or dropped by the policy, but for the
+        // frame the ring dropped and the one held when the run ended
+        uint32_t accounted = r.sent + r.flow.dropped_newest + r.flow.dropped_oldest;
+        CHECK(accounted + 1 >= r.ring.published && accounted <= r.ring.published);
+
+        if (policies[p] == FLOW_DROP_NEWEST) {
+            CHECK(r.flow.dropped_newest > 0 && r.flow.dropped_oldest == 0 && r.downscaled == 0);
+            CHECK(r.flow.latency_max_us <= earn_us + tx_us + FRAME_RING_SLOTS * PERIOD_US);
+        } else {
+            CHECK(r.flow.dropped_oldest > 0 && r.flow.dropped_newest == 0);
+            CHECK(r.flow.latency_max_us <= FRAME_RING_SLOTS * PERIOD_US);
+        }
+        if (policies[p] == FLOW_DOWNSCALE)
+            CHECK(r.downscaled > 0);
+        else
+            CHECK(r.downscaled == 0);
+    }
+
+    return check_result();
+}
@@ -0,0 +1,140 @@
+/*
+    Frames encoded by the firmware (frame_proto.c) through a damaged
+    link into the host decoder (ovrecv::FrameDecoder).
+
+    Some frames lose a byte, have one corrupted or are preceded by
+    junk, some of it a false "OVFR" marker. The stream is fed in
+    pieces of random size. Every undamaged frame must come out, in
+    order and intact, and nothing else may.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+
+extern "C" {
+#include "frame_proto.h"
+}
+
+using namespace ovrecv;
+
+namespace {
+
+struct Sent {
+    frame_desc_t desc;
+    uint16_t width;
+    uint16_t height;
+    uint8_t flags;
+    std::vector<uint8_t> payload;
+};
+
+// Header, payload and (with FRAME_FLAG_CRC_TRAILER) trailer, as the firmware sends them
+std::vector<uint8_t> wire_bytes(Sent& f)
+{
+    f.desc.data = f.payload.data();
+    f.desc.size = uint32_t(f.payload.size());
+
+    std::vector<uint8_t> out(FRAME_PROTO_HEADER_LEN);
+    frame_proto_encode_header(out.data(), &f.desc, f.width, f.height, f.flags);
+    out.insert(out.end(), f.payload.begin(), f.payload.end());
+    if (f.flags & FRAME_FLAG_CRC_TRAILER) {
+        uint32_t crc = crc32_calc(f.payload.data(), f.payload.size());
+        for (int i = 0; i < 4; i++)
+            out.push_back(uint8_t(crc >> (8 * i)));
+    }
+    return out;
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(5);
+
+    // the firmware and host CRCs are the same CRC
+    {
+        std::vector<uint8_t> data(1000);
+        for (auto& b : data)
+            b = uint8_t(rng());
+        CHECK(crc32_calc(data.data(), data.size()) == ovrecv::crc32_update(0, data.data(), data.size()));
+        CHECK(crc32_calc((const uint8_t*)"123456789", 9) == 0xCBF43926u);
+    }
+
+    std::vector<uint8_t> stream;
+    std::vector<Sent> expected;
+    uint32_t damaged = 0;
+
+    for (uint32_t seq = 0; seq < 400; seq++) {
+        Sent f = {};
+        f.desc.seq = seq * 2;       // capture runs ahead - gaps are normal
+        f.desc.timestamp_us = seq * 66666;
+        f.desc.format = uint8_t(seq % 5);
+        f.width = uint16_t(16 + rng() % 320);
+        f.height = uint16_t(1 + rng() % 240);
+        f.flags = (seq % 3 == 0) ? FRAME_FLAG_CRC_TRAILER : 0;
+        f.payload.resize(rng() % 20000);
+        for (auto& b : f.payload)
+            b = uint8_t(rng());
+        // payloads that contain the marker must not confuse the decoder
+        if (f.payload.size() > 100 && seq % 4 == 1)
+            memcpy(&f.payload[50], FRAME_PROTO_MAGIC, 4);
+
+        std::vector<uint8_t> wire = wire_bytes(f);
+
+        switch (rng() % 10) {
+        case 0:     // byte lost
+            wire.erase(wire.begin() + rng() % wire.size());
+            damaged++;
+            break;
+        case 1:     // byte corrupted
+            wire[rng() % wire.size()] ^= uint8_t(1 + rng() % 255);
+            damaged++;
+            break;
+        case 2: {   // junk before the frame, with a false marker
+            std::vector<uint8_t> junk(4 + rng() % 64);
+            for (auto& b : junk)
+                b = uint8_t(rng());
+            memcpy(&junk[rng() % (junk.size() - 3)], FRAME_PROTO_MAGIC, 4);
+            stream.insert(stream.end(), junk.begin(), junk.end());
+            expected.push_back(f);
+            break;
+        }
+        default:
+            expected.push_back(f);
+            break;
+        }
+        stream.insert(stream.end(), wire.begin(), wire.end());
+    }
+
+    FrameDecoder decoder;
+    std::vector<Frame> frames;
+    for (size_t pos = 0; pos < stream.size(); ) {
+        size_t n = std::min<size_t>(1 + rng() % 5000, stream.size() - pos);
+        decoder.feed(stream.data() + pos, n, frames);
+        pos += n;
+    }
+
+    printf("%zu frames sent, %u damaged, %zu received - %llu CRC errors, %llu resyncs\n",
+           expected.size() + damaged, damaged, frames.size(),
+           (unsigned long long)decoder.stats().crc_errors, (unsigned long long)decoder.stats().resyncs);
+
+    CHECK(frames.size() == expected.size());
+    for (size_t i = 0; i < std::min(frames.size(), expected.size()); i++) {
+        const Frame& got = frames[i];
+        const Sent& want = expected[i];
+        CHECK(got.seq == want.desc.seq);
+        CHECK(got.timestamp_us == want.desc.timestamp_us);
+        CHECK(uint8_t(got.format) == want.desc.format);
+        CHECK(got.flags == want.flags);
+        CHECK(got.width == want.width && got.height == want.height);
+        CHECK(got.payload == want.payload);
+    }
+    CHECK(decoder.stats().frames == expected.size());
+    CHECK(decoder.stats().crc_errors + decoder.stats().resyncs > 0);
+
+    return check_result();
+}
@@ -0,0 +1,178 @@
+/*
+    Stress test for the firmware frame ring (frame_ring.c).
+
+    The producer thread stands in for the DMA IRQ and the consumer for
+    the transmit loop. The producer completes a frame every period and
+    never waits: when no slot is free it counts an overrun, as the
+    capture path does. Some captures fail and the producer aborts
+    them while the consumer is releasing others. The consumer takes
+    longer than a period over some frames so the ring fills up. Every
+    frame the consumer gets must be whole, in order, and not written
+    to while it holds it, and the sequence gaps must add up to the
+    overruns.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "frame_ring.h"
+}
+
+namespace {
+
+constexpr uint32_t FRAME_BYTES = 4096;
+constexpr uint32_t FRAMES = 20000;
+constexpr uint32_t FRAME_PERIOD_US = 20;
+
+const auto t_start = std::chrono::steady_clock::now();
+
+// pattern for the frame with sequence number seq
+uint8_t fill_byte(uint32_t seq, uint32_t i)
+{
+    return uint8_t(seq * 31 + i * 7 + (i >> 8));
+}
+
+bool frame_intact(const frame_desc_t* slot)
+{
+    for (uint32_t i = 0; i < slot->size; i++) {
+        if (slot->data[i] != fill_byte(slot->seq, i))
+            return false;
+    }
+    return true;
+}
+
+}
+
+extern "C" uint32_t time_us_32(void)
+{
+    return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t_start).count());
+}
+
+int main()
+{
+    std::vector<uint8_t> storage(FRAME_RING_SLOTS * FRAME_BYTES);
+    frame_ring_init(storage.data(), FRAME_FMT_RGB565, FRAME_BYTES);
+
+    std::atomic<bool> done{false};
+    uint32_t overruns = 0;
+    uint32_t aborts = 0;
+    uint32_t bad_acquire = 0;
+    uint32_t seq = 0;
+
+    std::thread producer([&] {
+        uint32_t next = time_us_32();
+        for (uint32_t n = 0; n < FRAMES; n++) {
+            // a frame per period, however the consumer is doing
+            next += FRAME_PERIOD_US;
+            while (int32_t(time_us_32() - next) < 0)
+                std::this_thread::yield();
+
+            frame_desc_t* slot = frame_ring_acquire();
+            if (!slot) {
+                frame_ring_overrun();
+                seq++;
+                overruns++;
+                continue;
+            }
+            if (slot->status != FRAME_CAPTURING || slot != frame_ring_lookup(slot->data))
+                bad_acquire++;
+
+            // a failed capture gives the slot back without using a sequence number
+            if (n % 97 == 0) {
+                memset(slot->data, 0xEE, slot->size);
+                frame_ring_abort(slot);
+                aborts++;
+                continue;
+            }
+
+            for (uint32_t i = 0; i < slot->size; i++)
+                slot->data[i] = fill_byte(seq, i);
+            frame_ring_publish(slot);
+            seq++;
+        }
+        done = true;
+    });
+
+    uint32_t received = 0;
+    uint32_t gaps = 0;
+    uint32_t torn = 0;
+    uint32_t out_of_order = 0;
+    uint32_t bad_status = 0;
+    int64_t last_seq = -1;
+    uint32_t last_ts = 0;
+
+    std::thread consumer([&] {
+        for (;;) {
+            bool finished = done;
+            frame_desc_t* slot = frame_ring_get_ready();
+            if (!slot) {
+                if (finished)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (slot->status != FRAME_SENDING || slot->size != FRAME_BYTES || slot->format != FRAME_FMT_RGB565)
+                bad_status++;
+            if (int64_t(slot->seq) <= last_seq || slot->timestamp_us < last_ts)
+                out_of_order++;
+            else
+                gaps += uint32_t(slot->seq - last_seq - 1);
+            last_seq = slot->seq;
+            last_ts = slot->timestamp_us;
+
+            // hold some frames as long as a send would, then check nothing wrote to them
+            if (received % 8 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            if (!frame_intact(slot))
+                torn++;
+
+            frame_ring_release(slot);
+            received++;
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    frame_ring_stats_t stats;
+    frame_ring_get_stats(&stats);
+
+    printf("%u frames: %u received, %u overruns, %u aborted\n", FRAMES, received, overruns, aborts);
+
+    CHECK(bad_acquire == 0);
+    CHECK(bad_status == 0);
+    CHECK(torn == 0);
+    CHECK(out_of_order == 0);
+    CHECK(received + overruns + aborts == FRAMES);
+    // overruns after the last frame received aren't gaps yet
+    CHECK(seq == received + overruns);
+    CHECK(gaps == overruns - (seq - 1 - last_seq));
+    CHECK(stats.captured == received + overruns);
+    CHECK(stats.published == received);
+    CHECK(stats.consumed == received);
+    CHECK(stats.overruns == overruns);
+
+    // the slow frames must have filled the ring
+    CHECK(overruns > 0);
+
+    // every slot is free again
+    frame_desc_t* held[FRAME_RING_SLOTS];
+    for (int i = 0; i < FRAME_RING_SLOTS; i++)
+        CHECK((held[i] = frame_ring_acquire()) != nullptr);
+    CHECK(frame_ring_acquire() == nullptr);
+
+    // an aborted slot goes straight back to the producer
+    frame_ring_abort(held[1]);
+    CHECK(frame_ring_acquire() == held[1]);
+    CHECK(frame_ring_acquire() == nullptr);
+
+    return check_result();
+}
@@ -0,0 +1,340 @@
+/*
+    ov7670_grab_frame() (OV7670.c) against a simulated sensor.
+
+    Time is virtual: every poll of VSYNC is 1 us. The sensor runs QVGA
+    YUV422 at CLKRC 0x01 - 510 lines per 106624 us, VSYNC on lines
+    0-2 and HREF on the even lines 20-498, 240 lines of 160 words. The
+    one-shot SM and its DMA are modelled: after the line count is put
+    in the TX FIFO the SM waits for a VSYNC falling edge, then every
+    HREF line is 160 words until the transfer count runs out.
+
+    Faults: some frames lose a run of lines, PCLK stalls for 1-400 ms
+    (VSYNC keeps going) and the sensor stops entirely for 50-1500 ms.
+
+    No grab may return true with a frame that is short or has lines of
+    two frames, none may take longer than the start and frame
+    deadlines (1.5 + 1.25 periods), and all three kinds of failure
+    must be seen and recovered from.
+*/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+
+#include "OV7670.h"
+#include "boot_trace.h"
+#include "ov7670_grab.h"
+#include "ov7670_pio_gen.h"
+#include "sccb.h"
+}
+
+namespace {
+
+constexpr uint32_t PERIOD_US = 106624;
+constexpr uint32_t LINES = 510;
+constexpr uint32_t LINE_WORDS = 160;
+constexpr uint32_t FRAME_LINES = 240;
+constexpr int DROP_PCT = 10;        // frames that lose lines
+constexpr int GRABS = 500;
+
+uint64_t now_us = 1000000;
+
+// [from, to) - sorted and apart
+struct Window {
+    uint64_t from, to;
+};
+std::vector<Window> stalls;         // PCLK stopped, VSYNC running
+std::vector<Window> stops;          // sensor stopped
+
+bool in_window(const std::vector<Window>& w, uint64_t t)
+{
+    auto it = std::upper_bound(w.begin(), w.end(), t, [](uint64_t t, const Window& w) { return t < w.from; });
+    return it != w.begin() && t < (it - 1)->to;
+}
+
+uint32_t hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t frame_of(uint64_t t)
+{
+    return uint32_t(t / PERIOD_US);
+}
+
+uint32_t line_of(uint64_t t)
+{
+    return uint32_t((t % PERIOD_US) * LINES / PERIOD_US);
+}
+
+bool vsync_at(uint64_t t)
+{
+    return !in_window(stops, t) && line_of(t) < 3;
+}
+
+// Line l of frame f has HREF - some frames lose a run of lines
+bool href_line(uint32_t f, uint32_t l)
+{
+    if (l < 20 || l > 498 || (l & 1))
+        return false;
+    if (hash(f) % 100 < uint32_t(DROP_PCT)) {
+        uint32_t k = (l - 20) / 2, at = hash(f * 7 + 1) % FRAME_LINES, n = 1 + hash(f * 7 + 2) % 16;
+        if (k >= at && k < at + n)
+            return false;
+    }
+    return true;
+}
+
+// One-shot SM and DMA: 0 stopped, 1 pulled the line count, 2 saw
+// VSYNC high, 3 capturing lines
+int sm_phase;
+bool sm_enabled;
+bool dma_busy;
+uint32_t words_left;
+uint64_t model_us;
+
+// What the last capture got
+uint32_t cap_frame, cap_lines;
+bool cap_mixed;
+
+void advance()
+{
+    for (uint64_t u = model_us + 1; u <= now_us; u++) {
+        if (!sm_enabled)
+            continue;
+        bool vs = vsync_at(u);
+        if (sm_phase == 1 && vs) {
+            sm_phase = 2;
+        } else if (sm_phase == 2 && !vs) {
+            sm_phase = 3;
+        } else if (sm_phase == 3 && line_of(u) != line_of(u - 1)) {
+            uint64_t end = u - 1;   // the line that just ended
+            uint32_t f = frame_of(end), l = line_of(end);
+            if (dma_busy && !in_window(stops, end) && !in_window(stalls, end) && href_line(f, l)) {
+                if (cap_lines == 0)
+                    cap_frame = f;
+                else if (f != cap_frame)
+                    cap_mixed = true;
+                cap_lines++;
+                words_left -= LINE_WORDS;
+                if (words_left == 0)
+                    dma_busy = false;
+            }
+        }
+    }
+    model_us = now_us;
+}
+
+}
+
+extern "C" {
+
+// The grab path - the model above
+
+uint32_t time_us_32(void)
+{
+    return uint32_t(now_us);
+}
+
+bool gpio_get(uint gpio)
+{
+    now_us++;
+    advance();
+    return gpio == 2 && vsync_at(now_us);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return now_us + ms * 1000ull;
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return now_us >= t;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    now_us += ms * 1000ull;
+}
+
+bool dma_channel_is_busy(uint)
+{
+    advance();
+    return dma_busy;
+}
+
+void dma_channel_abort(uint)
+{
+    dma_busy = false;
+}
+
+void dma_channel_set_trans_count(uint, uint32_t count, bool)
+{
+    words_left = count;
+}
+
+void dma_channel_start(uint)
+{
+    advance();
+    dma_busy = true;
+    cap_lines = 0;
+    cap_mixed = false;
+}
+
+void pio_sm_set_enabled(PIO, uint, bool enabled)
+{
+    advance();
+    sm_enabled = enabled;
+}
+
+void pio_sm_exec(PIO, uint, uint)
+{
+    sm_phase = 0;
+}
+
+void pio_sm_put(PIO, uint, uint32_t)
+{
+    if (sm_phase == 0)
+        sm_phase = 1;
+}
+
+bool sccb_read(uint8_t, uint8_t* value)
+{
+    *value = 0;
+    return true;
+}
+
+void boot_trace_mark(const char*)
+{
+}
+
+// Not on the grab path
+
+void dma_channel_set_write_addr(uint, volatile void*, bool) {}
+void pio_sm_clear_fifos(PIO, uint) {}
+void pio_sm_restart(PIO, uint) {}
+void gpio_init(uint) {}
+void gpio_put(uint, bool) {}
+void gpio_set_dir(uint, bool) {}
+void gpio_set_function(uint, gpio_function_t) {}
+void gpio_set_pulls(uint, bool, bool) {}
+void irq_set_enabled(uint, bool) {}
+void irq_set_exclusive_handler(uint, irq_handler_t) {}
+int i2c_read_blocking(i2c_inst_t*, uint8_t, uint8_t*, size_t, bool) { return -1; }
+int dma_claim_unused_channel(bool) { return 0; }
+void dma_channel_unclaim(uint) {}
+dma_channel_config dma_channel_get_default_config(uint) { return dma_channel_config(); }
+void channel_config_set_read_increment(dma_channel_config*, bool) {}
+void channel_config_set_write_increment(dma_channel_config*, bool) {}
+void channel_config_set_dreq(dma_channel_config*, uint) {}
+void channel_config_set_transfer_data_size(dma_channel_config*, enum dma_channel_transfer_size) {}
+void channel_config_set_chain_to(dma_channel_config*, uint) {}
+void dma_channel_configure(uint, const dma_channel_config*, volatile void*, const volatile void*, uint, bool) {}
+void dma_channel_set_config(uint, const dma_channel_config*, bool) {}
+void dma_channel_set_irq0_enabled(uint, bool) {}
+bool dma_channel_get_irq0_status(uint) { return false; }
+void dma_channel_acknowledge_irq0(uint) {}
+pio_sm_config pio_get_default_sm_config(void) { return pio_sm_config(); }
+void sm_config_set_in_pins(pio_sm_config*, uint) {}
+void sm_config_set_in_shift(pio_sm_config*, bool, bool, uint) {}
+void sm_config_set_wrap(pio_sm_config*, uint, uint) {}
+bool pio_can_add_program(PIO, const pio_program_t*) { return true; }
+uint pio_add_program(PIO, const pio_program_t*) { return 0; }
+void pio_add_program_at_offset(PIO, const pio_program_t*, uint) {}
+void pio_remove_program(PIO, const pio_program_t*, uint) {}
+void pio_gpio_init(PIO, uint) {}
+uint pio_get_dreq(PIO, uint, bool) { return 0; }
+int pio_sm_init(PIO, uint, uint, const pio_sm_config*) { return 0; }
+uint pio_sm_get_tx_fifo_level(PIO, uint) { return 0; }
+uint pwm_gpio_to_slice_num(uint) { return 0; }
+void pwm_set_clkdiv(uint, float) {}
+void pwm_set_wrap(uint, uint16_t) {}
+void pwm_set_chan_level(uint, uint, uint16_t) {}
+void pwm_set_enabled(uint, bool) {}
+void sccb_init(i2c_inst_t*, uint8_t, uint) {}
+bool sccb_reset(uint) { return true; }
+bool sccb_poll(uint8_t, uint8_t, uint8_t, uint) { return true; }
+bool sccb_write(uint8_t, uint8_t) { return true; }
+void sccb_begin() {}
+void sccb_set(uint8_t, uint8_t) {}
+uint8_t sccb_get(uint8_t) { return 0; }
+uint sccb_commit() { return 0; }
+bool ov7670_pio_gen(const ov7670_capture_desc_t*, ov7670_pio_gen_t*) { return false; }
+
+}
+
+int main()
+{
+    std::mt19937 rng(25);
+    static uint8_t buffer[320 * 240 * 2];
+
+    // faults over the run
+    uint64_t end = now_us + uint64_t(GRABS) * 700000;
+    for (uint64_t t = now_us + 2000000; t < end; t += 2000000 + rng() % 8000000)
+        stalls.push_back({ t, t + 1000 + rng() % 400000 });
+    for (uint64_t t = now_us + 5000000; t < end; t += 5000000 + rng() % 20000000)
+        stops.push_back({ t, t + 50000 + rng() % 1450000 });
+
+    // measures the period the deadlines use
+    CHECK(ov7670_wait_ready(1000));
+    uint32_t period = ov7670_get_frame_period_us();
+    CHECK(period >= PERIOD_US - 2 && period <= PERIOD_US + 2);
+
+    uint32_t ok = 0, bad = 0, failed = 0;
+    uint64_t ok_max = 0, failed_max = 0;
+    for (int i = 0; i < GRABS; i++) {
+        uint64_t t0 = now_us;
+        bool got = ov7670_grab_frame(buffer);
+        uint64_t took = now_us - t0;
+        if (got) {
+            ok++;
+            ok_max = std::max(ok_max, took);
+            if (cap_mixed || cap_lines != FRAME_LINES)
+                bad++;
+        } else {
+            failed++;
+            failed_max = std::max(failed_max, took);
+        }
+
+        // sending, waiting for the button
+        now_us += rng() % 600000;
+        model_us = now_us;
+    }
+
+    ov7670_grab_stats_t stats;
+    ov7670_get_grab_stats(&stats);
+    printf("%u grabs: %u ok (%u torn or mixed), %u failed - %u timeouts, %u short, %u recoveries\n",
+           stats.grabs, ok, bad, failed, stats.timeouts, stats.short_frames, stats.recoveries);
+    printf("longest grab: ok %.1f ms, failed %.1f ms (deadlines %.1f ms)\n", ok_max / 1000.0,
+           failed_max / 1000.0, period * 2.75 / 1000.0);
+    printf("%zu PCLK stalls, %zu sensor stops, %d%% of frames lose lines\n", stalls.size(), stops.size(), DROP_PCT);
+
+    CHECK(stats.grabs == uint32_t(GRABS));
+    CHECK(bad == 0);
+    CHECK(ok > uint32_t(GRABS) / 2);
+    CHECK(failed == stats.timeouts + stats.short_frames);
+    CHECK(stats.timeouts > 0 && stats.short_frames > 0 && stats.recoveries > 0);
+
+    // both deadlines, and a line of slack for the last poll
+    uint64_t limit = uint64_t(period) * (OV7670_GRAB_START_PCT + OV7670_GRAB_FRAME_PCT) / 100 + PERIOD_US / LINES;
+    CHECK(ok_max <= limit);
+    CHECK(failed_max <= limit);
+
+    return check_result();
+}
@@ -0,0 +1,362 @@
+/*
+    The JPEG encoder (jpeg_enc.c) against a baseline decoder written
+    from the spec for this test: markers, Huffman tables from DHT,
+    dequantization from DQT and a floating-point IDCT, so nothing is
+    shared with the encoder's DCT or tables.
+
+    A synthetic QVGA YUYV frame - gradients, hard edges, fine stripes
+    and sensor-like noise, with smooth chroma - is encoded a row of
+    MCUs at a time as jpeg_stream.c does, decoded, and compared with
+    the source. The luma and chroma PSNR must be above a floor for
+    each quality, and go up with quality. Rows never delivered must
+    decode as flat grey, and an output buffer that is too small must
+    give 0, not a truncated JPEG.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "jpeg_enc.h"
+}
+
+namespace {
+
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 240;
+
+// A camera-like YUYV frame
+std::vector<uint8_t> test_frame()
+{
+    std::vector<uint8_t> f(WIDTH * HEIGHT * 2);
+    uint32_t noise = 1;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            noise = noise * 1103515245 + 12345;
+            int dx = x - 200, dy = y - 100;
+            int v = 40 + x * 120 / WIDTH + y * 60 / HEIGHT;
+            if (dx * dx + dy * dy < 50 * 50)
+                v += 50;                        // a disc with a hard edge
+            if (x < 80 && y > 150)
+                v = (x / 2 + y / 2) % 2 ? 200 : 60;  // 2-pixel checks
+            if (y > 20 && y < 60 && (x / 3) % 2)
+                v -= 30;                        // fine stripes
+            v += int((noise >> 16) % 7) - 3;
+            f[(y * WIDTH + x) * 2] = uint8_t(std::min(255, std::max(0, v)));
+            if (x % 2 == 0) {
+                f[(y * WIDTH + x) * 2 + 1] = uint8_t(128 + 40 * std::sin(x / 40.0 + y / 70.0));
+            } else {
+                f[(y * WIDTH + x) * 2 + 1] = uint8_t(128 + 30 * std::cos(x / 55.0 - y / 35.0));
+            }
+        }
+    }
+    return f;
+}
+
+// Baseline sequential JPEG, 8-bit, one scan of all components
+struct Decoder {
+    struct Huff {
+        std::vector<uint16_t> codes;
+        std::vector<uint8_t> sizes, vals;
+    };
+    struct Comp {
+        int id, h, v, tq, td, ta;
+        int pred;
+        std::vector<uint8_t> plane;
+        int pw, ph;
+    };
+
+    const uint8_t* p;
+    const uint8_t* end;
+    uint16_t q[4][64];
+    Huff dc[4], ac[4];
+    std::vector<Comp> comps;
+    int width = 0, height = 0, hmax = 1, vmax = 1;
+    uint32_t bits = 0;
+    int nbits = 0;
+    bool bad = false;
+
+    static const int zigzag[64];
+
+    int u16() { return p + 2 <= end ? (p += 2, p[-2] << 8 | p[-1]) : (bad = true, 0); }
+
+    int bit()
+    {
+        if (nbits == 0) {
+            if (p >= end) {
+                bad = true;
+                return 0;
+            }
+            bits = *p++;
+            if (bits == 0xFF) {
+                if (p >= end || *p != 0)
+                    bad = true;     // a marker inside the scan
+                p++;
+            }
+            nbits = 8;
+        }
+        return (bits >> --nbits) & 1;
+    }
+
+    int receive(int n)
+    {
+        int v = 0;
+        for (int i = 0; i < n; i++)
+            v = v << 1 | bit();
+        return v;
+    }
+
+    static int extend(int v, int n) { return n && v < (1 << (n - 1)) ? v - (1 << n) + 1 : v; }
+
+    int decode(const Huff& h)
+    {
+        int code = 0;
+        for (int len = 1; len <= 16; len++) {
+            code = code << 1 | bit();
+            for (size_t i = 0; i < h.codes.size(); i++) {
+                if (h.sizes[i] == len && h.codes[i] == code)
+                    return h.vals[i];
+            }
+        }
+        bad = true;
+        return 0;
+    }
+
+    void read_dht(const uint8_t* s, int len)
+    {
+        const uint8_t* e = s + len;
+        while (s < e) {
+            int tc = *s >> 4, th = *s & 3;
+            Huff& h = tc ? ac[th] : dc[th];
+            h = Huff();
+            const uint8_t* counts = s + 1;
+            s += 17;
+            int code = 0;
+            for (int l = 1; l <= 16; l++) {
+                for (int i = 0; i < counts[l - 1]; i++) {
+                    h.codes.push_back(uint16_t(code++));
+                    h.sizes.push_back(uint8_t(l));
+                    h.vals.push_back(*s++);
+                }
+                code <<= 1;
+            }
+        }
+    }
+
+    // the IDCT straight from the definition - basis[x][u] is C(u) cos((2x + 1) u pi / 16)
+    double basis[8][8];
+
+    Decoder()
+    {
+        for (int x = 0; x < 8; x++) {
+            for (int u = 0; u < 8; u++)
+                basis[x][u] = (u ? 1 : std::sqrt(0.5)) * std::cos((2 * x + 1) * u * M_PI / 16);
+        }
+    }
+
+    void idct_block(const int* coef, Comp& c, int bx, int by)
+    {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                double s = 0;
+                for (int v = 0; v < 8; v++) {
+                    for (int u = 0; u < 8; u++)
+                        s += coef[v * 8 + u] * basis[x][u] * basis[y][v];
+                }
+                int px = int(std::lround(s / 4 + 128));
+                int ox = bx * 8 + x, oy = by * 8 + y;
+                if (ox < c.pw && oy < c.ph)
+                    c.plane[oy * c.pw + ox] = uint8_t(std::min(255, std::max(0, px)));
+            }
+        }
+    }
+
+    void decode_block(Comp& c, int bx, int by)
+    {
+        int coef[64] = {};
+        int s = decode(dc[c.td]);
+        c.pred += extend(receive(s), s);
+        coef[0] = c.pred * q[c.tq][0];
+        for (int k = 1; k < 64;) {
+            int rs = decode(ac[c.ta]);
+            int r = rs >> 4;
+            s = rs & 15;
+            if (s == 0) {
+                if (r != 15)
+                    break;      // EOB
+                k += 16;
+                continue;
+            }
+            k += r;
+            if (k > 63) {
+                bad = true;
+                return;
+            }
+            coef[zigzag[k]] = extend(receive(s), s) * q[c.tq][k];
+            k++;
+        }
+        idct_block(coef, c, bx, by);
+    }
+
+    bool run(const uint8_t* data, size_t len)
+    {
+        p = data;
+        end = data + len;
+        if (u16() != 0xFFD8)
+            return false;
+        while (!bad) {
+            int marker = u16();
+            int seg = u16() - 2;
+            if (bad || seg < 0 || p + seg > end)
+                return false;
+            const uint8_t* s = p;
+            p += seg;
+            if (marker == 0xFFDB) {
+                for (const uint8_t* e = s + seg; s < e; s += 65) {
+                    if (*s >> 4)
+                        return false;   // 16-bit tables aren't baseline
+                    for (int i = 0; i < 64; i++)
+                        q[*s & 3][i] = s[1 + i];
+                }
+            } else if (marker == 0xFFC4) {
+                read_dht(s, seg);
+            } else if (marker == 0xFFC0) {
+                if (s[0] != 8)
+                    return false;
+                height = s[1] << 8 | s[2];
+                width = s[3] << 8 | s[4];
+                for (int i = 0; i < s[5]; i++) {
+                    const uint8_t* c = s + 6 + 3 * i;
+                    comps.push_back({ c[0], c[1] >> 4, c[1] & 15, c[2], 0, 0, 0, {}, 0, 0 });
+                    hmax = std::max(hmax, c[1] >> 4);
+                    vmax = std::max(vmax, c[1] & 15);
+                }
+            } else if (marker == 0xFFDA) {
+                if (s[0] != int(comps.size()))
+                    return false;
+                for (int i = 0; i < s[0]; i++) {
+                    comps[i].td = s[2 + 2 * i] >> 4;
+                    comps[i].ta = s[2 + 2 * i] & 15;
+                }
+                return scan() && u16() == 0xFFD9 && p == end && !bad;
+            } else if ((marker & 0xFFF0) != 0xFFE0) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool scan()
+    {
+        int mcu_w = 8 * hmax, mcu_h = 8 * vmax;
+        int mx_n = (width + mcu_w - 1) / mcu_w, my_n = (height + mcu_h - 1) / mcu_h;
+        for (auto& c : comps) {
+            c.pw = (width * c.h + hmax - 1) / hmax;
+            c.ph = (height * c.v + vmax - 1) / vmax;
+            c.plane.assign(c.pw * c.ph, 0);
+        }
+        for (int my = 0; my < my_n && !bad; my++) {
+            for (int mx = 0; mx < mx_n && !bad; mx++) {
+                for (auto& c : comps) {
+                    for (int v = 0; v < c.v; v++) {
+                        for (int h = 0; h < c.h; h++)
+                            decode_block(c, mx * c.h + h, my * c.v + v);
+                    }
+                }
+            }
+        }
+        // the rest of the last byte must be 1s
+        while (nbits)
+            if (!bit())
+                bad = true;
+        return !bad;
+    }
+};
+
+const int Decoder::zigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+double psnr(const std::vector<uint8_t>& yuyv, const std::vector<uint8_t>& plane, int offset, int step)
+{
+    double se = 0;
+    size_t n = plane.size();
+    for (size_t i = 0; i < n; i++) {
+        double d = double(yuyv[offset + i * step]) - plane[i];
+        se += d * d;
+    }
+    return se ? 10 * std::log10(255.0 * 255.0 * n / se) : 99;
+}
+
+uint32_t encode(const std::vector<uint8_t>& frame, int quality, std::vector<uint8_t>& out, int rows_sent)
+{
+    jpeg_enc_t enc;
+    CHECK(jpeg_enc_init(&enc, WIDTH, HEIGHT, quality));
+    jpeg_enc_begin(&enc, out.data(), uint32_t(out.size()));
+    for (int r = 0; r < rows_sent; r++)
+        jpeg_enc_mcu_row(&enc, frame.data() + r * JPEG_MCU_HEIGHT * WIDTH * 2, WIDTH * 2);
+    return jpeg_enc_end(&enc);
+}
+
+}
+
+int main()
+{
+    std::vector<uint8_t> frame = test_frame();
+    std::vector<uint8_t> out(256 * 1024);
+    constexpr int ROWS = HEIGHT / JPEG_MCU_HEIGHT;
+
+    // quality, luma and chroma floors (dB)
+    struct Case {
+        int quality;
+        double y_min, c_min;
+    };
+    const Case cases[] = { { 25, 30, 37 }, { 50, 32, 42 }, { 75, 36, 46 }, { 90, 40, 49 }, { 100, 55, 58 } };
+
+    double last_y = 0;
+    uint32_t last_len = 0;
+    for (const Case& c : cases) {
+        uint32_t len = encode(frame, c.quality, out, ROWS);
+        Decoder d;
+        bool ok = len && d.run(out.data(), len);
+        CHECK(ok);
+        if (!ok)
+            continue;
+        CHECK(d.width == WIDTH && d.height == HEIGHT && d.comps.size() == 3);
+        CHECK(d.comps[0].h == 2 && d.comps[0].v == 1 && d.comps[1].h == 1 && d.comps[2].h == 1);
+        double y = psnr(frame, d.comps[0].plane, 0, 2);
+        double cb = psnr(frame, d.comps[1].plane, 1, 4);
+        double cr = psnr(frame, d.comps[2].plane, 3, 4);
+        printf("quality %3d: %6u bytes, %.1f bits/pixel, PSNR Y %.1f dB, Cb %.1f dB, Cr %.1f dB\n", c.quality, len,
+               len * 8.0 / (WIDTH * HEIGHT), y, cb, cr);
+        CHECK(y >= c.y_min);
+        CHECK(cb >= c.c_min && cr >= c.c_min);
+        CHECK(y > last_y && len > last_len);
+        last_y = y;
+        last_len = len;
+    }
+
+    // the first half of the rows, then grey
+    uint32_t len = encode(frame, 75, out, ROWS / 2);
+    Decoder d;
+    CHECK(len && d.run(out.data(), len));
+    bool grey = true;
+    for (const auto& c : d.comps) {
+        for (size_t i = c.plane.size() / 2; i < c.plane.size(); i++)
+            grey = grey && c.plane[i] == 128;
+    }
+    printf("half a frame: %u bytes, %s below\n", len, grey ? "grey" : "NOT grey");
+    CHECK(grey);
+
+    // too small
+    std::vector<uint8_t> small(4096);
+    CHECK(encode(frame, 75, small, ROWS) == 0);
+
+    return check_result();
+}
@@ -0,0 +1,184 @@
+/*
+    VGA line streaming (line_stream.c) end to end: a simulated sensor,
+    the streaming capture in OV7670.c, line_stream.c and a 3 Mbaud
+    UART, on virtual time (sim_sensor.hpp). The wire goes into
+    ovrecv::FrameDecoder.
+
+    The sensor keeps the OV7670's timing: 784 x 510 pixel times a
+    frame, 480 of the lines active, at the PCLK its CLKRC gives. Every
+    frame must come out at the full VGA length. Each line must be what
+    the sensor sent, or zeros for a line with no free buffer, and the
+    zero lines must add up to the drop counter.
+
+    Runs:
+    - VGA YUV422 at LINE_STREAM_VGA_CLKRC - no line may be dropped.
+    - VGA Bayer at LINE_STREAM_VGA_BAYER_CLKRC - the same.
+    - VGA YUV422 at twice that clock - lines are dropped, the frames
+      keep their length. A frame whose last lines were dropped is
+      only closed by the next frame's first line, so the last one
+      stays open when the sensor stops.
+
+    It prints the line buffer memory against a frame buffer, the ring
+    high-water mark and the sustained lines/s.
+*/
+
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "OV7670.h"
+#include "line_stream.h"
+#include "ov7670_stream.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 640, HEIGHT = 480;
+constexpr uint32_t XCLK_MHZ = 15;
+
+// byte i of line l of frame f - different every frame, never 0
+uint8_t scene_byte(uint32_t f, uint l, uint i)
+{
+    return uint8_t(16 + (i * 7 + l * 3 + f * 11) % 220);
+}
+
+struct Run {
+    const char* name;
+    uint8_t clkrc;
+    uint bpp;
+    uint32_t frames;
+};
+
+struct Result {
+    uint32_t sent, intact, zero_lines, bad_lines, bad_size;
+    line_stream_stats_t stats;
+    uint32_t line_us;
+    uint32_t frame_bytes;
+};
+
+Result run(const Run& r)
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    // as LINE_MODE sets the sensor up
+    if (r.bpp == 1)
+        CHECK(ov7670_set_bayer(WIDTH, HEIGHT, r.clkrc));
+    else
+        CHECK(ov7670_set_size(WIDTH, HEIGHT, r.clkrc));
+    ov7670_capture_desc_t desc;
+    ov7670_capture_desc_default(&desc);
+    desc.bytes_per_pixel = r.bpp;
+    CHECK(desc.width == WIDTH && desc.height == HEIGHT);
+    line_stream_init(uart, &desc);
+
+    // 784 x 510 pixel times a frame, bpp PCLKs a pixel, PCLK XCLK / (prescale + 1)
+    uint32_t div = (r.clkrc & 0x3F) + 1;
+    uint32_t line_us = 784 * r.bpp * div / XCLK_MHZ;
+    sim::Sensor sensor;
+    sensor.lines = HEIGHT;
+    sensor.line_bytes = WIDTH * r.bpp;
+    sensor.vblank_us = 20 * line_us;
+    sensor.front_porch_us = 10 * line_us;
+    sensor.period_us = 510 * line_us;
+    sensor.byte = scene_byte;
+    uint32_t count = r.frames;
+    sensor.skip = [count](uint32_t f) { return f >= count; };
+    sim::sensor_start(sensor, desc, sim::now_us + 20000);
+    CHECK(ov7670_stream_start(&desc, 1, &line_stream_cb));
+
+    // the main loop of LINE_MODE
+    uint64_t end = sim::frame_start_us(r.frames) + 1000000;
+    while (sim::now_us < end) {
+        line_stream_poll();
+        sim::step();
+    }
+
+    Result res = {};
+    line_stream_get_stats(&res.stats);
+    res.line_us = line_us;
+    res.frame_bytes = WIDTH * HEIGHT * r.bpp;
+    ov7670_stream_stop();
+
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> frames;
+    dec.feed(sim::uart_wire().data(), sim::uart_wire().size(), frames);
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+
+    uint line_bytes = WIDTH * r.bpp;
+    for (const auto& fr : frames) {
+        res.sent++;
+        if (fr.payload.size() != res.frame_bytes || fr.width != WIDTH || fr.height != HEIGHT) {
+            res.bad_size++;
+            continue;
+        }
+        // line_stream.c numbers frames from 1
+        uint32_t f = fr.seq - 1;
+        std::vector<uint8_t> want = sim::expected_frame(f, desc);
+        bool intact = true;
+        for (uint l = 0; l < HEIGHT; l++) {
+            const uint8_t* got = &fr.payload[l * line_bytes];
+            bool zero = true;
+            for (uint i = 0; i < line_bytes && zero; i++)
+                zero = got[i] == 0;
+            if (zero) {
+                res.zero_lines++;
+                intact = false;
+            } else if (!std::equal(got, got + line_bytes, &want[l * line_bytes])) {
+                res.bad_lines++;
+                intact = false;
+            }
+        }
+        res.intact += intact;
+    }
+    return res;
+}
+
+}
+
+int main()
+{
+    const Run runs[] = {
+        { "VGA YUV422", LINE_STREAM_VGA_CLKRC, 2, 3 },
+        { "VGA Bayer", LINE_STREAM_VGA_BAYER_CLKRC, 1, 3 },
+        { "VGA YUV422 2x", (LINE_STREAM_VGA_CLKRC + 1) / 2 - 1, 2, 3 },
+    };
+    Result res[3];
+    for (int i = 0; i < 3; i++) {
+        const Run& r = runs[i];
+        Result& x = res[i];
+        x = run(r);
+        double sensor_kbs = WIDTH * r.bpp * 1000.0 / x.line_us;
+        printf("%-14s %u frames sent, %u intact; %u lines/s (%.0f KB/s from the sensor, %u KB/s link), "
+               "%u lines dropped\n",
+               r.name, x.sent, x.intact, x.stats.lines_per_sec, sensor_kbs, BAUD / 10 / 1000,
+               x.stats.lines_dropped);
+        printf("%-14s line buffers %u bytes for a %u byte frame (%.1f%%), high water %u of %u lines\n", "",
+               x.stats.ring_bytes, x.frame_bytes, 100.0 * x.stats.ring_bytes / x.frame_bytes,
+               x.stats.ring_high_water, LINE_RING_LINES);
+
+        CHECK(x.sent == x.stats.frames_sent && x.sent + 1 >= r.frames);
+        CHECK(x.bad_size == 0 && x.bad_lines == 0);
+        CHECK(x.zero_lines <= x.stats.lines_dropped);
+        CHECK(x.stats.ring_bytes == LINE_RING_LINES * LINE_MAX_BYTES);
+        CHECK(x.stats.ring_high_water <= LINE_RING_LINES);
+    }
+
+    // the link keeps up at the VGA clocks - every line, at the sensor's line rate
+    for (int i = 0; i < 2; i++) {
+        CHECK(res[i].sent == runs[i].frames && res[i].intact == res[i].sent);
+        CHECK(res[i].stats.lines_dropped == 0);
+        uint32_t rate = 1000000 / res[i].line_us;
+        CHECK(res[i].stats.lines_per_sec + 2 >= rate && res[i].stats.lines_per_sec <= rate + 2);
+    }
+    // twice as fast - lines dropped and sent as zeros, the ring full but for
+    // the two buffers armed ahead and the one being sent
+    CHECK(res[2].stats.lines_dropped > 0 && res[2].stats.ring_high_water == LINE_RING_LINES - 1);
+    CHECK(res[2].sent > 0 && res[2].zero_lines > 0);
+
+    return check_result();
+}
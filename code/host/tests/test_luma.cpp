@@ -0,0 +1,190 @@
+/*
+    Luma-only capture (luma_only in ov7670_capture_desc_t) against a
+    simulated YUYV stream: STREAM_MODE's capture and send loop, the
+    streaming capture in OV7670.c and a 3 Mbaud UART, on virtual time
+    (sim_sensor.hpp). The wire goes into ovrecv::FrameDecoder.
+
+    The same QVGA YUYV stream is captured twice, as YUV422 and luma
+    only, with the sensor at the 9.4 fps of CLKRC 0x01. Every luma
+    frame must be exactly the Y bytes of what the sensor sent, and
+    every YUV422 frame all of it. It prints the frames per second
+    each gets through the link, and the time from the end of capture
+    to the last byte sent.
+
+    The PIO side - that the program drops every chroma byte - is
+    test_pio_gen's. This is the frame size through the ring, the
+    frame format and the link time.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "OV7670.h"
+#include "bitrev.h"
+#include "frame_proto.h"
+#include "frame_ring.h"
+#include "ov7670_stream.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 320, HEIGHT = 240;
+
+// 784 x 510 pixel times a frame at 2 PCLKs a pixel, XCLK 15 MHz / 2
+constexpr uint32_t PERIOD_US = 784 * 510 * 2 * 2 / 15;
+
+uint8_t frame_storage[FRAME_RING_SLOTS * WIDTH * HEIGHT * 2];
+
+// byte i of line l of frame f - the frame number in the first 4 Y
+// bytes, chroma nothing like luma
+uint8_t yuyv_byte(uint32_t f, uint l, uint i)
+{
+    if (l == 0 && i < 8 && i % 2 == 0)
+        return uint8_t(f >> (4 * i));
+    if (i & 1)
+        return uint8_t(0xC0 ^ (i * 5 + l));
+    return uint8_t(i / 2 + l + f * 3);
+}
+
+// STREAM_MODE's stream callbacks - a frame is one band
+uint8_t* stream_frame_dest(uint line, void* ctx)
+{
+    frame_desc_t* slot = frame_ring_acquire();
+    if (!slot) {
+        frame_ring_overrun();
+        return NULL;
+    }
+    return slot->data;
+}
+
+void stream_frame_done(uint8_t* frame, uint line, uint nlines, void* ctx)
+{
+    frame_ring_publish(frame_ring_lookup(frame));
+}
+
+const ov7670_stream_cb_t stream_cb = { stream_frame_dest, stream_frame_done, NULL };
+
+// and its send_image()
+void send_image(transport_t* t, frame_desc_t* frame)
+{
+    static uint8_t header[FRAME_PROTO_HEADER_LEN];
+    bitrev_bytes(frame->data, frame->size);
+    frame_proto_encode_header(header, frame, ov7670_get_width(), ov7670_get_height(), 0);
+    transport_send(t, header, sizeof(header));
+    transport_send(t, frame->data, frame->size);
+}
+
+struct Result {
+    uint32_t sent, intact, out_of_order, bad_format;
+    double fps;
+    uint32_t frame_bytes;
+    uint64_t latency_us, latency_max_us;   // capture end -> last byte sent
+    frame_ring_stats_t ring;
+};
+
+Result run(bool luma_only, uint32_t frames)
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    ov7670_capture_desc_t desc;
+    ov7670_capture_desc_default(&desc);
+    desc.luma_only = luma_only;
+    uint32_t frame_bytes = WIDTH * HEIGHT * (luma_only ? 1 : 2);
+    frame_ring_init(frame_storage, luma_only ? FRAME_FMT_Y8 : FRAME_FMT_YUV422, frame_bytes);
+
+    sim::Sensor sensor;
+    sensor.period_us = PERIOD_US;
+    sensor.byte = yuyv_byte;
+    sensor.skip = [frames](uint32_t f) { return f >= frames; };
+    uint64_t start = sim::now_us + 20000;
+    sim::sensor_start(sensor, desc, start);
+    CHECK(ov7670_stream_start(&desc, HEIGHT, &stream_cb));
+
+    // STREAM_MODE's main loop, and when each frame's last byte went out
+    std::vector<uint64_t> sent_us;
+    uint64_t end = sim::frame_start_us(frames) + 2000000;
+    while (sim::now_us < end) {
+        frame_desc_t* slot;
+        while ((slot = frame_ring_get_ready())) {
+            send_image(uart, slot);
+            frame_ring_release(slot);
+            sent_us.push_back(sim::now_us);
+        }
+        sim::step();
+    }
+
+    Result res = {};
+    frame_ring_get_stats(&res.ring);
+    ov7670_stream_stop();
+    res.frame_bytes = frame_bytes;
+
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> decoded;
+    dec.feed(sim::uart_wire().data(), sim::uart_wire().size(), decoded);
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+    CHECK(decoded.size() == sent_us.size());
+
+    int64_t last = -1;
+    uint64_t latency_sum = 0;
+    for (size_t k = 0; k < decoded.size(); k++) {
+        const auto& fr = decoded[k];
+        uint32_t f = 0;
+        uint step = luma_only ? 1 : 2;
+        for (uint i = 0; i < 4 && 2 * i < fr.payload.size(); i++)
+            f |= uint32_t(fr.payload[i * step]) << (8 * i);
+        res.sent++;
+        if (fr.format != (luma_only ? ovrecv::Format::Y8 : ovrecv::Format::YUV422) ||
+            fr.width != WIDTH || fr.height != HEIGHT)
+            res.bad_format++;
+        if (fr.payload == sim::expected_frame(f, desc))
+            res.intact++;
+        if (int64_t(f) <= last)
+            res.out_of_order++;
+        last = f;
+
+        uint64_t latency = sent_us[k] - sim::frame_end_us(f, desc);
+        latency_sum += latency;
+        res.latency_max_us = std::max(res.latency_max_us, latency);
+    }
+    if (res.sent) {
+        res.latency_us = latency_sum / res.sent;
+        res.fps = res.sent * 1e6 / double(sent_us.back() - sim::frame_end_us(0, desc));
+    }
+    return res;
+}
+
+}
+
+int main()
+{
+    constexpr uint32_t FRAMES = 60;
+    Result yuyv = run(false, FRAMES);
+    Result luma = run(true, FRAMES);
+
+    printf("sensor %.1f fps, link %u KB/s\n", 1e6 / PERIOD_US, BAUD / 10 / 1000);
+    for (const Result* r : { &yuyv, &luma }) {
+        printf("%-7s %6u bytes/frame: %2u of %u frames sent, %2u intact, %.2f fps, "
+               "capture to last byte %llu us (max %llu us)\n",
+               r == &yuyv ? "YUV422" : "luma", r->frame_bytes, r->sent, FRAMES, r->intact, r->fps,
+               (unsigned long long)r->latency_us, (unsigned long long)r->latency_max_us);
+        CHECK(r->sent > 0 && r->intact == r->sent);
+        CHECK(r->bad_format == 0 && r->out_of_order == 0);
+        // and one more overrun for the frame armed after the sensor stopped
+        CHECK(r->sent + r->ring.overruns >= FRAMES && r->sent + r->ring.overruns <= FRAMES + 1);
+    }
+    printf("luma only: %.2fx the frames per second\n", luma.fps / yuyv.fps);
+
+    // half the bytes - about twice the frames through the same link
+    CHECK(luma.frame_bytes * 2 == yuyv.frame_bytes);
+    CHECK(luma.fps > 1.8 * yuyv.fps);
+    CHECK(luma.latency_max_us < yuyv.latency_max_us);
+
+    return check_result();
+}
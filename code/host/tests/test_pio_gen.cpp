@@ -0,0 +1,297 @@
+/*
+    The generated capture program (ov7670_pio_gen.c) run on a PIO
+    instruction simulator against a simulated sensor.
+
+    The simulator runs one SM: jmp, wait gpio, in, push/pull, mov and
+    set, autopush at 32 bits shifting right as ov7670_stream_start()
+    configures it, and wrap. The sensor drives VSYNC, HREF, PCLK and
+    D0-D7 a PCLK half period at a time, with PCLK running through
+    blanking as the OV7670's does, and the SM gets 4 cycles per half
+    period - at 150 MHz a 19 MHz PCLK, faster than the sensor runs.
+    Every byte is a hash of its frame, line and position.
+
+    Each case captures 3 frames, with the line count and line length
+    in the TX FIFO per frame as the stream code puts them, and the RX
+    words must be exactly the window's bytes of each frame. Cases:
+    full frames, crops, a window on the right and bottom edges, skips
+    of 1, 32 and 33 (the single and nested loops), the longest skip,
+    QVGA centred in VGA (160 pixels, 120 lines), luma only and 1 byte
+    per pixel. Descs the generator must refuse are checked too.
+*/
+
+#include <deque>
+#include <vector>
+
+#include "check.hpp"
+
+extern "C" {
+#include "ov7670_pio_gen.h"
+}
+
+namespace {
+
+constexpr uint VSYNC = 2, HREF = 3, PCLK = 4, DATA = 6;
+constexpr int CYCLES_PER_TICK = 4;
+constexpr int FRAMES = 3;
+
+// A sensor line_bytes wide and lines high, in ticks of half a PCLK.
+// Ticks with PCLK low present the next byte, the rising edge is on
+// the odd tick.
+struct Sensor {
+    uint line_bytes, lines;
+    uint64_t vsync_ticks = 200, back_porch = 120, h_blank = 80, front_porch = 120;
+
+    uint64_t line_ticks() const { return 2 * line_bytes + h_blank; }
+    uint64_t frame_ticks() const { return vsync_ticks + back_porch + lines * line_ticks() + front_porch; }
+
+    static uint8_t byte(uint64_t frame, uint line, uint i)
+    {
+        uint32_t x = uint32_t(frame * 0x9e3779b1u) ^ (line * 0x85ebca6bu) ^ (i * 0xc2b2ae35u);
+        x ^= x >> 15;
+        x *= 0x2c1b3c6d;
+        x ^= x >> 12;
+        return uint8_t(x);
+    }
+
+    // gpio levels at tick t
+    uint32_t pins(uint64_t t) const
+    {
+        uint64_t frame = t / frame_ticks(), p = t % frame_ticks();
+        uint32_t v = (t & 1) ? 1u << PCLK : 0;
+        if (p < vsync_ticks)
+            return v | 1u << VSYNC;
+        if (p < vsync_ticks + back_porch)
+            return v;
+        p -= vsync_ticks + back_porch;
+        uint line = uint(p / line_ticks()), o = uint(p % line_ticks());
+        if (line >= lines || o >= 2 * line_bytes)
+            return v;
+        return v | 1u << HREF | uint32_t(byte(frame, line, o / 2)) << DATA;
+    }
+};
+
+// One PIO state machine - just what the capture programs use
+struct Sm {
+    const uint16_t* prog;
+    uint wrap_target, wrap, in_base;
+    uint pc = 0;
+    uint32_t x = 0, y = 0, osr = 0, isr = 0;
+    uint isr_count = 0;
+    std::deque<uint32_t> tx;
+    std::vector<uint32_t> rx;
+    bool bad = false;       // an instruction the capture programs never use
+
+    uint32_t read(uint src, uint32_t pins) const
+    {
+        switch (src) {
+        case 0: return pins >> in_base;
+        case 1: return x;
+        case 2: return y;
+        case 3: return 0;
+        case 6: return isr;
+        case 7: return osr;
+        }
+        return 0;
+    }
+
+    // one cycle
+    void step(uint32_t pins)
+    {
+        uint instr = prog[pc];
+        uint op = instr >> 13, a = (instr >> 5) & 7, b = instr & 0x1f;
+        uint next = pc == wrap ? wrap_target : pc + 1;
+        if (instr & 0x1f00) {
+            // delay or side-set bits
+            bad = true;
+        }
+
+        switch (op) {
+        case 0: {   // jmp
+            bool take = false;
+            switch (a) {
+            case 0: take = true; break;
+            case 1: take = x == 0; break;
+            case 2: take = x-- != 0; break;
+            case 3: take = y == 0; break;
+            case 4: take = y-- != 0; break;
+            case 5: take = x != y; break;
+            default: bad = true;
+            }
+            pc = take ? b : next;
+            return;
+        }
+        case 1:     // wait
+            if (a & 3)
+                bad = true;
+            if (((pins >> b) & 1) != (a >> 2))
+                return;
+            break;
+        case 2: {   // in, autopush at 32
+            uint bits = b ? b : 32;
+            uint32_t data = read(a, pins) & (bits == 32 ? ~0u : (1u << bits) - 1);
+            isr = bits == 32 ? data : (isr >> bits) | (data << (32 - bits));
+            isr_count += bits;
+            if (isr_count >= 32) {
+                rx.push_back(isr);
+                isr = 0;
+                isr_count = 0;
+            }
+            break;
+        }
+        case 4:     // push / pull
+            if (!(instr & 0x80) || (instr & 0x40)) {
+                bad = true;
+                break;
+            }
+            if (tx.empty()) {
+                if (a & 1)
+                    return;
+                osr = x;
+            } else {
+                osr = tx.front();
+                tx.pop_front();
+            }
+            break;
+        case 5: {   // mov, no operation on the data
+            if (instr & 0x18)
+                bad = true;
+            uint32_t v = read(b & 7, pins);
+            switch (a) {
+            case 1: x = v; break;
+            case 2: y = v; break;
+            case 6: isr = v; isr_count = 0; break;
+            case 7: osr = v; break;
+            default: bad = true;
+            }
+            break;
+        }
+        case 7:     // set
+            if (a == 1)
+                x = b;
+            else if (a == 2)
+                y = b;
+            else
+                bad = true;
+            break;
+        default:
+            bad = true;
+        }
+        pc = next;
+    }
+};
+
+// What the SM should put in the RX FIFO for frame f
+void expect_frame(const ov7670_capture_desc_t& d, uint64_t f, std::vector<uint8_t>& out)
+{
+    uint bpp = d.bytes_per_pixel;
+    for (uint l = 0; l < d.height; l++) {
+        for (uint p = 0; p < d.width; p++) {
+            uint at = (d.skip_pixels + p) * bpp;
+            if (d.luma_only) {
+                out.push_back(Sensor::byte(f, d.skip_lines + l, at));
+            } else {
+                for (uint i = 0; i < bpp; i++)
+                    out.push_back(Sensor::byte(f, d.skip_lines + l, at + i));
+            }
+        }
+    }
+}
+
+ov7670_capture_desc_t make_desc(uint bpp, bool luma, uint skip_lines, uint skip_pixels, uint width, uint height)
+{
+    ov7670_capture_desc_t d;
+    d.vsync_pin = VSYNC;
+    d.href_pin = HREF;
+    d.pclk_pin = PCLK;
+    d.data_base = DATA;
+    d.skip_lines = skip_lines;
+    d.skip_pixels = skip_pixels;
+    d.bytes_per_pixel = bpp;
+    d.luma_only = luma;
+    d.width = width;
+    d.height = height;
+    return d;
+}
+
+// Capture FRAMES frames of the window d from a sensor_w x sensor_h sensor
+bool run(const char* name, uint sensor_w, uint sensor_h, const ov7670_capture_desc_t& d)
+{
+    ov7670_pio_gen_t gen;
+    if (!ov7670_pio_gen(&d, &gen)) {
+        printf("%-24s refused\n", name);
+        return false;
+    }
+
+    Sensor sensor{ sensor_w * d.bytes_per_pixel, sensor_h };
+    Sm sm{ gen.instr, gen.wrap_target, gen.wrap, d.data_base };
+    for (int f = 0; f < FRAMES; f++) {
+        sm.tx.push_back(d.height - 1);
+        sm.tx.push_back(ov7670_capture_line_bytes(&d) - 1);
+    }
+
+    // start mid-frame, as a stream start does, and capture the next FRAMES
+    uint64_t t0 = sensor.frame_ticks() / 2, t1 = (FRAMES + 1) * sensor.frame_ticks();
+    for (uint64_t t = t0; t < t1 && !sm.bad; t++) {
+        uint32_t pins = sensor.pins(t);
+        for (int c = 0; c < CYCLES_PER_TICK; c++)
+            sm.step(pins);
+    }
+
+    std::vector<uint8_t> want;
+    for (int f = 1; f <= FRAMES; f++)
+        expect_frame(d, f, want);
+    std::vector<uint8_t> got;
+    for (uint32_t w : sm.rx) {
+        for (int i = 0; i < 4; i++)
+            got.push_back(uint8_t(w >> (8 * i)));
+    }
+    // a partial word at the end of a frame goes with the next frame
+    want.resize(want.size() / 4 * 4);
+
+    bool ok = !sm.bad && got == want;
+    printf("%-24s %2u instructions, %7zu bytes %s\n", name, gen.length, got.size(), ok ? "ok" : "WRONG");
+    CHECK(gen.length <= OV7670_PIO_GEN_MAX_INSTR);
+    CHECK(!sm.bad);
+    CHECK(got == want);
+    return ok;
+}
+
+}
+
+int main()
+{
+    // full frames
+    CHECK(run("qvga rgb565", 320, 240, make_desc(2, false, 0, 0, 320, 240)));
+    CHECK(run("qvga luma", 320, 240, make_desc(2, true, 0, 0, 320, 240)));
+    CHECK(run("qcif bayer", 176, 144, make_desc(1, false, 0, 0, 176, 144)));
+
+    // crops and edges
+    CHECK(run("crop", 320, 240, make_desc(2, false, 10, 20, 100, 50)));
+    CHECK(run("crop luma", 320, 240, make_desc(2, true, 7, 13, 101, 33)));
+    CHECK(run("right bottom edge", 320, 240, make_desc(2, false, 40, 120, 200, 200)));
+    CHECK(run("one pixel", 16, 48, make_desc(2, false, 47, 15, 1, 1)));
+    CHECK(run("skip 1", 64, 48, make_desc(1, false, 1, 1, 62, 46)));
+    CHECK(run("skip 32", 96, 80, make_desc(1, false, 32, 32, 64, 48)));
+    CHECK(run("skip 33", 96, 80, make_desc(1, false, 33, 33, 60, 44)));
+    CHECK(run("skip 33 rgb565", 96, 80, make_desc(2, false, 33, 17, 60, 44)));
+    CHECK(run("longest skip", 1100, 1040, make_desc(1, false, OV7670_PIO_GEN_MAX_SKIP,
+                                                    OV7670_PIO_GEN_MAX_SKIP, 8, 4)));
+
+    // QVGA centred in VGA
+    CHECK(run("vga centre rgb565", 640, 480, make_desc(2, false, 120, 160, 320, 240)));
+    CHECK(run("vga centre luma", 640, 480, make_desc(2, true, 120, 160, 320, 240)));
+    CHECK(run("vga centre bayer", 640, 480, make_desc(1, false, 120, 160, 320, 240)));
+
+    // too long, and a long left skip on lines that aren't whole words
+    ov7670_pio_gen_t gen;
+    ov7670_capture_desc_t d = make_desc(1, false, OV7670_PIO_GEN_MAX_SKIP + 1, 0, 8, 4);
+    CHECK(!ov7670_pio_gen(&d, &gen));
+    d = make_desc(2, false, 0, OV7670_PIO_GEN_MAX_SKIP / 2 + 1, 8, 4);
+    CHECK(!ov7670_pio_gen(&d, &gen));
+    d = make_desc(1, false, 0, 40, 10, 4);
+    CHECK(!ov7670_pio_gen(&d, &gen));
+    d = make_desc(1, false, 0, 32, 10, 4);
+    CHECK(ov7670_pio_gen(&d, &gen));
+
+    return check_result();
+}
@@ -0,0 +1,188 @@
+/*
+    The row pipeline (pipeline.c) end to end: a simulated sensor,
+    the streaming capture in OV7670.c, pipeline.c and a 3 Mbaud UART,
+    on virtual time (sim_sensor.hpp). The wire goes into
+    ovrecv::FrameDecoder.
+
+    The sensor sends QVGA YUYV with noise, gradients and an edge that
+    moves every frame, and the first 4 bytes of a frame are its
+    number. Every frame decoded must be exactly what the sensor sent
+    for that frame, in order, with the frame number as its sequence
+    number - so every gap is a frame the ring dropped.
+
+    Runs:
+    - 1.6 fps, raw - the link keeps up. Nothing may be dropped, and
+      the last byte must go out within two band times of the last
+      line, where sending the frame after capture takes 512 ms.
+    - The same with qoi16 bands - fewer bytes, decoded bit-exact.
+    - 15 fps, raw - the sensor outruns the link. Frames are dropped
+      whole, at the ring, never torn, and pipeline_poll() still
+      returns to the main loop.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "frame_proto.h"
+#include "frame_ring.h"
+#include "ov7670_stream.h"
+#include "pipeline.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 320, HEIGHT = 240;
+constexpr uint32_t FRAME_BYTES = WIDTH * HEIGHT * 2;
+
+uint8_t frame_storage[FRAME_RING_SLOTS * FRAME_BYTES];
+
+uint32_t hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// byte i of line l of frame f - the frame number first, then a
+// gradient with an edge that moves each frame and a little noise
+uint8_t scene_byte(uint32_t f, uint l, uint i)
+{
+    if (l == 0 && i < 4)
+        return uint8_t(f >> (8 * i));
+    uint x = i / 2;
+    int v = int(x / 3 + l / 2) + (x > (f * 13) % WIDTH ? 60 : 0);
+    if (i & 1)
+        return uint8_t(128 + (l / 40) * 8);     // chroma - flat in bands
+    return uint8_t(v + (hash(f * 1000003 + l * WIDTH + x) & 3));
+}
+
+struct Run {
+    const char* name;
+    uint32_t period_us;
+    bool compress;
+    uint32_t frames;            // frames the sensor sends
+};
+
+struct Result {
+    uint32_t sent, intact, out_of_order, bad_seq;
+    uint64_t poll_max_us;       // longest pipeline_poll() call
+    pipeline_stats_t stats;
+    frame_ring_stats_t ring;
+    sim::SensorStats sensor;
+};
+
+Result run(const Run& r)
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    ov7670_capture_desc_t desc;
+    ov7670_capture_desc_default(&desc);
+    frame_ring_init(frame_storage, FRAME_FMT_YUV422, FRAME_BYTES);
+    pipeline_init(uart, &desc, r.compress);
+
+    sim::Sensor sensor;
+    sensor.period_us = r.period_us;
+    sensor.byte = scene_byte;
+    uint32_t count = r.frames;
+    sensor.skip = [count](uint32_t f) { return f >= count; };
+    uint64_t start = sim::now_us + 20000;
+    sim::sensor_start(sensor, desc, start);
+    CHECK(ov7670_stream_start(&desc, PIPELINE_BAND_LINES, &pipeline_stream_cb));
+
+    // the main loop of PIPELINE_MODE, until the ring has drained
+    Result res = {};
+    uint64_t end = sim::frame_start_us(r.frames) + 2000000;
+    while (sim::now_us < end) {
+        uint64_t t = sim::now_us;
+        pipeline_poll();
+        res.poll_max_us = std::max(res.poll_max_us, sim::now_us - t);
+        sim::step();
+    }
+
+    pipeline_get_stats(&res.stats);
+    frame_ring_get_stats(&res.ring);
+    res.sensor = sim::sensor_stats();
+    ov7670_stream_stop();
+
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> frames;
+    dec.feed(sim::uart_wire().data(), sim::uart_wire().size(), frames);
+    int64_t last = -1;
+    uint32_t seq0 = frames.empty() ? 0 : frames[0].seq;
+    for (const auto& fr : frames) {
+        uint32_t f = fr.payload.size() >= 4 ? fr.payload[0] | fr.payload[1] << 8 | fr.payload[2] << 16 |
+                                                  uint32_t(fr.payload[3]) << 24
+                                            : 0;
+        res.sent++;
+        if (fr.payload == sim::expected_frame(f, desc) && fr.width == WIDTH && fr.height == HEIGHT)
+            res.intact++;
+        if (int64_t(f) <= last)
+            res.out_of_order++;
+        if (fr.seq - seq0 != f)
+            res.bad_seq++;
+        last = f;
+    }
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+    return res;
+}
+
+}
+
+int main()
+{
+    uint32_t band_us = uint32_t(uint64_t(PIPELINE_BAND_LINES) * WIDTH * 2 * 10 * 1000000 / BAUD);
+    uint32_t whole_us = uint32_t(uint64_t(FRAME_BYTES + FRAME_PROTO_HEADER_LEN) * 10 * 1000000 / BAUD);
+
+    const Run runs[] = {
+        { "1.6 fps raw", 625000, false, 20 },
+        { "1.6 fps qoi16", 625000, true, 20 },
+        { "15 fps raw", 66667, false, 150 },
+    };
+    Result res[3];
+    for (int i = 0; i < 3; i++) {
+        const Run& r = runs[i];
+        Result& x = res[i];
+        x = run(r);
+        printf("%-14s %3u frames sent, %3u intact, %3u overruns; first byte %u us, latency %u us (max %u us)\n",
+               r.name, x.sent, x.intact, x.ring.overruns, x.stats.first_byte_us, x.stats.frame_latency_us,
+               x.stats.frame_latency_max_us);
+        printf("%-14s band wait max %u us, band tx %u us, %u wire bytes for %u, %u bands stored, "
+               "longest poll %llu us\n", "", x.stats.band_wait_max_us, x.stats.band_tx_us, x.stats.wire_bytes,
+               x.stats.raw_bytes, x.stats.bands_stored, (unsigned long long)x.poll_max_us);
+
+        CHECK(x.sent > 0 && x.intact == x.sent);
+        CHECK(x.out_of_order == 0 && x.bad_seq == 0);
+        CHECK(x.stats.frames_sent == x.sent);
+        // and one more overrun for the frame armed after the sensor stopped
+        CHECK(x.sent + x.ring.overruns >= r.frames && x.sent + x.ring.overruns <= r.frames + 1);
+        CHECK(x.sensor.captured == r.frames);
+        CHECK(x.sensor.missed == 0 && x.sensor.bad_params == 0 && x.sensor.rx_overflows == 0);
+
+        // at most the bands of every slot, queued before the call
+        CHECK(x.poll_max_us <= FRAME_RING_SLOTS * whole_us + band_us);
+    }
+    printf("a band is %u us on the wire, a whole frame %u us\n", band_us, whole_us);
+
+    // the link keeps up - every frame, the last byte a band or two after the last line
+    CHECK(res[0].sent == runs[0].frames && res[0].ring.overruns == 0);
+    CHECK(res[0].stats.frame_latency_max_us < 2 * band_us);
+    CHECK(res[0].stats.first_byte_us < band_us);
+    CHECK(res[1].sent == runs[1].frames && res[1].ring.overruns == 0);
+    CHECK(res[1].stats.wire_bytes < res[1].stats.raw_bytes);
+    CHECK(res[1].stats.frame_latency_max_us < res[0].stats.frame_latency_max_us);
+
+    // the sensor outruns it - whole frames dropped at the ring
+    CHECK(res[2].ring.overruns > 0);
+
+    return check_result();
+}
@@ -0,0 +1,93 @@
+/*
+    The firmware qoi16 encoder (qoi16.c) against the host decoder
+    (ovrecv::qoi16_decode).
+
+    Images that exercise every op - flat areas with runs past the
+    longest run op, gradients, repeats of earlier colours, noise that
+    needs literals and YUYV data - are coded in bands, with the
+    encoder state carried from band to band as pipeline.c does. Each
+    must decode bit-exact, and no band may exceed QOI16_MAX_SIZE().
+*/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+
+extern "C" {
+#include "qoi16.h"
+}
+
+namespace {
+
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 240;
+
+std::vector<uint16_t> test_image(int kind, std::mt19937& rng)
+{
+    std::vector<uint16_t> px(WIDTH * HEIGHT);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            uint16_t& p = px[y * WIDTH + x];
+            switch (kind) {
+            case 0:     // flat blocks - long runs
+                p = uint16_t((x / 100) * 0x1234 + (y / 80) * 0x0841);
+                break;
+            case 1:     // gradients with a little noise - DIFF and LUMA
+                p = uint16_t(((x * 31 / WIDTH) << 11) | (((y * 63 / HEIGHT) ^ (rng() & 1)) << 5) | ((x + y) & 0x1F));
+                break;
+            case 2:     // a few colours repeated - INDEX
+                p = uint16_t(0x1111 * (rng() % 6));
+                break;
+            case 3:     // noise - LITERAL, bands get stored
+                p = uint16_t(rng());
+                break;
+            default:    // YUYV pairs, little-endian
+                p = uint16_t((((x & 1) ? 128 + y / 4 : 128 - x / 8) << 8) | ((x * 2 + y) & 0xFF));
+                break;
+            }
+        }
+    }
+    return px;
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(12);
+
+    for (int kind = 0; kind < 5; kind++) {
+        for (int band_lines : { 1, 16, HEIGHT }) {
+            std::vector<uint16_t> img = test_image(kind, rng);
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(img.data());
+            size_t band_px = size_t(WIDTH) * band_lines;
+
+            qoi16_enc_t enc;
+            qoi16_enc_init(&enc);
+            uint16_t prev = 0;
+            uint16_t index[64] = {};
+            std::vector<uint8_t> out;
+            std::vector<uint8_t> chunk(QOI16_MAX_SIZE(band_px));
+            size_t coded = 0;
+            bool decoded = true;
+
+            for (size_t pos = 0; pos < img.size(); pos += band_px) {
+                size_t n = qoi16_encode(&enc, src + pos * 2, band_px, chunk.data());
+                n += qoi16_finish(&enc, chunk.data() + n);
+                CHECK(n <= QOI16_MAX_SIZE(band_px));
+                decoded &= ovrecv::qoi16_decode(chunk.data(), n, prev, index, out);
+                coded += n;
+            }
+
+            printf("image %d, %3d line bands: %6zu -> %6zu bytes\n", kind, band_lines, img.size() * 2, coded);
+            CHECK(decoded);
+            CHECK(out.size() == img.size() * 2);
+            CHECK(std::equal(out.begin(), out.end(), src));
+        }
+    }
+
+    return check_result();
+}
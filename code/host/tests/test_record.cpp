@@ -0,0 +1,258 @@
+/*
+    Pre/post-trigger recording: RECORD_MODE's main loop - the streaming
+    capture in OV7670.c in 8-line bands, record.c, event.c and a 3 Mbaud
+    UART - on a simulated 30 fps QVGA YUYV sensor, on virtual time
+    (sim_sensor.hpp). The wire goes into ovrecv::FrameDecoder.
+
+    Each history format is run with the largest K record_max_pre()
+    gives for RECORD_STORAGE_BYTES and M = 2, as framegrabber.c builds
+    it. The scene holds still but for a flicker of 1 in luma, and each
+    run triggers three bursts, each once the history is full again:
+    - the button, pressed mid-frame as its GPIO IRQ does it, and again
+      half a period later - that one must be ignored
+    - CAPTURE from the host, on the main loop as cmd.c runs it
+    - a scene change, for the motion detector
+    Every burst must be K + M frames, flagged FRAME_FLAG_RECORD, with
+    consecutive sequence numbers that are the sensor's frame numbers.
+    The first K must be flagged FRAME_FLAG_PRE_TRIGGER and have
+    completed by the trigger, the last of them the newest frame then -
+    the scene change itself for the detector. The last M must have
+    completed after it. Each frame must be exactly the sensor's frame
+    reduced to the format, with the time its last band landed.
+
+    It prints K, the history it spans and each burst's timestamps
+    around the trigger and send time, per format.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "event.h"
+#include "frame_proto.h"
+#include "record.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 320, HEIGHT = 240;
+constexpr uint32_t PERIOD_US = 33333;
+
+// as framegrabber.c
+constexpr uint32_t STORAGE_BYTES = 384 * 1024;
+constexpr uint POST = 2;
+constexpr uint MOTION = 20;
+
+uint8_t record_storage[STORAGE_BYTES];
+
+ov7670_capture_desc_t desc;
+sim::Sensor sensor;
+
+uint32_t change_frame;
+
+// a still scene with a flicker of 1 in luma, and everything 100
+// brighter from change_frame on
+uint8_t scene_byte(uint32_t f, uint l, uint i)
+{
+    if (i & 1)
+        return uint8_t(0x80 ^ (i * 5 + l));
+    return uint8_t(i / 2 + l + (f & 1) + (f >= change_frame ? 100 : 0));
+}
+
+// frame f as record.c keeps it - see record.h
+std::vector<uint8_t> reduced(uint32_t f, record_history_t history)
+{
+    std::vector<uint8_t> in = sim::expected_frame(f, desc), out;
+    bool half = history == RECORD_HALF || history == RECORD_LUMA_HALF;
+    bool luma = history == RECORD_LUMA || history == RECORD_LUMA_HALF;
+    for (uint y = 0; y < HEIGHT; y += half ? 2 : 1) {
+        const uint8_t* line = &in[y * WIDTH * 2];
+        for (uint x = 0; x < WIDTH * 2; x += half ? 8 : 4) {
+            if (luma) {
+                out.push_back(line[x]);
+                out.push_back(line[half ? x + 4 : x + 2]);
+            } else if (half) {
+                out.insert(out.end(), { line[x], line[x + 1], line[x + 4], line[x + 7] });
+            } else {
+                out.insert(out.end(), line + x, line + x + 4);
+            }
+        }
+    }
+    return out;
+}
+
+// when frame f's last band landed
+uint64_t frame_done_us(uint32_t f)
+{
+    return sim::frame_end_us(f, desc) + sensor.irq_latency_us;
+}
+
+// the newest frame complete at t
+uint32_t newest_at(uint64_t t)
+{
+    uint32_t f = sim::frame_at(t) + 1;
+    while (frame_done_us(f) > t)
+        f--;
+    return f;
+}
+
+bool capture_asked;
+
+// the button's GPIO IRQ
+void press()
+{
+    record_trigger();
+    event_post(EVENT_BUTTON);
+}
+
+enum Source { BUTTON, CAPTURE, MOTION_DETECTOR, SOURCES };
+const char* source_names[] = { "button", "CAPTURE", "motion" };
+
+struct Burst {
+    uint64_t trigger_us;
+    uint64_t sent_us;           // when record_poll() returned from sending it
+};
+
+struct Result {
+    uint pre;
+    uint32_t frame_bytes;
+    record_stats_t stats;
+    Burst bursts[SOURCES];
+    std::vector<ovrecv::Frame> frames;
+};
+
+// the next trigger once the history has K + M frames again after now
+uint64_t history_full_us(uint pre)
+{
+    return sim::frame_start_us(sim::frame_at(sim::now_us) + pre + POST + 3) + PERIOD_US / 2;
+}
+
+Result run(record_history_t history)
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    ov7670_capture_desc_default(&desc);
+    change_frame = UINT32_MAX;
+    sensor.period_us = PERIOD_US;
+    sensor.byte = scene_byte;
+    sim::sensor_start(sensor, desc, sim::now_us + 20000);
+
+    Result res = {};
+    res.pre = record_max_pre(STORAGE_BYTES, &desc, history, POST);
+    res.frame_bytes = record_frame_bytes(&desc, history);
+    CHECK(record_init(record_storage, STORAGE_BYTES, &desc, history, res.pre, POST, MOTION, uart));
+    CHECK(!record_init(record_storage, STORAGE_BYTES, &desc, history, res.pre + 1, POST, MOTION, uart));
+    CHECK(record_init(record_storage, STORAGE_BYTES, &desc, history, res.pre, POST, MOTION, uart));
+    CHECK(ov7670_stream_start(&desc, RECORD_BAND_LINES, &record_stream_cb));
+
+    // the button, twice
+    uint64_t t = history_full_us(res.pre);
+    res.bursts[BUTTON].trigger_us = t;
+    sim::at(t, press);
+    sim::at(t + PERIOD_US / 2, press);
+
+    // RECORD_MODE's main loop, with the next trigger set up after each burst
+    uint32_t bursts = 0;
+    while (bursts < SOURCES) {
+        uint32_t ev = event_wait();
+        if ((ev & EVENT_BIT(EVENT_CMD)) && capture_asked) {
+            record_trigger();
+            capture_asked = false;
+        }
+        record_poll();
+
+        record_stats_t stats;
+        record_get_stats(&stats);
+        if (stats.bursts == bursts)
+            continue;
+        res.bursts[bursts].sent_us = sim::now_us;
+        bursts = stats.bursts;
+        if (bursts == CAPTURE) {
+            t = history_full_us(res.pre);
+            res.bursts[CAPTURE].trigger_us = t;
+            sim::at(t, [] {
+                capture_asked = true;
+                event_post(EVENT_CMD);
+            });
+        } else if (bursts == MOTION_DETECTOR) {
+            change_frame = sim::frame_at(history_full_us(res.pre)) + 1;
+            res.bursts[MOTION_DETECTOR].trigger_us = frame_done_us(change_frame);
+        }
+    }
+
+    record_get_stats(&res.stats);
+    ov7670_stream_stop();
+
+    ovrecv::FrameDecoder dec;
+    dec.feed(sim::uart_wire().data(), sim::uart_wire().size(), res.frames);
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+    CHECK(sim::sensor_stats().missed == 0);
+
+    // each burst K + M frames in a row, split by the trigger
+    uint burst_len = res.pre + POST;
+    CHECK(res.frames.size() == SOURCES * burst_len);
+    if (res.frames.size() != SOURCES * burst_len)
+        return res;
+    bool luma = history == RECORD_LUMA || history == RECORD_LUMA_HALF;
+    bool half = history == RECORD_HALF || history == RECORD_LUMA_HALF;
+    for (uint b = 0; b < SOURCES; b++) {
+        uint64_t trigger = res.bursts[b].trigger_us;
+        for (uint k = 0; k < burst_len; k++) {
+            const ovrecv::Frame& fr = res.frames[b * burst_len + k];
+            bool pre = k < res.pre;
+            CHECK(fr.width == (half ? WIDTH / 2 : WIDTH) && fr.height == (half ? HEIGHT / 2 : HEIGHT));
+            CHECK(fr.format == (luma ? ovrecv::Format::Y8 : ovrecv::Format::YUV422));
+            CHECK(fr.flags == (ovrecv::FLAG_RECORD | (pre ? ovrecv::FLAG_PRE_TRIGGER : 0)));
+            CHECK(fr.payload == reduced(fr.seq, history));
+            CHECK(fr.timestamp_us == uint32_t(frame_done_us(fr.seq)));
+            if (k > 0)
+                CHECK(fr.seq == res.frames[b * burst_len + k - 1].seq + 1);
+            if (pre)
+                CHECK(fr.timestamp_us <= trigger);
+            else
+                CHECK(fr.timestamp_us > trigger);
+            if (k + 1 == res.pre)
+                CHECK(fr.seq == (b == MOTION_DETECTOR ? change_frame : newest_at(trigger)));
+        }
+    }
+    return res;
+}
+
+}
+
+int main()
+{
+    const record_history_t histories[] = { RECORD_FULL, RECORD_LUMA, RECORD_HALF, RECORD_LUMA_HALF };
+    const char* names[] = { "RECORD_FULL", "RECORD_LUMA", "RECORD_HALF", "RECORD_LUMA_HALF" };
+
+    printf("QVGA YUV422 at %.1f fps, %u KB of history, M = %u, link %u KB/s\n", 1e6 / PERIOD_US,
+           STORAGE_BYTES / 1024, POST, BAUD / 10 / 1000);
+    for (int h = 0; h < 4; h++) {
+        Result r = run(histories[h]);
+        printf("%-16s %6u bytes/frame, K = %2u (%3u ms of history):\n", names[h], r.frame_bytes, r.pre,
+               r.pre * PERIOD_US / 1000);
+        if (r.frames.size() != SOURCES * (r.pre + POST))
+            continue;
+        for (uint b = 0; b < SOURCES; b++) {
+            const ovrecv::Frame& first = r.frames[b * (r.pre + POST)];
+            const ovrecv::Frame& last = r.frames[(b + 1) * (r.pre + POST) - 1];
+            int64_t trigger = int64_t(r.bursts[b].trigger_us);
+            printf("  %-8s %2u frames, seq %4u-%4u, %+7.1f to %+6.1f ms around the trigger, sent %5.0f ms later\n",
+                   source_names[b], r.pre + POST, first.seq, last.seq, (first.timestamp_us - trigger) / 1000.0,
+                   (last.timestamp_us - trigger) / 1000.0, (r.bursts[b].sent_us - trigger) / 1000.0);
+        }
+        printf("  %u frames recorded, %u broken, %u bands dropped while sending\n", r.stats.frames,
+               r.stats.frames_broken, r.stats.bands_dropped);
+
+        CHECK(r.stats.bursts == SOURCES && r.stats.burst_frames == r.pre + POST);
+        CHECK(r.stats.triggers == SOURCES && r.stats.motion_triggers == 1 && r.stats.triggers_ignored == 1);
+    }
+
+    return check_result();
+}
@@ -0,0 +1,178 @@
+/*
+    Mode switching through the shadow register cache (sccb.c), on a
+    simulated sensor that logs every register access at 400 kHz
+    (sim_sensor.hpp).
+
+    ov7670_init() brings the sensor up in QVGA YUV422, then
+    ov7670_set_size() and ov7670_set_bayer() switch between the modes
+    the firmware uses. After every switch:
+    - the sensor's registers must be exactly what a reset followed by
+      the whole of the new mode's tables gives - the same mode set
+      from reset, in a run of its own
+    - COM7 must be the first write and CLKRC the last
+    - no register may be written twice, or with the value it held,
+      but for the ones the sensor owns (GAIN, AECH, ...), which are
+      written whenever they are staged
+    Setting the mode it is already in writes nothing else, and every
+    switch must take less time on the bus than the reset and whole
+    tables it stands for.
+
+    It prints each switch's register writes and time against a reset
+    and the whole tables, at 400 kHz and at the 100 kHz the firmware
+    used to run the bus at.
+*/
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "check.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "OV7670.h"
+#include "line_stream.h"
+#include "sccb.h"
+}
+
+namespace {
+
+constexpr uint8_t COM7 = 0x12, CLKRC = 0x11;
+
+// the registers sccb.c leaves to the sensor
+const std::set<uint8_t> sensor_owned = { 0x00, 0x01, 0x02, 0x07, 0x10, 0x2D, 0x2E };
+
+uint8_t frame_buffer[320 * 240 * 2];
+
+struct Mode {
+    const char* name;
+    bool bayer;
+    uint width, height;
+    uint8_t clkrc;
+};
+
+bool set_mode(const Mode& m)
+{
+    return m.bayer ? ov7670_set_bayer(m.width, m.height, m.clkrc) : ov7670_set_size(m.width, m.height, m.clkrc);
+}
+
+std::vector<uint8_t> sensor_regs()
+{
+    std::vector<uint8_t> regs(SCCB_NUM_REGS);
+    for (uint r = 0; r < SCCB_NUM_REGS; r++)
+        regs[r] = sim::sccb_reg(uint8_t(r));
+    return regs;
+}
+
+// A mode set straight after a reset - the registers it leaves, and how
+// many it stages (all either written or already at their defaults)
+struct Reference {
+    std::vector<uint8_t> regs;
+    uint32_t staged;
+};
+
+Reference from_reset(const Mode& m)
+{
+    sim::reset();
+    sccb_init(i2c0, 0x21, SCCB_BAUD);
+    CHECK(sccb_reset(300));
+    sccb_stats_t before, after;
+    sccb_get_stats(&before);
+    CHECK(set_mode(m));
+    sccb_get_stats(&after);
+    return { sensor_regs(), after.skipped - before.skipped + after.commit_writes };
+}
+
+// bus time of one register write
+uint32_t write_us(uint32_t baud)
+{
+    return (29 * 1000000 + baud - 1) / baud;
+}
+
+// a COM7 reset, the wait for it, and every staged register
+uint32_t full_us(uint32_t staged, uint32_t baud)
+{
+    return (1 + staged) * write_us(baud) + sim::SCCB_RESET_US;
+}
+
+}
+
+int main()
+{
+    const Mode qvga_yuv = { "QVGA YUV422", false, 320, 240, 0x01 };
+    const Mode vga_yuv = { "VGA YUV422", false, 640, 480, LINE_STREAM_VGA_CLKRC };
+    const Mode vga_bayer = { "VGA Bayer", true, 640, 480, LINE_STREAM_VGA_BAYER_CLKRC };
+    const Mode qvga_bayer = { "QVGA Bayer", true, 320, 240, 0x01 };
+    const Mode switches[] = { vga_yuv, vga_bayer, qvga_bayer, qvga_yuv, qvga_yuv, vga_bayer, vga_yuv };
+
+    std::vector<Reference> refs;
+    for (const Mode& m : switches)
+        refs.push_back(from_reset(m));
+
+    // boot - reset and QVGA YUV422, as every mode starts
+    sim::reset();
+    uint64_t t0 = sim::now_us;
+    ov7670_init(frame_buffer);
+    sccb_stats_t stats;
+    sccb_get_stats(&stats);
+    printf("ov7670_init(): %u reads and %u writes, %llu us on the bus, %llu us in all\n", stats.reads,
+           stats.writes, (unsigned long long)sim::sccb_busy_us(), (unsigned long long)(sim::now_us - t0));
+    CHECK(sensor_regs() == from_reset(qvga_yuv).regs);
+
+    sim::reset();
+    ov7670_init(frame_buffer);
+    const char* from = qvga_yuv.name;
+    uint32_t diff_us = 0, old_us = 0;
+    for (size_t k = 0; k < std::size(switches); k++) {
+        const Mode& m = switches[k];
+        bool same = from == m.name;
+        std::vector<uint8_t> held = sensor_regs();
+        sim::sccb_clear_log();
+        uint64_t bus0 = sim::sccb_busy_us();
+        CHECK(set_mode(m));
+        sccb_get_stats(&stats);
+        uint64_t bus_us = sim::sccb_busy_us() - bus0;
+
+        // what changed on the sensor, and how
+        const std::vector<sim::SccbOp>& log = sim::sccb_log();
+        std::set<uint8_t> written;
+        uint32_t twice = 0, unchanged = 0, naks = 0, owned = 0;
+        for (const sim::SccbOp& op : log) {
+            CHECK(op.write);
+            naks += !op.ack;
+            if (sensor_owned.count(op.reg)) {
+                owned++;
+                continue;
+            }
+            twice += !written.insert(op.reg).second;
+            unchanged += held[op.reg] == op.value;
+        }
+        if (written.count(COM7))
+            CHECK(log.front().reg == COM7);
+        if (written.count(CLKRC))
+            CHECK(log.back().reg == CLKRC);
+
+        uint32_t staged = refs[k].staged;
+        printf("%-11s -> %-11s %2zu writes (%u the sensor's) for %2u staged, %4llu us; "
+               "reset and tables %4u us at 400 kHz, %4u us at 100 kHz\n",
+               from, m.name, log.size(), owned, staged, (unsigned long long)bus_us, full_us(staged, 400000),
+               full_us(staged, 100000));
+
+        CHECK(sensor_regs() == refs[k].regs);
+        CHECK(stats.commit_writes == log.size() && naks == 0);
+        CHECK(twice == 0 && unchanged == 0);
+        CHECK(stats.commit_us == bus_us);
+        if (same) {
+            CHECK(written.empty());
+        } else {
+            CHECK(bus_us < full_us(staged, SCCB_BAUD));
+            diff_us += uint32_t(bus_us);
+            old_us += full_us(staged, 100000);
+        }
+        from = m.name;
+    }
+    printf("mode switches: %u us on the bus against %u us for reset and tables at 100 kHz (%.1fx)\n", diff_us,
+           old_us, double(old_us) / diff_us);
+
+    return check_result();
+}
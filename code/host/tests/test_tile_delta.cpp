@@ -0,0 +1,254 @@
+/*
+    Tile deltas (tile_delta.c) over a simulated QVGA YUV422 sequence:
+    a still scene with +-2 sensor noise on every byte, and a 40x40
+    square moving across it, 90 frames at the default threshold and
+    keyframe interval. The wire goes into ovrecv::FrameDecoder and the
+    host rebuilds each frame from the last keyframe as tile_delta.py
+    does.
+
+    Every frame must come out, keyframes every
+    TILE_DELTA_KEYFRAME_INTERVAL frames, and each rebuilt frame within
+    the threshold of the real one in every 4x4 block - exact in the
+    tiles wholly inside the square. saved_pct must be what the wire
+    gives. A sequence of noise, where every tile is dirty every frame,
+    is all keyframes and must save 0%, not wrap.
+
+    It prints the bytes per frame, the savings and the diff time per
+    frame on this host.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+
+extern "C" {
+#include "tile_delta.h"
+}
+
+namespace {
+
+constexpr uint WIDTH = 320, HEIGHT = 240, BPP = 2;
+constexpr uint32_t FRAME_BYTES = WIDTH * HEIGHT * BPP;
+constexpr uint FRAMES = 90;
+constexpr uint SQUARE = 40;
+constexpr uint TILES_X = WIDTH / TILE_SIZE;
+
+std::vector<uint8_t> wire;
+
+bool wire_send(transport_t* t, const uint8_t* data, size_t len)
+{
+    wire.insert(wire.end(), data, data + len);
+    return true;
+}
+
+bool wire_is_busy(transport_t* t)
+{
+    return false;
+}
+
+// where the square is in frame f
+uint square_x(uint f)
+{
+    return (f * 5) % (WIDTH - SQUARE);
+}
+
+uint square_y(uint f)
+{
+    return (f * 3) % (HEIGHT - SQUARE);
+}
+
+// kind 0 is the moving square, 1 every byte random
+std::vector<uint8_t> sequence_frame(uint f, int kind, std::mt19937& rng)
+{
+    std::vector<uint8_t> frame(FRAME_BYTES);
+    for (uint y = 0; y < HEIGHT; y++) {
+        for (uint i = 0; i < WIDTH * BPP; i++) {
+            uint8_t& b = frame[y * WIDTH * BPP + i];
+            if (kind == 1) {
+                b = uint8_t(rng());
+                continue;
+            }
+            bool in_square = y - square_y(f) < SQUARE && i / BPP - square_x(f) < SQUARE;
+            b = in_square ? uint8_t(f * 97) : uint8_t(40 + (i / 2 + y) % 160 + int(rng() % 5) - 2);
+        }
+    }
+    return frame;
+}
+
+// tiles wholly inside the square in frame f
+bool square_tile(uint f, uint tx, uint ty)
+{
+    return tx * TILE_SIZE >= square_x(f) && (tx + 1) * TILE_SIZE <= square_x(f) + SQUARE &&
+           ty * TILE_SIZE >= square_y(f) && (ty + 1) * TILE_SIZE <= square_y(f) + SQUARE;
+}
+
+// Patch the dirty tiles of a FLAG_TILES payload into frame - false if
+// it doesn't follow the frame sent before
+bool apply_tiles(const ovrecv::Frame& fr, uint32_t prev_seq, std::vector<uint8_t>& frame, uint& tiles)
+{
+    const uint8_t* p = fr.payload.data();
+    uint32_t ref = p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+    const uint8_t* bitmap = p + 4;
+    uint ntiles = TILES_X * (HEIGHT / TILE_SIZE);
+    const uint8_t* tile = bitmap + (ntiles + 7) / 8;
+    tiles = 0;
+    for (uint i = 0; i < ntiles; i++) {
+        if (!(bitmap[i / 8] & (1 << (i % 8))))
+            continue;
+        uint tx = i % TILES_X, ty = i / TILES_X;
+        for (uint r = 0; r < TILE_SIZE; r++, tile += TILE_SIZE * BPP)
+            std::copy(tile, tile + TILE_SIZE * BPP,
+                      &frame[((ty * TILE_SIZE + r) * WIDTH + tx * TILE_SIZE) * BPP]);
+        tiles++;
+    }
+    return ref == prev_seq && tile == fr.payload.data() + fr.payload.size();
+}
+
+// the largest 4x4 block sum difference, and whether the tiles inside the square are exact
+uint32_t block_error(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, uint f, bool& square_exact)
+{
+    uint32_t worst = 0;
+    square_exact = true;
+    for (uint by = 0; by < HEIGHT; by += 4) {
+        for (uint bx = 0; bx < WIDTH; bx += 4) {
+            int32_t sa = 0, sb = 0;
+            bool diff = false;
+            for (uint y = by; y < by + 4; y++) {
+                for (uint i = bx * BPP; i < (bx + 4) * BPP; i++) {
+                    sa += a[y * WIDTH * BPP + i];
+                    sb += b[y * WIDTH * BPP + i];
+                    diff |= a[y * WIDTH * BPP + i] != b[y * WIDTH * BPP + i];
+                }
+            }
+            worst = std::max<uint32_t>(worst, uint32_t(std::abs(sa - sb)));
+            if (diff && square_tile(f, bx / TILE_SIZE, by / TILE_SIZE))
+                square_exact = false;
+        }
+    }
+    return worst;
+}
+
+struct Result {
+    uint32_t frames, keyframes, rebuilt, square_exact;
+    uint32_t worst_block;
+    uint64_t payload_bytes;
+    uint32_t delta_bytes_max;
+    uint64_t delta_bytes, deltas;
+    uint64_t tiles_sent;
+    uint32_t diff_us_sum;
+    tile_delta_stats_t stats;
+};
+
+Result run(int kind)
+{
+    std::mt19937 rng(13);
+    wire.clear();
+    transport_t t = {};
+    t.send_async = wire_send;
+    t.is_busy = wire_is_busy;
+    CHECK(tile_delta_init(WIDTH, HEIGHT, BPP, TILE_DELTA_THRESHOLD, TILE_DELTA_KEYFRAME_INTERVAL));
+
+    Result res = {};
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint f = 0; f < FRAMES; f++) {
+        frames.push_back(sequence_frame(f, kind, rng));
+        frame_desc_t desc = {};
+        desc.seq = 2 * f;
+        desc.format = FRAME_FMT_YUV422;
+        desc.size = FRAME_BYTES;
+        desc.data = frames.back().data();
+        tile_delta_send(&t, &desc);
+        tile_delta_get_stats(&res.stats);
+        res.diff_us_sum += res.stats.diff_us;
+    }
+
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> sent;
+    dec.feed(wire.data(), wire.size(), sent);
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+    CHECK(sent.size() == FRAMES);
+
+    // the host's frame, rebuilt from the last keyframe
+    std::vector<uint8_t> host;
+    uint32_t prev_seq = 0;
+    for (size_t k = 0; k < sent.size() && k < FRAMES; k++) {
+        const ovrecv::Frame& fr = sent[k];
+        res.frames++;
+        res.payload_bytes += fr.payload.size();
+        uint tiles = TILES_X * (HEIGHT / TILE_SIZE);
+        bool ok;
+        if (fr.flags & ovrecv::FLAG_TILES) {
+            ok = !host.empty() && apply_tiles(fr, prev_seq, host, tiles);
+            res.delta_bytes += fr.payload.size();
+            res.delta_bytes_max = std::max<uint32_t>(res.delta_bytes_max, uint32_t(fr.payload.size()));
+            res.deltas++;
+        } else {
+            host = fr.payload;
+            ok = fr.payload.size() == FRAME_BYTES;
+            res.keyframes++;
+            CHECK(k % TILE_DELTA_KEYFRAME_INTERVAL == 0 || kind == 1);
+        }
+        res.tiles_sent += tiles;
+        prev_seq = fr.seq;
+        if (!ok)
+            continue;
+        res.rebuilt++;
+        bool exact;
+        res.worst_block = std::max(res.worst_block, block_error(host, frames[k], uint(k), exact));
+        res.square_exact += exact;
+    }
+    return res;
+}
+
+}
+
+// no IRQs here - the diff time is host time
+extern "C" uint32_t time_us_32(void)
+{
+    static const auto t0 = std::chrono::steady_clock::now();
+    return uint32_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count());
+}
+
+int main()
+{
+    const uint32_t block_threshold = TILE_DELTA_THRESHOLD * 4 * 4 * BPP;
+    const char* names[] = { "moving square", "noise" };
+
+    printf("%u QVGA YUV422 frames, threshold %u, keyframe every %u\n", FRAMES, TILE_DELTA_THRESHOLD,
+           TILE_DELTA_KEYFRAME_INTERVAL);
+    for (int kind = 0; kind < 2; kind++) {
+        Result r = run(kind);
+        const tile_delta_stats_t& s = r.stats;
+        printf("%-13s %u frames, %u keyframes, %llu of %u bytes sent, %d%% saved\n", names[kind], r.frames,
+               r.keyframes, (unsigned long long)r.payload_bytes, FRAMES * FRAME_BYTES, s.saved_pct);
+        if (r.deltas)
+            printf("%-13s deltas %llu bytes on average (max %u), %.1f of %u tiles\n", "",
+                   (unsigned long long)(r.delta_bytes / r.deltas), r.delta_bytes_max,
+                   double(r.tiles_sent - r.keyframes * s.tiles_total) / r.deltas, s.tiles_total);
+        printf("%-13s diff %u us a frame on average, max %u us\n", "", r.diff_us_sum / FRAMES, s.diff_max_us);
+        printf("%-13s rebuilt %u, largest 4x4 block sum error %u (threshold %u), square exact in %u\n", "",
+               r.rebuilt, r.worst_block, block_threshold, r.square_exact);
+
+        CHECK(r.frames == FRAMES && r.rebuilt == FRAMES && s.frames_sent == FRAMES);
+        CHECK(r.keyframes == s.keyframes);
+        CHECK(r.worst_block <= block_threshold);
+        int64_t raw = int64_t(FRAMES) * FRAME_BYTES;
+        uint64_t wire_payload = r.payload_bytes + 4 * r.deltas;    // and the CRC trailers
+        CHECK(s.saved_pct == int32_t((raw - int64_t(wire_payload)) * 100 / raw));
+        if (kind == 0) {
+            CHECK(r.keyframes == (FRAMES + TILE_DELTA_KEYFRAME_INTERVAL - 1) / TILE_DELTA_KEYFRAME_INTERVAL);
+            CHECK(r.square_exact == FRAMES);
+            CHECK(s.saved_pct >= 90);
+        } else {
+            CHECK(r.keyframes == FRAMES && s.saved_pct == 0);
+        }
+    }
+
+    return check_result();
+}
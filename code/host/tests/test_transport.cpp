@@ -0,0 +1,165 @@
+/*
+    The pty transport (pty_transport.c), which the firmware's send
+    paths use on the host, against ovrecv::SerialPort on the slave.
+
+    Correctness: 400 transfers of 1 byte to 64 KB of random data. Half
+    are started from the done callback of the one before, the rest
+    from the sender once is_busy clears. The host must read back
+    exactly the bytes sent, in order, and bytes_sent, transfers and
+    the callbacks must all agree.
+
+    Back-pressure: with the host not reading, a 1 MB transfer must
+    still be busy after 50 ms, a second send must be refused, and it
+    must finish once the host reads again.
+
+    Throughput: 40 QVGA RGB565 frames (153,600 bytes) with
+    transport_send(), to the last byte read. It has to be well above
+    3 Mbaud (300 KB/s) for simulations of the link to mean anything.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/serial_port.hpp"
+
+extern "C" {
+#include "pty_transport.h"
+}
+
+namespace {
+
+constexpr int TRANSFERS = 400;
+constexpr size_t MAX_LEN = 65536;
+constexpr size_t FRAME_BYTES = 320 * 240 * 2;
+constexpr int FRAMES = 40;
+
+// Reads into got until it has want bytes, or nothing comes for a second
+void read_until(ovrecv::SerialPort& port, std::vector<uint8_t>& got, size_t want)
+{
+    uint8_t chunk[65536];
+    while (got.size() < want) {
+        size_t n = port.read(chunk, sizeof(chunk), 1000);
+        if (n == 0)
+            break;
+        got.insert(got.end(), chunk, chunk + n);
+    }
+}
+
+// Chained sends - the done callback starts the next transfer
+struct Chain {
+    transport_t* t;
+    const std::vector<std::vector<uint8_t>>* bufs;
+    std::atomic<int> next{0};
+    std::atomic<int> callbacks{0};
+    int end = 0;
+};
+
+void chain_done(void* user)
+{
+    Chain* c = static_cast<Chain*>(user);
+    c->callbacks++;
+    int n = c->next;
+    if (n < c->end) {
+        c->next = n + 1;
+        const auto& b = (*c->bufs)[n];
+        if (!transport_send_async(c->t, b.data(), b.size()))
+            c->next = -1000000;    // refused from the callback - flagged below
+    }
+}
+
+}
+
+int main()
+{
+    pty_transport_t* pty = pty_transport_open();
+    if (!pty) {
+        perror("pty_transport_open");
+        return 1;
+    }
+    transport_t* t = pty_transport_get(pty);
+    ovrecv::SerialPort port;
+    port.open(pty_transport_path(pty), 3000000);
+
+    std::mt19937 rng(4);
+    std::vector<std::vector<uint8_t>> bufs(TRANSFERS);
+    std::vector<uint8_t> want;
+    for (auto& b : bufs) {
+        b.resize(1 + (rng() % 4 == 0 ? rng() % MAX_LEN : rng() % 512));
+        for (auto& v : b)
+            v = uint8_t(rng());
+        want.insert(want.end(), b.begin(), b.end());
+    }
+
+    // correctness
+    std::vector<uint8_t> got;
+    std::thread host([&] { read_until(port, got, want.size()); });
+
+    Chain chain;
+    chain.t = t;
+    chain.bufs = &bufs;
+    t->done_cb = chain_done;
+    t->user_data = &chain;
+
+    for (int n = 0; n < TRANSFERS / 2; n++) {
+        while (transport_is_busy(t));
+        CHECK(transport_send_async(t, bufs[n].data(), bufs[n].size()));
+    }
+    // the second half chains from the callback - once the last
+    // callback of the first half has run
+    while (chain.callbacks < TRANSFERS / 2)
+        std::this_thread::yield();
+    chain.end = TRANSFERS;
+    chain.next = TRANSFERS / 2 + 1;
+    CHECK(transport_send_async(t, bufs[TRANSFERS / 2].data(), bufs[TRANSFERS / 2].size()));
+
+    host.join();
+    while (chain.callbacks < TRANSFERS && chain.next >= 0)
+        std::this_thread::yield();
+    t->done_cb = nullptr;
+
+    printf("%d transfers, %zu bytes: %s\n", TRANSFERS, want.size(), got == want ? "intact" : "WRONG");
+    CHECK(got == want);
+    CHECK(chain.next == TRANSFERS);
+    CHECK(t->transfers == uint32_t(TRANSFERS));
+    CHECK(t->bytes_sent == want.size());
+    CHECK(chain.callbacks == TRANSFERS);
+
+    // back-pressure - nobody reads until 50 ms in
+    std::vector<uint8_t> big(1 << 20, 0x5A);
+    CHECK(transport_send_async(t, big.data(), big.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool held_up = transport_is_busy(t);
+    bool refused = !transport_send_async(t, big.data(), 1);
+    got.clear();
+    read_until(port, got, big.size());
+    while (transport_is_busy(t));
+    printf("1 MB with the host not reading: %s, second send %s\n", held_up ? "held up" : "NOT held up",
+           refused ? "refused" : "NOT refused");
+    CHECK(held_up && refused);
+    CHECK(got == big);
+
+    // throughput
+    std::vector<uint8_t> frame(FRAME_BYTES);
+    for (auto& v : frame)
+        v = uint8_t(rng());
+    got.clear();
+    got.reserve(FRAMES * FRAME_BYTES);
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread reader([&] { read_until(port, got, FRAMES * FRAME_BYTES); });
+    for (int n = 0; n < FRAMES; n++)
+        transport_send(t, frame.data(), frame.size());
+    reader.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double rate = FRAMES * FRAME_BYTES / s;
+    printf("%d QVGA frames: %.1f MB/s, %.0f fps - %.0fx 3 Mbaud\n", FRAMES, rate / 1e6, FRAMES / s, rate / 300e3);
+    CHECK(got.size() == FRAMES * FRAME_BYTES);
+    CHECK(rate > 10 * 300e3);
+
+    port.close();
+    pty_transport_close(pty);
+    return check_result();
+}
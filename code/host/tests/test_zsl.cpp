@@ -0,0 +1,219 @@
+/*
+    Zero-shutter-lag snapshots: ZSL_MODE's main loop - the streaming
+    capture in OV7670.c, zsl.c, event.c and a 3 Mbaud UART - on a
+    simulated 30 fps sensor, on virtual time (sim_sensor.hpp). The
+    wire goes into ovrecv::FrameDecoder.
+
+    The button is pressed PRESSES times, each 150-450 ms after the
+    previous snapshot went out, as the GPIO IRQ does it: zsl_trigger(1)
+    and EVENT_BUTTON. Then CAPTURE 3 comes from the host. For every
+    press:
+    - the snapshot must be the newest frame complete at the press -
+      its timestamp at most one period before it, and the next frame
+      not yet complete
+    - and intact, exactly what the sensor sent, though capture went on
+      into the other slots while it was on the wire
+    CAPTURE 3 must send the newest frame, then two completed after the
+    trigger, in order. zsl_get_stats() must agree with what arrived.
+
+    It prints trigger -> frame timestamp for ZSL_MODE, and for the
+    one-shot capture_frame() at the same press times - the next VSYNC
+    plus a frame, worked out from the sensor's timing.
+*/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "ovrecv/frame_decoder.hpp"
+#include "sim_sensor.hpp"
+
+extern "C" {
+#include "event.h"
+#include "frame_proto.h"
+#include "zsl.h"
+}
+
+namespace {
+
+constexpr uint32_t BAUD = 3000000;
+constexpr uint WIDTH = 320, HEIGHT = 240;
+constexpr uint32_t FRAME_BYTES = WIDTH * HEIGHT * 2;
+constexpr uint32_t PERIOD_US = 33333;
+constexpr uint32_t PRESSES = 150;
+constexpr uint CAPTURE_FRAMES = 3;
+
+uint8_t zsl_storage[ZSL_SLOTS * FRAME_BYTES];
+
+// byte i of line l of frame f - the frame number in the first two bytes
+uint8_t scene_byte(uint32_t f, uint l, uint i)
+{
+    if (l == 0 && i < 2)
+        return uint8_t(f >> (8 * i));
+    return uint8_t(i * 3 + l * 5 + f * 7);
+}
+
+uint32_t frame_number(const ovrecv::Frame& fr)
+{
+    return fr.payload.size() >= 2 ? fr.payload[0] | fr.payload[1] << 8 : UINT32_MAX;
+}
+
+ov7670_capture_desc_t desc;
+sim::Sensor sensor;
+
+// when frame f's DMA IRQ ran, and zsl.c stamped it
+uint64_t frame_done_us(uint32_t f)
+{
+    return sim::frame_end_us(f, desc) + sensor.irq_latency_us;
+}
+
+// the newest frame complete at t
+uint32_t newest_at(uint64_t t)
+{
+    uint32_t f = sim::frame_at(t) + 1;
+    while (frame_done_us(f) > t)
+        f--;
+    return f;
+}
+
+// capture_frame() at t - the next VSYNC, then the whole frame
+int64_t one_shot_lag_us(uint64_t t)
+{
+    uint32_t f = sim::frame_at(t);
+    if (sim::frame_start_us(f) < t)
+        f++;
+    return int64_t(sim::frame_end_us(f, desc) - t);
+}
+
+std::vector<uint64_t> triggers_us;
+bool capture_asked;
+
+// the button's GPIO IRQ
+void press()
+{
+    triggers_us.push_back(sim::now_us);
+    zsl_trigger(1);
+    event_post(EVENT_BUTTON);
+}
+
+// CAPTURE 3 on RX - cmd.c hands it to the main loop
+void capture_cmd()
+{
+    capture_asked = true;
+    event_post(EVENT_CMD);
+}
+
+double mean(const std::vector<int64_t>& v)
+{
+    double sum = 0;
+    for (int64_t x : v)
+        sum += double(x);
+    return v.empty() ? 0 : sum / double(v.size());
+}
+
+int64_t percentile(std::vector<int64_t> v, uint p)
+{
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[std::min<size_t>(v.size() - 1, v.size() * p / 100)];
+}
+
+void print_lags(const char* name, const std::vector<int64_t>& lags)
+{
+    printf("  %-22s mean %+8.1f ms, min %+6.1f ms, p50 %+6.1f ms, p99 %+6.1f ms, max %+6.1f ms\n", name,
+           mean(lags) / 1000, percentile(lags, 0) / 1000.0, percentile(lags, 50) / 1000.0,
+           percentile(lags, 99) / 1000.0, percentile(lags, 100) / 1000.0);
+}
+
+}
+
+int main()
+{
+    sim::reset();
+    transport_t* uart = sim::uart_open(BAUD);
+
+    ov7670_capture_desc_default(&desc);
+    sensor.period_us = PERIOD_US;
+    sensor.byte = scene_byte;
+    sim::sensor_start(sensor, desc, sim::now_us + 20000);
+
+    zsl_init(zsl_storage, FRAME_FMT_YUV422, FRAME_BYTES, uart, WIDTH, HEIGHT);
+    CHECK(ov7670_stream_start(&desc, HEIGHT, &zsl_stream_cb));
+
+    // ZSL_MODE's main loop, with the next press scheduled after each
+    // snapshot has gone out
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<uint32_t> gap_ms(150, 450);
+    sim::at(sim::now_us + gap_ms(rng) * 1000, press);
+    uint32_t snapshots = 0;
+    while (snapshots < PRESSES + CAPTURE_FRAMES) {
+        uint32_t ev = event_wait();
+        if ((ev & EVENT_BIT(EVENT_CMD)) && capture_asked) {
+            triggers_us.push_back(sim::now_us);
+            zsl_trigger(CAPTURE_FRAMES);
+            capture_asked = false;
+        }
+        uint n = zsl_poll();
+        snapshots += n;
+        if (n && snapshots < PRESSES)
+            sim::at(sim::now_us + gap_ms(rng) * 1000, press);
+        else if (n && snapshots == PRESSES)
+            sim::at(sim::now_us + gap_ms(rng) * 1000, capture_cmd);
+    }
+
+    zsl_stats_t stats;
+    zsl_get_stats(&stats);
+    ov7670_stream_stop();
+
+    ovrecv::FrameDecoder dec;
+    std::vector<ovrecv::Frame> frames;
+    dec.feed(sim::uart_wire().data(), sim::uart_wire().size(), frames);
+    CHECK(dec.stats().crc_errors == 0 && dec.stats().skipped_bytes == 0);
+    CHECK(frames.size() == PRESSES + CAPTURE_FRAMES);
+    CHECK(triggers_us.size() == PRESSES + 1);
+    if (frames.size() != PRESSES + CAPTURE_FRAMES || triggers_us.size() != PRESSES + 1)
+        return check_result();
+
+    // each snapshot the newest frame at its trigger, and intact
+    std::vector<int64_t> lags, one_shot;
+    uint32_t intact = 0, newest = 0;
+    for (size_t k = 0; k < frames.size(); k++) {
+        const ovrecv::Frame& fr = frames[k];
+        uint32_t f = frame_number(fr);
+        bool ok = fr.width == WIDTH && fr.height == HEIGHT && fr.format == ovrecv::Format::YUV422 &&
+                  fr.payload == sim::expected_frame(f, desc);
+        intact += ok;
+        CHECK(ok && uint32_t(frame_done_us(f)) == fr.timestamp_us);
+
+        uint64_t t = triggers_us[std::min<size_t>(k, PRESSES)];
+        if (k > PRESSES) {
+            // the rest of CAPTURE 3 - completed after the trigger, in order
+            CHECK(frame_done_us(f) > t && f > frame_number(frames[k - 1]));
+            continue;
+        }
+        newest += f == newest_at(t);
+        int64_t lag = int64_t(fr.timestamp_us) - int64_t(t);
+        lags.push_back(lag);
+        one_shot.push_back(one_shot_lag_us(t));
+        CHECK(lag <= 0 && lag > -int64_t(PERIOD_US));
+    }
+    CHECK(intact == frames.size() && newest == PRESSES + 1);
+
+    printf("%u presses 150-450 ms after the last snapshot, then CAPTURE %u; sensor %.1f fps, link %u KB/s\n",
+           PRESSES, CAPTURE_FRAMES, 1e6 / PERIOD_US, BAUD / 10 / 1000);
+    printf("%zu snapshots, %u intact, %u the newest frame at the trigger\n", frames.size(), intact, newest);
+    printf("trigger -> frame timestamp:\n");
+    print_lags("one-shot capture_frame()", one_shot);
+    print_lags("ZSL_MODE", lags);
+    printf("zsl: %u triggers, %u snapshots, %u captured, %u recycled, %u overruns, lag %d to %d us\n",
+           stats.triggers, stats.snapshots, stats.captured, stats.recycled, stats.overruns, stats.lag_min_us,
+           stats.lag_max_us);
+
+    CHECK(stats.triggers == PRESSES + 1 && stats.snapshots == frames.size());
+    CHECK(stats.lag_min_us == percentile(lags, 0) && stats.lag_max_us == percentile(lags, 100));
+    // frames are dropped only while a snapshot is on the wire
+    CHECK(stats.overruns > 0 && stats.recycled > 0);
+    CHECK(percentile(lags, 100) < percentile(one_shot, 0));
+
+    return check_result();
+}
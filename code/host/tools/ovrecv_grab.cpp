@@ -0,0 +1,111 @@
+/*
+    ovrecv_grab - receive frames and save them as PPM images.
+
+    Usage: ovrecv_grab <serial_port> [--count <n>] [--baud <rate>] [--window <bytes>]
+
+    Frames are saved as frame_<seq>.ppm (.jpg for JPEG frames, which
+    are written as they came). --window grants flow-control credit like
+    recv_image.py does.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ovrecv/convert.hpp"
+#include "ovrecv/receiver.hpp"
+
+using namespace ovrecv;
+
+static void save_ppm(const char* name, const uint8_t* rgb, int width, int height)
+{
+    FILE* f = fopen(name, "wb");
+    if (!f) {
+        perror(name);
+        return;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    fwrite(rgb, 3, size_t(width) * size_t(height), f);
+    fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <serial_port> [--count <n>] [--baud <rate>] [--window <bytes>]\n", argv[0]);
+        return 1;
+    }
+
+    int count = 1;
+    int baud = 3000000;     // BAUD_RATE in framegrabber.c
+    uint32_t window = 0;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (!strcmp(argv[i], "--count"))
+            count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--baud"))
+            baud = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--window"))
+            window = uint32_t(strtoul(argv[++i], nullptr, 0));
+    }
+
+    Receiver rx;
+    try {
+        rx.start(argv[1], baud);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (window)
+        rx.send(encode_credit(window));
+
+    printf("Waiting for image data (%s kernels)...\n", isa_name(convert_isa()));
+
+    std::vector<uint8_t> rgb;
+    Frame frame;
+    for (int got = 0; got < count; ) {
+        if (!rx.wait_frame(frame, std::chrono::seconds(5))) {
+            printf("No frame for 5 s\n");
+            continue;
+        }
+        if (window)
+            rx.send(encode_credit(uint32_t(HEADER_LEN + frame.payload.size())));
+
+        printf("Frame %u: %ux%u %s, %zu bytes, t=%u us\n", frame.seq, frame.width, frame.height,
+               format_name(frame.format), frame.payload.size(), frame.timestamp_us);
+
+        char name[64];
+        if (frame.format == Format::JPEG) {
+            snprintf(name, sizeof(name), "frame_%u.jpg", frame.seq);
+            FILE* f = fopen(name, "wb");
+            if (f) {
+                fwrite(frame.payload.data(), 1, frame.payload.size(), f);
+                fclose(f);
+            }
+        } else if (frame.flags & FLAG_TILES) {
+            printf("  tile delta frame - skipped\n");
+            continue;
+        } else {
+            rgb.resize(size_t(frame.width) * frame.height * 3);
+            // same orientation as recv_image.py
+            if (!convert(frame.format, frame.payload.data(), frame.width, frame.height,
+                         rgb.data(), Layout::RGB888, true)) {
+                printf("  unsupported format\n");
+                continue;
+            }
+            snprintf(name, sizeof(name), "frame_%u.ppm", frame.seq);
+            save_ppm(name, rgb.data(), frame.width, frame.height);
+        }
+        printf("  saved %s\n", name);
+        got++;
+    }
+
+    ReceiverStats st = rx.stats();
+    printf("%llu bytes, %llu frames, %llu CRC errors, %llu resyncs, %llu lost, %llu dropped\n",
+           (unsigned long long)st.bytes_read, (unsigned long long)st.decoder.frames,
+           (unsigned long long)st.decoder.crc_errors, (unsigned long long)st.decoder.resyncs,
+           (unsigned long long)st.decoder.lost_frames, (unsigned long long)st.frames_dropped);
+    return 0;
+}